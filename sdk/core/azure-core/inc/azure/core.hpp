@@ -11,6 +11,7 @@
  */
 
 // azure/core
+#include "azure/core/buffer_pool.hpp"
 #include "azure/core/context.hpp"
 #include "azure/core/credentials.hpp"
 #include "azure/core/datetime.hpp"
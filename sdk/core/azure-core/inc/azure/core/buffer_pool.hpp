@@ -0,0 +1,193 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// SPDX-License-Identifier: MIT
+
+/**
+ * @file
+ * @brief Pool of the byte buffers re-used by the chunks of transfers.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Azure { namespace Core {
+
+  /**
+   * @brief Counters of a #BufferPool since it was created.
+   */
+  struct BufferPoolStatistics
+  {
+    /**
+     * @brief Number of buffers handed out by #BufferPool::Acquire.
+     */
+    int64_t AcquireCount = 0;
+
+    /**
+     * @brief Number of buffers handed out which were re-used rather than allocated. The hit rate
+     * is HitCount / AcquireCount.
+     */
+    int64_t HitCount = 0;
+
+    /**
+     * @brief Number of buffers given back with #BufferPool::Release.
+     */
+    int64_t ReleaseCount = 0;
+
+    /**
+     * @brief Bytes of the buffers handed out and not given back yet.
+     *
+     * @remark Counted from the capacity of the buffers when handed out and given back, so
+     * buffers grown in between or given back without being acquired from the pool make it an
+     * estimate.
+     */
+    int64_t BytesInUse = 0;
+
+    /**
+     * @brief Highest value of BytesInUse.
+     */
+    int64_t PeakBytesInUse = 0;
+
+    /**
+     * @brief Bytes of the buffers kept by the pool for re-use.
+     */
+    int64_t BytesPooled = 0;
+
+    /**
+     * @brief Highest value of BytesPooled.
+     */
+    int64_t PeakBytesPooled = 0;
+  };
+
+  /**
+   * @brief Source of the byte buffers of the chunks of transfers, such as the blocks staged by
+   * uploads and the chunks read ahead by downloads.
+   *
+   * @remark Buffers are plain `std::vector<uint8_t>`, the pool re-uses their allocations. A
+   * buffer which isn't given back is freed as usual when destroyed.
+   *
+   * @remark HTTP response bodies and the buffers sending request bodies aren't taken from the
+   * pool, so the content of other requests, such as secrets, doesn't end up in re-used buffers.
+   *
+   * @remark Implementations must be safe to call from several threads at once. The default pool
+   * can be replaced with #SetDefault, for example by one with other limits, or by one which never
+   * keeps buffers to turn pooling off.
+   */
+  class BufferPool {
+  public:
+    virtual ~BufferPool() = default;
+
+    /**
+     * @brief Get a buffer of \p size bytes.
+     *
+     * @remark The content of the buffer is unspecified.
+     */
+    virtual std::vector<uint8_t> Acquire(std::size_t size) = 0;
+
+    /**
+     * @brief Get a buffer holding \p size bytes which start at an address aligned to
+     * \p alignment, a power of two. The first of them is found with #GetAlignedData.
+     *
+     * @remark The buffer is up to `alignment - 1` bytes larger than \p size, for the bytes
+     * before the aligned ones.
+     */
+    std::vector<uint8_t> Acquire(std::size_t size, std::size_t alignment)
+    {
+      return Acquire(size + alignment - 1);
+    }
+
+    /**
+     * @brief Get the first byte of \p buffer at an address aligned to \p alignment, a power of
+     * two.
+     */
+    static uint8_t* GetAlignedData(std::vector<uint8_t>& buffer, std::size_t alignment);
+
+    /**
+     * @brief Give back a buffer for re-use. It may be one not acquired from the pool.
+     *
+     * @remark Implementations should clear the content of buffers they keep.
+     */
+    virtual void Release(std::vector<uint8_t> buffer) = 0;
+
+    /**
+     * @brief Get the counters of the pool.
+     */
+    virtual BufferPoolStatistics GetStatistics() const = 0;
+
+    /**
+     * @brief Get the pool used by the SDK, a #SizeClassedBufferPool with default limits unless
+     * replaced.
+     */
+    static std::shared_ptr<BufferPool> GetDefault();
+
+    /**
+     * @brief Replace the pool used by the SDK. Buffers acquired from the previous pool are given
+     * back to the new one.
+     *
+     * @param pool The new pool, nullptr to go back to a #SizeClassedBufferPool with default
+     * limits.
+     */
+    static void SetDefault(std::shared_ptr<BufferPool> pool);
+  };
+
+  /**
+   * @brief #BufferPool keeping buffers in size classes of powers of two.
+   *
+   * @remark A buffer is handed out from the class of the smallest power of two at least as large
+   * as the size asked for, and allocated with the capacity of the class when the class is empty.
+   * A buffer given back goes to the class of the largest power of two no larger than its
+   * capacity, unless the pool already keeps MaxPooledBytes or the buffer is outside the range of
+   * the classes, in which case it is freed. A buffer kept is filled with zeros first.
+   */
+  class SizeClassedBufferPool : public BufferPool {
+  public:
+    /**
+     * @brief Default smallest size class, 4KiB.
+     */
+    static constexpr std::size_t DefaultMinBufferSize = 4 * 1024;
+
+    /**
+     * @brief Default largest size class, 64MiB.
+     */
+    static constexpr std::size_t DefaultMaxBufferSize = 64 * 1024 * 1024;
+
+    /**
+     * @brief Default max bytes kept for re-use, 64MiB.
+     */
+    static constexpr std::size_t DefaultMaxPooledBytes = 64 * 1024 * 1024;
+
+    /**
+     * @brief Construct a pool.
+     *
+     * @param minBufferSize Smallest size class, rounded up to a power of two.
+     * @param maxBufferSize Largest size class. Larger buffers aren't pooled.
+     * @param maxPooledBytes Max bytes of the buffers kept for re-use.
+     */
+    explicit SizeClassedBufferPool(
+        std::size_t minBufferSize = DefaultMinBufferSize,
+        std::size_t maxBufferSize = DefaultMaxBufferSize,
+        std::size_t maxPooledBytes = DefaultMaxPooledBytes);
+
+    using BufferPool::Acquire;
+
+    std::vector<uint8_t> Acquire(std::size_t size) override;
+
+    void Release(std::vector<uint8_t> buffer) override;
+
+    BufferPoolStatistics GetStatistics() const override;
+
+  private:
+    std::size_t m_minBufferSizeLog2 = 0;
+    std::size_t const m_maxBufferSize;
+    std::size_t const m_maxPooledBytes;
+
+    mutable std::mutex m_mutex;
+    // Free buffers of each size class, from the smallest one.
+    std::vector<std::vector<std::vector<uint8_t>>> m_classes;
+    BufferPoolStatistics m_statistics;
+  };
+
+}} // namespace Azure::Core
@@ -89,6 +89,75 @@ namespace Azure { namespace Core { namespace Http {
      *
      */
     CurlTransportSSLOptions SSLOptions;
+
+    /**
+     * @brief The maximum number of connections, in use or waiting in the connection pool, that
+     * can be open at the same time to one host.
+     *
+     * @remark When the limit is reached, a request waits in a first-in first-out queue until a
+     * connection is moved back to the connection pool or closed, instead of opening a new
+     * connection. Waiting can be cancelled with the #Context used to send the request.
+     *
+     * @remark The default value is `0`, which means no limit.
+     */
+    size_t MaxConnectionsPerHost = 0;
+
+    /**
+     * @brief The maximum number of idle connections to one host kept in the connection pool.
+     *
+     * @remark Connections moved back to a connection pool which already has this many idle
+     * connections for the host are closed.
+     *
+     * @remark With `Http2Multiplexing`, and for #CurlTransport::SendAsync, this caps all the
+     * connections open to the host, busy or idle, as when `MaxConnectionsPerHost` is set to the
+     * lower of both values.
+     *
+     * @remark The default value is `0`, which means no limit.
+     */
+    size_t MaxIdleConnectionsPerHost = 0;
+
+    /**
+     * @brief The size, in bytes, of the buffer used to read HTTP responses from the network.
+     *
+     * @remark Status line, headers and body reads smaller than this size are read from the network
+     * into this buffer, so a single read from the socket can serve many of them. Body reads of this
+     * size or larger go straight from the network into the caller's buffer.
+     *
+     * @remark The default value is 16 KiB. Values between 16 KiB and 256 KiB trade memory per
+     * request for fewer reads from the socket. A value of `0` uses the default.
+     */
+    size_t ReadBufferSize = 1024 * 16;
+
+    /**
+     * @brief The size, in bytes, of the pieces a request body is read and sent to the network in.
+     *
+     * @remark The HTTP headers are sent together with the first piece. A `PUT` request with a body
+     * that fits in one piece is sent at once, without waiting for a `100 Continue` response.
+     *
+     * @remark A size set with #Azure::Core::Http::Request::SetUploadChunkSize takes precedence.
+     * The default value is 64 KiB. A value of `0` uses the default.
+     */
+    size_t UploadChunkSize = 1024 * 64;
+
+    /**
+     * @brief Send requests to a host over a few shared connections, as HTTP/2 streams.
+     *
+     * @remark A single thread drives the requests to all the hosts with the libcurl multi
+     * interface. Requests sent at the same time are multiplexed over one connection when the server
+     * supports HTTP/2, which is negotiated for `https` URLs. Otherwise, connections are re-used
+     * between requests like with HTTP/1.1. The body of a response is received from the network
+     * while it is read.
+     *
+     * @remark `MaxConnectionsPerHost` applies to the connections of the host and
+     * `MaxIdleConnectionsPerHost` caps them too, busy or idle. #CurlTransport::Prewarm doesn't
+     * open connections for this mode.
+     *
+     * @remark #CurlTransport::SendAsync always sends requests this way. This option only selects
+     * whether HTTP/2 is negotiated for them.
+     *
+     * @remark The default value is `false`.
+     */
+    bool Http2Multiplexing = false;
   };
 
   /**
@@ -117,6 +186,43 @@ namespace Azure { namespace Core { namespace Http {
      * @return unique ptr to an HTTP RawResponse.
      */
     std::unique_ptr<RawResponse> Send(Context const& context, Request& request) override;
+
+    /**
+     * @brief Start sending an HTTP request without waiting for the response.
+     *
+     * @remark Requests are driven by a single thread for the whole application with the libcurl
+     * multi interface, the same way as with `Http2Multiplexing`, so many requests can be in flight
+     * without a thread each. The future is ready once the response headers are received. The body
+     * of the response is received from the network while it is read.
+     *
+     * @remark The request body is read into memory before this returns, \p request doesn't have
+     * to be kept alive after that. Dropping the future cancels the transfer once the response
+     * headers are received.
+     *
+     * @param context #Context so that operation can be cancelled.
+     * @param request an HTTP Request to be send.
+     * @return A future for the response, or for the exception thrown while sending the request.
+     */
+    std::future<std::unique_ptr<RawResponse>> SendAsync(Context const& context, Request& request)
+        override;
+
+    /**
+     * @brief Opens connections to the host of \p url in parallel and keeps them in the connection
+     * pool, so the first requests to the host don't pay for DNS resolution and TCP and TLS
+     * handshakes.
+     *
+     * @remark Connections already in the pool for the host count toward \p connectionCount. When
+     * `MaxConnectionsPerHost` is set, no more than that number of connections are opened.
+     *
+     * @param context #Context so that operation can be cancelled.
+     * @param url The URL of the host to connect to. No request is sent to it.
+     * @param connectionCount The number of connections to keep in the pool for the host.
+     *
+     * @throw TransportException if a connection can't be opened.
+     * @throw OperationCancelledException if \p context is cancelled, including while waiting for
+     * a connection when `MaxConnectionsPerHost` is reached.
+     */
+    void Prewarm(Context const& context, Url const& url, size_t connectionCount);
   };
 
 }}} // namespace Azure::Core::Http
@@ -15,12 +15,15 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <functional>
+#include <initializer_list>
 #include <map>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #if defined(TESTING_BUILD)
@@ -33,21 +36,236 @@ namespace Azure { namespace Core { namespace Test {
 
 namespace Azure { namespace Core { namespace Http {
 
+  /**
+   * @brief A collection of HTTP headers, sorted by name in one contiguous array.
+   *
+   * @remark Names are stored in lower case and looked up ignoring case, without allocating. Each
+   * header is a `std::pair` of name (`first`) and value (`second`), and iteration follows name
+   * order, as for a `std::map`.
+   *
+   * @remark Names and values are owned strings rather than views into a single buffer because
+   * #at() and iteration hand out `std::string` references.
+   *
+   * @remark Code written for the `std::map<std::string, std::string>` that held headers before
+   * keeps working: the collection converts to such a map, and has the same lookup and iteration
+   * members.
+   */
+  class CaseInsensitiveHeaders {
+  public:
+    /**
+     * @brief A header, as a pair of name and value.
+     */
+    using value_type = std::pair<std::string, std::string>;
+
+    /**
+     * @brief Iterator over the headers. Headers can't be modified through it.
+     */
+    using const_iterator = std::vector<value_type>::const_iterator;
+
+    /**
+     * @brief Iterator over the headers. Headers can't be modified through it.
+     */
+    using iterator = const_iterator;
+
+  private:
+    std::vector<value_type> m_headers;
+
+    const_iterator LowerBound(char const* name, size_t nameSize) const;
+    const_iterator Find(char const* name, size_t nameSize) const;
+    std::string const& At(char const* name, size_t nameSize) const;
+
+  public:
+    /**
+     * @brief Construct an empty collection of headers.
+     */
+    CaseInsensitiveHeaders() = default;
+
+    /**
+     * @brief Construct a collection of headers from name and value pairs.
+     *
+     * @remark When a name is repeated, the last value is kept.
+     */
+    CaseInsensitiveHeaders(std::initializer_list<value_type> headers)
+    {
+      for (auto const& header : headers)
+      {
+        insert_or_assign(header.first, header.second);
+      }
+    }
+
+    /**
+     * @brief Compare headers, names and values, for equality.
+     */
+    bool operator==(CaseInsensitiveHeaders const& other) const
+    {
+      return m_headers == other.m_headers;
+    }
+
+    /**
+     * @brief Compare headers, names and values, for inequality.
+     */
+    bool operator!=(CaseInsensitiveHeaders const& other) const { return !(*this == other); }
+
+    /**
+     * @brief Copy the headers into a map of lower case names to values.
+     */
+    operator std::map<std::string, std::string>() const
+    {
+      return std::map<std::string, std::string>(m_headers.begin(), m_headers.end());
+    }
+
+    /**
+     * @brief Get an iterator to the first header.
+     */
+    const_iterator begin() const noexcept { return m_headers.begin(); }
+
+    /**
+     * @brief Get an iterator past the last header.
+     */
+    const_iterator end() const noexcept { return m_headers.end(); }
+
+    /**
+     * @brief Get the number of headers.
+     */
+    size_t size() const noexcept { return m_headers.size(); }
+
+    /**
+     * @brief Check whether there are no headers.
+     */
+    bool empty() const noexcept { return m_headers.empty(); }
+
+    /**
+     * @brief Find a header by name, ignoring case.
+     *
+     * @param name Header name.
+     * @return An iterator to the header, or #end() if there is none with \p name.
+     */
+    const_iterator find(std::string const& name) const { return Find(name.data(), name.size()); }
+
+    /**
+     * @brief Find a header by name, ignoring case.
+     *
+     * @param name Header name.
+     * @return An iterator to the header, or #end() if there is none with \p name.
+     */
+    const_iterator find(char const* name) const { return Find(name, std::strlen(name)); }
+
+    /**
+     * @brief Get the first header with a name not less than \p name, ignoring case.
+     *
+     * @remark Used to iterate over headers sharing a prefix, such as `x-ms-meta-`.
+     *
+     * @param name Header name or name prefix.
+     */
+    const_iterator lower_bound(std::string const& name) const
+    {
+      return LowerBound(name.data(), name.size());
+    }
+
+    /**
+     * @brief Get the first header with a name not less than \p name, ignoring case.
+     *
+     * @remark Used to iterate over headers sharing a prefix, such as `x-ms-meta-`.
+     *
+     * @param name Header name or name prefix.
+     */
+    const_iterator lower_bound(char const* name) const
+    {
+      return LowerBound(name, std::strlen(name));
+    }
+
+    /**
+     * @brief Get the number of headers named \p name, ignoring case. Either `0` or `1`.
+     */
+    size_t count(std::string const& name) const { return find(name) == end() ? 0 : 1; }
+
+    /**
+     * @brief Get the number of headers named \p name, ignoring case. Either `0` or `1`.
+     */
+    size_t count(char const* name) const { return find(name) == end() ? 0 : 1; }
+
+    /**
+     * @brief Get the value of the header named \p name, ignoring case.
+     *
+     * @throw std::out_of_range if there is no header with \p name.
+     */
+    std::string const& at(std::string const& name) const { return At(name.data(), name.size()); }
+
+    /**
+     * @brief Get the value of the header named \p name, ignoring case.
+     *
+     * @throw std::out_of_range if there is no header with \p name.
+     */
+    std::string const& at(char const* name) const { return At(name, std::strlen(name)); }
+
+    /**
+     * @brief Get the value of the header named \p name, ignoring case, adding the header with an
+     * empty value if there is none.
+     *
+     * @remark \p name is stored in lower case.
+     */
+    std::string& operator[](std::string const& name);
+
+    /**
+     * @brief Set the value of the header named \p name, adding the header if there is none.
+     *
+     * @remark \p name is stored in lower case.
+     *
+     * @param name Header name.
+     * @param value Header value.
+     */
+    void insert_or_assign(std::string name, std::string value);
+
+    /**
+     * @brief Remove the header named \p name, ignoring case.
+     *
+     * @return The number of headers removed. Either `0` or `1`.
+     */
+    size_t erase(std::string const& name);
+
+    /**
+     * @brief Remove all headers.
+     */
+    void clear() noexcept { m_headers.clear(); }
+  };
+
   namespace Details {
     /**
      * @brief Insert a header into \p headers checking that \p headerName does not contain invalid
      * characters.
      *
-     * @param headers The headers map where to insert header.
+     * @param headers The headers where to insert header.
      * @param headerName The header name for the header to be inserted.
      * @param headerValue The header value for the header to be inserted.
      *
      * @throw if \p headerName is invalid.
      */
     void InsertHeaderWithValidation(
-        std::map<std::string, std::string>& headers,
+        CaseInsensitiveHeaders& headers,
         std::string const& headerName,
         std::string const& headerValue);
+
+    /**
+     * @brief Insert a header into \p headers from the name and value found in a buffer, checking
+     * that the name does not contain invalid characters.
+     *
+     * @remark The name is converted to lower case while it is validated. Only the strings stored
+     * in \p headers are allocated.
+     *
+     * @param headers The headers where to insert header.
+     * @param nameFirst Reference to the start of the header name.
+     * @param nameLast Reference to the end of the header name.
+     * @param valueFirst Reference to the start of the header value.
+     * @param valueLast Reference to the end of the header value.
+     *
+     * @throw if the header name is invalid.
+     */
+    void InsertHeaderWithValidation(
+        CaseInsensitiveHeaders& headers,
+        uint8_t const* nameFirst,
+        uint8_t const* nameLast,
+        uint8_t const* valueFirst,
+        uint8_t const* valueLast);
   } // namespace Details
 
   /*********************  Exceptions  **********************/
@@ -458,8 +676,11 @@ namespace Azure { namespace Core { namespace Http {
   private:
     HttpMethod m_method;
     Url m_url;
-    std::map<std::string, std::string> m_headers;
-    std::map<std::string, std::string> m_retryHeaders;
+    CaseInsensitiveHeaders m_headers;
+
+    // Headers added since the last StartTry(), with the value each one replaced, if any. Used to
+    // put the headers back as they were on the next try.
+    std::vector<std::pair<std::string, Nullable<std::string>>> m_retryHeaders;
 
     BodyStream* m_bodyStream;
 
@@ -558,8 +779,11 @@ namespace Azure { namespace Core { namespace Http {
 
     /**
      * @brief Get HTTP headers.
+     *
+     * @remark Headers added during the current try take precedence over the ones with the same
+     * name added before.
      */
-    std::map<std::string, std::string> GetHeaders() const;
+    CaseInsensitiveHeaders const& GetHeaders() const;
 
     /**
      * @brief Get HTTP body as #BodyStream.
@@ -610,7 +834,7 @@ namespace Azure { namespace Core { namespace Http {
     int32_t m_minorVersion;
     HttpStatusCode m_statusCode;
     std::string m_reasonPhrase;
-    std::map<std::string, std::string> m_headers;
+    CaseInsensitiveHeaders m_headers;
 
     std::unique_ptr<BodyStream> m_bodyStream;
     std::vector<uint8_t> m_body;
@@ -726,7 +950,7 @@ namespace Azure { namespace Core { namespace Http {
     /**
      * @brief Get HTTP response headers.
      */
-    std::map<std::string, std::string> const& GetHeaders() const;
+    CaseInsensitiveHeaders const& GetHeaders() const;
 
     /**
      * @brief Get HTTP response body as #BodyStream.
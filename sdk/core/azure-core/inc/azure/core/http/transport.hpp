@@ -11,6 +11,9 @@
 #include "azure/core/context.hpp"
 #include "azure/core/http/http.hpp"
 
+#include <future>
+#include <memory>
+
 namespace Azure { namespace Core { namespace Http {
 
   /**
@@ -31,6 +34,28 @@ namespace Azure { namespace Core { namespace Http {
     // TODO - Should this be const
     virtual std::unique_ptr<RawResponse> Send(Context const& context, Request& request) = 0;
 
+    /**
+     * @brief Start sending an HTTP request over the wire, without waiting for the response.
+     *
+     * @remark \p request must be kept alive until the future is ready and the body stream of the
+     * response is destroyed.
+     *
+     * @remark The default implementation calls #Send on a new thread. Transports able to drive
+     * many requests from one thread override it.
+     *
+     * @param context #Context so that operation can be cancelled.
+     * @param request An HTTP #Request to send.
+     * @return A future for the response, or for the exception thrown while sending the request.
+     */
+    virtual std::future<std::unique_ptr<RawResponse>> SendAsync(
+        Context const& context,
+        Request& request)
+    {
+      // The context is copied, it doesn't have to outlive this call.
+      return std::async(
+          std::launch::async, [this, context, &request]() { return Send(context, request); });
+    }
+
     /// Destructor.
     virtual ~HttpTransport() {}
 
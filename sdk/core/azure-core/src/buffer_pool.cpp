@@ -0,0 +1,136 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// SPDX-License-Identifier: MIT
+
+#include "azure/core/buffer_pool.hpp"
+
+#include <algorithm>
+
+using namespace Azure::Core;
+
+namespace {
+// Leaked, so transfers finishing while the application exits can still give back their buffers.
+// Read and replaced with the atomic functions of shared_ptr.
+std::shared_ptr<BufferPool>& GetDefaultBufferPool()
+{
+  static std::shared_ptr<BufferPool>* defaultBufferPool
+      = new std::shared_ptr<BufferPool>(std::make_shared<SizeClassedBufferPool>());
+  return *defaultBufferPool;
+}
+
+// Index of the highest bit set, value must not be 0.
+std::size_t Log2Floor(std::size_t value)
+{
+  std::size_t log2 = 0;
+  while (value >>= 1)
+  {
+    ++log2;
+  }
+  return log2;
+}
+
+std::size_t Log2Ceil(std::size_t value) { return value <= 1 ? 0 : Log2Floor(value - 1) + 1; }
+} // namespace
+
+constexpr std::size_t SizeClassedBufferPool::DefaultMinBufferSize;
+constexpr std::size_t SizeClassedBufferPool::DefaultMaxBufferSize;
+constexpr std::size_t SizeClassedBufferPool::DefaultMaxPooledBytes;
+
+std::shared_ptr<BufferPool> BufferPool::GetDefault()
+{
+  return std::atomic_load(&GetDefaultBufferPool());
+}
+
+void BufferPool::SetDefault(std::shared_ptr<BufferPool> pool)
+{
+  if (!pool)
+  {
+    pool = std::make_shared<SizeClassedBufferPool>();
+  }
+  std::atomic_store(&GetDefaultBufferPool(), std::move(pool));
+}
+
+uint8_t* BufferPool::GetAlignedData(std::vector<uint8_t>& buffer, std::size_t alignment)
+{
+  const auto address = reinterpret_cast<std::uintptr_t>(buffer.data());
+  return buffer.data() + ((alignment - address % alignment) & (alignment - 1));
+}
+
+SizeClassedBufferPool::SizeClassedBufferPool(
+    std::size_t minBufferSize,
+    std::size_t maxBufferSize,
+    std::size_t maxPooledBytes)
+    : m_minBufferSizeLog2(Log2Ceil(std::max<std::size_t>(minBufferSize, 1))),
+      m_maxBufferSize(maxBufferSize), m_maxPooledBytes(maxPooledBytes)
+{
+  if (m_maxBufferSize >= (std::size_t(1) << m_minBufferSizeLog2))
+  {
+    m_classes.resize(Log2Floor(m_maxBufferSize) - m_minBufferSizeLog2 + 1);
+  }
+}
+
+std::vector<uint8_t> SizeClassedBufferPool::Acquire(std::size_t size)
+{
+  const std::size_t sizeLog2 = std::max(Log2Ceil(size), m_minBufferSizeLog2);
+  const std::size_t sizeClass = sizeLog2 - m_minBufferSizeLog2;
+  const bool pooled = sizeClass < m_classes.size();
+  // Allocated with the capacity of the class, so it goes back to the same class.
+  const std::size_t capacity = pooled ? std::size_t(1) << sizeLog2 : size;
+  std::vector<uint8_t> buffer;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    ++m_statistics.AcquireCount;
+    if (pooled && !m_classes[sizeClass].empty())
+    {
+      buffer = std::move(m_classes[sizeClass].back());
+      m_classes[sizeClass].pop_back();
+      ++m_statistics.HitCount;
+      m_statistics.BytesPooled -= static_cast<int64_t>(buffer.capacity());
+    }
+    m_statistics.BytesInUse
+        += static_cast<int64_t>(buffer.capacity() ? buffer.capacity() : capacity);
+    m_statistics.PeakBytesInUse = std::max(m_statistics.PeakBytesInUse, m_statistics.BytesInUse);
+  }
+
+  if (buffer.capacity() == 0)
+  {
+    buffer.reserve(capacity);
+  }
+  // A re-used buffer was already cleared, only bytes past its current size are initialized.
+  buffer.resize(size);
+  return buffer;
+}
+
+void SizeClassedBufferPool::Release(std::vector<uint8_t> buffer)
+{
+  const std::size_t capacity = buffer.capacity();
+  const bool poolable
+      = capacity >= (std::size_t(1) << m_minBufferSizeLog2) && capacity <= m_maxBufferSize;
+  if (poolable)
+  {
+    // Cleared outside of the lock, the content of a transfer doesn't outlive it in the pool.
+    buffer.assign(capacity, 0);
+  }
+
+  std::lock_guard<std::mutex> guard(m_mutex);
+  ++m_statistics.ReleaseCount;
+  m_statistics.BytesInUse
+      -= std::min(m_statistics.BytesInUse, static_cast<int64_t>(capacity));
+
+  if (!poolable
+      || static_cast<std::size_t>(m_statistics.BytesPooled) + capacity > m_maxPooledBytes)
+  {
+    // Freed when the buffer goes out of scope.
+    return;
+  }
+  const std::size_t sizeClass
+      = std::min(Log2Floor(capacity) - m_minBufferSizeLog2, m_classes.size() - 1);
+  m_classes[sizeClass].push_back(std::move(buffer));
+  m_statistics.BytesPooled += static_cast<int64_t>(capacity);
+  m_statistics.PeakBytesPooled = std::max(m_statistics.PeakBytesPooled, m_statistics.BytesPooled);
+}
+
+BufferPoolStatistics SizeClassedBufferPool::GetStatistics() const
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_statistics;
+}
@@ -54,17 +54,37 @@ int64_t BodyStream::ReadToCount(
 std::vector<uint8_t> BodyStream::ReadToEnd(Context const& context, BodyStream& body)
 {
   constexpr int64_t chunkSize = 1024 * 8;
-  auto buffer = std::vector<uint8_t>();
+  constexpr int64_t maxInitialSize = 64 * 1024 * 1024;
+  const int64_t length = body.Length();
+  auto buffer = std::vector<uint8_t>(
+      static_cast<size_t>(length >= 0 ? std::min(length, maxInitialSize) : chunkSize));
 
-  for (auto chunkNumber = 0;; chunkNumber++)
+  int64_t totalRead = 0;
+  for (;;)
   {
-    buffer.resize((static_cast<decltype(buffer)::size_type>(chunkNumber) + 1) * chunkSize);
-    int64_t readBytes
-        = ReadToCount(context, body, buffer.data() + (chunkNumber * chunkSize), chunkSize);
+    if (static_cast<size_t>(totalRead) == buffer.size())
+    {
+      if (totalRead == length)
+      {
+        // All the bytes announced were read, check the end with a small read rather than by
+        // growing the buffer.
+        uint8_t probe[1];
+        if (ReadToCount(context, body, probe, sizeof(probe)) == 0)
+        {
+          return buffer;
+        }
+        buffer.push_back(probe[0]);
+        ++totalRead;
+      }
+      buffer.resize(buffer.size() + chunkSize);
+    }
+    const int64_t count = static_cast<int64_t>(buffer.size()) - totalRead;
+    int64_t readBytes = ReadToCount(context, body, buffer.data() + totalRead, count);
+    totalRead += readBytes;
 
-    if (readBytes < chunkSize)
+    if (readBytes < count)
     {
-      buffer.resize(static_cast<size_t>((chunkNumber * chunkSize) + readBytes));
+      buffer.resize(static_cast<size_t>(totalRead));
       return buffer;
     }
   }
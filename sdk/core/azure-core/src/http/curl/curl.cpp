@@ -6,11 +6,13 @@
 #include "azure/core/http/policy.hpp"
 #include "azure/core/http/transport.hpp"
 #include "azure/core/internal/log.hpp"
+#include "azure/core/internal/strings.hpp"
 #include "azure/core/platform.hpp"
 
 // Private incude
 #include "curl_connection_pool_private.hpp"
 #include "curl_connection_private.hpp"
+#include "curl_multiplexer_private.hpp"
 #include "curl_session_private.hpp"
 
 #if defined(AZ_PLATFORM_POSIX)
@@ -20,9 +22,18 @@
 #endif
 
 #include <algorithm>
+#include <condition_variable>
+#include <cstring>
 #include <curl/curl.h>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <queue>
+#include <set>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace {
 // Can be used from anywhere a little simpler
@@ -147,6 +158,9 @@ void WinSocketSetBuffSize(curl_socket_t socket)
 using Azure::Core::Context;
 using Azure::Core::Http::CurlConnection;
 using Azure::Core::Http::CurlConnectionPool;
+using Azure::Core::Http::CurlMultiplexedBodyStream;
+using Azure::Core::Http::CurlMultiplexedTransfer;
+using Azure::Core::Http::CurlMultiplexer;
 using Azure::Core::Http::CurlNetworkConnection;
 using Azure::Core::Http::CurlSession;
 using Azure::Core::Http::CurlTransport;
@@ -156,13 +170,23 @@ using Azure::Core::Http::LogClassification;
 using Azure::Core::Http::RawResponse;
 using Azure::Core::Http::Request;
 using Azure::Core::Http::TransportException;
+using Azure::Core::Http::Url;
 
 std::unique_ptr<RawResponse> CurlTransport::Send(Context const& context, Request& request)
 {
+  if (m_options.Http2Multiplexing)
+  {
+    return CurlMultiplexer::Send(context, request, m_options);
+  }
+
   // Create CurlSession to perform request
   LogThis("Creating a new session.");
   auto session = std::make_unique<CurlSession>(
-      request, CurlConnectionPool::GetCurlConnection(request, m_options), m_options.HttpKeepAlive);
+      request,
+      CurlConnectionPool::GetCurlConnection(context, request, m_options),
+      m_options.HttpKeepAlive,
+      m_options.ReadBufferSize,
+      m_options.UploadChunkSize);
   CURLcode performing;
 
   // Try to send the request. If we get CURLE_UNSUPPORTED_PROTOCOL back, it means the connection is
@@ -178,11 +202,21 @@ std::unique_ptr<RawResponse> CurlTransport::Send(Context const& context, Request
     {
       break;
     }
-    // Let session be destroyed and create a new one to get a new connection
+    // Let session be destroyed before getting a new connection. The broken connection still
+    // counts against the host connection limit until it is closed.
+    session.reset();
+    // The first piece of the body is sent along with the headers, so the failed attempt may have
+    // read from the body stream already. Send it again from the start.
+    if (auto bodyStream = request.GetBodyStream())
+    {
+      bodyStream->Rewind();
+    }
     session = std::make_unique<CurlSession>(
         request,
-        CurlConnectionPool::GetCurlConnection(request, m_options),
-        m_options.HttpKeepAlive);
+        CurlConnectionPool::GetCurlConnection(context, request, m_options),
+        m_options.HttpKeepAlive,
+        m_options.ReadBufferSize,
+        m_options.UploadChunkSize);
   }
 
   if (performing != CURLE_OK)
@@ -199,6 +233,57 @@ std::unique_ptr<RawResponse> CurlTransport::Send(Context const& context, Request
   return response;
 }
 
+std::future<std::unique_ptr<RawResponse>> CurlTransport::SendAsync(
+    Context const& context,
+    Request& request)
+{
+  return CurlMultiplexer::SendAsync(context, request, m_options);
+}
+
+void CurlTransport::Prewarm(Context const& context, Url const& url, size_t connectionCount)
+{
+  if (m_options.MaxConnectionsPerHost > 0)
+  {
+    // Getting more connections than the limit would wait forever for our own connections.
+    connectionCount = std::min(connectionCount, m_options.MaxConnectionsPerHost);
+  }
+
+  // Connections are opened with connect-only mode, nothing is sent to the url path.
+  Request request(HttpMethod::Get, url);
+
+  LogThis("Opening " + std::to_string(connectionCount) + " connections to " + url.GetHost());
+  // All connections are held until every connection is opened. Otherwise a connection moved back
+  // to the pool would be taken by another task instead of opening a new one.
+  std::vector<std::future<std::unique_ptr<CurlNetworkConnection>>> connectionTasks;
+  for (size_t i = 0; i < connectionCount; i++)
+  {
+    connectionTasks.emplace_back(std::async(std::launch::async, [&]() {
+      return CurlConnectionPool::GetCurlConnection(context, request, m_options);
+    }));
+  }
+
+  std::exception_ptr firstError;
+  for (auto& task : connectionTasks)
+  {
+    try
+    {
+      // Connections were not used to send a request, they are as good as after an OK response.
+      CurlConnectionPool::MoveConnectionBackToPool(task.get(), HttpStatusCode::Ok);
+    }
+    catch (...)
+    {
+      if (!firstError)
+      {
+        firstError = std::current_exception();
+      }
+    }
+  }
+  if (firstError)
+  {
+    std::rethrow_exception(firstError);
+  }
+}
+
 CURLcode CurlSession::Perform(Context const& context)
 {
 
@@ -207,7 +292,7 @@ CURLcode CurlSession::Perform(Context const& context)
 
   // LibCurl settings after connection is open (headers)
   {
-    auto headers = this->m_request.GetHeaders();
+    auto const& headers = this->m_request.GetHeaders();
     auto hostHeader = headers.find("Host");
     if (hostHeader == headers.end())
     {
@@ -223,8 +308,13 @@ CURLcode CurlSession::Perform(Context const& context)
     }
   }
 
-  // use expect:100 for PUT requests. Server will decide if it can take our request
-  if (this->m_request.GetMethod() == HttpMethod::Put)
+  // use expect:100 for PUT requests. Server will decide if it can take our request. Skip it when
+  // the body is sent in one piece, together with the headers; the round trip would cost more than
+  // sending the body for nothing.
+  auto bodyLength = this->m_request.GetBodyStream()->Length();
+  this->m_expectContinue = this->m_request.GetMethod() == HttpMethod::Put
+      && (bodyLength < 0 || bodyLength > GetUploadChunkSize());
+  if (this->m_expectContinue)
   {
     LogThis("Using 100-continue for PUT request");
     this->m_request.AddHeader("expect", "100-continue");
@@ -243,9 +333,10 @@ CURLcode CurlSession::Perform(Context const& context)
   LogThis("Parse server response");
   ReadStatusLineAndHeadersFromRawResponse(context);
 
-  // non-PUT request are ready to be stream at this point. Only PUT request would start an uploading
-  // transfer where we want to maintain the `PERFORM` state.
-  if (this->m_request.GetMethod() != HttpMethod::Put)
+  // Requests sent along with their body are ready to be stream at this point. Only PUT request
+  // waiting for 100-continue would start an uploading transfer where we want to maintain the
+  // `PERFORM` state.
+  if (!this->m_expectContinue)
   {
     m_sessionState = SessionState::STREAMING;
     return result;
@@ -294,19 +385,20 @@ static std::unique_ptr<RawResponse> CreateHTTPResponse(
     uint8_t const* const last)
 {
   // set response code, http version and reason phrase (i.e. HTTP/1.1 200 OK)
+  // HTTP/2 status lines have neither minor version nor reason phrase (i.e. HTTP/2 200)
   auto start = begin + 5; // HTTP = 4, / = 1, moving to 5th place for version
-  auto end = std::find(start, last, '.');
+  auto const versionEnd = std::find(start, last, ' ');
+  auto end = std::find(start, versionEnd, '.');
   auto majorVersion = std::stoi(std::string(start, end));
 
-  start = end + 1; // start of minor version
-  end = std::find(start, last, ' ');
-  auto minorVersion = std::stoi(std::string(start, end));
+  // start of minor version
+  auto minorVersion = end == versionEnd ? 0 : std::stoi(std::string(end + 1, versionEnd));
 
-  start = end + 1; // start of status code
+  start = versionEnd == last ? last : versionEnd + 1; // start of status code
   end = std::find(start, last, ' ');
   auto statusCode = std::stoi(std::string(start, end));
 
-  start = end + 1; // start of reason phrase
+  start = end == last ? last : end + 1; // start of reason phrase
   end = std::find(start, last, '\r');
   auto reasonPhrase = std::string(start, end); // remove \r
 
@@ -385,31 +477,37 @@ CURLcode CurlConnection::SendBuffer(
   return CURLE_OK;
 }
 
-CURLcode CurlSession::UploadBody(Context const& context)
+int64_t CurlSession::GetUploadChunkSize()
+{
+  auto uploadChunkSize = this->m_request.GetUploadChunkSize();
+  return uploadChunkSize > 0 ? uploadChunkSize : this->m_uploadChunkSize;
+}
+
+CURLcode CurlSession::UploadBody(Context const& context, std::string const& messagePreBody)
 {
   // Send body UploadStreamPageSize at a time (libcurl default)
   // NOTE: if stream is on top a contiguous memory, we can avoid allocating this copying buffer
   auto streamBody = this->m_request.GetBodyStream();
   CURLcode sendResult = CURLE_OK;
 
-  int64_t uploadChunkSize = this->m_request.GetUploadChunkSize();
-  if (uploadChunkSize <= 0)
-  {
-    // use default size
-    uploadChunkSize = Details::DefaultUploadChunkSize;
-  }
-  auto unique_buffer = std::make_unique<uint8_t[]>(static_cast<size_t>(uploadChunkSize));
+  int64_t uploadChunkSize = GetUploadChunkSize();
+  auto unique_buffer
+      = std::make_unique<uint8_t[]>(messagePreBody.size() + static_cast<size_t>(uploadChunkSize));
 
-  while (true)
+  // The first piece of the body goes right after the headers, so small requests are sent with a
+  // single write to the socket.
+  std::memcpy(unique_buffer.get(), messagePreBody.data(), messagePreBody.size());
+  for (auto prefixLen = messagePreBody.size();; prefixLen = 0)
   {
-    auto rawRequestLen = streamBody->Read(context, unique_buffer.get(), uploadChunkSize);
-    if (rawRequestLen == 0)
+    auto rawRequestLen
+        = streamBody->Read(context, unique_buffer.get() + prefixLen, uploadChunkSize);
+    auto sendLen = prefixLen + static_cast<size_t>(rawRequestLen);
+    if (sendLen == 0)
     {
       break;
     }
-    sendResult = m_connection->SendBuffer(
-        context, unique_buffer.get(), static_cast<size_t>(rawRequestLen));
-    if (sendResult != CURLE_OK)
+    sendResult = m_connection->SendBuffer(context, unique_buffer.get(), sendLen);
+    if (sendResult != CURLE_OK || rawRequestLen == 0)
     {
       return sendResult;
     }
@@ -422,19 +520,15 @@ CURLcode CurlSession::SendRawHttp(Context const& context)
 {
   // something like GET /path HTTP1.0 \r\nheaders\r\n
   auto rawRequest = this->m_request.GetHTTPMessagePreBody();
-  int64_t rawRequestLen = rawRequest.size();
-
-  CURLcode sendResult = m_connection->SendBuffer(
-      context,
-      reinterpret_cast<uint8_t const*>(rawRequest.data()),
-      static_cast<size_t>(rawRequestLen));
 
-  if (sendResult != CURLE_OK || this->m_request.GetMethod() == HttpMethod::Put)
+  if (!this->m_expectContinue)
   {
-    return sendResult;
+    // Send the headers together with the body
+    return this->UploadBody(context, rawRequest);
   }
 
-  return this->UploadBody(context);
+  return m_connection->SendBuffer(
+      context, reinterpret_cast<uint8_t const*>(rawRequest.data()), rawRequest.size());
 }
 
 void CurlSession::ParseChunkSize(Context const& context)
@@ -489,7 +583,7 @@ void CurlSession::ParseChunkSize(Context const& context)
            * indicate the the next read call should read from the inner buffer start.
            */
           this->m_innerBufferSize = m_connection->ReadFromSocket(
-              context, this->m_readBuffer, Details::DefaultLibcurlReaderSize);
+              context, this->m_readBuffer.get(), this->m_readBufferSize);
           this->m_bodyStartInBuffer = 0;
         }
         else
@@ -509,7 +603,7 @@ void CurlSession::ParseChunkSize(Context const& context)
     if (keepPolling)
     { // Read all internal buffer and \n was not found, pull from wire
       this->m_innerBufferSize = m_connection->ReadFromSocket(
-          context, this->m_readBuffer, Details::DefaultLibcurlReaderSize);
+          context, this->m_readBuffer.get(), this->m_readBufferSize);
       this->m_bodyStartInBuffer = 0;
     }
   }
@@ -534,7 +628,7 @@ void CurlSession::ReadStatusLineAndHeadersFromRawResponse(
       // response. This happens when Server returns a 100-continue plus an error code
       bufferSize = this->m_innerBufferSize - this->m_bodyStartInBuffer;
       bytesParsed = parser.Parse(
-          this->m_readBuffer + this->m_bodyStartInBuffer, static_cast<size_t>(bufferSize));
+          this->m_readBuffer.get() + this->m_bodyStartInBuffer, static_cast<size_t>(bufferSize));
       // if parsing from internal buffer is not enough, do next read from wire
       reuseInternalBuffer = false;
       // reset body start
@@ -545,7 +639,7 @@ void CurlSession::ReadStatusLineAndHeadersFromRawResponse(
       // Try to fill internal buffer from socket.
       // If response is smaller than buffer, we will get back the size of the response
       bufferSize = m_connection->ReadFromSocket(
-          context, this->m_readBuffer, Details::DefaultLibcurlReaderSize);
+          context, this->m_readBuffer.get(), this->m_readBufferSize);
       if (bufferSize == 0)
       {
         // closed connection, prevent application from keep trying to pull more bytes from the wire
@@ -553,7 +647,7 @@ void CurlSession::ReadStatusLineAndHeadersFromRawResponse(
             "Connection was closed by the server while trying to read a response");
       }
       // returns the number of bytes parsed up to the body Start
-      bytesParsed = parser.Parse(this->m_readBuffer, static_cast<size_t>(bufferSize));
+      bytesParsed = parser.Parse(this->m_readBuffer.get(), static_cast<size_t>(bufferSize));
     }
 
     if (bytesParsed < bufferSize)
@@ -580,7 +674,7 @@ void CurlSession::ReadStatusLineAndHeadersFromRawResponse(
   }
 
   // headers are already lowerCase at this point
-  auto headers = this->m_response->GetHeaders();
+  auto const& headers = this->m_response->GetHeaders();
 
   auto isContentLengthHeaderInResponse = headers.find("content-length");
   if (isContentLengthHeaderInResponse != headers.end())
@@ -594,7 +688,7 @@ void CurlSession::ReadStatusLineAndHeadersFromRawResponse(
   auto isTransferEncodingHeaderInResponse = headers.find("transfer-encoding");
   if (isTransferEncodingHeaderInResponse != headers.end())
   {
-    auto headerValue = isTransferEncodingHeaderInResponse->second;
+    auto const& headerValue = isTransferEncodingHeaderInResponse->second;
     auto isChunked = headerValue.find("chunked");
 
     if (isChunked != std::string::npos)
@@ -607,7 +701,7 @@ void CurlSession::ReadStatusLineAndHeadersFromRawResponse(
       if (this->m_bodyStartInBuffer == -1)
       { // if nothing on inner buffer, pull from wire
         this->m_innerBufferSize = m_connection->ReadFromSocket(
-            context, this->m_readBuffer, Details::DefaultLibcurlReaderSize);
+            context, this->m_readBuffer.get(), this->m_readBufferSize);
         this->m_bodyStartInBuffer = 0;
       }
 
@@ -630,7 +724,7 @@ void CurlSession::ReadExpected(Context const& context, uint8_t expected)
   {
     // end of buffer, pull data from wire
     this->m_innerBufferSize = m_connection->ReadFromSocket(
-        context, this->m_readBuffer, Details::DefaultLibcurlReaderSize);
+        context, this->m_readBuffer.get(), this->m_readBufferSize);
     this->m_bodyStartInBuffer = 0;
   }
   auto data = this->m_readBuffer[this->m_bodyStartInBuffer];
@@ -643,6 +737,23 @@ void CurlSession::ReadExpected(Context const& context, uint8_t expected)
   this->m_bodyStartInBuffer += 1;
 }
 
+int64_t CurlSession::ReadFromInnerBuffer(uint8_t* buffer, int64_t count)
+{
+  auto totalRead = std::min(count, this->m_innerBufferSize - this->m_bodyStartInBuffer);
+  std::memcpy(
+      buffer,
+      this->m_readBuffer.get() + this->m_bodyStartInBuffer,
+      static_cast<size_t>(totalRead));
+  this->m_bodyStartInBuffer += totalRead;
+  this->m_sessionTotalRead += totalRead;
+
+  if (this->m_bodyStartInBuffer == this->m_innerBufferSize)
+  {
+    this->m_bodyStartInBuffer = -1; // read everything from inner buffer already
+  }
+  return totalRead;
+}
+
 void CurlSession::ReadCRLF(Context const& context)
 {
   ReadExpected(context, '\r');
@@ -694,20 +805,7 @@ int64_t CurlSession::OnRead(Context const& context, uint8_t* buffer, int64_t cou
   // Take data from inner buffer if any
   if (this->m_bodyStartInBuffer >= 0)
   {
-    // still have data to take from innerbuffer
-    MemoryBodyStream innerBufferMemoryStream(
-        this->m_readBuffer + this->m_bodyStartInBuffer,
-        this->m_innerBufferSize - this->m_bodyStartInBuffer);
-
-    totalRead = innerBufferMemoryStream.Read(context, buffer, readRequestLength);
-    this->m_bodyStartInBuffer += totalRead;
-    this->m_sessionTotalRead += totalRead;
-
-    if (this->m_bodyStartInBuffer == this->m_innerBufferSize)
-    {
-      this->m_bodyStartInBuffer = -1; // read everything from inner buffer already
-    }
-    return totalRead;
+    return ReadFromInnerBuffer(buffer, readRequestLength);
   }
 
   // Head request have contentLength = 0, so we won't read more, just return 0
@@ -717,10 +815,32 @@ int64_t CurlSession::OnRead(Context const& context, uint8_t* buffer, int64_t cou
     return 0;
   }
 
-  // Read from socket when no more data on internal buffer
-  // For chunk request, read a chunk based on chunk size
-  totalRead = m_connection->ReadFromSocket(context, buffer, static_cast<size_t>(readRequestLength));
-  this->m_sessionTotalRead += totalRead;
+  if (readRequestLength >= this->m_readBufferSize)
+  {
+    // Read from socket straight into the caller's buffer when it can take as much as the inner
+    // buffer. For chunk request, read a chunk based on chunk size
+    totalRead
+        = m_connection->ReadFromSocket(context, buffer, static_cast<size_t>(readRequestLength));
+    this->m_sessionTotalRead += totalRead;
+  }
+  else
+  {
+    // Small reads fill the inner buffer first, so one read from socket can serve the next calls.
+    // Never read beyond Content-length for the same reason as above.
+    auto innerReadLength = this->m_readBufferSize;
+    if (this->m_contentLength > 0)
+    {
+      innerReadLength
+          = std::min(innerReadLength, this->m_contentLength - this->m_sessionTotalRead);
+    }
+    this->m_innerBufferSize = m_connection->ReadFromSocket(
+        context, this->m_readBuffer.get(), static_cast<size_t>(innerReadLength));
+    if (this->m_innerBufferSize > 0)
+    {
+      this->m_bodyStartInBuffer = 0;
+      totalRead = ReadFromInnerBuffer(buffer, readRequestLength);
+    }
+  }
 
   // Reading 0 bytes means closed connection.
   // For known content length and chunked response, this means there is nothing else to read
@@ -917,140 +1037,135 @@ int64_t CurlSession::ResponseBufferParser::Parse(
   return index;
 }
 
-// Finds delimiter '\r' as the end of the
-int64_t CurlSession::ResponseBufferParser::BuildStatusCode(
-    uint8_t const* const buffer,
-    int64_t const bufferSize)
-{
-  if (this->state != ResponseParserState::StatusLine)
-  {
-    return 0; // Wrong internal state to call this method.
-  }
-
-  uint8_t endOfStatusLine = '\r';
-  auto endOfBuffer = buffer + bufferSize;
-
-  // Look for the end of status line in buffer
-  auto indexOfEndOfStatusLine = std::find(buffer, endOfBuffer, endOfStatusLine);
-
-  if (indexOfEndOfStatusLine == endOfBuffer)
-  {
-    // did not find the delimiter yet, copy to internal buffer
-    this->m_internalBuffer.append(buffer, endOfBuffer);
-    return bufferSize; // all buffer read and requesting for more
-  }
-
-  // Delimiter found, check if there is data in the internal buffer
-  if (this->m_internalBuffer.size() > 0)
-  {
-    // If the index is same as buffer it means delimiter is at position 0, meaning that
-    // internalBuffer contains the status line and we don't need to add anything else
-    if (indexOfEndOfStatusLine > buffer)
-    {
-      // Append and build response minus the delimiter
-      this->m_internalBuffer.append(buffer, indexOfEndOfStatusLine);
-    }
-    this->m_response = CreateHTTPResponse(this->m_internalBuffer);
-  }
-  else
-  {
-    // Internal Buffer was not required, create response directly from buffer
-    this->m_response = CreateHTTPResponse(std::string(buffer, indexOfEndOfStatusLine));
-  }
+std::array<
+    CurlConnectionPool::ConnectionPoolShard,
+    Azure::Core::Http::Details::ConnectionPoolShardCount>
+    CurlConnectionPool::s_shards;
 
-  // update control
-  this->state = ResponseParserState::Headers;
-  this->m_internalBuffer.clear();
+namespace {
+// Limiters of the hosts with open connections or with requests waiting for one. The entry for a
+// host is removed with the last reference to its limiter. Leaked, so connections closed while the
+// application exits can still remove their entry.
+struct ConnectionLimiterRegistry
+{
+  std::mutex Mutex;
+  std::map<std::string, std::weak_ptr<Azure::Core::Http::CurlConnectionLimiter>> Limiters;
+};
 
-  // Return the index of the next char to read after delimiter
-  // No need to advance one more char ('\n') (since we might be at the end of the array)
-  // Parsing Headers will make sure to move one possition
-  return indexOfEndOfStatusLine + 1 - buffer;
+ConnectionLimiterRegistry& GetConnectionLimiterRegistry()
+{
+  static ConnectionLimiterRegistry* connectionLimiterRegistry = new ConnectionLimiterRegistry();
+  return *connectionLimiterRegistry;
 }
 
-// Finds delimiter '\r' as the end of the
-int64_t CurlSession::ResponseBufferParser::BuildHeader(
-    uint8_t const* const buffer,
-    int64_t const bufferSize)
+// Expiration check for the connections of one key on one shard of the connection pool.
+struct ExpirationCheck
 {
-  if (this->state != ResponseParserState::Headers)
-  {
-    return 0; // can't run this if state is not Headers.
-  }
+  std::chrono::steady_clock::time_point ExpiresOn;
+  size_t ShardIndex;
+  std::string ConnectionKey;
 
-  uint8_t delimiter = '\r';
-  auto start = buffer;
-  auto endOfBuffer = buffer + bufferSize;
+  bool operator>(ExpirationCheck const& other) const { return ExpiresOn > other.ExpiresOn; }
+};
 
-  if (bufferSize == 1 && buffer[0] == '\n')
-  {
-    // rare case of using buffer of size 1 to read. In this case, if the char is next value
-    // after headers or previous header, just consider it as read and return
-    return bufferSize;
-  }
-  else if (bufferSize > 1 && this->m_internalBuffer.size() == 0) // only if nothing in
-                                                                 // buffer, advance
-  {
-    // move offset one possition. This is because readStatusLine and readHeader will read up
-    // to
-    // '\r' then next delimiter is '\n' and we don't care
-    start = buffer + 1;
-  }
+// Background thread removing expired connections from the connection pool. It sleeps until the
+// next scheduled check is due or until a sooner check is scheduled, so only the connections that
+// are expired are visited.
+//
+// The cleaner is leaked together with its thread, which is never joined, so nothing waits for the
+// thread while static objects are destroyed or a DLL is unloaded. Stop() is called before the
+// connection pool shards are destroyed. It waits for the check in progress, if any, because that
+// check uses the shards. The thread doesn't start another check after that and checks scheduled
+// later are ignored.
+class ConnectionPoolCleaner {
+private:
+  std::mutex m_mutex;
+  std::condition_variable m_checksChanged;
+  std::condition_variable m_checkDone;
+  std::priority_queue<ExpirationCheck, std::vector<ExpirationCheck>, std::greater<ExpirationCheck>>
+      m_checks;
+  std::thread m_thread;
+  bool m_stop = false;
+  bool m_cleaning = false;
+
+  void Run(void (*cleanUp)(size_t, std::string const&))
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop)
+    {
+      if (m_checks.empty())
+      {
+        m_checksChanged.wait(lock);
+        continue;
+      }
 
-  // Look for the end of status line in buffer
-  auto indexOfEndOfStatusLine = std::find(start, endOfBuffer, delimiter);
+      auto const nextCheck = m_checks.top().ExpiresOn;
+      if (nextCheck > std::chrono::steady_clock::now())
+      {
+        m_checksChanged.wait_until(lock, nextCheck);
+        continue;
+      }
 
-  if (indexOfEndOfStatusLine == start && this->m_internalBuffer.size() == 0)
-  {
-    // \r found at the start means the end of headers
-    this->m_internalBuffer.clear();
-    this->m_parseCompleted = true;
-    return 1; // can't return more than the found delimiter. On read remaining we need to
-              // also remove first char
+      auto check = m_checks.top();
+      m_checks.pop();
+      // Clean up takes the shard mutex and might schedule the next check. Don't hold the cleaner
+      // mutex while doing it.
+      m_cleaning = true;
+      lock.unlock();
+      cleanUp(check.ShardIndex, check.ConnectionKey);
+      lock.lock();
+      m_cleaning = false;
+      m_checkDone.notify_all();
+    }
   }
 
-  if (indexOfEndOfStatusLine == endOfBuffer)
+  ConnectionPoolCleaner() = default;
+
+public:
+  static ConnectionPoolCleaner& GetInstance()
   {
-    // did not find the delimiter yet, copy to internal buffer
-    this->m_internalBuffer.append(start, endOfBuffer);
-    return bufferSize; // all buffer read and requesting for more
+    static ConnectionPoolCleaner* connectionPoolCleaner = new ConnectionPoolCleaner();
+    return *connectionPoolCleaner;
   }
 
-  // Delimiter found, check if there is data in the internal buffer
-  if (this->m_internalBuffer.size() > 0)
+  void Schedule(ExpirationCheck check, void (*cleanUp)(size_t, std::string const&))
   {
-    // If the index is same as buffer it means delimiter is at position 0, meaning that
-    // internalBuffer contains the status line and we don't need to add anything else
-    if (indexOfEndOfStatusLine > buffer)
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stop)
+    {
+      // The connection pool is being destroyed, its connections are closed with it.
+      return;
+    }
+    if (!m_thread.joinable())
     {
-      // Append and build response minus the delimiter
-      this->m_internalBuffer.append(start, indexOfEndOfStatusLine);
+      m_thread = std::thread([this, cleanUp]() { Run(cleanUp); });
+    }
+    // The thread only needs to wake up if this check is due before the one it is waiting for.
+    auto const isNextCheck = m_checks.empty() || check.ExpiresOn < m_checks.top().ExpiresOn;
+    m_checks.push(std::move(check));
+    if (isNextCheck)
+    {
+      m_checksChanged.notify_all();
     }
-    // will throw if header is invalid
-    m_response->AddHeader(this->m_internalBuffer);
   }
-  else
+
+  void Stop()
   {
-    // Internal Buffer was not required, create response directly from buffer
-    std::string header(std::string(start, indexOfEndOfStatusLine));
-    // will throw if header is invalid
-    this->m_response->AddHeader(header);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stop = true;
+    m_checks = decltype(m_checks)();
+    m_checksChanged.notify_all();
+    m_checkDone.wait(lock, [this]() { return !m_cleaning; });
   }
+};
 
-  // reuse buffer
-  this->m_internalBuffer.clear();
-
-  // Return the index of the next char to read after delimiter
-  // No need to advance one more char ('\n') (since we might be at the end of the array)
-  // Parsing Headers will make sure to move one position
-  return indexOfEndOfStatusLine + 1 - buffer;
-}
-
-std::mutex CurlConnectionPool::ConnectionPoolMutex;
-std::map<std::string, std::list<std::unique_ptr<CurlNetworkConnection>>>
-    CurlConnectionPool::ConnectionPoolIndex;
-int32_t CurlConnectionPool::s_connectionCounter = 0;
-bool CurlConnectionPool::s_isCleanConnectionsRunning = false;
+// Defined after the connection pool shards so it is destroyed before them. Stops the cleaner and
+// waits for the check in progress, but not for its thread.
+struct ConnectionPoolCleanerStopper
+{
+  ~ConnectionPoolCleanerStopper() { ConnectionPoolCleaner::GetInstance().Stop(); }
+} ConnectionPoolCleanerStopperInstance;
+} // namespace
 
 namespace {
 inline std::string GetConnectionKey(std::string const& host, CurlTransportOptions const& options)
@@ -1088,89 +1203,77 @@ inline std::string GetConnectionKey(std::string const& host, CurlTransportOption
   {
     key.append("0");
   }
+  // Connections with per-host limits are counted on their own limiter, keep them apart.
+  if (options.MaxConnectionsPerHost > 0 || options.MaxIdleConnectionsPerHost > 0)
+  {
+    key.append("L" + std::to_string(options.MaxConnectionsPerHost) + "-"
+               + std::to_string(options.MaxIdleConnectionsPerHost));
+  }
   return key;
 }
 } // namespace
 
 std::unique_ptr<CurlNetworkConnection> CurlConnectionPool::GetCurlConnection(
+    Context const& context,
     Request& request,
     CurlTransportOptions const& options)
 {
   std::string const& host = request.GetUrl().GetHost();
   std::string const connectionKey = GetConnectionKey(host, options);
 
+  std::shared_ptr<CurlConnectionLimiter> connectionLimiter;
+  if (options.MaxConnectionsPerHost > 0 || options.MaxIdleConnectionsPerHost > 0)
   {
-    // Critical section. Needs to own ConnectionPoolMutex before executing
-    // Lock mutex to access connection pool. mutex is unlock as soon as lock is out of scope
-    std::lock_guard<std::mutex> lock(CurlConnectionPool::ConnectionPoolMutex);
-
-    // get a ref to the pool from the map of pools
-    auto hostPoolIndex = CurlConnectionPool::ConnectionPoolIndex.find(connectionKey);
-    if (hostPoolIndex != CurlConnectionPool::ConnectionPoolIndex.end()
-        && hostPoolIndex->second.size() > 0)
+    connectionLimiter = GetConnectionLimiter(connectionKey, options);
+    // Wait for our turn. Once it returns, there is either a connection reserved in the pool or
+    // room for a new connection.
+    if (connectionLimiter->Acquire(context))
     {
-      // get ref to first connection
-      auto fistConnectionIterator = hostPoolIndex->second.begin();
-      // move the connection ref to temp ref
-      auto connection = std::move(*fistConnectionIterator);
-      // Remove the connection ref from list
-      hostPoolIndex->second.erase(fistConnectionIterator);
-      // reduce number of connections on the pool
-      CurlConnectionPool::s_connectionCounter -= 1;
-
-      // Remove index if there are no more connections
-      if (hostPoolIndex->second.size() == 0)
+      auto connection = TakeConnectionFromPool(connectionKey);
+      if (connection)
       {
-        CurlConnectionPool::ConnectionPoolIndex.erase(hostPoolIndex);
+        return connection;
       }
-
-      // return connection ref
-      return connection;
+      // The reserved connection expired and was removed by the cleaner.
+      connectionLimiter->OnIdleConnectionMissing();
     }
   }
-
-  // Creating a new connection is thread safe. No need to lock mutex here.
-  // No available connection for the pool for the required host. Create one
-  CURL* newHandle = curl_easy_init();
-  if (!newHandle)
-  {
-    throw Azure::Core::Http::TransportException(
-        Details::DefaultFailedToGetNewConnectionTemplate + host + ". "
-        + std::string("curl_easy_init returned Null"));
-  }
-  CURLcode result;
-
-  // Libcurl setup before open connection (url, connect_only, timeout)
-  if (!SetLibcurlOption(newHandle, CURLOPT_URL, request.GetUrl().GetAbsoluteUrl().data(), &result))
+  else
   {
-    throw Azure::Core::Http::TransportException(
-        Details::DefaultFailedToGetNewConnectionTemplate + host + ". "
-        + std::string(curl_easy_strerror(result)));
+    auto connection = TakeConnectionFromPool(connectionKey);
+    if (connection)
+    {
+      return connection;
+    }
   }
 
-  if (!SetLibcurlOption(newHandle, CURLOPT_CONNECT_ONLY, 1L, &result))
+  try
   {
-    throw Azure::Core::Http::TransportException(
-        Details::DefaultFailedToGetNewConnectionTemplate + host + ". "
-        + std::string(curl_easy_strerror(result)));
+    return CreateCurlConnection(request, options, connectionKey, connectionLimiter);
   }
-
-  // Set timeout to 24h. Libcurl will fail uploading on windows if timeout is:
-  // timeout >= 25 days. Fails as soon as trying to upload any data
-  // 25 days < timeout > 1 days. Fail on huge uploads ( > 1GB)
-  if (!SetLibcurlOption(newHandle, CURLOPT_TIMEOUT, 60L * 60L * 24L, &result))
+  catch (...)
   {
-    throw Azure::Core::Http::TransportException(
-        Details::DefaultFailedToGetNewConnectionTemplate + host + ". "
-        + std::string(curl_easy_strerror(result)));
+    // The connection was never created, give the slot back to the limiter.
+    if (connectionLimiter)
+    {
+      connectionLimiter->OnConnectionClosed();
+    }
+    throw;
   }
+}
 
-  /******************** Curl handle options apply to all connections created
-   * The keepAlive option is managed by the session directly.
-   */
+namespace {
+// Set the proxy, CA and SSL options of the transport on a libcurl handle.
+void SetConnectionOptions(
+    CURL* handle,
+    std::string const& host,
+    CurlTransportOptions const& options)
+{
+  namespace Details = Azure::Core::Http::Details;
+  CURLcode result;
   if (!options.Proxy.empty())
   {
-    if (!SetLibcurlOption(newHandle, CURLOPT_PROXY, options.Proxy.c_str(), &result))
+    if (!SetLibcurlOption(handle, CURLOPT_PROXY, options.Proxy.c_str(), &result))
     {
       throw Azure::Core::Http::TransportException(
           Details::DefaultFailedToGetNewConnectionTemplate + host + ". Failed to set proxy to:"
@@ -1180,7 +1283,7 @@ std::unique_ptr<CurlNetworkConnection> CurlConnectionPool::GetCurlConnection(
 
   if (!options.CAInfo.empty())
   {
-    if (!SetLibcurlOption(newHandle, CURLOPT_CAINFO, options.CAInfo.c_str(), &result))
+    if (!SetLibcurlOption(handle, CURLOPT_CAINFO, options.CAInfo.c_str(), &result))
     {
       throw Azure::Core::Http::TransportException(
           Details::DefaultFailedToGetNewConnectionTemplate + host + ". Failed to set CA cert to:"
@@ -1194,7 +1297,7 @@ std::unique_ptr<CurlNetworkConnection> CurlConnectionPool::GetCurlConnection(
     sslOption |= CURLSSLOPT_NO_REVOKE;
   }
 
-  if (!SetLibcurlOption(newHandle, CURLOPT_SSL_OPTIONS, sslOption, &result))
+  if (!SetLibcurlOption(handle, CURLOPT_SSL_OPTIONS, sslOption, &result))
   {
     throw Azure::Core::Http::TransportException(
         Details::DefaultFailedToGetNewConnectionTemplate + host
@@ -1204,7 +1307,7 @@ std::unique_ptr<CurlNetworkConnection> CurlConnectionPool::GetCurlConnection(
 
   if (!options.SSLVerifyPeer)
   {
-    if (!SetLibcurlOption(newHandle, CURLOPT_SSL_VERIFYPEER, 0L, &result))
+    if (!SetLibcurlOption(handle, CURLOPT_SSL_VERIFYPEER, 0L, &result))
     {
       throw Azure::Core::Http::TransportException(
           Details::DefaultFailedToGetNewConnectionTemplate + host
@@ -1212,6 +1315,57 @@ std::unique_ptr<CurlNetworkConnection> CurlConnectionPool::GetCurlConnection(
           + std::string(curl_easy_strerror(result)));
     }
   }
+}
+} // namespace
+
+std::unique_ptr<CurlNetworkConnection> CurlConnectionPool::CreateCurlConnection(
+    Request& request,
+    CurlTransportOptions const& options,
+    std::string const& connectionKey,
+    std::shared_ptr<CurlConnectionLimiter> connectionLimiter)
+{
+  std::string const& host = request.GetUrl().GetHost();
+
+  // Creating a new connection is thread safe. No need to lock mutex here.
+  // No available connection for the pool for the required host. Create one
+  CURL* newHandle = curl_easy_init();
+  if (!newHandle)
+  {
+    throw Azure::Core::Http::TransportException(
+        Details::DefaultFailedToGetNewConnectionTemplate + host + ". "
+        + std::string("curl_easy_init returned Null"));
+  }
+  CURLcode result;
+
+  // Libcurl setup before open connection (url, connect_only, timeout)
+  if (!SetLibcurlOption(newHandle, CURLOPT_URL, request.GetUrl().GetAbsoluteUrl().data(), &result))
+  {
+    throw Azure::Core::Http::TransportException(
+        Details::DefaultFailedToGetNewConnectionTemplate + host + ". "
+        + std::string(curl_easy_strerror(result)));
+  }
+
+  if (!SetLibcurlOption(newHandle, CURLOPT_CONNECT_ONLY, 1L, &result))
+  {
+    throw Azure::Core::Http::TransportException(
+        Details::DefaultFailedToGetNewConnectionTemplate + host + ". "
+        + std::string(curl_easy_strerror(result)));
+  }
+
+  // Set timeout to 24h. Libcurl will fail uploading on windows if timeout is:
+  // timeout >= 25 days. Fails as soon as trying to upload any data
+  // 25 days < timeout > 1 days. Fail on huge uploads ( > 1GB)
+  if (!SetLibcurlOption(newHandle, CURLOPT_TIMEOUT, 60L * 60L * 24L, &result))
+  {
+    throw Azure::Core::Http::TransportException(
+        Details::DefaultFailedToGetNewConnectionTemplate + host + ". "
+        + std::string(curl_easy_strerror(result)));
+  }
+
+  /******************** Curl handle options apply to all connections created
+   * The keepAlive option is managed by the session directly.
+   */
+  SetConnectionOptions(newHandle, host, options);
 
   auto performResult = curl_easy_perform(newHandle);
   if (performResult != CURLE_OK)
@@ -1221,7 +1375,8 @@ std::unique_ptr<CurlNetworkConnection> CurlConnectionPool::GetCurlConnection(
         + std::string(curl_easy_strerror(performResult)));
   }
 
-  return std::make_unique<CurlConnection>(newHandle, std::move(connectionKey));
+  return std::make_unique<CurlConnection>(
+      newHandle, connectionKey, std::move(connectionLimiter));
 }
 
 // Move the connection back to the connection pool. Push it to the front so it becomes the
@@ -1238,88 +1393,1164 @@ void CurlConnectionPool::MoveConnectionBackToPool(
     return;
   }
 
-  // Lock mutex to access connection pool. mutex is unlock as soon as lock is out of scope
-  std::lock_guard<std::mutex> lock(CurlConnectionPool::ConnectionPoolMutex);
   auto& poolId = connection->GetConnectionKey();
-  auto& hostPool = CurlConnectionPool::ConnectionPoolIndex[poolId];
-  // update the time when connection was moved back to pool
-  connection->updateLastUsageTime();
-  hostPool.push_front(std::move(connection));
-  CurlConnectionPool::s_connectionCounter += 1;
-  // Check if there's no cleaner running and started
-  if (!CurlConnectionPool::s_isCleanConnectionsRunning)
+  auto const shardIndex = GetHomeShardIndex(poolId);
+  auto& shard = CurlConnectionPool::s_shards[shardIndex];
+  auto moveToShard = [&]() {
+    // Lock the shard mutex only. mutex is unlock as soon as lock is out of scope
+    std::lock_guard<std::mutex> lock(shard.Mutex);
+    auto& hostPool = shard.ConnectionPoolIndex[poolId];
+    // update the time when connection was moved back to pool
+    connection->updateLastUsageTime();
+    auto const expiresOn = std::chrono::steady_clock::now()
+        + std::chrono::milliseconds(Details::DefaultConnectionExpiredMilliseconds);
+    hostPool.push_front(PooledConnection{std::move(connection), expiresOn});
+
+    // Older connections for this key in the shard have a check scheduled already, which will
+    // schedule the next one. Otherwise, this connection is the oldest one.
+    if (shard.ScheduledKeys.insert(poolId).second)
+    {
+      ScheduleCleanUp(expiresOn, shardIndex, poolId);
+    }
+  };
+
+  auto connectionLimiter = connection->GetConnectionLimiter();
+  if (!connectionLimiter)
   {
-    CurlConnectionPool::s_isCleanConnectionsRunning = true;
-    CurlConnectionPool::CleanUp();
+    moveToShard();
+    return;
   }
+  // The limiter checks the idle connections cap and moves the connection while it is locked, so
+  // connections moved back at the same time can't go over the cap. When the host has enough idle
+  // connections already, the connection is closed when it goes out of scope.
+  connectionLimiter->MoveConnectionToPool(moveToShard);
 }
 
-// spawn a thread for cleaning old connections.
-// Thread will keep running while there are at least one connection in the pool
-void CurlConnectionPool::CleanUp()
+std::unique_ptr<CurlNetworkConnection> CurlConnectionPool::TakeConnectionFromShard(
+    ConnectionPoolShard& shard,
+    std::string const& connectionKey)
 {
-  std::thread backgroundCleanerThread([]() {
-    for (;;)
-    {
-      // wait before trying to clean
-      std::this_thread::sleep_for(
-          std::chrono::milliseconds(Details::DefaultCleanerIntervalMilliseconds));
+  // Critical section. Needs to own the shard mutex before executing
+  std::lock_guard<std::mutex> lock(shard.Mutex);
 
-      {
-        // take mutex for reading the pool
-        std::lock_guard<std::mutex> lock(CurlConnectionPool::ConnectionPoolMutex);
+  // get a ref to the pool from the map of pools
+  auto hostPoolIndex = shard.ConnectionPoolIndex.find(connectionKey);
+  if (hostPoolIndex == shard.ConnectionPoolIndex.end() || hostPoolIndex->second.size() == 0)
+  {
+    return nullptr;
+  }
 
-        if (CurlConnectionPool::s_connectionCounter == 0)
-        {
-          // stop the cleaner since there are no connections
-          CurlConnectionPool::s_isCleanConnectionsRunning = false;
-          return;
-        }
+  // get ref to first connection
+  auto fistConnectionIterator = hostPoolIndex->second.begin();
+  // move the connection ref to temp ref
+  auto connection = std::move(fistConnectionIterator->Connection);
+  // Remove the connection ref from list
+  hostPoolIndex->second.erase(fistConnectionIterator);
 
-        // loop the connection pool index
-        for (auto index = CurlConnectionPool::ConnectionPoolIndex.begin();
-             index != CurlConnectionPool::ConnectionPoolIndex.end();
-             index++)
-        {
-          if (index->second.size() == 0)
-          {
-            // Move the next pool index
-            continue;
-          }
+  // Remove index if there are no more connections
+  if (hostPoolIndex->second.size() == 0)
+  {
+    shard.ConnectionPoolIndex.erase(hostPoolIndex);
+  }
+
+  // return connection ref
+  return connection;
+}
+
+std::unique_ptr<CurlNetworkConnection> CurlConnectionPool::TakeConnectionFromPool(
+    std::string const& connectionKey)
+{
+  // Start looking at the home shard of this thread and then try the rest of the shards before
+  // creating a new connection. Each shard is locked only while taking a connection out of it.
+  auto const homeShard = GetHomeShardIndex(connectionKey);
+  for (size_t probe = 0; probe < Details::ConnectionPoolShardCount; probe++)
+  {
+    auto& shard = CurlConnectionPool::s_shards
+        [(homeShard + probe) & (Details::ConnectionPoolShardCount - 1)];
+    auto connection = TakeConnectionFromShard(shard, connectionKey);
+    if (connection)
+    {
+      return connection;
+    }
+  }
+  return nullptr;
+}
 
-          // Pool index with waiting connections. Loop the connection pool backwards until
-          // a connection that is not expired is found or until all connections are removed.
-          for (auto connection = index->second.end();;)
+std::shared_ptr<Azure::Core::Http::CurlConnectionLimiter> CurlConnectionPool::GetConnectionLimiter(
+    std::string const& connectionKey,
+    CurlTransportOptions const& options)
+{
+  auto& registry = GetConnectionLimiterRegistry();
+  std::lock_guard<std::mutex> lock(registry.Mutex);
+  auto& registeredLimiter = registry.Limiters[connectionKey];
+  auto connectionLimiter = registeredLimiter.lock();
+  if (!connectionLimiter)
+  {
+    // Held by the connections for the key and by the requests waiting for one. The last one to
+    // release it removes the entry, unless a new limiter was registered for the key meanwhile.
+    connectionLimiter = std::shared_ptr<CurlConnectionLimiter>(
+        new CurlConnectionLimiter(
+            options.MaxConnectionsPerHost, options.MaxIdleConnectionsPerHost),
+        [connectionKey](CurlConnectionLimiter* limiter) {
+          delete limiter;
+          auto& registry = GetConnectionLimiterRegistry();
+          std::lock_guard<std::mutex> lock(registry.Mutex);
+          auto entry = registry.Limiters.find(connectionKey);
+          if (entry != registry.Limiters.end() && entry->second.expired())
           {
-            // loop starts at end(), go back to previous possition. We know the list is
-            // size() > 0 so we are safe to go end() - 1 and find the last element in the
-            // list
-            connection--;
-            if (connection->get()->isExpired())
-            {
-              // remove connection from the pool and update the connection to the next one
-              // which is going to be list.end()
-              connection = index->second.erase(connection);
-              CurlConnectionPool::s_connectionCounter -= 1;
-
-              // Connection removed, break if there are no more connections to check
-              if (index->second.size() == 0)
-              {
-                break;
-              }
-            }
-            else
-            {
-              // Got a non-expired connection, all connections before this one are not
-              // expired. Break the loop and continue looping the Pool index
-              break;
-            }
+            registry.Limiters.erase(entry);
           }
+        });
+    registeredLimiter = connectionLimiter;
+  }
+  return connectionLimiter;
+}
+
+size_t CurlConnectionPool::ConnectionLimitersCount()
+{
+  auto& registry = GetConnectionLimiterRegistry();
+  std::lock_guard<std::mutex> lock(registry.Mutex);
+  return registry.Limiters.size();
+}
+
+size_t CurlConnectionPool::GetHomeShardIndex(std::string const& connectionKey)
+{
+  // Each thread gets a different offset the first time it uses the pool. Adding it to the key
+  // hash spreads threads working with the same host across shards.
+  static std::atomic<size_t> threadCounter(0);
+  thread_local size_t const threadOffset = threadCounter++;
+
+  return (std::hash<std::string>()(connectionKey) + threadOffset)
+      & (Details::ConnectionPoolShardCount - 1);
+}
+
+void CurlConnectionPool::ClearIndex()
+{
+  for (auto& shard : CurlConnectionPool::s_shards)
+  {
+    // Connections are closed after the shard is unlocked, limiters are never locked while a shard
+    // is locked.
+    std::map<std::string, std::list<PooledConnection>> connectionPoolIndex;
+    {
+      std::lock_guard<std::mutex> lock(shard.Mutex);
+      // Scheduled keys are kept. Their pending checks will find no connections and remove them.
+      connectionPoolIndex.swap(shard.ConnectionPoolIndex);
+    }
+    for (auto const& index : connectionPoolIndex)
+    {
+      for (auto const& pooledConnection : index.second)
+      {
+        auto connectionLimiter = pooledConnection.Connection->GetConnectionLimiter();
+        if (connectionLimiter)
+        {
+          connectionLimiter->OnConnectionRemovedFromPool();
         }
       }
     }
-  });
+  }
+}
 
-  // let thread run independent. It will be done once ther is not connections in the pool
-  backgroundCleanerThread.detach();
+int64_t CurlConnectionPool::ConnectionsOnPool(std::string const& connectionKey)
+{
+  int64_t connections = 0;
+  for (auto& shard : CurlConnectionPool::s_shards)
+  {
+    std::lock_guard<std::mutex> lock(shard.Mutex);
+    auto hostPoolIndex = shard.ConnectionPoolIndex.find(connectionKey);
+    if (hostPoolIndex != shard.ConnectionPoolIndex.end())
+    {
+      connections += hostPoolIndex->second.size();
+    }
+  }
+  return connections;
+}
+
+int64_t CurlConnectionPool::ConnectionsIndexOnPool()
+{
+  std::set<std::string> keys;
+  for (auto& shard : CurlConnectionPool::s_shards)
+  {
+    std::lock_guard<std::mutex> lock(shard.Mutex);
+    for (auto const& index : shard.ConnectionPoolIndex)
+    {
+      keys.insert(index.first);
+    }
+  }
+  return keys.size();
+}
+
+void CurlConnectionPool::ScheduleCleanUp(
+    std::chrono::steady_clock::time_point expiresOn,
+    size_t shardIndex,
+    std::string const& connectionKey)
+{
+  ConnectionPoolCleaner::GetInstance().Schedule(
+      ExpirationCheck{expiresOn, shardIndex, connectionKey},
+      [](size_t index, std::string const& key) { CurlConnectionPool::CleanUp(index, key); });
+}
+
+// Called from the cleaner thread when the oldest connection for a key on a shard might be expired.
+void CurlConnectionPool::CleanUp(size_t shardIndex, std::string const& connectionKey)
+{
+  // Expired connections are closed after the shard is unlocked, limiters are never locked while a
+  // shard is locked.
+  std::list<PooledConnection> expiredConnections;
+  {
+    auto& shard = CurlConnectionPool::s_shards[shardIndex];
+    std::lock_guard<std::mutex> lock(shard.Mutex);
+
+    auto index = shard.ConnectionPoolIndex.find(connectionKey);
+    if (index != shard.ConnectionPoolIndex.end())
+    {
+      // Connections are sorted from the most recently used to the oldest. Remove connections from
+      // the back until a connection that is not expired is found.
+      auto const now = std::chrono::steady_clock::now();
+      while (index->second.size() > 0 && index->second.back().ExpiresOn <= now)
+      {
+        expiredConnections.splice(
+            expiredConnections.end(), index->second, std::prev(index->second.end()));
+      }
+
+      if (index->second.size() > 0)
+      {
+        // Check again when the oldest connection left is expected to expire.
+        ScheduleCleanUp(index->second.back().ExpiresOn, shardIndex, connectionKey);
+      }
+      else
+      {
+        // Remove index if there are no more connections
+        shard.ConnectionPoolIndex.erase(index);
+        shard.ScheduledKeys.erase(connectionKey);
+      }
+    }
+    else
+    {
+      shard.ScheduledKeys.erase(connectionKey);
+    }
+  }
+
+  for (auto const& expiredConnection : expiredConnections)
+  {
+    auto connectionLimiter = expiredConnection.Connection->GetConnectionLimiter();
+    if (connectionLimiter)
+    {
+      connectionLimiter->OnConnectionRemovedFromPool();
+    }
+  }
+}
+
+bool Azure::Core::Http::CurlConnectionLimiter::Acquire(Context const& context)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  auto const ticket = m_nextTicket++;
+  m_waitQueue.push_back(ticket);
+
+  for (;;)
+  {
+    // Only the request at the front of the queue can take a connection. Any other request keeps
+    // waiting even if there is a connection available, so requests are served in order.
+    if (m_waitQueue.front() == ticket)
+    {
+      if (m_idleConnections > 0)
+      {
+        m_idleConnections -= 1;
+        m_waitQueue.pop_front();
+        m_waitQueueChanged.notify_all();
+        return true;
+      }
+      if (m_maxConnections == 0 || m_openConnections < static_cast<int64_t>(m_maxConnections))
+      {
+        m_openConnections += 1;
+        m_waitQueue.pop_front();
+        m_waitQueueChanged.notify_all();
+        return false;
+      }
+    }
+
+    if (context.IsCancelled())
+    {
+      // Leave the queue so the next request can be served.
+      m_waitQueue.remove(ticket);
+      m_waitQueueChanged.notify_all();
+      context.ThrowIfCancelled();
+    }
+
+    // Wake up periodically to check cancellation, as it is done while polling sockets.
+    m_waitQueueChanged.wait_for(
+        lock, std::chrono::milliseconds(Details::DefaultConnectionWaitIntervalMilliseconds));
+  }
+}
+
+void Azure::Core::Http::CurlConnectionLimiter::OnIdleConnectionMissing()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // The idle connection was removed from the pool and counted as removed already.
+  m_idleConnections += 1;
+  m_openConnections += 1;
+}
+
+bool Azure::Core::Http::CurlConnectionLimiter::MoveConnectionToPool(
+    std::function<void()> const& moveToPool)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_maxIdleConnections != 0 && m_idleConnections >= static_cast<int64_t>(m_maxIdleConnections))
+  {
+    return false;
+  }
+  moveToPool();
+  m_idleConnections += 1;
+  // Wake up the next request waiting for a connection to this host.
+  m_waitQueueChanged.notify_all();
+  return true;
+}
+
+void Azure::Core::Http::CurlConnectionLimiter::OnConnectionRemovedFromPool()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_idleConnections -= 1;
+}
+
+void Azure::Core::Http::CurlConnectionLimiter::OnConnectionClosed()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_openConnections -= 1;
+  m_waitQueueChanged.notify_all();
+}
+
+namespace {
+// libcurl has no idle connections limit. CURLMOPT_MAXCONNECTS caps the whole connection cache, busy
+// connections included, and transfers over it wait for a connection. A multi handle only talks to
+// one host, so both limits become a cap on the connections to the host.
+size_t GetMultiplexedMaxConnections(CurlTransportOptions const& options)
+{
+  auto maxConnections = options.MaxConnectionsPerHost;
+  if (options.MaxIdleConnectionsPerHost > 0
+      && (maxConnections == 0 || options.MaxIdleConnectionsPerHost < maxConnections))
+  {
+    maxConnections = options.MaxIdleConnectionsPerHost;
+  }
+  return maxConnections;
+}
+} // namespace
+
+CurlMultiplexedTransfer::CurlMultiplexedTransfer(
+    CurlMultiplexer& multiplexer,
+    Context const& context,
+    Request& request,
+    CurlTransportOptions const& options,
+    bool copyRequestBody)
+    : m_multiplexer(multiplexer),
+      m_connectionKey(::GetConnectionKey(request.GetUrl().GetHost(), options)),
+      m_maxConnections(GetMultiplexedMaxConnections(options)), m_method(request.GetMethod()),
+      m_context(context), m_handle(curl_easy_init()),
+      m_requestBodyStream(copyRequestBody ? nullptr : request.GetBodyStream())
+{
+  std::string const& host = request.GetUrl().GetHost();
+  if (!m_handle)
+  {
+    throw Azure::Core::Http::TransportException(
+        Details::DefaultFailedToGetNewConnectionTemplate + host + ". "
+        + std::string("curl_easy_init returned Null"));
+  }
+
+  CURLcode result;
+  auto const setOption = [&](CURLoption option, auto value) {
+    if (!SetLibcurlOption(m_handle, option, value, &result))
+    {
+      throw Azure::Core::Http::TransportException(
+          Details::DefaultFailedToGetNewConnectionTemplate + host + ". "
+          + std::string(curl_easy_strerror(result)));
+    }
+  };
+
+  try
+  {
+    auto const url = request.GetUrl().GetAbsoluteUrl();
+    setOption(CURLOPT_URL, url.c_str());
+    // Same timeout as connections of the connection pool, see CreateCurlConnection().
+    setOption(CURLOPT_TIMEOUT, 60L * 60L * 24L);
+    SetConnectionOptions(m_handle, host, options);
+
+    // HTTP/2 is negotiated during the TLS handshake. Plain HTTP requests keep using HTTP/1.1.
+    if (options.Http2Multiplexing
+        && Azure::Core::Internal::Strings::LocaleInvariantCaseInsensitiveEqual(
+            url.substr(0, 6), "https:"))
+    {
+      setOption(CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2_0));
+    }
+    // Wait for a connection being opened to the host to multiplex on it, instead of opening one
+    // more connection.
+    setOption(CURLOPT_PIPEWAIT, 1L);
+    if (!options.HttpKeepAlive)
+    {
+      setOption(CURLOPT_FORBID_REUSE, 1L);
+    }
+    auto const readBufferSize
+        = options.ReadBufferSize == 0 ? Details::DefaultLibcurlReaderSize : options.ReadBufferSize;
+    // Libcurl takes receive buffers between 1 KiB and 512 KiB.
+    setOption(
+        CURLOPT_BUFFERSIZE,
+        static_cast<long>(std::min(std::max(readBufferSize, size_t(1024)), size_t(1024 * 512))));
+#if LIBCURL_VERSION_NUM >= 0x073600
+    // The response of a proxy to CONNECT is not part of the response.
+    setOption(CURLOPT_SUPPRESS_CONNECT_HEADERS, 1L);
+#endif
+
+    for (auto const& header : request.GetHeaders())
+    {
+      // Libcurl drops headers with an empty value unless they end with ';' instead of ':'.
+      auto const line
+          = header.second.empty() ? header.first + ";" : header.first + ": " + header.second;
+      auto headers = curl_slist_append(m_headers, line.c_str());
+      if (!headers)
+      {
+        throw Azure::Core::Http::TransportException(
+            Details::DefaultFailedToGetNewConnectionTemplate + host
+            + ". Failed to add header: " + header.first);
+      }
+      m_headers = headers;
+    }
+    // The body is sent without waiting for a 100 Continue response.
+    auto headers = curl_slist_append(m_headers, "Expect:");
+    if (!headers)
+    {
+      throw Azure::Core::Http::TransportException(
+          Details::DefaultFailedToGetNewConnectionTemplate + host
+          + ". Failed to add header: Expect");
+    }
+    m_headers = headers;
+    setOption(CURLOPT_HTTPHEADER, m_headers);
+
+    setOption(CURLOPT_HEADERFUNCTION, &CurlMultiplexedTransfer::OnHeader);
+    setOption(CURLOPT_HEADERDATA, static_cast<void*>(this));
+    setOption(CURLOPT_WRITEFUNCTION, &CurlMultiplexedTransfer::OnWrite);
+    setOption(CURLOPT_WRITEDATA, static_cast<void*>(this));
+
+    auto const method = request.GetMethod();
+    auto bodyLength = request.GetBodyStream()->Length();
+    if (copyRequestBody)
+    {
+      m_requestBody = BodyStream::ReadToEnd(context, *request.GetBodyStream());
+      bodyLength = static_cast<int64_t>(m_requestBody.size());
+    }
+    if (method == HttpMethod::Head)
+    {
+      setOption(CURLOPT_NOBODY, 1L);
+    }
+    else
+    {
+      if (bodyLength != 0 || method == HttpMethod::Put || method == HttpMethod::Post
+          || method == HttpMethod::Patch)
+      {
+        // A body of unknown length (-1) is sent with chunked transfer encoding over HTTP/1.1.
+        setOption(CURLOPT_UPLOAD, 1L);
+        setOption(CURLOPT_INFILESIZE_LARGE, static_cast<curl_off_t>(bodyLength));
+        setOption(CURLOPT_READFUNCTION, &CurlMultiplexedTransfer::OnUpload);
+        setOption(CURLOPT_READDATA, static_cast<void*>(this));
+      }
+      setOption(CURLOPT_CUSTOMREQUEST, HttpMethodToString(method).c_str());
+    }
+  }
+  catch (...)
+  {
+    curl_slist_free_all(m_headers);
+    curl_easy_cleanup(m_handle);
+    throw;
+  }
+}
+
+CurlMultiplexedTransfer::~CurlMultiplexedTransfer()
+{
+  curl_easy_cleanup(m_handle);
+  curl_slist_free_all(m_headers);
+}
+
+size_t CurlMultiplexedTransfer::OnHeader(char* buffer, size_t size, size_t count, void* userData)
+{
+  auto transfer = static_cast<CurlMultiplexedTransfer*>(userData);
+  auto const length = size * count;
+  auto const first = reinterpret_cast<uint8_t const*>(buffer);
+  auto last = first + length;
+  // Each header line comes with its CRLF
+  while (last > first && (last[-1] == '\n' || last[-1] == '\r'))
+  {
+    --last;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(transfer->m_mutex);
+    if (transfer->m_headersReceived)
+    {
+      // Trailers after the body are not part of the response
+      return length;
+    }
+
+    try
+    {
+      if (first != last)
+      {
+        if (length >= 5 && std::memcmp(buffer, "HTTP/", 5) == 0)
+        {
+          transfer->m_response = CreateHTTPResponse(first, last);
+        }
+        else if (transfer->m_response)
+        {
+          transfer->m_response->AddHeader(first, last);
+        }
+        return length;
+      }
+
+      // The empty line ends the headers. Informational responses, like 100 Continue, are followed
+      // by the actual response.
+      if (!transfer->m_response
+          || static_cast<int>(transfer->m_response->GetStatusCode()) < 200)
+      {
+        transfer->m_response.reset();
+        return length;
+      }
+      transfer->m_headersReceived = true;
+      transfer->m_stateChanged.notify_all();
+    }
+    catch (std::exception const& e)
+    {
+      transfer->m_error = e.what();
+      // Fails the transfer
+      return 0;
+    }
+  }
+
+  // Without holding the mutex, the response is destroyed right away if the future was dropped.
+  transfer->DeliverResponse();
+  return length;
+}
+
+size_t CurlMultiplexedTransfer::OnWrite(char* buffer, size_t size, size_t count, void* userData)
+{
+  auto transfer = static_cast<CurlMultiplexedTransfer*>(userData);
+  auto const length = size * count;
+
+  std::lock_guard<std::mutex> lock(transfer->m_mutex);
+  auto& body = transfer->m_body;
+  if (body.size() - transfer->m_bodyOffset >= Details::DefaultMultiplexedBodyBufferSize)
+  {
+    // Libcurl delivers the same bytes again once the transfer is resumed
+    transfer->m_paused = true;
+    return CURL_WRITEFUNC_PAUSE;
+  }
+
+  body.erase(body.begin(), body.begin() + transfer->m_bodyOffset);
+  transfer->m_bodyOffset = 0;
+  body.insert(body.end(), buffer, buffer + length);
+  transfer->m_stateChanged.notify_all();
+  return length;
+}
+
+size_t CurlMultiplexedTransfer::OnUpload(char* buffer, size_t size, size_t count, void* userData)
+{
+  auto transfer = static_cast<CurlMultiplexedTransfer*>(userData);
+  if (!transfer->m_requestBodyStream)
+  {
+    auto const& body = transfer->m_requestBody;
+    auto const readSize = std::min(size * count, body.size() - transfer->m_requestBodyOffset);
+    std::memcpy(buffer, body.data() + transfer->m_requestBodyOffset, readSize);
+    transfer->m_requestBodyOffset += readSize;
+    return readSize;
+  }
+  try
+  {
+    return static_cast<size_t>(transfer->m_requestBodyStream->Read(
+        transfer->m_context,
+        reinterpret_cast<uint8_t*>(buffer),
+        static_cast<int64_t>(size * count)));
+  }
+  catch (std::exception const& e)
+  {
+    std::lock_guard<std::mutex> lock(transfer->m_mutex);
+    transfer->m_error = e.what();
+    return CURL_READFUNC_ABORT;
+  }
+}
+
+std::string CurlMultiplexedTransfer::GetError() const
+{
+  return m_error.empty() ? std::string(curl_easy_strerror(m_result)) : m_error;
+}
+
+void CurlMultiplexedTransfer::OnDone(CURLcode result)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_done = true;
+    m_result = result;
+    m_stateChanged.notify_all();
+  }
+  DeliverResponse();
+}
+
+std::future<std::unique_ptr<RawResponse>> CurlMultiplexedTransfer::GetResponseFuture()
+{
+  m_responsePromise = std::make_unique<std::promise<std::unique_ptr<RawResponse>>>();
+  return m_responsePromise->get_future();
+}
+
+bool CurlMultiplexedTransfer::IsCancelledBeforeResponse()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_responsePromise && m_context.IsCancelled();
+}
+
+void CurlMultiplexedTransfer::DeliverResponse()
+{
+  std::unique_ptr<std::promise<std::unique_ptr<RawResponse>>> responsePromise;
+  std::string error;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_responsePromise || (!m_headersReceived && !m_done))
+    {
+      return;
+    }
+    responsePromise = std::move(m_responsePromise);
+    if (!m_headersReceived)
+    {
+      error = GetError();
+    }
+  }
+
+  try
+  {
+    if (!error.empty())
+    {
+      m_context.ThrowIfCancelled();
+      throw Azure::Core::Http::TransportException("Error while sending request. " + error);
+    }
+    responsePromise->set_value(TakeResponse());
+  }
+  catch (...)
+  {
+    responsePromise->set_exception(std::current_exception());
+  }
+}
+
+std::unique_ptr<RawResponse> CurlMultiplexedTransfer::TakeResponse()
+{
+  // Once the headers are received, the multiplexer thread no longer touches the response.
+  auto response = std::move(m_response);
+
+  // Same as the session, HEAD and NoContent responses have no body whatever content-length says
+  int64_t contentLength = -1;
+  if (m_method == HttpMethod::Head
+      || response->GetStatusCode() == HttpStatusCode::NoContent)
+  {
+    contentLength = 0;
+  }
+  else
+  {
+    auto const& headers = response->GetHeaders();
+    auto contentLengthHeader = headers.find("content-length");
+    if (contentLengthHeader != headers.end())
+    {
+      contentLength = static_cast<int64_t>(std::stoull(contentLengthHeader->second));
+    }
+  }
+
+  response->SetBodyStream(
+      std::make_unique<CurlMultiplexedBodyStream>(shared_from_this(), contentLength));
+  return response;
+}
+
+std::unique_ptr<RawResponse> CurlMultiplexedTransfer::WaitForResponse(Context const& context)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (!m_headersReceived && !m_done)
+  {
+    m_stateChanged.wait_for(
+        lock, std::chrono::milliseconds(Details::DefaultConnectionWaitIntervalMilliseconds));
+    if (context.IsCancelled())
+    {
+      lock.unlock();
+      Cancel();
+      context.ThrowIfCancelled();
+    }
+  }
+
+  if (!m_headersReceived)
+  {
+    throw Azure::Core::Http::TransportException("Error while sending request. " + GetError());
+  }
+  lock.unlock();
+  return TakeResponse();
+}
+
+int64_t CurlMultiplexedTransfer::ReadBody(Context const& context, uint8_t* buffer, int64_t count)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (m_bodyOffset == m_body.size() && !m_done)
+  {
+    m_stateChanged.wait_for(
+        lock, std::chrono::milliseconds(Details::DefaultConnectionWaitIntervalMilliseconds));
+    if (context.IsCancelled())
+    {
+      lock.unlock();
+      Cancel();
+      context.ThrowIfCancelled();
+    }
+  }
+
+  auto const buffered = m_body.size() - m_bodyOffset;
+  if (buffered == 0)
+  {
+    if (m_result != CURLE_OK)
+    {
+      throw Azure::Core::Http::TransportException(
+          "Error while reading the response body. " + GetError());
+    }
+    return 0;
+  }
+
+  auto const readSize = std::min(static_cast<size_t>(count), buffered);
+  std::memcpy(buffer, m_body.data() + m_bodyOffset, readSize);
+  m_bodyOffset += readSize;
+
+  // Let libcurl receive again once half of the buffer was read
+  auto const resume
+      = m_paused && buffered - readSize <= Details::DefaultMultiplexedBodyBufferSize / 2;
+  if (resume)
+  {
+    m_paused = false;
+  }
+  lock.unlock();
+  if (resume)
+  {
+    m_multiplexer.Resume(m_handle);
+  }
+  return static_cast<int64_t>(readSize);
+}
+
+void CurlMultiplexedTransfer::Cancel()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_done)
+    {
+      return;
+    }
+  }
+  // Libcurl may still call back into the transfer until the multiplexer thread removes it
+  m_multiplexer.Remove(m_handle);
+  if (m_multiplexer.IsMultiplexerThread())
+  {
+    // The response of an async transfer was dropped while delivered from a libcurl callback, the
+    // multiplexer thread can't wait for itself.
+    return;
+  }
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_stateChanged.wait(lock, [this]() { return m_done; });
+}
+
+namespace {
+// Stops the multiplexer while static objects are destroyed, without waiting for its thread.
+struct CurlMultiplexerStopper
+{
+  ~CurlMultiplexerStopper() { CurlMultiplexer::GetInstance().Stop(); }
+} CurlMultiplexerStopperInstance;
+} // namespace
+
+CurlMultiplexer& CurlMultiplexer::GetInstance()
+{
+  static CurlMultiplexer* multiplexer = new CurlMultiplexer();
+  return *multiplexer;
+}
+
+std::unique_ptr<CurlMultiplexer::HostMultiplexer> CurlMultiplexer::CreateHostMultiplexer(
+    size_t maxConnections)
+{
+  auto host = std::make_unique<HostMultiplexer>();
+  host->MultiHandle = curl_multi_init();
+  if (!host->MultiHandle)
+  {
+    return nullptr;
+  }
+  // Transfers share a connection as HTTP/2 streams when the server supports it
+  curl_multi_setopt(host->MultiHandle, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+  if (maxConnections > 0)
+  {
+    curl_multi_setopt(
+        host->MultiHandle, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(maxConnections));
+    curl_multi_setopt(host->MultiHandle, CURLMOPT_MAXCONNECTS, static_cast<long>(maxConnections));
+  }
+  curl_multi_setopt(host->MultiHandle, CURLMOPT_SOCKETFUNCTION, &CurlMultiplexer::OnSocket);
+  curl_multi_setopt(host->MultiHandle, CURLMOPT_SOCKETDATA, static_cast<void*>(host.get()));
+  curl_multi_setopt(host->MultiHandle, CURLMOPT_TIMERFUNCTION, &CurlMultiplexer::OnTimer);
+  curl_multi_setopt(host->MultiHandle, CURLMOPT_TIMERDATA, static_cast<void*>(host.get()));
+  return host;
+}
+
+int CurlMultiplexer::OnSocket(CURL*, curl_socket_t socket, int what, void* userData, void*)
+{
+  auto host = static_cast<HostMultiplexer*>(userData);
+  if (what == CURL_POLL_REMOVE)
+  {
+    host->Sockets.erase(socket);
+  }
+  else
+  {
+    host->Sockets[socket] = what;
+  }
+  return 0;
+}
+
+int CurlMultiplexer::OnTimer(CURLM*, long timeoutMilliseconds, void* userData)
+{
+  auto host = static_cast<HostMultiplexer*>(userData);
+  // -1 removes the timeout
+  host->HasTimeout = timeoutMilliseconds >= 0;
+  host->Timeout
+      = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds);
+  return 0;
+}
+
+void CurlMultiplexer::Run()
+{
+  std::vector<std::shared_ptr<CurlMultiplexedTransfer>> transfersToAdd;
+  std::vector<CURL*> transfersToResume;
+  std::vector<CURL*> transfersToRemove;
+  std::vector<curl_waitfd> waitFds;
+  std::vector<HostMultiplexer*> waitFdHosts;
+  for (;;)
+  {
+    uint64_t clearsRequested;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_stop)
+      {
+        break;
+      }
+      transfersToAdd.swap(m_transfersToAdd);
+      transfersToResume.swap(m_transfersToResume);
+      transfersToRemove.swap(m_transfersToRemove);
+      clearsRequested = m_clearsRequested;
+    }
+
+    for (auto& transfer : transfersToAdd)
+    {
+      AddTransfer(std::move(transfer));
+    }
+    for (auto handle : transfersToResume)
+    {
+      if (m_transfers.find(handle) != m_transfers.end())
+      {
+        curl_easy_pause(handle, CURLPAUSE_CONT);
+      }
+    }
+    for (auto handle : transfersToRemove)
+    {
+      RemoveTransfer(handle, CURLE_ABORTED_BY_CALLBACK);
+    }
+    transfersToAdd.clear();
+    transfersToResume.clear();
+    transfersToRemove.clear();
+
+    // Nobody waits on the context of async transfers until their response is delivered
+    for (auto transfer = m_transfers.begin(); transfer != m_transfers.end();)
+    {
+      auto const current = transfer++;
+      if (current->second.Transfer->IsCancelledBeforeResponse())
+      {
+        RemoveTransfer(current->first, CURLE_ABORTED_BY_CALLBACK);
+      }
+    }
+
+    if (clearsRequested != m_clearsDone)
+    {
+      while (!m_transfers.empty())
+      {
+        RemoveTransfer(m_transfers.begin()->first, CURLE_ABORTED_BY_CALLBACK);
+      }
+      CleanUpHosts(false);
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_clearsDone = clearsRequested;
+      m_stateChanged.notify_all();
+    }
+
+    CleanUpHosts(true);
+    Poll(waitFds, waitFdHosts);
+
+    for (auto& host : m_hosts)
+    {
+      int messagesLeft = 0;
+      while (auto message = curl_multi_info_read(host.second->MultiHandle, &messagesLeft))
+      {
+        if (message->msg == CURLMSG_DONE)
+        {
+          // The message is gone once the transfer is removed
+          auto handle = message->easy_handle;
+          auto result = message->data.result;
+          RemoveTransfer(handle, result);
+        }
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_running = false;
+  m_stateChanged.notify_all();
+}
+
+void CurlMultiplexer::Poll(
+    std::vector<curl_waitfd>& waitFds,
+    std::vector<HostMultiplexer*>& waitFdHosts)
+{
+  auto const now = std::chrono::steady_clock::now();
+  auto timeout = std::chrono::milliseconds(Details::DefaultMultiplexerPollMilliseconds);
+  waitFds.clear();
+  waitFdHosts.clear();
+  for (auto const& host : m_hosts)
+  {
+    for (auto const& socket : host.second->Sockets)
+    {
+      short events = 0;
+      if (socket.second == CURL_POLL_IN || socket.second == CURL_POLL_INOUT)
+      {
+        events |= CURL_WAIT_POLLIN;
+      }
+      if (socket.second == CURL_POLL_OUT || socket.second == CURL_POLL_INOUT)
+      {
+        events |= CURL_WAIT_POLLOUT;
+      }
+      waitFds.push_back(curl_waitfd{socket.first, events, 0});
+      waitFdHosts.push_back(host.second.get());
+    }
+    if (host.second->HasTimeout)
+    {
+      timeout = std::min(
+          timeout,
+          std::max(
+              std::chrono::duration_cast<std::chrono::milliseconds>(
+                  host.second->Timeout - now),
+              std::chrono::milliseconds(0)));
+    }
+  }
+
+  // The sockets of all the multi handles are waited on at once by the poll handle, which is woken
+  // up when there is new work for the thread.
+#if LIBCURL_VERSION_NUM >= 0x074400
+  curl_multi_poll(
+      m_pollHandle,
+      waitFds.data(),
+      static_cast<unsigned int>(waitFds.size()),
+      static_cast<int>(timeout.count()),
+      nullptr);
+#else
+  curl_multi_wait(
+      m_pollHandle,
+      waitFds.data(),
+      static_cast<unsigned int>(waitFds.size()),
+      static_cast<int>(timeout.count()),
+      nullptr);
+#endif
+
+  int runningTransfers = 0;
+  for (size_t i = 0; i < waitFds.size(); i++)
+  {
+    auto const socket = waitFds[i].fd;
+    auto const host = waitFdHosts[i];
+    // A socket closed while handling another one is no longer waited on.
+    if (waitFds[i].revents == 0 || host->Sockets.find(socket) == host->Sockets.end())
+    {
+      continue;
+    }
+    int events = 0;
+    if (waitFds[i].revents & (CURL_WAIT_POLLIN | CURL_WAIT_POLLPRI))
+    {
+      events |= CURL_CSELECT_IN;
+    }
+    if (waitFds[i].revents & CURL_WAIT_POLLOUT)
+    {
+      events |= CURL_CSELECT_OUT;
+    }
+    curl_multi_socket_action(host->MultiHandle, socket, events, &runningTransfers);
+  }
+
+  for (auto& host : m_hosts)
+  {
+    if (host.second->HasTimeout && host.second->Timeout <= std::chrono::steady_clock::now())
+    {
+      host.second->HasTimeout = false;
+      curl_multi_socket_action(
+          host.second->MultiHandle, CURL_SOCKET_TIMEOUT, 0, &runningTransfers);
+    }
+  }
+}
+
+void CurlMultiplexer::Wakeup()
+{
+#if LIBCURL_VERSION_NUM >= 0x074400
+  if (m_pollHandle)
+  {
+    curl_multi_wakeup(m_pollHandle);
+  }
+#endif
+}
+
+void CurlMultiplexer::AddTransfer(std::shared_ptr<CurlMultiplexedTransfer> transfer)
+{
+  auto& host = m_hosts[transfer->GetConnectionKey()];
+  if (!host)
+  {
+    LogThis("Creating a new multi handle for a multiplexed host.");
+    host = CreateHostMultiplexer(transfer->GetMaxConnections());
+    if (!host)
+    {
+      m_hosts.erase(transfer->GetConnectionKey());
+      transfer->OnDone(CURLE_OUT_OF_MEMORY);
+      return;
+    }
+    m_hostsCount = m_hosts.size();
+  }
+
+  auto handle = transfer->GetHandle();
+  if (curl_multi_add_handle(host->MultiHandle, handle) != CURLM_OK)
+  {
+    transfer->OnDone(CURLE_FAILED_INIT);
+    return;
+  }
+  ++host->TransfersCount;
+  m_transfers.emplace(handle, ActiveTransfer{std::move(transfer), host.get()});
+}
+
+void CurlMultiplexer::RemoveTransfer(CURL* handle, CURLcode result)
+{
+  auto transfer = m_transfers.find(handle);
+  if (transfer == m_transfers.end())
+  {
+    // Already done
+    return;
+  }
+  auto host = transfer->second.Host;
+  curl_multi_remove_handle(host->MultiHandle, handle);
+  if (--host->TransfersCount == 0)
+  {
+    host->IdleSince = std::chrono::steady_clock::now();
+  }
+  transfer->second.Transfer->OnDone(result);
+  m_transfers.erase(transfer);
+}
+
+void CurlMultiplexer::CleanUpHosts(bool idleOnly)
+{
+  // Same as connections in the connection pool, idle connections of a host are kept for a while
+  // to be re-used by the next requests.
+  auto const expiredSince = std::chrono::steady_clock::now()
+      - std::chrono::milliseconds(Details::DefaultConnectionExpiredMilliseconds);
+  for (auto host = m_hosts.begin(); host != m_hosts.end();)
+  {
+    if (host->second->TransfersCount > 0 || (idleOnly && host->second->IdleSince > expiredSince))
+    {
+      ++host;
+      continue;
+    }
+    LogThis("Closing the idle connections of a multiplexed host.");
+    curl_multi_cleanup(host->second->MultiHandle);
+    host = m_hosts.erase(host);
+  }
+  m_hostsCount = m_hosts.size();
+}
+
+void CurlMultiplexer::Add(std::shared_ptr<CurlMultiplexedTransfer> transfer)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_stop)
+    {
+      if (!m_running)
+      {
+        m_pollHandle = curl_multi_init();
+        if (!m_pollHandle)
+        {
+          throw Azure::Core::Http::TransportException(
+              "Error while sending request. curl_multi_init returned Null");
+        }
+        m_thread = std::thread([this]() { Run(); });
+        m_running = true;
+      }
+      m_transfersToAdd.push_back(std::move(transfer));
+      Wakeup();
+      return;
+    }
+  }
+  // The application is exiting
+  transfer->OnDone(CURLE_ABORTED_BY_CALLBACK);
+}
+
+void CurlMultiplexer::Resume(CURL* handle)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_transfersToResume.push_back(handle);
+  Wakeup();
+}
+
+void CurlMultiplexer::Remove(CURL* handle)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_transfersToRemove.push_back(handle);
+  Wakeup();
+}
+
+void CurlMultiplexer::Stop()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_stop = true;
+  Wakeup();
+  m_stateChanged.wait(lock, [this]() { return !m_running; });
+}
+
+std::unique_ptr<RawResponse> CurlMultiplexer::Send(
+    Context const& context,
+    Request& request,
+    CurlTransportOptions const& options)
+{
+  auto& multiplexer = GetInstance();
+  auto transfer
+      = std::make_shared<CurlMultiplexedTransfer>(multiplexer, context, request, options, false);
+  multiplexer.Add(transfer);
+
+  try
+  {
+    return transfer->WaitForResponse(context);
+  }
+  catch (...)
+  {
+    transfer->Cancel();
+    throw;
+  }
+}
+
+std::future<std::unique_ptr<RawResponse>> CurlMultiplexer::SendAsync(
+    Context const& context,
+    Request& request,
+    CurlTransportOptions const& options)
+{
+  auto& multiplexer = GetInstance();
+  auto transfer
+      = std::make_shared<CurlMultiplexedTransfer>(multiplexer, context, request, options, true);
+  auto response = transfer->GetResponseFuture();
+  multiplexer.Add(std::move(transfer));
+  return response;
+}
+
+size_t CurlMultiplexer::MultiplexersCount() { return GetInstance().m_hostsCount; }
+
+void CurlMultiplexer::ClearMultiplexers()
+{
+  auto& multiplexer = GetInstance();
+  std::unique_lock<std::mutex> lock(multiplexer.m_mutex);
+  if (!multiplexer.m_running)
+  {
+    return;
+  }
+  auto const clearRequest = ++multiplexer.m_clearsRequested;
+  multiplexer.Wakeup();
+  multiplexer.m_stateChanged.wait(lock, [&multiplexer, clearRequest]() {
+    return multiplexer.m_clearsDone >= clearRequest || !multiplexer.m_running;
+  });
 }
@@ -14,16 +14,20 @@
 
 #include "curl_connection_private.hpp"
 
+#include <array>
+#include <chrono>
 #include <curl/curl.h>
 #include <list>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 
 #if defined(TESTING_BUILD)
 // Define the class name that reads from ConnectionPool private members
 namespace Azure { namespace Core { namespace Test {
   class CurlConnectionPool_connectionPoolTest_Test;
+  class CurlConnectionPoolAccessor;
 }}} // namespace Azure::Core::Test
 #endif
 
@@ -35,39 +39,81 @@ namespace Azure { namespace Core { namespace Http {
    *
    * This pool offers static methods and it is allocated statically. There can be only one
    * connection pool per application.
+   *
+   * @remark The pool is split into a fixed number of shards, each one guarded by its own mutex.
+   * Every thread gets a home shard per connection key, so concurrent requests to the same host
+   * from different threads mostly lock different shards instead of serializing on one mutex.
    */
   class CurlConnectionPool {
 #if defined(TESTING_BUILD)
     // Give access to private to this tests class
     friend class Azure::Core::Test::CurlConnectionPool_connectionPoolTest_Test;
+    friend class Azure::Core::Test::CurlConnectionPoolAccessor;
 #endif
   public:
     /**
-     * @brief Mutex for accessing connection pool for thread-safe reading and writing.
+     * @brief A connection waiting in the pool to be re-used.
      */
-    AZ_CORE_DLLEXPORT static std::mutex ConnectionPoolMutex;
+    struct PooledConnection
+    {
+      /**
+       * @brief The connection.
+       */
+      std::unique_ptr<CurlNetworkConnection> Connection;
+
+      /**
+       * @brief The time when the connection is considered expired if it was not re-used.
+       */
+      std::chrono::steady_clock::time_point ExpiresOn;
+    };
 
     /**
-     * @brief Keeps an unique key for each host and creates a connection pool for each key.
+     * @brief One slice of the connection pool.
      *
-     * @detail This way getting a connection for a specific host can be done in O(1) instead of
-     * looping a single connection list to find the first connection for the required host.
-     *
-     * @remark There might be multiple connections for each host.
+     * @remark A connection key can have connections in more than one shard. Connections are moved
+     * back to the home shard of the thread releasing it and taken from the home shard of the
+     * requesting thread first.
      */
-    AZ_CORE_DLLEXPORT static std::
-        map<std::string, std::list<std::unique_ptr<CurlNetworkConnection>>>
-            ConnectionPoolIndex;
+    struct ConnectionPoolShard
+    {
+      /**
+       * @brief Mutex for accessing this shard for thread-safe reading and writing.
+       */
+      std::mutex Mutex;
+
+      /**
+       * @brief Keeps an unique key for each host and creates a connection list for each key.
+       *
+       * @detail This way getting a connection for a specific host can be done in O(1) instead of
+       * looping a single connection list to find the first connection for the required host.
+       *
+       * @remark There might be multiple connections for each host. Connections are sorted from
+       * the most recently used to the oldest one.
+       */
+      std::map<std::string, std::list<PooledConnection>> ConnectionPoolIndex;
+
+      /**
+       * @brief Connection keys from this shard with a pending expiration check in the cleaner.
+       *
+       * @remark There is at most one pending check for each key on each shard.
+       */
+      std::set<std::string> ScheduledKeys;
+    };
 
     /**
      * @brief Finds a connection to be re-used from the connection pool.
      * @remark If there is not any available connection, a new connection is created.
+     * @remark When the host has reached `MaxConnectionsPerHost`, waits until a connection is
+     * moved back to the pool or closed.
      *
+     * @param context #Context so that waiting for a connection can be cancelled.
      * @param request HTTP request to get #CurlNetworkConnection for.
+     * @param options The transport options used to create a new connection.
      *
      * @return #CurlNetworkConnection to use.
      */
     static std::unique_ptr<CurlNetworkConnection> GetCurlConnection(
+        Context const& context,
         Request& request,
         CurlTransportOptions const& options);
 
@@ -85,29 +131,84 @@ namespace Azure { namespace Core { namespace Http {
     CurlConnectionPool() = delete;
 
   private:
+    // Removes all connections from the pool
+    static void ClearIndex();
+
+    // Makes possible to know the number of connections in the pool for a connection key
+    static int64_t ConnectionsOnPool(std::string const& connectionKey);
+
+    // Makes possible to know the number of connection keys in the pool
+    static int64_t ConnectionsIndexOnPool();
+
     /**
-     * Review all connections in the pool and removes old connections that might be already
-     * expired and closed its connection on server side.
+     * @brief Removes the expired connections for \p connectionKey from one shard.
+     *
+     * @remark Called from the cleaner thread when the oldest connection for the key on the shard
+     * is expected to be expired. Schedules the next check if there are connections left.
      */
-    static void CleanUp();
+    static void CleanUp(size_t shardIndex, std::string const& connectionKey);
 
-    AZ_CORE_DLLEXPORT static int32_t s_connectionCounter;
-    AZ_CORE_DLLEXPORT static bool s_isCleanConnectionsRunning;
-    // Removes all connections and indexes
-    static void ClearIndex() { CurlConnectionPool::ConnectionPoolIndex.clear(); }
+    /**
+     * @brief Asks the cleaner thread to check \p connectionKey on a shard at \p expiresOn.
+     *
+     * @remark Starts the cleaner thread the first time it is called.
+     */
+    static void ScheduleCleanUp(
+        std::chrono::steady_clock::time_point expiresOn,
+        size_t shardIndex,
+        std::string const& connectionKey);
 
-    // Makes possible to know the number of current connections in the connection pool for an
-    // index
-    static int64_t ConnectionsOnPool(std::string const& host)
-    {
-      auto& pool = CurlConnectionPool::ConnectionPoolIndex[host];
-      return pool.size();
-    };
+    /**
+     * @brief Opens a new connection for \p request.
+     *
+     * @param connectionLimiter The limiter the new connection is counted on, if any.
+     */
+    static std::unique_ptr<CurlNetworkConnection> CreateCurlConnection(
+        Request& request,
+        CurlTransportOptions const& options,
+        std::string const& connectionKey,
+        std::shared_ptr<CurlConnectionLimiter> connectionLimiter);
 
-    // Makes possible to know the number indexes in the pool
-    static int64_t ConnectionsIndexOnPool()
-    {
-      return CurlConnectionPool::ConnectionPoolIndex.size();
-    };
+    /**
+     * @brief Gets the index of the shard the calling thread uses first for \p connectionKey.
+     */
+    static size_t GetHomeShardIndex(std::string const& connectionKey);
+
+    /**
+     * @brief Takes the first connection for \p connectionKey from one shard.
+     *
+     * @return The connection or `nullptr` if the shard has no connection for the key.
+     */
+    static std::unique_ptr<CurlNetworkConnection> TakeConnectionFromShard(
+        ConnectionPoolShard& shard,
+        std::string const& connectionKey);
+
+    /**
+     * @brief Takes the first connection for \p connectionKey from any shard, starting at the home
+     * shard of the calling thread.
+     *
+     * @remark Shards are locked one at a time, so a connection moved back to a shard already
+     * probed is missed. The caller opens a new connection then.
+     *
+     * @return The connection or `nullptr` if there is no connection for the key in the pool.
+     */
+    static std::unique_ptr<CurlNetworkConnection> TakeConnectionFromPool(
+        std::string const& connectionKey);
+
+    /**
+     * @brief Gets the limiter for \p connectionKey, creating it on first use.
+     *
+     * @remark The limiter is forgotten once the connections for the key are closed and no request
+     * is waiting for one.
+     */
+    static std::shared_ptr<CurlConnectionLimiter> GetConnectionLimiter(
+        std::string const& connectionKey,
+        CurlTransportOptions const& options);
+
+    // Makes possible to know the number of hosts with a connection limiter
+    static size_t ConnectionLimitersCount();
+
+    AZ_CORE_DLLEXPORT static std::array<ConnectionPoolShard, Details::ConnectionPoolShardCount>
+        s_shards;
   };
 }}} // namespace Azure::Core::Http
@@ -12,7 +12,12 @@
 #include "azure/core/http/http.hpp"
 
 #include <chrono>
+#include <condition_variable>
 #include <curl/curl.h>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
 
 namespace Azure { namespace Core { namespace Http {
@@ -20,18 +25,92 @@ namespace Azure { namespace Core { namespace Http {
   namespace Details {
     // libcurl CURL_MAX_WRITE_SIZE is 64k. Using same value for default uploading chunk size.
     // This can be customizable in the HttpRequest
-    constexpr static int64_t DefaultUploadChunkSize = 1024 * 64;
-    constexpr static auto DefaultLibcurlReaderSize = 1024;
+    constexpr static size_t DefaultUploadChunkSize = 1024 * 64;
+    // Default size of the buffer a session reads headers and small body reads into.
+    constexpr static size_t DefaultLibcurlReaderSize = 1024 * 16;
     // Run time error template
     constexpr static const char* DefaultFailedToGetNewConnectionTemplate
         = "Fail to get a new connection for: ";
     constexpr static int DefaultMaxOpenNewConnectionIntentsAllowed = 10;
-    // 90 sec -> cleaner wait time before next clean routine
-    constexpr static int DefaultCleanerIntervalMilliseconds = 1000 * 90;
     // 60 sec -> expired connection is when it waits for 60 sec or more and it's not re-used
     constexpr static int DefaultConnectionExpiredMilliseconds = 1000 * 60;
+    // Number of lock-striped shards in the connection pool. Power of two so the shard index is a
+    // mask over the hash.
+    constexpr static size_t ConnectionPoolShardCount = 16;
+    // 1 sec -> max time a request waiting for a connection goes without checking cancellation
+    constexpr static int DefaultConnectionWaitIntervalMilliseconds = 1000;
   } // namespace Details
 
+  /**
+   * @brief Keeps track of the connections open to one host and of the requests waiting to get a
+   * connection when the host reached its limit of connections.
+   *
+   * @remark Requests waiting for a connection are served in the same order they started waiting.
+   */
+  class CurlConnectionLimiter {
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_waitQueueChanged;
+    size_t const m_maxConnections;
+    size_t const m_maxIdleConnections;
+    int64_t m_openConnections = 0;
+    int64_t m_idleConnections = 0;
+    uint64_t m_nextTicket = 0;
+    std::list<uint64_t> m_waitQueue;
+
+  public:
+    /**
+     * @brief Construct a limiter for one host.
+     *
+     * @param maxConnections Max number of open connections. `0` means no limit.
+     * @param maxIdleConnections Max number of connections in the pool. `0` means no limit.
+     */
+    CurlConnectionLimiter(size_t maxConnections, size_t maxIdleConnections)
+        : m_maxConnections(maxConnections), m_maxIdleConnections(maxIdleConnections)
+    {
+    }
+
+    /**
+     * @brief Wait in the queue until there is a connection in the pool to be re-used or until a
+     * new connection can be open.
+     *
+     * @param context #Context so that waiting can be cancelled.
+     * @return `true` when a connection in the pool was reserved for the caller. `false` when the
+     * caller is allowed to open a new connection.
+     *
+     * @throw OperationCancelledException if \p context is cancelled while waiting.
+     */
+    bool Acquire(Context const& context);
+
+    /**
+     * @brief Called when a connection reserved by #Acquire is not in the pool anymore (it
+     * expired). The reservation becomes a new connection reservation.
+     */
+    void OnIdleConnectionMissing();
+
+    /**
+     * @brief Moves a connection back to the pool if there is room for one more idle connection.
+     *
+     * @remark \p moveToPool is called with the limiter locked, so connections moved back at the
+     * same time can't go over the max number of idle connections.
+     *
+     * @param moveToPool Moves the connection to the pool.
+     * @return `false` when the pool has the max number of idle connections already. \p moveToPool
+     * is not called then.
+     */
+    bool MoveConnectionToPool(std::function<void()> const& moveToPool);
+
+    /**
+     * @brief Called when the pool removes an idle connection without handing it to a request.
+     */
+    void OnConnectionRemovedFromPool();
+
+    /**
+     * @brief Called when a connection is closed.
+     */
+    void OnConnectionClosed();
+  };
+
   /**
    * @brief Interface for the connection to the network with Curl.
    *
@@ -77,6 +156,13 @@ namespace Azure { namespace Core { namespace Http {
      */
     virtual CURLcode SendBuffer(Context const& context, uint8_t const* buffer, size_t bufferSize)
         = 0;
+
+    /**
+     * @brief Get the per-host limiter this connection is counted on.
+     *
+     * @return `nullptr` when the connection was created without per-host limits.
+     */
+    virtual CurlConnectionLimiter* GetConnectionLimiter() const { return nullptr; }
   };
 
   /**
@@ -88,15 +174,21 @@ namespace Azure { namespace Core { namespace Http {
     curl_socket_t m_curlSocket;
     std::chrono::steady_clock::time_point m_lastUseTime;
     std::string m_connectionKey;
+    std::shared_ptr<CurlConnectionLimiter> m_connectionLimiter;
 
   public:
     /**
      * @Brief Construct CURL HTTP connection.
      *
      * @param host HTTP connection host name.
+     * @param connectionLimiter The per-host limiter to notify when the connection is closed.
      */
-    CurlConnection(CURL* handle, std::string connectionPropertiesKey)
-        : m_handle(handle), m_connectionKey(std::move(connectionPropertiesKey))
+    CurlConnection(
+        CURL* handle,
+        std::string connectionPropertiesKey,
+        std::shared_ptr<CurlConnectionLimiter> connectionLimiter = nullptr)
+        : m_handle(handle), m_connectionKey(std::move(connectionPropertiesKey)),
+          m_connectionLimiter(std::move(connectionLimiter))
     {
       // Get the socket that libcurl is using from handle. Will use this to wait while
       // reading/writing
@@ -122,10 +214,22 @@ namespace Azure { namespace Core { namespace Http {
        * @brief Destructor.
        * @detail Cleans up CURL (invokes `curl_easy_cleanup()`).
        */
-      ~CurlConnection() override { curl_easy_cleanup(this->m_handle); }
+      ~CurlConnection() override
+      {
+        curl_easy_cleanup(this->m_handle);
+        if (this->m_connectionLimiter)
+        {
+          this->m_connectionLimiter->OnConnectionClosed();
+        }
+      }
 
       std::string const& GetConnectionKey() const override { return this->m_connectionKey; }
 
+      CurlConnectionLimiter* GetConnectionLimiter() const override
+      {
+        return this->m_connectionLimiter.get();
+      }
+
       /**
        * @brief Update last usage time for the connection.
        */
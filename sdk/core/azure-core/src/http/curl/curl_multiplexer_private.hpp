@@ -0,0 +1,354 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// SPDX-License-Identifier: MIT
+
+/**
+ * @file
+ * @brief The curl multiplexer sends many requests at the same time over a few connections to one
+ * host, as HTTP/2 streams, using the libcurl multi interface.
+ */
+
+#pragma once
+
+#include "azure/core/context.hpp"
+#include "azure/core/http/curl/curl.hpp"
+#include "azure/core/http/http.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <curl/curl.h>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Azure { namespace Core { namespace Http {
+
+  namespace Details {
+    // Bytes of a response body a multiplexed transfer keeps before it is paused until the body
+    // stream is read.
+    constexpr static size_t DefaultMultiplexedBodyBufferSize = 1024 * 64;
+    // Max time the multiplexer thread waits for network activity before checking for new work.
+    // Libcurl older than 7.68 can't wake the thread up, so it checks more often.
+#if LIBCURL_VERSION_NUM >= 0x074400
+    constexpr static int DefaultMultiplexerPollMilliseconds = 1000;
+#else
+    constexpr static int DefaultMultiplexerPollMilliseconds = 10;
+#endif
+  } // namespace Details
+
+  class CurlMultiplexer;
+
+  /**
+   * @brief One request sent by a #CurlMultiplexer and the response coming back for it.
+   *
+   * @remark The libcurl callbacks run on the multiplexer thread. They fill the response and its
+   * body buffer, which the thread that sent the request reads from.
+   *
+   * @remark The response of a transfer sent with #CurlMultiplexer::SendAsync is delivered through
+   * a promise by the multiplexer thread.
+   */
+  class CurlMultiplexedTransfer : public std::enable_shared_from_this<CurlMultiplexedTransfer> {
+  private:
+    CurlMultiplexer& m_multiplexer;
+    std::string m_connectionKey;
+    size_t m_maxConnections;
+    HttpMethod m_method;
+    Context m_context;
+    CURL* m_handle;
+    curl_slist* m_headers = nullptr;
+    // The body of the request is read from the stream of the request, or from a copy owned by the
+    // transfer when the stream is null.
+    BodyStream* m_requestBodyStream;
+    std::vector<uint8_t> m_requestBody;
+    size_t m_requestBodyOffset = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_stateChanged;
+    std::unique_ptr<RawResponse> m_response;
+    bool m_headersReceived = false;
+    bool m_done = false;
+    CURLcode m_result = CURLE_OK;
+    std::string m_error;
+    // Body bytes received and not yet read. Bytes before m_bodyOffset were already read.
+    std::vector<uint8_t> m_body;
+    size_t m_bodyOffset = 0;
+    bool m_paused = false;
+    // Set for transfers sent with SendAsync until the response, or the error, is delivered.
+    std::unique_ptr<std::promise<std::unique_ptr<RawResponse>>> m_responsePromise;
+
+    static size_t OnHeader(char* buffer, size_t size, size_t count, void* userData);
+    static size_t OnWrite(char* buffer, size_t size, size_t count, void* userData);
+    static size_t OnUpload(char* buffer, size_t size, size_t count, void* userData);
+
+    std::string GetError() const;
+
+    /**
+     * @brief Move the response out, with the body stream reading from this transfer.
+     */
+    std::unique_ptr<RawResponse> TakeResponse();
+
+    /**
+     * @brief Fulfill the promise of a transfer sent with SendAsync once the headers are received
+     * or the transfer is done. Called without holding the transfer mutex.
+     */
+    void DeliverResponse();
+
+  public:
+    /**
+     * @brief Set up a libcurl handle to send \p request.
+     *
+     * @param copyRequestBody Read the request body into memory, so \p request is not used once
+     * the transfer is constructed. Otherwise, it must be kept alive until the transfer is done.
+     *
+     * @throw TransportException if the handle can't be set up.
+     */
+    CurlMultiplexedTransfer(
+        CurlMultiplexer& multiplexer,
+        Context const& context,
+        Request& request,
+        CurlTransportOptions const& options,
+        bool copyRequestBody);
+
+    ~CurlMultiplexedTransfer();
+
+    CurlMultiplexedTransfer(CurlMultiplexedTransfer const&) = delete;
+    CurlMultiplexedTransfer& operator=(CurlMultiplexedTransfer const&) = delete;
+
+    CURL* GetHandle() const { return m_handle; }
+
+    /**
+     * @brief The key of the host and transport options the transfer shares a multi handle with.
+     */
+    std::string const& GetConnectionKey() const { return m_connectionKey; }
+
+    /**
+     * @brief The max number of connections to the host, `0` for no limit.
+     */
+    size_t GetMaxConnections() const { return m_maxConnections; }
+
+    /**
+     * @brief Called by the multiplexer thread once libcurl is done with the transfer or the
+     * transfer was removed from the multiplexer.
+     */
+    void OnDone(CURLcode result);
+
+    /**
+     * @brief Get the future for the response. Only for transfers sent with SendAsync, before they
+     * are added to the multiplexer.
+     */
+    std::future<std::unique_ptr<RawResponse>> GetResponseFuture();
+
+    /**
+     * @brief Check if the context of a transfer sent with SendAsync was cancelled before its
+     * response was delivered.
+     */
+    bool IsCancelledBeforeResponse();
+
+    /**
+     * @brief Wait until the status line and headers of the response are received.
+     *
+     * @throw TransportException if the transfer failed before the headers were received.
+     * @throw OperationCancelledException if \p context is cancelled while waiting.
+     */
+    std::unique_ptr<RawResponse> WaitForResponse(Context const& context);
+
+    /**
+     * @brief Read up to \p count bytes of the response body, waiting for them to arrive if none
+     * are buffered.
+     *
+     * @return The number of bytes read. `0` once the whole body was read.
+     */
+    int64_t ReadBody(Context const& context, uint8_t* buffer, int64_t count);
+
+    /**
+     * @brief Stop the transfer if it is not done and wait until libcurl is no longer using it.
+     *
+     * @remark On the multiplexer thread, the transfer is removed later without waiting.
+     */
+    void Cancel();
+  };
+
+  /**
+   * @brief The body stream of a response received by a #CurlMultiplexer.
+   *
+   * @remark Destroying the body stream before it is read to the end cancels the transfer.
+   */
+  class CurlMultiplexedBodyStream : public BodyStream {
+  private:
+    std::shared_ptr<CurlMultiplexedTransfer> m_transfer;
+    int64_t m_contentLength;
+
+    int64_t OnRead(Context const& context, uint8_t* buffer, int64_t count) override
+    {
+      return m_transfer->ReadBody(context, buffer, count);
+    }
+
+  public:
+    CurlMultiplexedBodyStream(
+        std::shared_ptr<CurlMultiplexedTransfer> transfer,
+        int64_t contentLength)
+        : m_transfer(std::move(transfer)), m_contentLength(contentLength)
+    {
+    }
+
+    ~CurlMultiplexedBodyStream() override { m_transfer->Cancel(); }
+
+    int64_t Length() const override { return m_contentLength; }
+  };
+
+  /**
+   * @brief Drives all the multiplexed transfers of the application from a single thread, with the
+   * libcurl multi socket interface.
+   *
+   * @remark Transfers to one host with the same transport options share a libcurl multi handle.
+   * Libcurl multiplexes them as streams over a shared HTTP/2 connection when the server supports
+   * it, and re-uses connections between transfers otherwise. The thread waits for activity on the
+   * sockets of all the multi handles at once, and only calls into libcurl for the sockets which
+   * are ready and the timeouts which are due.
+   *
+   * @remark There is one multi handle per host and transport options, created on the first
+   * request. It is destroyed with its idle connections once it had no transfer for as long as a
+   * connection is kept in the connection pool.
+   *
+   * @remark The multiplexer is leaked together with its thread, which is never joined. #Stop is
+   * called when static objects are destroyed.
+   */
+  class CurlMultiplexer {
+  private:
+    // The multi handle for the transfers to one host with the same transport options.
+    struct HostMultiplexer
+    {
+      CURLM* MultiHandle = nullptr;
+      // Sockets libcurl waits on, with the CURL_POLL_* events it waits for.
+      std::map<curl_socket_t, int> Sockets;
+      // Transfers added to the multi handle, and when the last one was removed.
+      size_t TransfersCount = 0;
+      std::chrono::steady_clock::time_point IdleSince;
+      // When libcurl asked to be called back without socket activity, if it did.
+      bool HasTimeout = false;
+      std::chrono::steady_clock::time_point Timeout;
+    };
+
+    // A transfer added to the multi handle of its host.
+    struct ActiveTransfer
+    {
+      std::shared_ptr<CurlMultiplexedTransfer> Transfer;
+      HostMultiplexer* Host;
+    };
+
+    // Work handed to the multiplexer thread by other threads.
+    std::mutex m_mutex;
+    std::condition_variable m_stateChanged;
+    std::vector<std::shared_ptr<CurlMultiplexedTransfer>> m_transfersToAdd;
+    std::vector<CURL*> m_transfersToResume;
+    std::vector<CURL*> m_transfersToRemove;
+    uint64_t m_clearsRequested = 0;
+    uint64_t m_clearsDone = 0;
+    bool m_stop = false;
+    bool m_running = false;
+    // Waits for network activity and wakes the thread up. No transfer is added to it.
+    CURLM* m_pollHandle = nullptr;
+    std::thread m_thread;
+
+    // Only used by the multiplexer thread.
+    std::map<std::string, std::unique_ptr<HostMultiplexer>> m_hosts;
+    std::map<CURL*, ActiveTransfer> m_transfers;
+    std::atomic<size_t> m_hostsCount{0};
+
+    CurlMultiplexer() = default;
+
+    void Run();
+    // Called with m_mutex held.
+    void Wakeup();
+    void AddTransfer(std::shared_ptr<CurlMultiplexedTransfer> transfer);
+    void RemoveTransfer(CURL* handle, CURLcode result);
+    // Waits until a socket is ready or a timeout is due, and lets libcurl handle them.
+    void Poll(std::vector<curl_waitfd>& waitFds, std::vector<HostMultiplexer*>& waitFdHosts);
+    // Destroys the multi handles idle for long enough, or all of them when they are all idle.
+    void CleanUpHosts(bool idleOnly);
+
+    static std::unique_ptr<HostMultiplexer> CreateHostMultiplexer(size_t maxConnections);
+    static int OnSocket(CURL* handle, curl_socket_t socket, int what, void* userData, void*);
+    static int OnTimer(CURLM* multiHandle, long timeoutMilliseconds, void* userData);
+
+  public:
+    static CurlMultiplexer& GetInstance();
+
+    CurlMultiplexer(CurlMultiplexer const&) = delete;
+    CurlMultiplexer& operator=(CurlMultiplexer const&) = delete;
+
+    /**
+     * @brief Start sending a transfer. Starts the multiplexer thread the first time it is called.
+     *
+     * @throw TransportException if the multiplexer thread can't be started.
+     */
+    void Add(std::shared_ptr<CurlMultiplexedTransfer> transfer);
+
+    /**
+     * @brief Resume a transfer paused because its body buffer was full.
+     */
+    void Resume(CURL* handle);
+
+    /**
+     * @brief Remove a transfer which is not done. The transfer is done once it is removed.
+     */
+    void Remove(CURL* handle);
+
+    /**
+     * @brief Check if the calling thread is the multiplexer thread.
+     */
+    bool IsMultiplexerThread() const { return std::this_thread::get_id() == m_thread.get_id(); }
+
+    /**
+     * @brief Stop the multiplexer thread and wait until it no longer calls into libcurl.
+     *
+     * @remark Transfers which are not done are left as they are. Transfers added later are
+     * failed.
+     */
+    void Stop();
+
+    /**
+     * @brief Send \p request with the multiplexer and wait for the response headers.
+     *
+     * @remark The body of the response is streamed from the network while it is read.
+     *
+     * @throw TransportException if the request can't be sent or the response is not received.
+     */
+    static std::unique_ptr<RawResponse> Send(
+        Context const& context,
+        Request& request,
+        CurlTransportOptions const& options);
+
+    /**
+     * @brief Start sending \p request with the multiplexer.
+     *
+     * @remark The request body is read into memory first. The transfer doesn't use \p request
+     * once this returns, and the future can be dropped before it is ready.
+     *
+     * @return A future ready once the response headers are received, or with the exception that
+     * stopped the transfer before.
+     */
+    static std::future<std::unique_ptr<RawResponse>> SendAsync(
+        Context const& context,
+        Request& request,
+        CurlTransportOptions const& options);
+
+    /**
+     * @brief The number of multi handles created, one for each host and transport options.
+     */
+    static size_t MultiplexersCount();
+
+    /**
+     * @brief Destroy all the multi handles, closing their connections.
+     *
+     * @remark Transfers which are not done are cancelled. No response received through the
+     * multiplexer can be alive when calling this.
+     */
+    static void ClearMultiplexers();
+  };
+
+}}} // namespace Azure::Core::Http
@@ -134,33 +134,6 @@ namespace Azure { namespace Core { namespace Http {
        */
       std::string m_internalBuffer;
 
-      /**
-       * @brief This method is invoked by the Parsing process if the internal state is set to
-       * status code. Function will get the status-line expected tokens until finding the end of
-       * status line delimiter.
-       *
-       * @remark When the end of status line delimiter is found, this method will create the HTTP
-       * RawResponse. The HTTP RawResponse is constructed by default with body type as Stream.
-       *
-       * @param buffer Points to a memory address with all or some part of a HTTP status line.
-       * @param bufferSize Indicates the size of the buffer.
-       * @return Returns the index of the last parsed position from buffer.
-       */
-      int64_t BuildStatusCode(uint8_t const* const buffer, int64_t const bufferSize);
-
-      /**
-       * @brief This method is invoked by the Parsing process if the internal state is set to
-       * headers. Function will keep adding headers to the HTTP RawResponse created before while
-       * parsing an status line.
-       *
-       * @param buffer Points to a memory address with all or some part of a HTTP header.
-       * @param bufferSize Indicates the size of the buffer.
-       * @return Returns the index of the last parsed position from buffer. When the returned
-       * value is smaller than the body size, means there is part of the body response in the
-       * buffer.
-       */
-      int64_t BuildHeader(uint8_t const* const buffer, int64_t const bufferSize);
-
     public:
       /**
        * @brief Construct a new RawResponse Buffer Parser object.
@@ -247,7 +220,7 @@ namespace Azure { namespace Core { namespace Http {
      * from wire into it, it can be holding less then N bytes.
      *
      */
-    int64_t m_innerBufferSize = Details::DefaultLibcurlReaderSize;
+    int64_t m_innerBufferSize = 0;
 
     bool m_isChunkedResponseType = false;
 
@@ -277,8 +250,13 @@ namespace Azure { namespace Core { namespace Http {
      * provide their own buffer to copy from socket when reading the HTTP body using streams.
      *
      */
-    uint8_t m_readBuffer[Details::DefaultLibcurlReaderSize]
-        = {0}; // to work with libcurl custom read.
+    std::unique_ptr<uint8_t[]> m_readBuffer;
+
+    /**
+     * @brief The capacity of #m_readBuffer.
+     *
+     */
+    int64_t m_readBufferSize;
 
     /**
      * @brief Function used when working with Streams to manually write from the HTTP Request to
@@ -290,14 +268,22 @@ namespace Azure { namespace Core { namespace Http {
      */
     CURLcode SendRawHttp(Context const& context);
 
+    /**
+     * @brief Get the size of the pieces the request body is sent in.
+     *
+     */
+    int64_t GetUploadChunkSize();
+
     /**
      * @brief Upload body.
      *
      * @param context #Context so that operation can be cancelled.
+     * @param messagePreBody HTTP request line and headers to send together with the first piece
+     * of the body.
      *
      * @return Curl code.
      */
-    CURLcode UploadBody(Context const& context);
+    CURLcode UploadBody(Context const& context, std::string const& messagePreBody = std::string());
 
     /**
      * @brief This function is used after sending an HTTP request to the server to read the HTTP
@@ -320,6 +306,15 @@ namespace Azure { namespace Core { namespace Http {
      */
     void ParseChunkSize(Context const& context);
 
+    /**
+     * @brief Copies up to \p count bytes of the response body from the inner buffer to \p buffer.
+     *
+     * @param buffer Buffer where data from the inner buffer is written to.
+     * @param count The number of bytes to copy.
+     * @return The actual number of bytes copied.
+     */
+    int64_t ReadFromInnerBuffer(uint8_t* buffer, int64_t count);
+
     /**
      * @brief Last HTTP status code read.
      *
@@ -355,6 +350,18 @@ namespace Azure { namespace Core { namespace Http {
      */
     bool m_keepAlive = true;
 
+    /**
+     * @brief The size of the pieces the request body is sent in, unless the request sets one.
+     *
+     */
+    int64_t m_uploadChunkSize;
+
+    /**
+     * @brief Whether the request waits for a `100 Continue` response before sending the body.
+     *
+     */
+    bool m_expectContinue = false;
+
     /**
      * @brief Implement #BodyStream `OnRead`. Calling this function pulls data from the wire.
      *
@@ -370,9 +377,25 @@ namespace Azure { namespace Core { namespace Http {
      * @brief Construct a new Curl Session object. Init internal libcurl handler.
      *
      * @param request reference to an HTTP Request.
+     * @param connection The connection used to send the request and read the response.
+     * @param keepAlive Whether the connection can be moved back to the connection pool.
+     * @param readBufferSize The size of the buffer used to read the response from the network.
+     * @param uploadChunkSize The size of the pieces the request body is sent in.
      */
-    CurlSession(Request& request, std::unique_ptr<CurlNetworkConnection> connection, bool keepAlive)
-        : m_connection(std::move(connection)), m_request(request), m_keepAlive(keepAlive)
+    CurlSession(
+        Request& request,
+        std::unique_ptr<CurlNetworkConnection> connection,
+        bool keepAlive,
+        size_t readBufferSize = Details::DefaultLibcurlReaderSize,
+        size_t uploadChunkSize = Details::DefaultUploadChunkSize)
+        : m_connection(std::move(connection)), m_request(request),
+          m_readBuffer(std::make_unique<uint8_t[]>(
+              readBufferSize > 0 ? readBufferSize : Details::DefaultLibcurlReaderSize)),
+          m_readBufferSize(static_cast<int64_t>(
+              readBufferSize > 0 ? readBufferSize : Details::DefaultLibcurlReaderSize)),
+          m_keepAlive(keepAlive),
+          m_uploadChunkSize(static_cast<int64_t>(
+              uploadChunkSize > 0 ? uploadChunkSize : Details::DefaultUploadChunkSize))
     {
     }
 
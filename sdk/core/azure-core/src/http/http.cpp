@@ -2,156 +2,286 @@
 // SPDX-License-Identifier: MIT
 
 #include "azure/core/http/http.hpp"
+#include "azure/core/internal/strings.hpp"
 
 #include <utility>
 
+using Azure::Core::Http::CaseInsensitiveHeaders;
+
+namespace {
+// Static table for validating header names. It is created just once for the program and reused
+// each time AddHeader is called. Valid characters map to their lower case.
+const uint8_t validChars[256] = {
+    0, /* 0 - null */
+    0, /* 1 - start of heading */
+    0, /* 2 - start of text */
+    0, /* 3 - end of text */
+    0, /* 4 - end of transmission */
+    0, /* 5 - enquiry */
+    0, /* 6 - acknowledge */
+    0, /* 7 - bell */
+    0, /* 8 - backspace */
+    0, /* 9 - horizontal tab */
+    0, /* 10 -  new line */
+    0, /* 11 -  vertical tab */
+    0, /* 12 -  new page */
+    0, /* 13 -  carriage return */
+    0, /* 14 -  shift out */
+    0, /* 15 -  shift in */
+    0, /* 16 -  data link escape */
+    0, /* 17 -  device control 1 */
+    0, /* 18 -  device control 2 */
+    0, /* 19 -  device control 3 */
+    0, /* 20 -  device control 4 */
+    0, /* 21 -  negative acknowledge */
+    0, /* 22 -  synchronous idle */
+    0, /* 23 -  end of trans. block */
+    0, /* 24 -  cancel */
+    0, /* 25 -  end of medium */
+    0, /* 26 -  substitute */
+    0, /* 27 -  escape */
+    0, /* 28 -  file separator */
+    0, /* 29 -  group separator */
+    0, /* 30 -  record separator */
+    0, /* 31 -  unit separator */
+    ' ', /* 32 -  space */
+    '!', /* 33 -  ! */
+    0, /* 34 -  " */
+    '#', /* 35 -  # */
+    '$', /* 36 -  $ */
+    '%', /* 37 -  % */
+    '&', /* 38 -  & */
+    '\'', /* 39 - ' */
+    0, /* 40 -  ( */
+    0, /* 41 -  ) */
+    '*', /* 42 -  * */
+    '+', /* 43 -  + */
+    0, /* 44 -  , */
+    '-', /* 45 -  - */
+    '.', /* 46 -  . */
+    0, /* 47 -  / */
+    '0', /* 48 -  0 */
+    '1', /* 49 -  1 */
+    '2', /* 50 -  2 */
+    '3', /* 51 -  3 */
+    '4', /* 52 -  4 */
+    '5', /* 53 -  5 */
+    '6', /* 54 -  6 */
+    '7', /* 55 -  7 */
+    '8', /* 56 -  8 */
+    '9', /* 57 -  9 */
+    0, /* 58 -  : */
+    0, /* 59 -  ; */
+    0, /* 60 -  < */
+    0, /* 61 -  = */
+    0, /* 62 -  > */
+    0, /* 63 -  ? */
+    0, /* 64 -  @ */
+    'a', /* 65 -  A */
+    'b', /* 66 -  B */
+    'c', /* 67 -  C */
+    'd', /* 68 -  D */
+    'e', /* 69 -  E */
+    'f', /* 70 -  F */
+    'g', /* 71 -  G */
+    'h', /* 72 -  H */
+    'i', /* 73 -  I */
+    'j', /* 74 -  J */
+    'k', /* 75 -  K */
+    'l', /* 76 -  L */
+    'm', /* 77 -  M */
+    'n', /* 78 -  N */
+    'o', /* 79 -  O */
+    'p', /* 80 -  P */
+    'q', /* 81 -  Q */
+    'r', /* 82 -  R */
+    's', /* 83 -  S */
+    't', /* 84 -  T */
+    'u', /* 85 -  U */
+    'v', /* 86 -  V */
+    'w', /* 87 -  W */
+    'x', /* 88 -  X */
+    'y', /* 89 -  Y */
+    'z', /* 90 -  Z */
+    0, /* 91 -  [ */
+    0, /* 92 -  comment */
+    0, /* 93 -  ] */
+    '^', /* 94 -  ^ */
+    '_', /* 95 -  _ */
+    '`', /* 96 -  ` */
+    'a', /* 97 -  a */
+    'b', /* 98 -  b */
+    'c', /* 99 -  c */
+    'd', /* 100 -  d */
+    'e', /* 101 -  e */
+    'f', /* 102 -  f */
+    'g', /* 103 -  g */
+    'h', /* 104 -  h */
+    'i', /* 105 -  i */
+    'j', /* 106 -  j */
+    'k', /* 107 -  k */
+    'l', /* 108 -  l */
+    'm', /* 109 -  m */
+    'n', /* 110 -  n */
+    'o', /* 111 -  o */
+    'p', /* 112 -  p */
+    'q', /* 113 -  q */
+    'r', /* 114 -  r */
+    's', /* 115 -  s */
+    't', /* 116 -  t */
+    'u', /* 117 -  u */
+    'v', /* 118 -  v */
+    'w', /* 119 -  w */
+    'x', /* 120 -  x */
+    'y', /* 121 -  y */
+    'z', /* 122 -  z */
+    0, /* 123 -  { */
+    '|', /* 124 -  | */
+    0, /* 125 -  } */
+    '~', /* 126 -  ~ */
+    0 /* 127 -  DEL */
+    // ...128-255 is all zeros (not valid) characters}
+};
+
+// Compares the names ignoring case, returning less than, equal to or greater than zero
+int CompareHeaderNames(char const* left, size_t leftSize, char const* right, size_t rightSize)
+{
+  auto const size = std::min(leftSize, rightSize);
+  for (size_t index = 0; index < size; index++)
+  {
+    auto const leftChar = Azure::Core::Internal::Strings::ToLower(
+        static_cast<unsigned char>(left[index]));
+    auto const rightChar = Azure::Core::Internal::Strings::ToLower(
+        static_cast<unsigned char>(right[index]));
+    if (leftChar != rightChar)
+    {
+      return leftChar < rightChar ? -1 : 1;
+    }
+  }
+  return leftSize == rightSize ? 0 : (leftSize < rightSize ? -1 : 1);
+}
+} // namespace
+
+CaseInsensitiveHeaders::const_iterator CaseInsensitiveHeaders::LowerBound(
+    char const* name,
+    size_t nameSize) const
+{
+  return std::lower_bound(
+      m_headers.begin(),
+      m_headers.end(),
+      name,
+      [nameSize](value_type const& header, char const* value) {
+        return CompareHeaderNames(header.first.data(), header.first.size(), value, nameSize) < 0;
+      });
+}
+
+CaseInsensitiveHeaders::const_iterator CaseInsensitiveHeaders::Find(
+    char const* name,
+    size_t nameSize) const
+{
+  auto header = LowerBound(name, nameSize);
+  if (header != m_headers.end()
+      && CompareHeaderNames(header->first.data(), header->first.size(), name, nameSize) == 0)
+  {
+    return header;
+  }
+  return m_headers.end();
+}
+
+std::string const& CaseInsensitiveHeaders::At(char const* name, size_t nameSize) const
+{
+  auto header = Find(name, nameSize);
+  if (header == m_headers.end())
+  {
+    throw std::out_of_range("Header not found: " + std::string(name, nameSize));
+  }
+  return header->second;
+}
+
+void CaseInsensitiveHeaders::insert_or_assign(std::string name, std::string value)
+{
+  auto header = LowerBound(name.data(), name.size());
+  if (header != m_headers.end()
+      && CompareHeaderNames(header->first.data(), header->first.size(), name.data(), name.size())
+          == 0)
+  {
+    // const_iterator to iterator, same position
+    m_headers[header - m_headers.begin()].second = std::move(value);
+    return;
+  }
+
+  for (auto& c : name)
+  {
+    c = static_cast<char>(Azure::Core::Internal::Strings::ToLower(static_cast<unsigned char>(c)));
+  }
+  if (m_headers.capacity() == 0)
+  {
+    // Room for the headers of a typical request or response, so inserting doesn't grow the
+    // array again and again. The collection is empty, so the insert position is the start.
+    m_headers.reserve(16);
+    header = m_headers.begin();
+  }
+  m_headers.emplace(header, std::move(name), std::move(value));
+}
+
+std::string& CaseInsensitiveHeaders::operator[](std::string const& name)
+{
+  auto header = Find(name.data(), name.size());
+  if (header == m_headers.end())
+  {
+    insert_or_assign(name, std::string());
+    header = Find(name.data(), name.size());
+  }
+  // const_iterator to iterator, same position
+  return m_headers[header - m_headers.begin()].second;
+}
+
+size_t CaseInsensitiveHeaders::erase(std::string const& name)
+{
+  auto header = Find(name.data(), name.size());
+  if (header == m_headers.end())
+  {
+    return 0;
+  }
+  m_headers.erase(header);
+  return 1;
+}
+
 void Azure::Core::Http::Details::InsertHeaderWithValidation(
-    std::map<std::string, std::string>& headers,
+    CaseInsensitiveHeaders& headers,
     std::string const& headerName,
     std::string const& headerValue)
 {
-  // Static table for validating header names. It is created just once for the program and reused
-  // each time AddHeader is called
-  static const uint8_t validChars[256] = {
-      0, /* 0 - null */
-      0, /* 1 - start of heading */
-      0, /* 2 - start of text */
-      0, /* 3 - end of text */
-      0, /* 4 - end of transmission */
-      0, /* 5 - enquiry */
-      0, /* 6 - acknowledge */
-      0, /* 7 - bell */
-      0, /* 8 - backspace */
-      0, /* 9 - horizontal tab */
-      0, /* 10 -  new line */
-      0, /* 11 -  vertical tab */
-      0, /* 12 -  new page */
-      0, /* 13 -  carriage return */
-      0, /* 14 -  shift out */
-      0, /* 15 -  shift in */
-      0, /* 16 -  data link escape */
-      0, /* 17 -  device control 1 */
-      0, /* 18 -  device control 2 */
-      0, /* 19 -  device control 3 */
-      0, /* 20 -  device control 4 */
-      0, /* 21 -  negative acknowledge */
-      0, /* 22 -  synchronous idle */
-      0, /* 23 -  end of trans. block */
-      0, /* 24 -  cancel */
-      0, /* 25 -  end of medium */
-      0, /* 26 -  substitute */
-      0, /* 27 -  escape */
-      0, /* 28 -  file separator */
-      0, /* 29 -  group separator */
-      0, /* 30 -  record separator */
-      0, /* 31 -  unit separator */
-      ' ', /* 32 -  space */
-      '!', /* 33 -  ! */
-      0, /* 34 -  " */
-      '#', /* 35 -  # */
-      '$', /* 36 -  $ */
-      '%', /* 37 -  % */
-      '&', /* 38 -  & */
-      '\'', /* 39 - ' */
-      0, /* 40 -  ( */
-      0, /* 41 -  ) */
-      '*', /* 42 -  * */
-      '+', /* 43 -  + */
-      0, /* 44 -  , */
-      '-', /* 45 -  - */
-      '.', /* 46 -  . */
-      0, /* 47 -  / */
-      '0', /* 48 -  0 */
-      '1', /* 49 -  1 */
-      '2', /* 50 -  2 */
-      '3', /* 51 -  3 */
-      '4', /* 52 -  4 */
-      '5', /* 53 -  5 */
-      '6', /* 54 -  6 */
-      '7', /* 55 -  7 */
-      '8', /* 56 -  8 */
-      '9', /* 57 -  9 */
-      0, /* 58 -  : */
-      0, /* 59 -  ; */
-      0, /* 60 -  < */
-      0, /* 61 -  = */
-      0, /* 62 -  > */
-      0, /* 63 -  ? */
-      0, /* 64 -  @ */
-      'a', /* 65 -  A */
-      'b', /* 66 -  B */
-      'c', /* 67 -  C */
-      'd', /* 68 -  D */
-      'e', /* 69 -  E */
-      'f', /* 70 -  F */
-      'g', /* 71 -  G */
-      'h', /* 72 -  H */
-      'i', /* 73 -  I */
-      'j', /* 74 -  J */
-      'k', /* 75 -  K */
-      'l', /* 76 -  L */
-      'm', /* 77 -  M */
-      'n', /* 78 -  N */
-      'o', /* 79 -  O */
-      'p', /* 80 -  P */
-      'q', /* 81 -  Q */
-      'r', /* 82 -  R */
-      's', /* 83 -  S */
-      't', /* 84 -  T */
-      'u', /* 85 -  U */
-      'v', /* 86 -  V */
-      'w', /* 87 -  W */
-      'x', /* 88 -  X */
-      'y', /* 89 -  Y */
-      'z', /* 90 -  Z */
-      0, /* 91 -  [ */
-      0, /* 92 -  comment */
-      0, /* 93 -  ] */
-      '^', /* 94 -  ^ */
-      '_', /* 95 -  _ */
-      '`', /* 96 -  ` */
-      'a', /* 97 -  a */
-      'b', /* 98 -  b */
-      'c', /* 99 -  c */
-      'd', /* 100 -  d */
-      'e', /* 101 -  e */
-      'f', /* 102 -  f */
-      'g', /* 103 -  g */
-      'h', /* 104 -  h */
-      'i', /* 105 -  i */
-      'j', /* 106 -  j */
-      'k', /* 107 -  k */
-      'l', /* 108 -  l */
-      'm', /* 109 -  m */
-      'n', /* 110 -  n */
-      'o', /* 111 -  o */
-      'p', /* 112 -  p */
-      'q', /* 113 -  q */
-      'r', /* 114 -  r */
-      's', /* 115 -  s */
-      't', /* 116 -  t */
-      'u', /* 117 -  u */
-      'v', /* 118 -  v */
-      'w', /* 119 -  w */
-      'x', /* 120 -  x */
-      'y', /* 121 -  y */
-      'z', /* 122 -  z */
-      0, /* 123 -  { */
-      '|', /* 124 -  | */
-      0, /* 125 -  } */
-      '~', /* 126 -  ~ */
-      0 /* 127 -  DEL */
-      // ...128-255 is all zeros (not valid) characters}
-  };
-
   // Check all chars in name are valid
   for (size_t index = 0; index < headerName.size(); index++)
   {
-    if (validChars[static_cast<int>(headerName[index])] == 0)
+    if (validChars[static_cast<uint8_t>(headerName[index])] == 0)
     {
       throw InvalidHeaderException("Invalid header: " + headerName);
     }
   }
   // insert (override if duplicated)
-  headers[headerName] = headerValue;
+  headers.insert_or_assign(headerName, headerValue);
+}
+
+void Azure::Core::Http::Details::InsertHeaderWithValidation(
+    CaseInsensitiveHeaders& headers,
+    uint8_t const* nameFirst,
+    uint8_t const* nameLast,
+    uint8_t const* valueFirst,
+    uint8_t const* valueLast)
+{
+  // Validate and lower case the name in one pass
+  std::string headerName(nameFirst, nameLast);
+  for (auto& c : headerName)
+  {
+    c = static_cast<char>(validChars[static_cast<uint8_t>(c)]);
+    if (c == 0)
+    {
+      throw InvalidHeaderException("Invalid header: " + std::string(nameFirst, nameLast));
+    }
+  }
+
+  // insert (override if duplicated)
+  headers.insert_or_assign(std::move(headerName), std::string(valueFirst, valueLast));
 }
@@ -37,7 +37,7 @@ std::string GetRequestLogMessage(Request const& request)
   log << "HTTP Request : " << HttpMethodToString(request.GetMethod()) << " "
       << request.GetUrl().GetAbsoluteUrl();
 
-  for (auto header : request.GetHeaders())
+  for (auto const& header : request.GetHeaders())
   {
     log << "\n\t" << header.first << " : " << TruncateIfLengthy(header.second);
   }
@@ -57,7 +57,7 @@ std::string GetResponseLogMessage(
       << "ms) : " << static_cast<int>(response.GetStatusCode()) << " "
       << response.GetReasonPhrase();
 
-  for (auto header : response.GetHeaders())
+  for (auto const& header : response.GetHeaders())
   {
     log << "\n\t" << header.first;
     if (!header.second.empty() && header.first != "authorization")
@@ -2,8 +2,8 @@
 // SPDX-License-Identifier: MIT
 
 #include "azure/core/http/http.hpp"
-#include "azure/core/internal/strings.hpp"
 
+#include <algorithm>
 #include <cctype>
 #include <map>
 #include <string>
@@ -15,7 +15,7 @@ HttpStatusCode RawResponse::GetStatusCode() const { return m_statusCode; }
 
 std::string const& RawResponse::GetReasonPhrase() const { return m_reasonPhrase; }
 
-std::map<std::string, std::string> const& RawResponse::GetHeaders() const
+CaseInsensitiveHeaders const& RawResponse::GetHeaders() const
 {
   return this->m_headers;
 }
@@ -31,18 +31,17 @@ void RawResponse::AddHeader(uint8_t const* const first, uint8_t const* const las
     throw InvalidHeaderException("Invalid header. No delimiter ':' found.");
   }
 
-  // Always toLower() headers
-  auto headerName = Azure::Core::Internal::Strings::ToLower(std::string(start, end));
+  auto nameEnd = end;
   start = end + 1; // start value
   while (start < last && (*start == ' ' || *start == '\t'))
   {
     ++start;
   }
 
-  end = std::find(start, last, '\r');
-  auto headerValue = std::string(start, end); // remove \r
+  end = std::find(start, last, '\r'); // remove \r
 
-  AddHeader(headerName, headerValue);
+  // Always toLower() headers. Name is lower cased while validated, straight from the buffer.
+  Details::InsertHeaderWithValidation(this->m_headers, first, nameEnd, start, end);
 }
 
 void RawResponse::AddHeader(std::string const& header)
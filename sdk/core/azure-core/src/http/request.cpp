@@ -4,51 +4,78 @@
 #include "azure/core/http/http.hpp"
 #include "azure/core/internal/strings.hpp"
 
-#include <map>
+#include <algorithm>
 #include <string>
+#include <utility>
 #include <vector>
 
 using namespace Azure::Core::Http;
 
-namespace {
-// returns left map plus all items in right
-// when duplicates, left items are preferred
-static std::map<std::string, std::string> MergeMaps(
-    std::map<std::string, std::string> left,
-    std::map<std::string, std::string> const& right)
-{
-  left.insert(right.begin(), right.end());
-  return left;
-}
-} // namespace
-
 void Request::AddHeader(std::string const& name, std::string const& value)
 {
-  auto headerNameLowerCase = Azure::Core::Internal::Strings::ToLower(name);
-  return this->m_retryModeEnabled
-      ? Details::InsertHeaderWithValidation(this->m_retryHeaders, headerNameLowerCase, value)
-      : Details::InsertHeaderWithValidation(this->m_headers, headerNameLowerCase, value);
+  if (this->m_retryModeEnabled)
+  {
+    // Remember the value the header had before this try, the first time it is set on this try
+    auto retryHeader = std::find_if(
+        this->m_retryHeaders.begin(),
+        this->m_retryHeaders.end(),
+        [&name](std::pair<std::string, Nullable<std::string>> const& header) {
+          return Azure::Core::Internal::Strings::LocaleInvariantCaseInsensitiveEqual(
+              header.first, name);
+        });
+    if (retryHeader == this->m_retryHeaders.end())
+    {
+      auto header = this->m_headers.find(name);
+      this->m_retryHeaders.emplace_back(
+          name,
+          header == this->m_headers.end() ? Nullable<std::string>()
+                                          : Nullable<std::string>(header->second));
+    }
+  }
+  return Details::InsertHeaderWithValidation(this->m_headers, name, value);
 }
 
 void Request::RemoveHeader(std::string const& name)
 {
   this->m_headers.erase(name);
-  this->m_retryHeaders.erase(name);
+  // Don't bring the header back on the next try
+  this->m_retryHeaders.erase(
+      std::remove_if(
+          this->m_retryHeaders.begin(),
+          this->m_retryHeaders.end(),
+          [&name](std::pair<std::string, Nullable<std::string>> const& header) {
+            return Azure::Core::Internal::Strings::LocaleInvariantCaseInsensitiveEqual(
+                header.first, name);
+          }),
+      this->m_retryHeaders.end());
 }
 
 void Request::StartTry()
 {
   this->m_retryModeEnabled = true;
+
+  // Put back the headers as they were before the previous try
+  for (auto& retryHeader : this->m_retryHeaders)
+  {
+    if (retryHeader.second.HasValue())
+    {
+      this->m_headers.insert_or_assign(
+          std::move(retryHeader.first), std::move(retryHeader.second.GetValue()));
+    }
+    else
+    {
+      this->m_headers.erase(retryHeader.first);
+    }
+  }
   this->m_retryHeaders.clear();
 }
 
 HttpMethod Request::GetMethod() const { return this->m_method; }
 
-std::map<std::string, std::string> Request::GetHeaders() const
+CaseInsensitiveHeaders const& Request::GetHeaders() const
 {
-  // create map with retry headers which are the most important and we don't want
-  // to override them with any duplicate header
-  return MergeMaps(this->m_retryHeaders, this->m_headers);
+  // retry headers already replaced any duplicate header added before the try
+  return this->m_headers;
 }
 
 std::string Request::GetHeadersAsString() const
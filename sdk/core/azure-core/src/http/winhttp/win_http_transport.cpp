@@ -311,7 +311,7 @@ void WinHttpTransport::SendRequest(std::unique_ptr<Details::HandleManager>& hand
   std::wstring encodedHeaders;
   int encodedHeadersLength = 0;
 
-  auto requestHeaders = handleManager->m_request.GetHeaders();
+  auto const& requestHeaders = handleManager->m_request.GetHeaders();
   if (requestHeaders.size() != 0)
   {
     // The encodedHeaders will be null-terminated and the length is calculated.
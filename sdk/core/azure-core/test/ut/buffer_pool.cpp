@@ -0,0 +1,136 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// SPDX-License-Identifier: MIT
+
+#include <azure/core/buffer_pool.hpp>
+#include <azure/core/context.hpp>
+#include <azure/core/http/body_stream.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace Azure::Core;
+
+TEST(BufferPool, SizeClasses)
+{
+  SizeClassedBufferPool pool(4096, 1024 * 1024, 4 * 1024 * 1024);
+
+  auto buffer = pool.Acquire(5000);
+  EXPECT_EQ(buffer.size(), 5000U);
+  EXPECT_EQ(buffer.capacity(), 8192U);
+  auto data = buffer.data();
+  pool.Release(std::move(buffer));
+
+  // Served from the same class, smaller sizes from smaller classes.
+  buffer = pool.Acquire(8192);
+  EXPECT_EQ(buffer.data(), data);
+  EXPECT_EQ(buffer.size(), 8192U);
+  auto small = pool.Acquire(10);
+  EXPECT_EQ(small.capacity(), 4096U);
+
+  auto statistics = pool.GetStatistics();
+  EXPECT_EQ(statistics.AcquireCount, 3);
+  EXPECT_EQ(statistics.HitCount, 1);
+  EXPECT_EQ(statistics.ReleaseCount, 1);
+  EXPECT_EQ(statistics.BytesInUse, 8192 + 4096);
+  EXPECT_EQ(statistics.PeakBytesInUse, 8192 + 4096);
+  EXPECT_EQ(statistics.BytesPooled, 0);
+  EXPECT_EQ(statistics.PeakBytesPooled, 8192);
+
+  pool.Release(std::move(buffer));
+  pool.Release(std::move(small));
+  statistics = pool.GetStatistics();
+  EXPECT_EQ(statistics.BytesInUse, 0);
+  EXPECT_EQ(statistics.BytesPooled, 8192 + 4096);
+}
+
+TEST(BufferPool, Limits)
+{
+  SizeClassedBufferPool pool(4096, 1024 * 1024, 1024 * 1024 + 4096);
+
+  // Larger than the largest class, allocated with the size asked for and not kept.
+  auto large = pool.Acquire(2 * 1024 * 1024 + 1);
+  EXPECT_EQ(large.size(), 2U * 1024 * 1024 + 1);
+  pool.Release(std::move(large));
+  EXPECT_EQ(pool.GetStatistics().BytesPooled, 0);
+
+  // Kept until the pool holds the max bytes.
+  auto first = pool.Acquire(1024 * 1024);
+  auto second = pool.Acquire(1024 * 1024);
+  auto third = pool.Acquire(4096);
+  pool.Release(std::move(first));
+  pool.Release(std::move(second));
+  pool.Release(std::move(third));
+  EXPECT_EQ(pool.GetStatistics().BytesPooled, 1024 * 1024 + 4096);
+
+  // Buffers not acquired from the pool are kept too.
+  SizeClassedBufferPool otherPool;
+  otherPool.Release(std::vector<uint8_t>(10000));
+  EXPECT_EQ(otherPool.Acquire(8192).capacity(), 10000U);
+  EXPECT_EQ(otherPool.GetStatistics().HitCount, 1);
+}
+
+TEST(BufferPool, Cleared)
+{
+  SizeClassedBufferPool pool;
+
+  // The content of a buffer given back, even past its size, isn't handed out again.
+  auto buffer = pool.Acquire(8192);
+  std::fill(buffer.begin(), buffer.end(), uint8_t('x'));
+  buffer.resize(100);
+  auto data = buffer.data();
+  pool.Release(std::move(buffer));
+
+  buffer = pool.Acquire(8192);
+  EXPECT_EQ(buffer.data(), data);
+  EXPECT_EQ(buffer, std::vector<uint8_t>(8192, 0));
+}
+
+TEST(BufferPool, Aligned)
+{
+  SizeClassedBufferPool pool;
+  for (std::size_t alignment : {1, 16, 4096})
+  {
+    for (int i = 0; i < 4; ++i)
+    {
+      auto buffer = pool.Acquire(10000, alignment);
+      uint8_t* data = BufferPool::GetAlignedData(buffer, alignment);
+      EXPECT_EQ(reinterpret_cast<std::uintptr_t>(data) % alignment, 0U);
+      EXPECT_GE(buffer.data() + buffer.size(), data + 10000);
+      pool.Release(std::move(buffer));
+    }
+  }
+}
+
+TEST(BufferPool, ReadToEndExactLength)
+{
+  auto pool = std::make_shared<SizeClassedBufferPool>();
+  BufferPool::SetDefault(pool);
+
+  // A body of a known length fills a buffer of that length, without a larger one for the end.
+  // Bodies, which may hold secrets, aren't read into buffers of the pool.
+  std::vector<uint8_t> content(64 * 1024, 'x');
+  Http::MemoryBodyStream stream(content);
+  auto body = Http::BodyStream::ReadToEnd(GetApplicationContext(), stream);
+  EXPECT_EQ(body, content);
+  EXPECT_EQ(body.capacity(), 64U * 1024U);
+  EXPECT_EQ(pool->GetStatistics().AcquireCount, 0);
+
+  BufferPool::SetDefault(nullptr);
+}
+
+TEST(BufferPool, Default)
+{
+  auto pool = std::make_shared<SizeClassedBufferPool>();
+  BufferPool::SetDefault(pool);
+  EXPECT_EQ(BufferPool::GetDefault(), pool);
+
+  auto buffer = BufferPool::GetDefault()->Acquire(100000);
+  EXPECT_EQ(pool->GetStatistics().AcquireCount, 1);
+  BufferPool::GetDefault()->Release(std::move(buffer));
+  EXPECT_EQ(pool->GetStatistics().BytesPooled, 128 * 1024);
+
+  BufferPool::SetDefault(nullptr);
+  EXPECT_NE(BufferPool::GetDefault(), pool);
+}
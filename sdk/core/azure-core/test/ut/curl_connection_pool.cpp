@@ -10,9 +10,13 @@
 #include "azure/core/http/curl/curl.hpp"
 #endif
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 // The next includes are from Azure Core private headers.
 // That's why the path starts from `sdk/core/azure-core/src/`
@@ -21,6 +25,8 @@
 #include <http/curl/curl_connection_private.hpp>
 #include <http/curl/curl_session_private.hpp>
 
+#include "curl_connection_pool_accessor.hpp"
+
 using testing::ValuesIn;
 
 namespace Azure { namespace Core { namespace Test {
@@ -30,9 +36,9 @@ namespace Azure { namespace Core { namespace Test {
 
     TEST(CurlConnectionPool, connectionPoolTest)
     {
-      Azure::Core::Http::CurlConnectionPool::ClearIndex();
+      CurlConnectionPoolAccessor::ClearIndex();
       // Make sure there are nothing in the pool
-      EXPECT_EQ(Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.size(), 0);
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsIndexOnPool(), 0);
 
       // Use the same request for all connections.
       Azure::Core::Http::Request req(
@@ -42,7 +48,8 @@ namespace Azure { namespace Core { namespace Test {
       {
         // Creating a new connection with default options
         Azure::Core::Http::CurlTransportOptions options;
-        auto connection = Azure::Core::Http::CurlConnectionPool::GetCurlConnection(req, options);
+        auto connection = Azure::Core::Http::CurlConnectionPool::GetCurlConnection(
+            Azure::Core::GetApplicationContext(), req, options);
         EXPECT_EQ(connection->GetConnectionKey(), expectedConnectionKey);
 
         auto session = std::make_unique<Azure::Core::Http::CurlSession>(
@@ -52,19 +59,17 @@ namespace Azure { namespace Core { namespace Test {
         session->m_sessionState = Azure::Core::Http::CurlSession::SessionState::STREAMING;
       }
       // Check that after the connection is gone, it is moved back to the pool
-      EXPECT_EQ(Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.size(), 1);
-      auto connectionFromPool = Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.begin()
-                                    ->second.begin()
-                                    ->get();
-      EXPECT_EQ(connectionFromPool->GetConnectionKey(), expectedConnectionKey);
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsIndexOnPool(), 1);
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsOnPool(expectedConnectionKey), 1);
 
       // Test that asking a connection with same config will re-use the same connection
       {
         // Creating a new connection with default options
         Azure::Core::Http::CurlTransportOptions options;
-        auto connection = Azure::Core::Http::CurlConnectionPool::GetCurlConnection(req, options);
+        auto connection = Azure::Core::Http::CurlConnectionPool::GetCurlConnection(
+            Azure::Core::GetApplicationContext(), req, options);
         // There was just one connection in the pool, it should be empty now
-        EXPECT_EQ(Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.size(), 0);
+        EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsIndexOnPool(), 0);
         // And the connection key for the connection we got is the expected
         EXPECT_EQ(connection->GetConnectionKey(), expectedConnectionKey);
 
@@ -75,10 +80,8 @@ namespace Azure { namespace Core { namespace Test {
         session->m_sessionState = Azure::Core::Http::CurlSession::SessionState::STREAMING;
       }
       // Check that after the connection is gone, it is moved back to the pool
-      EXPECT_EQ(Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.size(), 1);
-      auto values = Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.begin();
-      EXPECT_EQ(values->second.size(), 1);
-      EXPECT_EQ(values->second.begin()->get()->GetConnectionKey(), expectedConnectionKey);
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsIndexOnPool(), 1);
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsOnPool(expectedConnectionKey), 1);
 
       // Now test that using a different connection config won't re-use the same connection
       std::string const CAinfo = "someFakePath";
@@ -87,17 +90,13 @@ namespace Azure { namespace Core { namespace Test {
         // Creating a new connection with default options
         Azure::Core::Http::CurlTransportOptions options;
         options.CAInfo = CAinfo;
-        auto connection = Azure::Core::Http::CurlConnectionPool::GetCurlConnection(req, options);
+        auto connection = Azure::Core::Http::CurlConnectionPool::GetCurlConnection(
+            Azure::Core::GetApplicationContext(), req, options);
         EXPECT_EQ(connection->GetConnectionKey(), secondExpectedKey);
         // One connection still in the pool after getting a new connection and with first expected
         // key
-        EXPECT_EQ(Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.size(), 1);
-        EXPECT_EQ(
-            Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.begin()
-                ->second.begin()
-                ->get()
-                ->GetConnectionKey(),
-            expectedConnectionKey);
+        EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsIndexOnPool(), 1);
+        EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsOnPool(expectedConnectionKey), 1);
 
         auto session = std::make_unique<Azure::Core::Http::CurlSession>(
             req, std::move(connection), options.HttpKeepAlive);
@@ -107,30 +106,22 @@ namespace Azure { namespace Core { namespace Test {
       }
 
       // Now there should be 2 index wit one connection each
-      EXPECT_EQ(Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.size(), 2);
-      values = Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.begin();
-      EXPECT_EQ(values->second.size(), 1);
-      EXPECT_EQ(values->second.begin()->get()->GetConnectionKey(), expectedConnectionKey);
-      values++;
-      EXPECT_EQ(values->second.size(), 1);
-      EXPECT_EQ(values->second.begin()->get()->GetConnectionKey(), secondExpectedKey);
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsIndexOnPool(), 2);
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsOnPool(expectedConnectionKey), 1);
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsOnPool(secondExpectedKey), 1);
 
       // Test re-using same custom config
       {
         // Creating a new connection with default options
         Azure::Core::Http::CurlTransportOptions options;
         options.CAInfo = CAinfo;
-        auto connection = Azure::Core::Http::CurlConnectionPool::GetCurlConnection(req, options);
+        auto connection = Azure::Core::Http::CurlConnectionPool::GetCurlConnection(
+            Azure::Core::GetApplicationContext(), req, options);
         EXPECT_EQ(connection->GetConnectionKey(), secondExpectedKey);
         // One connection still in the pool after getting a new connection and with first expected
         // key
-        EXPECT_EQ(Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.size(), 1);
-        EXPECT_EQ(
-            Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.begin()
-                ->second.begin()
-                ->get()
-                ->GetConnectionKey(),
-            expectedConnectionKey);
+        EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsIndexOnPool(), 1);
+        EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsOnPool(expectedConnectionKey), 1);
 
         auto session = std::make_unique<Azure::Core::Http::CurlSession>(
             req, std::move(connection), options.HttpKeepAlive);
@@ -139,13 +130,9 @@ namespace Azure { namespace Core { namespace Test {
         session->m_sessionState = Azure::Core::Http::CurlSession::SessionState::STREAMING;
       }
       // Now there should be 2 index wit one connection each
-      EXPECT_EQ(Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.size(), 2);
-      values = Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.begin();
-      EXPECT_EQ(values->second.size(), 1);
-      EXPECT_EQ(values->second.begin()->get()->GetConnectionKey(), expectedConnectionKey);
-      values++;
-      EXPECT_EQ(values->second.size(), 1);
-      EXPECT_EQ(values->second.begin()->get()->GetConnectionKey(), secondExpectedKey);
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsIndexOnPool(), 2);
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsOnPool(expectedConnectionKey), 1);
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsOnPool(secondExpectedKey), 1);
 
 #ifdef RUN_LONG_UNIT_TESTS
       {
@@ -159,18 +146,231 @@ namespace Azure { namespace Core { namespace Test {
 
         // Wait for 100 secs to make sure connections are removed.
         // Connection need to be in the pool for more than 60 sec to consider it expired.
-        // Clean routine runs every 90 secs.
+        // Cleaner wakes up as soon as the oldest connection expires.
         std::this_thread::sleep_for(std::chrono::milliseconds(1000 * 100));
 
-        // Ensure connections are removed but indexes are still there
-        EXPECT_EQ(Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.size(), 2);
-        values = Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.begin();
-        EXPECT_EQ(values->second.size(), 0);
-        values++;
-        EXPECT_EQ(values->second.size(), 0);
+        // Ensure connections and their indexes are removed
+        EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsIndexOnPool(), 0);
+        EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsOnPool(expectedConnectionKey), 0);
+        EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsOnPool(secondExpectedKey), 0);
       }
 #endif
     }
 
+    TEST(CurlConnectionPool, prewarmConnections)
+    {
+      CurlConnectionPoolAccessor::ClearIndex();
+      std::string const expectedConnectionKey = "httpbin.org0011";
+
+      Azure::Core::Http::CurlTransport transport;
+      Azure::Core::Http::Url const url("http://httpbin.org/get");
+      transport.Prewarm(Azure::Core::GetApplicationContext(), url, 3);
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsOnPool(expectedConnectionKey), 3);
+
+      // Connections in the pool are re-used, prewarming again does not open more than requested
+      transport.Prewarm(Azure::Core::GetApplicationContext(), url, 2);
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsOnPool(expectedConnectionKey), 3);
+
+      CurlConnectionPoolAccessor::ClearIndex();
+    }
+
+    namespace {
+      // Connection that never touches the network.
+      class FakeCurlNetworkConnection : public Azure::Core::Http::CurlNetworkConnection {
+        std::string m_connectionKey;
+        std::shared_ptr<Azure::Core::Http::CurlConnectionLimiter> m_connectionLimiter;
+
+      public:
+        FakeCurlNetworkConnection(
+            std::string connectionKey,
+            std::shared_ptr<Azure::Core::Http::CurlConnectionLimiter> connectionLimiter = nullptr)
+            : m_connectionKey(std::move(connectionKey)),
+              m_connectionLimiter(std::move(connectionLimiter))
+        {
+        }
+        std::string const& GetConnectionKey() const override { return m_connectionKey; }
+        Azure::Core::Http::CurlConnectionLimiter* GetConnectionLimiter() const override
+        {
+          return m_connectionLimiter.get();
+        }
+        void updateLastUsageTime() override {}
+        bool isExpired() override { return false; }
+        int64_t ReadFromSocket(Context const&, uint8_t*, int64_t) override { return 0; }
+        CURLcode SendBuffer(Context const&, uint8_t const*, size_t) override { return CURLE_OK; }
+      };
+    } // namespace
+
+    TEST(CurlConnectionPool, concurrentGetAndMoveBack)
+    {
+      CurlConnectionPoolAccessor::ClearIndex();
+
+      // All threads use the same key so they take connections from each other's home shards.
+      std::string const connectionKey = "fake.blob.core.windows.net0011";
+      constexpr int iterations = 2000;
+
+      for (int threads = 1; threads <= 16; threads *= 4)
+      {
+        // One connection per thread, so there is always one in the pool for a thread looking for
+        // it.
+        for (int i = 0; i < threads; i++)
+        {
+          Azure::Core::Http::CurlConnectionPool::MoveConnectionBackToPool(
+              std::make_unique<FakeCurlNetworkConnection>(connectionKey),
+              Azure::Core::Http::HttpStatusCode::Ok);
+        }
+
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; i++)
+        {
+          workers.emplace_back([&]() {
+            for (int j = 0; j < iterations; j++)
+            {
+              // A probe can miss a connection moved back to a shard it went through already,
+              // where getting a connection would open a new one. Probe again instead.
+              std::unique_ptr<Azure::Core::Http::CurlNetworkConnection> connection;
+              while (!connection)
+              {
+                connection = CurlConnectionPoolAccessor::TakeConnectionFromPool(connectionKey);
+              }
+              EXPECT_EQ(connection->GetConnectionKey(), connectionKey);
+              Azure::Core::Http::CurlConnectionPool::MoveConnectionBackToPool(
+                  std::move(connection), Azure::Core::Http::HttpStatusCode::Ok);
+            }
+          });
+        }
+        for (auto& worker : workers)
+        {
+          worker.join();
+        }
+
+        // No connection is lost or duplicated
+        EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsOnPool(connectionKey), threads);
+        CurlConnectionPoolAccessor::ClearIndex();
+      }
+    }
+
+    TEST(CurlConnectionPool, connectionLimiterFifo)
+    {
+      // One connection allowed per host
+      Azure::Core::Http::CurlConnectionLimiter limiter(1, 0);
+      EXPECT_FALSE(limiter.Acquire(Azure::Core::GetApplicationContext()));
+
+      std::mutex orderMutex;
+      std::vector<int> order;
+      std::vector<std::thread> waiters;
+      for (int i = 0; i < 3; i++)
+      {
+        waiters.emplace_back([&, i]() {
+          // All waiters get a new connection slot once the previous one is closed
+          EXPECT_FALSE(limiter.Acquire(Azure::Core::GetApplicationContext()));
+          std::lock_guard<std::mutex> lock(orderMutex);
+          order.push_back(i);
+        });
+        // Give the thread time to be queued before starting the next one
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      }
+
+      for (int i = 0; i < 3; i++)
+      {
+        limiter.OnConnectionClosed();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      }
+      for (auto& waiter : waiters)
+      {
+        waiter.join();
+      }
+      EXPECT_EQ(order, std::vector<int>({0, 1, 2}));
+    }
+
+    TEST(CurlConnectionPool, connectionLimiterCancelWait)
+    {
+      Azure::Core::Http::CurlConnectionLimiter limiter(1, 0);
+      EXPECT_FALSE(limiter.Acquire(Azure::Core::GetApplicationContext()));
+
+      // Host is at the limit, waiting is cancelled by the context
+      auto context = Azure::Core::GetApplicationContext().WithDeadline(
+          std::chrono::system_clock::now() + std::chrono::milliseconds(100));
+      EXPECT_THROW(limiter.Acquire(context), Azure::Core::OperationCancelledException);
+
+      // The cancelled request left the queue, next request is not blocked by it
+      limiter.OnConnectionClosed();
+      EXPECT_FALSE(limiter.Acquire(Azure::Core::GetApplicationContext()));
+    }
+
+    TEST(CurlConnectionPool, connectionLimiterIdleConnections)
+    {
+      // Two connections per host, only one can be idle in the pool
+      Azure::Core::Http::CurlConnectionLimiter limiter(2, 1);
+      EXPECT_FALSE(limiter.Acquire(Azure::Core::GetApplicationContext()));
+      EXPECT_FALSE(limiter.Acquire(Azure::Core::GetApplicationContext()));
+
+      int movedConnections = 0;
+      EXPECT_TRUE(limiter.MoveConnectionToPool([&]() { movedConnections++; }));
+      // Second connection won't be kept in the pool
+      EXPECT_FALSE(limiter.MoveConnectionToPool([&]() { movedConnections++; }));
+      EXPECT_EQ(movedConnections, 1);
+      limiter.OnConnectionClosed();
+
+      // The idle connection is re-used, which makes room for another one
+      EXPECT_TRUE(limiter.Acquire(Azure::Core::GetApplicationContext()));
+      EXPECT_TRUE(limiter.MoveConnectionToPool([&]() { movedConnections++; }));
+    }
+
+    TEST(CurlConnectionPool, idleConnectionsCapWithConcurrentMoveBack)
+    {
+      CurlConnectionPoolAccessor::ClearIndex();
+      std::string const connectionKey = "fake.blob.core.windows.net0011L0-2";
+      Azure::Core::Http::CurlTransportOptions options;
+      options.MaxIdleConnectionsPerHost = 2;
+      auto connectionLimiter
+          = CurlConnectionPoolAccessor::GetConnectionLimiter(connectionKey, options);
+
+      // All threads move a connection back at the same time, only two of them are kept.
+      std::atomic<bool> start(false);
+      std::vector<std::thread> workers;
+      for (int i = 0; i < 16; i++)
+      {
+        workers.emplace_back([&]() {
+          while (!start)
+          {
+            std::this_thread::yield();
+          }
+          Azure::Core::Http::CurlConnectionPool::MoveConnectionBackToPool(
+              std::make_unique<FakeCurlNetworkConnection>(connectionKey, connectionLimiter),
+              Azure::Core::Http::HttpStatusCode::Ok);
+        });
+      }
+      start = true;
+      for (auto& worker : workers)
+      {
+        worker.join();
+      }
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsOnPool(connectionKey), 2);
+      CurlConnectionPoolAccessor::ClearIndex();
+    }
+
+    TEST(CurlConnectionPool, connectionLimiterRemovedWithLastConnection)
+    {
+      std::string const connectionKey = "fake.queue.core.windows.net0011L0-1";
+      Azure::Core::Http::CurlTransportOptions options;
+      options.MaxIdleConnectionsPerHost = 1;
+      auto const connectionLimiters = CurlConnectionPoolAccessor::ConnectionLimitersCount();
+
+      auto connectionLimiter
+          = CurlConnectionPoolAccessor::GetConnectionLimiter(connectionKey, options);
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionLimitersCount(), connectionLimiters + 1);
+      EXPECT_EQ(
+          CurlConnectionPoolAccessor::GetConnectionLimiter(connectionKey, options),
+          connectionLimiter);
+
+      // The limiter is kept while a connection for the host is open
+      auto connection
+          = std::make_unique<FakeCurlNetworkConnection>(connectionKey, connectionLimiter);
+      connectionLimiter.reset();
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionLimitersCount(), connectionLimiters + 1);
+      connection.reset();
+      EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionLimitersCount(), connectionLimiters);
+    }
+
 #endif
 }}} // namespace Azure::Core::Test
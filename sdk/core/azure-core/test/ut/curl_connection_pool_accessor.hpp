@@ -0,0 +1,52 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// SPDX-License-Identifier: MIT
+
+/**
+ * @file
+ * @brief Test-only access to the private members of the curl connection pool.
+ *
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <http/curl/curl_connection_pool_private.hpp>
+
+namespace Azure { namespace Core { namespace Test {
+
+  class CurlConnectionPoolAccessor {
+  public:
+    static void ClearIndex() { Azure::Core::Http::CurlConnectionPool::ClearIndex(); }
+
+    static int64_t ConnectionsOnPool(std::string const& connectionKey)
+    {
+      return Azure::Core::Http::CurlConnectionPool::ConnectionsOnPool(connectionKey);
+    }
+
+    static int64_t ConnectionsIndexOnPool()
+    {
+      return Azure::Core::Http::CurlConnectionPool::ConnectionsIndexOnPool();
+    }
+
+    static std::unique_ptr<Azure::Core::Http::CurlNetworkConnection> TakeConnectionFromPool(
+        std::string const& connectionKey)
+    {
+      return Azure::Core::Http::CurlConnectionPool::TakeConnectionFromPool(connectionKey);
+    }
+
+    static std::shared_ptr<Azure::Core::Http::CurlConnectionLimiter> GetConnectionLimiter(
+        std::string const& connectionKey,
+        Azure::Core::Http::CurlTransportOptions const& options)
+    {
+      return Azure::Core::Http::CurlConnectionPool::GetConnectionLimiter(connectionKey, options);
+    }
+
+    static size_t ConnectionLimitersCount()
+    {
+      return Azure::Core::Http::CurlConnectionPool::ConnectionLimitersCount();
+    }
+  };
+
+}}} // namespace Azure::Core::Test
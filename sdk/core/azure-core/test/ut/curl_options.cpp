@@ -8,6 +8,7 @@
 #include <azure/core/http/pipeline.hpp>
 #include <azure/core/http/policy.hpp>
 #include <azure/core/http/transport.hpp>
+#include <azure/core/platform.hpp>
 #include <azure/core/response.hpp>
 
 #if defined(BUILD_CURL_HTTP_TRANSPORT_ADAPTER)
@@ -15,13 +16,197 @@
 #endif
 
 #include <http/curl/curl_connection_private.hpp>
+#include <http/curl/curl_multiplexer_private.hpp>
 #include <http/curl/curl_session_private.hpp>
 
+#include "curl_connection_pool_accessor.hpp"
+
+#if defined(AZ_PLATFORM_POSIX)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <future>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace Azure { namespace Core { namespace Test {
 
+#if defined(AZ_PLATFORM_POSIX)
+  namespace {
+    // Minimal HTTP/1.1 server on the loopback interface. A `GET /<size>` gets back a response with
+    // a body of `<size>` bytes, any other request gets back its own body. Connections are kept
+    // alive and each is served by its own thread.
+    class LoopbackServer {
+      int m_listenSocket;
+      uint16_t m_port = 0;
+      std::atomic<int> m_openConnections{0};
+      std::atomic<int> m_maxOpenConnections{0};
+      std::vector<std::thread> m_connectionThreads;
+      std::thread m_thread;
+
+      static bool SendAll(int socket, char const* data, size_t size)
+      {
+        while (size > 0)
+        {
+          auto sent = send(socket, data, size, MSG_NOSIGNAL);
+          if (sent <= 0)
+          {
+            return false;
+          }
+          data += sent;
+          size -= static_cast<size_t>(sent);
+        }
+        return true;
+      }
+
+      static void Serve(int socket)
+      {
+        std::string request;
+        std::vector<char> body(1024 * 64, 'x');
+        char buffer[1024];
+        for (;;)
+        {
+          auto received = recv(socket, buffer, sizeof(buffer), 0);
+          if (received <= 0)
+          {
+            return;
+          }
+          request.append(buffer, static_cast<size_t>(received));
+          auto headersEnd = request.find("\r\n\r\n");
+          if (headersEnd == std::string::npos)
+          {
+            continue;
+          }
+          unsigned long long bodySize = 0;
+          std::string upload;
+          if (std::sscanf(request.c_str(), "GET /%llu", &bodySize) != 1)
+          {
+            // Any other request is answered with the body it was sent with.
+            auto lowerCaseHeaders = request.substr(0, headersEnd);
+            std::transform(
+                lowerCaseHeaders.begin(),
+                lowerCaseHeaders.end(),
+                lowerCaseHeaders.begin(),
+                [](char c) { return static_cast<char>(std::tolower(c)); });
+            unsigned long long uploadSize = 0;
+            auto contentLength = lowerCaseHeaders.find("content-length:");
+            if (contentLength != std::string::npos)
+            {
+              std::sscanf(
+                  lowerCaseHeaders.c_str() + contentLength, "content-length: %llu", &uploadSize);
+            }
+            if (lowerCaseHeaders.find("expect: 100-continue") != std::string::npos)
+            {
+              std::string const continueResponse = "HTTP/1.1 100 Continue\r\n\r\n";
+              if (!SendAll(socket, continueResponse.data(), continueResponse.size()))
+              {
+                return;
+              }
+            }
+            while (request.size() < headersEnd + 4 + uploadSize)
+            {
+              received = recv(socket, buffer, sizeof(buffer), 0);
+              if (received <= 0)
+              {
+                return;
+              }
+              request.append(buffer, static_cast<size_t>(received));
+            }
+            upload = request.substr(headersEnd + 4, static_cast<size_t>(uploadSize));
+            bodySize = upload.size();
+          }
+          request.erase(0, headersEnd + 4 + upload.size());
+
+          auto headers = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(bodySize)
+              + "\r\n\r\n" + upload;
+          if (!SendAll(socket, headers.data(), headers.size()))
+          {
+            return;
+          }
+          if (!upload.empty())
+          {
+            continue;
+          }
+          while (bodySize > 0)
+          {
+            auto size = std::min(static_cast<size_t>(bodySize), body.size());
+            if (!SendAll(socket, body.data(), size))
+            {
+              return;
+            }
+            bodySize -= size;
+          }
+        }
+      }
+
+    public:
+      LoopbackServer() : m_listenSocket(socket(AF_INET, SOCK_STREAM, 0))
+      {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addressSize = sizeof(address);
+        bind(m_listenSocket, reinterpret_cast<sockaddr*>(&address), addressSize);
+        listen(m_listenSocket, 16);
+        getsockname(m_listenSocket, reinterpret_cast<sockaddr*>(&address), &addressSize);
+        m_port = ntohs(address.sin_port);
+
+        m_thread = std::thread([this]() {
+          for (int socket; (socket = accept(m_listenSocket, nullptr, nullptr)) >= 0;)
+          {
+            // Headers and body are sent separately, don't let Nagle delay the body
+            int noDelay = 1;
+            setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            // A client sending less than it announced fails its test instead of hanging it.
+            timeval timeout = {10, 0};
+            setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            auto openConnections = ++m_openConnections;
+            if (openConnections > m_maxOpenConnections)
+            {
+              m_maxOpenConnections = openConnections;
+            }
+            m_connectionThreads.emplace_back([this, socket]() {
+              Serve(socket);
+              close(socket);
+              --m_openConnections;
+            });
+          }
+        });
+      }
+
+      ~LoopbackServer()
+      {
+        // Stops accept(). Connections kept alive by the client must be closed before this.
+        shutdown(m_listenSocket, SHUT_RDWR);
+        close(m_listenSocket);
+        m_thread.join();
+        for (auto& connectionThread : m_connectionThreads)
+        {
+          connectionThread.join();
+        }
+      }
+
+      // Largest number of connections open at the same time.
+      int GetMaxOpenConnectionsCount() const { return m_maxOpenConnections; }
+
+      std::string GetUrl(size_t bodySize) const
+      {
+        return "http://127.0.0.1:" + std::to_string(m_port) + "/" + std::to_string(bodySize);
+      }
+    };
+  } // namespace
+#endif
+
   // proxy server can take some minutes to handle the request. Only testing HTTP proxy
   // Test is disabled until there is a reliable proxy to be used for CI111
   TEST(CurlTransportOptions, DISABLED_proxy)
@@ -84,7 +269,7 @@ namespace Azure { namespace Core { namespace Test {
 
     // Clean the connection from the pool *Windows fails to clean if we leave to be clean uppon
     // app-destruction
-    EXPECT_NO_THROW(Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.clear());
+    EXPECT_NO_THROW(CurlConnectionPoolAccessor::ClearIndex());
   }
 
   /*
@@ -203,7 +388,7 @@ namespace Azure { namespace Core { namespace Test {
 
     // Clean the connection from the pool *Windows fails to clean if we leave to be clean uppon
     // app-destruction
-    EXPECT_NO_THROW(Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.clear());
+    EXPECT_NO_THROW(CurlConnectionPoolAccessor::ClearIndex());
   }
 
   TEST(CurlTransportOptions, httpsDefault)
@@ -233,7 +418,7 @@ namespace Azure { namespace Core { namespace Test {
 
     // Clean the connection from the pool *Windows fails to clean if we leave to be clean uppon
     // app-destruction
-    EXPECT_NO_THROW(Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.clear());
+    EXPECT_NO_THROW(CurlConnectionPoolAccessor::ClearIndex());
   }
 
   TEST(CurlTransportOptions, disableKeepAlive)
@@ -267,7 +452,340 @@ namespace Azure { namespace Core { namespace Test {
               responseCode));
     }
     // Make sure there are no connections in the pool
-    EXPECT_EQ(Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.size(), 0);
+    EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsIndexOnPool(), 0);
+  }
+
+#if defined(AZ_PLATFORM_POSIX)
+  // Bodies smaller and larger than the read buffer are read whole, whatever its size.
+  TEST(CurlTransportOptions, readBufferSize)
+  {
+    LoopbackServer server;
+    size_t const readSize = 1024 * 4;
+    std::vector<uint8_t> buffer(readSize);
+
+    for (size_t readBufferSize : {0, 1024, 1024 * 16, 1024 * 256})
+    {
+      Azure::Core::Http::CurlTransportOptions curlOptions;
+      curlOptions.ReadBufferSize = readBufferSize;
+      Azure::Core::Http::CurlTransport transport(curlOptions);
+
+      for (size_t bodySize : {0, 1024 * 4, 1024 * 256 + 1, 1024 * 1024 * 4})
+      {
+        Azure::Core::Http::Request request(
+            Azure::Core::Http::HttpMethod::Get,
+            Azure::Core::Http::Url(server.GetUrl(bodySize)),
+            true);
+
+        auto response = transport.Send(Azure::Core::GetApplicationContext(), request);
+        auto bodyStream = response->GetBodyStream();
+        int64_t totalRead = 0;
+        for (int64_t read; (read = bodyStream->Read(
+                                Azure::Core::GetApplicationContext(), buffer.data(), readSize))
+             > 0;)
+        {
+          totalRead += read;
+        }
+        EXPECT_EQ(static_cast<int64_t>(bodySize), totalRead);
+      }
+    }
+    CurlConnectionPoolAccessor::ClearIndex();
+  }
+
+  namespace {
+    // A pooled connection the server has closed in the meantime. Whatever is sent on it fails.
+    class BrokenCurlNetworkConnection : public Azure::Core::Http::CurlNetworkConnection {
+      std::string m_connectionKey;
+
+    public:
+      explicit BrokenCurlNetworkConnection(std::string connectionKey)
+          : m_connectionKey(std::move(connectionKey))
+      {
+      }
+      std::string const& GetConnectionKey() const override { return m_connectionKey; }
+      void updateLastUsageTime() override {}
+      bool isExpired() override { return false; }
+      int64_t ReadFromSocket(Context const&, uint8_t*, int64_t) override { return 0; }
+      CURLcode SendBuffer(Context const&, uint8_t const*, size_t) override
+      {
+        return CURLE_UNSUPPORTED_PROTOCOL;
+      }
+    };
+  } // namespace
+
+  // The body is sent along with the headers. When that fails on a broken pooled connection, the
+  // request is sent again on a new connection and the whole body must go with it.
+  TEST(CurlTransportOptions, uploadOnBrokenPooledConnection)
+  {
+    LoopbackServer server;
+    Azure::Core::Http::CurlTransportOptions curlOptions;
+    curlOptions.UploadChunkSize = 1024;
+    Azure::Core::Http::CurlTransport transport(curlOptions);
+    // Key of the loopback server connections for the default options
+    std::string const connectionKey = "127.0.0.10011";
+
+    for (auto method : {Azure::Core::Http::HttpMethod::Post, Azure::Core::Http::HttpMethod::Put})
+    {
+      // Smaller than a chunk, sent in one piece, and larger than a chunk.
+      for (size_t bodySize : {512, 1024 * 4})
+      {
+        std::vector<uint8_t> body(bodySize);
+        for (size_t i = 0; i < bodySize; i++)
+        {
+          body[i] = static_cast<uint8_t>(i % 251);
+        }
+        Azure::Core::Http::MemoryBodyStream bodyStream(body);
+        Azure::Core::Http::Request request(
+            method, Azure::Core::Http::Url(server.GetUrl(0)), &bodyStream);
+
+        // The broken connection is the only one the request can get from the pool.
+        CurlConnectionPoolAccessor::ClearIndex();
+        Azure::Core::Http::CurlConnectionPool::MoveConnectionBackToPool(
+            std::make_unique<BrokenCurlNetworkConnection>(connectionKey),
+            Azure::Core::Http::HttpStatusCode::Ok);
+        ASSERT_EQ(1, CurlConnectionPoolAccessor::ConnectionsOnPool(connectionKey));
+
+        auto response = transport.Send(Azure::Core::GetApplicationContext(), request);
+        EXPECT_EQ(Azure::Core::Http::HttpStatusCode::Ok, response->GetStatusCode());
+        EXPECT_EQ(
+            body,
+            Azure::Core::Http::BodyStream::ReadToEnd(
+                Azure::Core::GetApplicationContext(), *response->GetBodyStream()));
+        response.reset();
+        // The broken connection was dropped, the new one went back to the pool.
+        EXPECT_EQ(1, CurlConnectionPoolAccessor::ConnectionsOnPool(connectionKey));
+      }
+    }
+    CurlConnectionPoolAccessor::ClearIndex();
+  }
+
+  namespace {
+    int64_t ReadToEndInPieces(Azure::Core::Http::BodyStream& bodyStream, size_t pieceSize)
+    {
+      std::vector<uint8_t> buffer(pieceSize);
+      int64_t totalRead = 0;
+      for (int64_t read; (read = bodyStream.Read(
+                              Azure::Core::GetApplicationContext(), buffer.data(), pieceSize))
+           > 0;)
+      {
+        totalRead += read;
+      }
+      return totalRead;
+    }
+  } // namespace
+
+  // Bodies larger than what a multiplexed transfer buffers are streamed while they are read.
+  TEST(CurlTransportOptions, http2MultiplexingDownload)
+  {
+    LoopbackServer server;
+    Azure::Core::Http::CurlTransportOptions curlOptions;
+    curlOptions.Http2Multiplexing = true;
+    Azure::Core::Http::CurlTransport transport(curlOptions);
+    auto const multiplexersCount = Azure::Core::Http::CurlMultiplexer::MultiplexersCount();
+
+    for (size_t bodySize : {0, 1024, 1024 * 1024 * 4})
+    {
+      Azure::Core::Http::Request request(
+          Azure::Core::Http::HttpMethod::Get,
+          Azure::Core::Http::Url(server.GetUrl(bodySize)),
+          true);
+      auto response = transport.Send(Azure::Core::GetApplicationContext(), request);
+
+      EXPECT_EQ(response->GetStatusCode(), Azure::Core::Http::HttpStatusCode::Ok);
+      EXPECT_EQ(response->GetHeaders().at("content-length"), std::to_string(bodySize));
+      auto bodyStream = response->GetBodyStream();
+      EXPECT_EQ(bodyStream->Length(), static_cast<int64_t>(bodySize));
+      EXPECT_EQ(ReadToEndInPieces(*bodyStream, 1024 * 4), static_cast<int64_t>(bodySize));
+    }
+    // All the requests to the host went through one multiplexer
+    EXPECT_EQ(Azure::Core::Http::CurlMultiplexer::MultiplexersCount(), multiplexersCount + 1);
+    Azure::Core::Http::CurlMultiplexer::ClearMultiplexers();
+  }
+
+  // Requests over the connection limit wait in the multiplexer for a connection.
+  TEST(CurlTransportOptions, http2MultiplexingConcurrentRequests)
+  {
+    LoopbackServer server;
+    Azure::Core::Http::CurlTransportOptions curlOptions;
+    curlOptions.Http2Multiplexing = true;
+    // The requests take turns on one connection
+    curlOptions.MaxConnectionsPerHost = 1;
+    Azure::Core::Http::CurlTransport transport(curlOptions);
+
+    size_t const bodySize = 1024 * 256;
+    std::vector<std::future<int64_t>> downloads;
+    for (int i = 0; i < 4; i++)
+    {
+      downloads.emplace_back(std::async(std::launch::async, [&]() {
+        Azure::Core::Http::Request request(
+            Azure::Core::Http::HttpMethod::Get,
+            Azure::Core::Http::Url(server.GetUrl(bodySize)),
+            true);
+        auto response = transport.Send(Azure::Core::GetApplicationContext(), request);
+        return ReadToEndInPieces(*response->GetBodyStream(), 1024 * 16);
+      }));
+    }
+    for (auto& download : downloads)
+    {
+      EXPECT_EQ(download.get(), static_cast<int64_t>(bodySize));
+    }
+    Azure::Core::Http::CurlMultiplexer::ClearMultiplexers();
   }
 
+  // The multiplexer of a host keeps no more than MaxIdleConnectionsPerHost connections open, busy
+  // or idle. Requests over it wait for a connection.
+  TEST(CurlTransportOptions, http2MultiplexingIdleConnections)
+  {
+    LoopbackServer server;
+    Azure::Core::Http::CurlTransportOptions curlOptions;
+    curlOptions.Http2Multiplexing = true;
+    curlOptions.MaxIdleConnectionsPerHost = 2;
+    Azure::Core::Http::CurlTransport transport(curlOptions);
+
+    size_t const bodySize = 1024 * 16;
+    std::vector<std::unique_ptr<Azure::Core::Http::Request>> requests;
+    std::vector<std::future<std::unique_ptr<Azure::Core::Http::RawResponse>>> responses;
+    for (int i = 0; i < 16; i++)
+    {
+      requests.push_back(std::make_unique<Azure::Core::Http::Request>(
+          Azure::Core::Http::HttpMethod::Get,
+          Azure::Core::Http::Url(server.GetUrl(bodySize)),
+          true));
+      responses.push_back(
+          transport.SendAsync(Azure::Core::GetApplicationContext(), *requests.back()));
+    }
+    for (auto& response : responses)
+    {
+      auto rawResponse = response.get();
+      EXPECT_EQ(
+          ReadToEndInPieces(*rawResponse->GetBodyStream(), 1024 * 4),
+          static_cast<int64_t>(bodySize));
+    }
+    // HTTP/1.1 can't multiplex, the requests took turns on the connections.
+    EXPECT_LE(server.GetMaxOpenConnectionsCount(), 2);
+    Azure::Core::Http::CurlMultiplexer::ClearMultiplexers();
+  }
+
+  // Dropping a response before reading its body stops the transfer.
+  TEST(CurlTransportOptions, http2MultiplexingCancelBody)
+  {
+    LoopbackServer server;
+    Azure::Core::Http::CurlTransportOptions curlOptions;
+    curlOptions.Http2Multiplexing = true;
+    Azure::Core::Http::CurlTransport transport(curlOptions);
+
+    {
+      Azure::Core::Http::Request request(
+          Azure::Core::Http::HttpMethod::Get,
+          Azure::Core::Http::Url(server.GetUrl(1024 * 1024 * 64)),
+          true);
+      auto response = transport.Send(Azure::Core::GetApplicationContext(), request);
+      uint8_t buffer[1024];
+      EXPECT_GT(
+          response->GetBodyStream()->Read(
+              Azure::Core::GetApplicationContext(), buffer, sizeof(buffer)),
+          0);
+    }
+
+    Azure::Core::Http::Request request(
+        Azure::Core::Http::HttpMethod::Get, Azure::Core::Http::Url(server.GetUrl(1024)), true);
+    auto response = transport.Send(Azure::Core::GetApplicationContext(), request);
+    EXPECT_EQ(ReadToEndInPieces(*response->GetBodyStream(), 1024), 1024);
+    response.reset();
+    Azure::Core::Http::CurlMultiplexer::ClearMultiplexers();
+  }
+
+  // Many requests are in flight at once from the test thread, driven by the multiplexer thread.
+  TEST(CurlTransportOptions, sendAsyncManyRequests)
+  {
+    LoopbackServer server;
+    Azure::Core::Http::CurlTransportOptions curlOptions;
+    // The requests take turns on one connection
+    curlOptions.MaxConnectionsPerHost = 1;
+    Azure::Core::Http::CurlTransport transport(curlOptions);
+
+    size_t const bodySize = 1024 * 16;
+    std::vector<std::unique_ptr<Azure::Core::Http::Request>> requests;
+    std::vector<std::future<std::unique_ptr<Azure::Core::Http::RawResponse>>> responses;
+    for (int i = 0; i < 32; i++)
+    {
+      requests.push_back(std::make_unique<Azure::Core::Http::Request>(
+          Azure::Core::Http::HttpMethod::Get,
+          Azure::Core::Http::Url(server.GetUrl(bodySize)),
+          true));
+      responses.push_back(
+          transport.SendAsync(Azure::Core::GetApplicationContext(), *requests.back()));
+    }
+    for (auto& response : responses)
+    {
+      auto rawResponse = response.get();
+      EXPECT_EQ(rawResponse->GetStatusCode(), Azure::Core::Http::HttpStatusCode::Ok);
+      EXPECT_EQ(
+          ReadToEndInPieces(*rawResponse->GetBodyStream(), 1024 * 4),
+          static_cast<int64_t>(bodySize));
+    }
+    Azure::Core::Http::CurlMultiplexer::ClearMultiplexers();
+  }
+
+  // Cancelling the context of a request waiting for a connection completes its future.
+  TEST(CurlTransportOptions, sendAsyncCancelled)
+  {
+    LoopbackServer server;
+    Azure::Core::Http::CurlTransportOptions curlOptions;
+    curlOptions.MaxConnectionsPerHost = 1;
+    Azure::Core::Http::CurlTransport transport(curlOptions);
+
+    // Keeps the only connection busy, its body is not read
+    Azure::Core::Http::Request busyRequest(
+        Azure::Core::Http::HttpMethod::Get,
+        Azure::Core::Http::Url(server.GetUrl(1024 * 1024 * 64)),
+        true);
+    auto busyResponse
+        = transport.SendAsync(Azure::Core::GetApplicationContext(), busyRequest).get();
+
+    auto context = Azure::Core::GetApplicationContext().WithDeadline(
+        std::chrono::system_clock::now() + std::chrono::hours(1));
+    Azure::Core::Http::Request request(
+        Azure::Core::Http::HttpMethod::Get, Azure::Core::Http::Url(server.GetUrl(1024)), true);
+    auto response = transport.SendAsync(context, request);
+    EXPECT_EQ(
+        response.wait_for(std::chrono::milliseconds(100)), std::future_status::timeout);
+
+    context.Cancel();
+    EXPECT_THROW(response.get(), Azure::Core::OperationCancelledException);
+
+    busyResponse.reset();
+    Azure::Core::Http::CurlMultiplexer::ClearMultiplexers();
+  }
+
+  // The request and its body can be destroyed once SendAsync returns, and the future dropped.
+  TEST(CurlTransportOptions, sendAsyncRequestNotKept)
+  {
+    LoopbackServer server;
+    Azure::Core::Http::CurlTransport transport;
+
+    std::future<std::unique_ptr<Azure::Core::Http::RawResponse>> response;
+    {
+      std::vector<uint8_t> body(1024 * 1024, 'a');
+      Azure::Core::Http::MemoryBodyStream bodyStream(body);
+      Azure::Core::Http::Request request(
+          Azure::Core::Http::HttpMethod::Put,
+          Azure::Core::Http::Url(server.GetUrl(0)),
+          &bodyStream);
+      response = transport.SendAsync(Azure::Core::GetApplicationContext(), request);
+      bodyStream.Rewind();
+      transport.SendAsync(Azure::Core::GetApplicationContext(), request);
+      std::fill(body.begin(), body.end(), 'b');
+    }
+
+    auto rawResponse = response.get();
+    EXPECT_EQ(rawResponse->GetStatusCode(), Azure::Core::Http::HttpStatusCode::Ok);
+    EXPECT_EQ(
+        Azure::Core::Http::BodyStream::ReadToEnd(
+            Azure::Core::GetApplicationContext(), *rawResponse->GetBodyStream()),
+        std::vector<uint8_t>(1024 * 1024, 'a'));
+    rawResponse.reset();
+    Azure::Core::Http::CurlMultiplexer::ClearMultiplexers();
+  }
+#endif
+
 }}} // namespace Azure::Core::Test
@@ -0,0 +1,140 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// SPDX-License-Identifier: MIT
+
+/**
+ * @file
+ * @brief Tests counting the heap allocations of a curl session.
+ *
+ * @remark Built into an executable of its own, azure-core-allocations-test, as it replaces the
+ * global operator new and operator delete.
+ *
+ */
+
+#include "curl_session.hpp"
+
+#include <azure/core/http/curl/curl.hpp>
+#include <azure/core/http/http.hpp>
+
+#include <http/curl/curl_connection_private.hpp>
+#include <http/curl/curl_session_private.hpp>
+
+#include <cstdlib>
+#include <new>
+#include <string>
+
+namespace {
+// Counts heap allocations made by the test thread while enabled.
+thread_local bool g_countAllocations = false;
+thread_local size_t g_allocations = 0;
+} // namespace
+
+void* operator new(size_t size)
+{
+  if (g_countAllocations)
+  {
+    g_allocations++;
+  }
+  if (auto memory = std::malloc(size > 0 ? size : 1))
+  {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::Return;
+using ::testing::SetArrayArgument;
+
+namespace Azure { namespace Core { namespace Test {
+
+  namespace {
+    // Sends a request and parses \p response, returning the number of heap allocations made.
+    size_t CountPerformAllocations(std::string const& response, size_t headersCount)
+    {
+      // Can't mock the curMock directly from a unique ptr, heap allocate it first and then make a
+      // unique ptr for it
+      MockCurlNetworkConnection* curlMock = new MockCurlNetworkConnection();
+      EXPECT_CALL(*curlMock, SendBuffer(_, _, _)).WillOnce(Return(CURLE_OK));
+      EXPECT_CALL(*curlMock, ReadFromSocket(_, _, _))
+          .WillOnce(DoAll(
+              SetArrayArgument<1>(response.data(), response.data() + response.size()),
+              Return(response.size())));
+      EXPECT_CALL(*curlMock, DestructObj());
+
+      // Create the unique ptr to take care about memory free at the end
+      std::unique_ptr<MockCurlNetworkConnection> uniqueCurlMock(curlMock);
+
+      // Simulate a request to be sent
+      Azure::Core::Http::Url url("http://microsoft.com");
+      Azure::Core::Http::Request request(Azure::Core::Http::HttpMethod::Get, url);
+
+      auto session = std::make_unique<Azure::Core::Http::CurlSession>(
+          request, std::move(uniqueCurlMock), false);
+
+      g_allocations = 0;
+      g_countAllocations = true;
+      auto result = session->Perform(Azure::Core::GetApplicationContext());
+      g_countAllocations = false;
+
+      EXPECT_EQ(CURLE_OK, result);
+      EXPECT_EQ(headersCount, session->GetResponse()->GetHeaders().size());
+      return g_allocations;
+    }
+  } // namespace
+
+  // Parsing a response with the headers storage services typically send back allocates only the
+  // strings kept in the headers collection.
+  TEST_F(CurlSession, responseHeadersAllocations)
+  {
+    std::string response("HTTP/1.1 200 OK\r\n"
+                         "Content-Length: 0\r\n"
+                         "Content-Type: application/octet-stream\r\n"
+                         "Content-MD5: Q2hlY2sgSW50ZWdyaXR5IQ==\r\n"
+                         "Last-Modified: Wed, 13 Jan 2021 22:38:52 GMT\r\n"
+                         "Accept-Ranges: bytes\r\n"
+                         "ETag: \"0x8D8B81A9C3E8F1B\"\r\n"
+                         "Server: Windows-Azure-Blob/1.0 Microsoft-HTTPAPI/2.0\r\n"
+                         "x-ms-request-id: 2f8b3c4a-b01e-0071-7d1f-ea8a5e000000\r\n"
+                         "x-ms-client-request-id: 6a3f5c2e-7d1b-4c8e-9f0a-1b2c3d4e5f60\r\n"
+                         "x-ms-version: 2020-02-10\r\n"
+                         "x-ms-version-id: 2021-01-13T22:38:52.1234567Z\r\n"
+                         "x-ms-is-current-version: true\r\n"
+                         "x-ms-creation-time: Wed, 13 Jan 2021 22:38:52 GMT\r\n"
+                         "x-ms-lease-status: unlocked\r\n"
+                         "x-ms-lease-state: available\r\n"
+                         "x-ms-blob-type: BlockBlob\r\n"
+                         "x-ms-server-encrypted: true\r\n"
+                         "x-ms-access-tier: Hot\r\n"
+                         "x-ms-access-tier-inferred: true\r\n"
+                         "Date: Wed, 13 Jan 2021 22:38:53 GMT\r\n"
+                         "\r\n");
+
+    std::string noHeadersResponse("HTTP/1.1 200 OK\r\n\r\n");
+
+    // Only names and values too long for the small string buffer need memory of their own.
+    size_t longStrings = 0;
+    auto const smallStringCapacity = std::string().capacity();
+    for (auto lineStart = response.find("\r\n") + 2, lineEnd = response.find("\r\n", lineStart);
+         lineEnd != lineStart;
+         lineStart = lineEnd + 2, lineEnd = response.find("\r\n", lineStart))
+    {
+      auto colon = response.find(':', lineStart);
+      auto nameSize = colon - lineStart;
+      auto valueSize = lineEnd - colon - 2;
+      longStrings += (nameSize > smallStringCapacity ? 1 : 0)
+          + (valueSize > smallStringCapacity ? 1 : 0);
+    }
+
+    // The first request also makes the allocations done once per process, keep them out.
+    auto noHeadersAllocations = CountPerformAllocations(noHeadersResponse, 0);
+    noHeadersAllocations = CountPerformAllocations(noHeadersResponse, 0);
+    auto headersAllocations = CountPerformAllocations(response, 20) - noHeadersAllocations;
+    // Plus the headers array, reserved for 16 headers and grown once.
+    EXPECT_LE(headersAllocations, longStrings + 2);
+  }
+}}} // namespace Azure::Core::Test
@@ -9,6 +9,11 @@
 #include <http/curl/curl_connection_private.hpp>
 #include <http/curl/curl_session_private.hpp>
 
+#include "curl_connection_pool_accessor.hpp"
+
+#include <string>
+#include <vector>
+
 using ::testing::_;
 using ::testing::DoAll;
 using ::testing::Return;
@@ -79,7 +84,7 @@ namespace Azure { namespace Core { namespace Test {
       EXPECT_NO_THROW(session->Perform(Azure::Core::GetApplicationContext()));
     }
     // Clear the connections from the pool to invoke clean routine
-    Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.clear();
+    CurlConnectionPoolAccessor::ClearIndex();
   }
 
   TEST_F(CurlSession, chunkBadFormatResponse)
@@ -127,7 +132,7 @@ namespace Azure { namespace Core { namespace Test {
           Azure::Core::Http::TransportException);
     }
     // Clear the connections from the pool to invoke clean routine
-    Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.clear();
+    CurlConnectionPoolAccessor::ClearIndex();
   }
 
   TEST_F(CurlSession, chunkSegmentedResponse)
@@ -203,7 +208,173 @@ namespace Azure { namespace Core { namespace Test {
           Azure::Core::Http::BodyStream::ReadToEnd(Azure::Core::GetApplicationContext(), *bodyS));
     }
     // Clear the connections from the pool to invoke clean routine
-    Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.clear();
+    CurlConnectionPoolAccessor::ClearIndex();
+  }
+
+  TEST_F(CurlSession, smallReadsFromInnerBuffer)
+  {
+    std::string response("HTTP/1.1 200 Ok\r\ncontent-length: 10\r\n\r\n");
+    std::string body("0123456789");
+    auto const readBufferSize
+        = static_cast<int64_t>(Azure::Core::Http::Details::DefaultLibcurlReaderSize);
+
+    // Can't mock the curMock directly from a unique ptr, heap allocate it first and then make a
+    // unique ptr for it
+    MockCurlNetworkConnection* curlMock = new MockCurlNetworkConnection();
+    EXPECT_CALL(*curlMock, SendBuffer(_, _, _)).WillOnce(Return(CURLE_OK));
+    // The whole body is read from the wire once, never asking for more than content-length
+    EXPECT_CALL(*curlMock, ReadFromSocket(_, _, readBufferSize))
+        .WillOnce(DoAll(
+            SetArrayArgument<1>(response.data(), response.data() + response.size()),
+            Return(response.size())));
+    EXPECT_CALL(*curlMock, ReadFromSocket(_, _, 10))
+        .WillOnce(DoAll(
+            SetArrayArgument<1>(body.data(), body.data() + body.size()), Return(body.size())));
+    EXPECT_CALL(*curlMock, DestructObj());
+
+    // Create the unique ptr to take care about memory free at the end
+    std::unique_ptr<MockCurlNetworkConnection> uniqueCurlMock(curlMock);
+
+    // Simulate a request to be sent
+    Azure::Core::Http::Url url("http://microsoft.com");
+    Azure::Core::Http::Request request(Azure::Core::Http::HttpMethod::Get, url);
+
+    {
+      auto session = std::make_unique<Azure::Core::Http::CurlSession>(
+          request, std::move(uniqueCurlMock), false);
+
+      EXPECT_NO_THROW(session->Perform(Azure::Core::GetApplicationContext()));
+
+      // Read the body one byte at a time
+      std::string readBody;
+      uint8_t byte = 0;
+      while (session->Read(Azure::Core::GetApplicationContext(), &byte, 1) == 1)
+      {
+        readBody.push_back(static_cast<char>(byte));
+      }
+      EXPECT_EQ(body, readBody);
+    }
+  }
+
+  TEST_F(CurlSession, largeReadsToCallerBuffer)
+  {
+    std::string response("HTTP/1.1 200 Ok\r\ncontent-length: 128\r\n\r\n");
+    std::string body(128, 'x');
+
+    // Can't mock the curMock directly from a unique ptr, heap allocate it first and then make a
+    // unique ptr for it
+    MockCurlNetworkConnection* curlMock = new MockCurlNetworkConnection();
+    EXPECT_CALL(*curlMock, SendBuffer(_, _, _)).WillOnce(Return(CURLE_OK));
+    EXPECT_CALL(*curlMock, ReadFromSocket(_, _, 64))
+        .WillOnce(DoAll(
+            SetArrayArgument<1>(response.data(), response.data() + response.size()),
+            Return(response.size())));
+    // A read as large as the inner buffer goes from the wire to the caller's buffer
+    EXPECT_CALL(*curlMock, ReadFromSocket(_, _, 128))
+        .WillOnce(DoAll(
+            SetArrayArgument<1>(body.data(), body.data() + body.size()), Return(body.size())));
+    EXPECT_CALL(*curlMock, DestructObj());
+
+    // Create the unique ptr to take care about memory free at the end
+    std::unique_ptr<MockCurlNetworkConnection> uniqueCurlMock(curlMock);
+
+    // Simulate a request to be sent
+    Azure::Core::Http::Url url("http://microsoft.com");
+    Azure::Core::Http::Request request(Azure::Core::Http::HttpMethod::Get, url);
+
+    {
+      auto session = std::make_unique<Azure::Core::Http::CurlSession>(
+          request, std::move(uniqueCurlMock), false, 64);
+
+      EXPECT_NO_THROW(session->Perform(Azure::Core::GetApplicationContext()));
+
+      std::vector<uint8_t> buffer(128);
+      EXPECT_EQ(
+          128, session->Read(Azure::Core::GetApplicationContext(), buffer.data(), buffer.size()));
+      EXPECT_EQ(body, std::string(buffer.begin(), buffer.end()));
+    }
+  }
+
+  TEST_F(CurlSession, smallPutSentWithHeaders)
+  {
+    std::string response("HTTP/1.1 201 Created\r\ncontent-length: 0\r\n\r\n");
+    std::vector<uint8_t> body(100, 'x');
+    std::string sent;
+
+    // Can't mock the curMock directly from a unique ptr, heap allocate it first and then make a
+    // unique ptr for it
+    MockCurlNetworkConnection* curlMock = new MockCurlNetworkConnection();
+    // Headers and body go in one send, without waiting for 100-continue
+    EXPECT_CALL(*curlMock, SendBuffer(_, _, _))
+        .WillOnce([&sent](Context const&, uint8_t const* buffer, size_t bufferSize) {
+          sent.assign(reinterpret_cast<char const*>(buffer), bufferSize);
+          return CURLE_OK;
+        });
+    EXPECT_CALL(*curlMock, ReadFromSocket(_, _, _))
+        .WillOnce(DoAll(
+            SetArrayArgument<1>(response.data(), response.data() + response.size()),
+            Return(response.size())));
+    EXPECT_CALL(*curlMock, DestructObj());
+
+    // Create the unique ptr to take care about memory free at the end
+    std::unique_ptr<MockCurlNetworkConnection> uniqueCurlMock(curlMock);
+
+    // Simulate a request to be sent
+    Azure::Core::Http::Url url("http://microsoft.com");
+    Azure::Core::Http::MemoryBodyStream bodyStream(body);
+    Azure::Core::Http::Request request(Azure::Core::Http::HttpMethod::Put, url, &bodyStream);
+
+    {
+      auto session = std::make_unique<Azure::Core::Http::CurlSession>(
+          request, std::move(uniqueCurlMock), false);
+
+      EXPECT_EQ(CURLE_OK, session->Perform(Azure::Core::GetApplicationContext()));
+      EXPECT_EQ(
+          Azure::Core::Http::HttpStatusCode::Created, session->GetResponse()->GetStatusCode());
+    }
+    EXPECT_EQ(std::string::npos, sent.find("100-continue"));
+    EXPECT_EQ(std::string(body.begin(), body.end()), sent.substr(sent.size() - body.size()));
+  }
+
+  TEST_F(CurlSession, uploadChunkSize)
+  {
+    std::string response("HTTP/1.1 200 Ok\r\ncontent-length: 0\r\n\r\n");
+    std::vector<uint8_t> body(10, 'x');
+
+    // Can't mock the curMock directly from a unique ptr, heap allocate it first and then make a
+    // unique ptr for it
+    MockCurlNetworkConnection* curlMock = new MockCurlNetworkConnection();
+    {
+      ::testing::InSequence sequence;
+      // Headers with the first 4 bytes, then the rest of the body 4 bytes at a time
+      EXPECT_CALL(*curlMock, SendBuffer(_, _, _)).WillOnce(Return(CURLE_OK));
+      EXPECT_CALL(*curlMock, SendBuffer(_, _, 4)).WillOnce(Return(CURLE_OK));
+      EXPECT_CALL(*curlMock, SendBuffer(_, _, 2)).WillOnce(Return(CURLE_OK));
+    }
+    EXPECT_CALL(*curlMock, ReadFromSocket(_, _, _))
+        .WillOnce(DoAll(
+            SetArrayArgument<1>(response.data(), response.data() + response.size()),
+            Return(response.size())));
+    EXPECT_CALL(*curlMock, DestructObj());
+
+    // Create the unique ptr to take care about memory free at the end
+    std::unique_ptr<MockCurlNetworkConnection> uniqueCurlMock(curlMock);
+
+    // Simulate a request to be sent
+    Azure::Core::Http::Url url("http://microsoft.com");
+    Azure::Core::Http::MemoryBodyStream bodyStream(body);
+    Azure::Core::Http::Request request(Azure::Core::Http::HttpMethod::Post, url, &bodyStream);
+
+    {
+      auto session = std::make_unique<Azure::Core::Http::CurlSession>(
+          request,
+          std::move(uniqueCurlMock),
+          false,
+          Azure::Core::Http::Details::DefaultLibcurlReaderSize,
+          4);
+
+      EXPECT_EQ(CURLE_OK, session->Perform(Azure::Core::GetApplicationContext()));
+    }
   }
 
   TEST_F(CurlSession, DoNotReuseConnectionIfDownloadFail)
@@ -232,6 +403,6 @@ namespace Azure { namespace Core { namespace Test {
       EXPECT_EQ(CURLE_SEND_ERROR, returnCode);
     }
     // Check connection pool is empty (connection was not moved to the pool)
-    EXPECT_EQ(Azure::Core::Http::CurlConnectionPool::ConnectionPoolIndex.size(), 0);
+    EXPECT_EQ(CurlConnectionPoolAccessor::ConnectionsIndexOnPool(), 0);
   }
 }}} // namespace Azure::Core::Test
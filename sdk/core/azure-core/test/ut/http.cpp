@@ -6,6 +6,8 @@
 #include "http.hpp"
 #include <azure/core/http/http.hpp>
 
+#include <map>
+#include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
@@ -24,7 +26,7 @@ namespace Azure { namespace Core { namespace Test {
 
     EXPECT_NO_THROW(req.AddHeader(expected.first, expected.second));
     EXPECT_PRED2(
-        [](std::map<std::string, std::string> headers,
+        [](Http::CaseInsensitiveHeaders const& headers,
            std::pair<std::string, std::string> expected) {
           auto firstHeader = headers.begin();
           return firstHeader->first == expected.first && firstHeader->second == expected.second
@@ -39,7 +41,7 @@ namespace Azure { namespace Core { namespace Test {
     std::pair<std::string, std::string> expectedOverride("valid", "override");
     EXPECT_NO_THROW(req.AddHeader(expectedOverride.first, expectedOverride.second));
     EXPECT_PRED2(
-        [](std::map<std::string, std::string> headers,
+        [](Http::CaseInsensitiveHeaders const& headers,
            std::pair<std::string, std::string> expected) {
           auto firstHeader = headers.begin();
           return firstHeader->first == expected.first && firstHeader->second == expected.second
@@ -52,7 +54,7 @@ namespace Azure { namespace Core { namespace Test {
     std::pair<std::string, std::string> expected2("valid2", "header2");
     EXPECT_NO_THROW(req.AddHeader(expected2.first, expected2.second));
     EXPECT_PRED2(
-        [](std::map<std::string, std::string> headers,
+        [](Http::CaseInsensitiveHeaders const& headers,
            std::pair<std::string, std::string> expected) {
           auto secondHeader = headers.begin();
           secondHeader++;
@@ -72,7 +74,7 @@ namespace Azure { namespace Core { namespace Test {
 
     EXPECT_NO_THROW(response.AddHeader(expected.first, expected.second));
     EXPECT_PRED2(
-        [](std::map<std::string, std::string> headers,
+        [](Http::CaseInsensitiveHeaders const& headers,
            std::pair<std::string, std::string> expected) {
           auto firstHeader = headers.begin();
           return firstHeader->first == expected.first && firstHeader->second == expected.second
@@ -88,7 +90,7 @@ namespace Azure { namespace Core { namespace Test {
     std::pair<std::string, std::string> expectedOverride("valid", "override");
     EXPECT_NO_THROW(response.AddHeader(expectedOverride.first, expectedOverride.second));
     EXPECT_PRED2(
-        [](std::map<std::string, std::string> headers,
+        [](Http::CaseInsensitiveHeaders const& headers,
            std::pair<std::string, std::string> expected) {
           auto firstHeader = headers.begin();
           return firstHeader->first == expected.first && firstHeader->second == expected.second
@@ -101,7 +103,7 @@ namespace Azure { namespace Core { namespace Test {
     std::pair<std::string, std::string> expected2("valid2", "header2");
     EXPECT_NO_THROW(response.AddHeader(expected2.first, expected2.second));
     EXPECT_PRED2(
-        [](std::map<std::string, std::string> headers,
+        [](Http::CaseInsensitiveHeaders const& headers,
            std::pair<std::string, std::string> expected) {
           auto secondtHeader = headers.begin();
           secondtHeader++;
@@ -119,7 +121,7 @@ namespace Azure { namespace Core { namespace Test {
     // adding header after previous error just happened on add from string
     EXPECT_NO_THROW(response.AddHeader("valid3: header3"));
     EXPECT_PRED2(
-        [](std::map<std::string, std::string> headers,
+        [](Http::CaseInsensitiveHeaders const& headers,
            std::pair<std::string, std::string> expected) {
           auto secondtHeader = headers.begin();
           secondtHeader++;
@@ -131,6 +133,86 @@ namespace Azure { namespace Core { namespace Test {
         (std::pair<std::string, std::string>("valid3", "header3")));
   }
 
+  // Headers - Case insensitive lookups
+  TEST(TestHttp, case_insensitive_headers)
+  {
+    Http::CaseInsensitiveHeaders headers{
+        {"Content-Length", "10"}, {"x-ms-meta-B", "b"}, {"X-MS-META-a", "a"}, {"ETag", "tag"}};
+
+    // Names are stored in lower case and kept sorted
+    std::vector<std::string> names;
+    for (auto const& header : headers)
+    {
+      names.push_back(header.first);
+    }
+    EXPECT_EQ(
+        names,
+        (std::vector<std::string>{"content-length", "etag", "x-ms-meta-a", "x-ms-meta-b"}));
+
+    EXPECT_EQ(headers.at("content-length"), "10");
+    EXPECT_EQ(headers.at(std::string("CONTENT-LENGTH")), "10");
+    EXPECT_EQ(headers.find("Etag")->second, "tag");
+    EXPECT_EQ(headers.count("etag"), 1);
+    EXPECT_EQ(headers.count("etag2"), 0);
+    EXPECT_EQ(headers.find("etag2"), headers.end());
+    EXPECT_THROW(headers.at("etag2"), std::out_of_range);
+
+    // Prefix iteration
+    auto header = headers.lower_bound("X-Ms-Meta-");
+    ASSERT_NE(header, headers.end());
+    EXPECT_EQ(header->first, "x-ms-meta-a");
+    EXPECT_EQ((++header)->first, "x-ms-meta-b");
+
+    // Same name replaces the value
+    headers.insert_or_assign("ETAG", "tag2");
+    EXPECT_EQ(headers.size(), 4);
+    EXPECT_EQ(headers.at("etag"), "tag2");
+
+    EXPECT_EQ(headers.erase("ETag"), 1);
+    EXPECT_EQ(headers.erase("ETag"), 0);
+    EXPECT_EQ(headers.size(), 3);
+  }
+
+  // Code written for the std::map returned by GetHeaders() before still builds
+  TEST(TestHttp, headers_as_map)
+  {
+    Http::RawResponse response(1, 1, Http::HttpStatusCode::Ok, "OK");
+    response.AddHeader("Content-Type", "text/plain");
+    response.AddHeader("x-ms-request-id", "id");
+
+    std::map<std::string, std::string> const& map = response.GetHeaders();
+    EXPECT_EQ(
+        map,
+        (std::map<std::string, std::string>{
+            {"content-type", "text/plain"}, {"x-ms-request-id", "id"}}));
+
+    auto headers = response.GetHeaders();
+    headers["X-MS-Request-Id"] += "2";
+    headers["x-ms-version"] = "2020-02-10";
+    EXPECT_EQ(headers.size(), 3);
+    EXPECT_EQ(headers.at("x-ms-request-id"), "id2");
+    EXPECT_EQ(headers.at("X-Ms-Version"), "2020-02-10");
+  }
+
+  // Request - Headers added on a try are undone on the next try
+  TEST(TestHttp, retry_headers)
+  {
+    Http::Request req(Http::HttpMethod::Get, Http::Url("http://test.com"));
+    req.AddHeader("name", "value");
+    req.AddHeader("removed", "value");
+
+    req.StartTry();
+    req.AddHeader("Name", "retry");
+    req.AddHeader("Name", "retry2");
+    req.AddHeader("new", "retry");
+    req.RemoveHeader("removed");
+    EXPECT_EQ(req.GetHeaders().at("name"), "retry2");
+    EXPECT_EQ(req.GetHeaders().at("new"), "retry");
+
+    req.StartTry();
+    EXPECT_EQ(req.GetHeaders(), (Http::CaseInsensitiveHeaders{{"name", "value"}}));
+  }
+
   // HTTP Range
   TEST(TestHttp, Range)
   {
@@ -255,6 +255,20 @@ namespace Azure { namespace Storage { namespace Blobs {
         const std::string& fileName,
         const DownloadBlobToOptions& options = DownloadBlobToOptions()) const;
 
+    /**
+     * @brief Opens a stream reading a blob or a blob range from the service in order, while the
+     * chunks after the one being read are downloaded in parallel.
+     *
+     * @remark At most `Concurrency + 1` chunks are kept in memory, whatever the size of the blob.
+     * All the chunks are read from the version of the blob the first one was read from. Destroying
+     * the stream cancels the chunks being downloaded.
+     *
+     * @param options Optional parameters to execute this function.
+     * @return A body stream with the content of the blob or blob range.
+     */
+    std::unique_ptr<Azure::Core::Http::BodyStream> OpenRead(
+        const OpenReadBlobOptions& options = OpenReadBlobOptions()) const;
+
     /**
      * @brief Creates a read-only snapshot of a blob.
      *
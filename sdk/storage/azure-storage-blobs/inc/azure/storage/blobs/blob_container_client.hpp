@@ -4,6 +4,7 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -201,6 +202,24 @@ namespace Azure { namespace Storage { namespace Blobs {
     Azure::Core::Response<Models::ListBlobsSinglePageResult> ListBlobsSinglePage(
         const ListBlobsSinglePageOptions& options = ListBlobsSinglePageOptions()) const;
 
+    /**
+     * @brief Returns a single segment of blobs in this container like #ListBlobsSinglePage,
+     * handing each blob to a callback as soon as it's parsed.
+     *
+     * @remark The response is parsed while it's received rather than after all of it's buffered,
+     * and the blobs aren't kept in the result, so a segment of thousands of blobs is listed
+     * without holding them all in memory. Since the body isn't buffered, a connection failure
+     * while it's received isn't retried.
+     *
+     * @param onBlobItem Called with each blob, in the order listed.
+     * @param options Optional parameters to execute this function.
+     * @return A ListBlobsSinglePageResult describing a segment of the blobs in the container, with
+     * empty Items.
+     */
+    Azure::Core::Response<Models::ListBlobsSinglePageResult> ListBlobsSinglePage(
+        const std::function<void(Models::BlobItem)>& onBlobItem,
+        const ListBlobsSinglePageOptions& options = ListBlobsSinglePageOptions()) const;
+
     /**
      * @brief Returns a single segment of blobs in this container, starting from the
      * specified Marker, Use an empty Marker to start enumeration from the beginning and the
@@ -220,6 +239,26 @@ namespace Azure { namespace Storage { namespace Blobs {
         const std::string& delimiter,
         const ListBlobsSinglePageOptions& options = ListBlobsSinglePageOptions()) const;
 
+    /**
+     * @brief Lists all the blobs in this container, or under a prefix, listing several pages at
+     * the same time, and hands each blob to a callback.
+     *
+     * @remark Blob names are split into prefixes by a delimiter, like directories. The blobs
+     * right under each prefix are listed page by page with ListBlobsByHierarchySinglePage, and
+     * the prefixes found under it are listed concurrently with it, up to Concurrency pages at a
+     * time. A container without the delimiter in its blob names is listed one page at a time.
+     *
+     * @remark The callback is called from one thread at a time, with the blobs in no particular
+     * order. Each blob is handed to it once. The first error thrown by a page or by the callback
+     * stops the listing and is rethrown.
+     *
+     * @param onBlobItem Called with each blob.
+     * @param options Optional parameters to execute this function.
+     */
+    void ListBlobsParallel(
+        const std::function<void(Models::BlobItem)>& onBlobItem,
+        const ListBlobsParallelOptions& options = ListBlobsParallelOptions()) const;
+
     /**
      * @brief Gets the permissions for this container. The permissions indicate whether
      * container data may be accessed publicly.
@@ -422,6 +422,43 @@ namespace Azure { namespace Storage { namespace Blobs {
     Models::ListBlobsIncludeFlags Include = Models::ListBlobsIncludeFlags::None;
   };
 
+  /**
+   * @brief Optional parameters for BlobContainerClient::ListBlobsParallel.
+   */
+  struct ListBlobsParallelOptions
+  {
+    /**
+     * @brief Context for cancelling long running operations.
+     */
+    Azure::Core::Context Context;
+
+    /**
+     * @brief Specifies a string that filters the results to return only blobs whose
+     * name begins with the specified prefix.
+     */
+    Azure::Core::Nullable<std::string> Prefix;
+
+    /**
+     * @brief The delimiter splitting blob names into the prefixes listed in parallel.
+     */
+    std::string Delimiter = "/";
+
+    /**
+     * @brief Specifies the maximum number of blobs to return in each page.
+     */
+    Azure::Core::Nullable<int32_t> PageSizeHint;
+
+    /**
+     * @brief Specifies one or more datasets to include in the response.
+     */
+    Models::ListBlobsIncludeFlags Include = Models::ListBlobsIncludeFlags::None;
+
+    /**
+     * @brief The maximum number of pages listed at the same time.
+     */
+    int Concurrency = 5;
+  };
+
   /**
    * @brief Optional parameters for BlobContainerClient::GetAccessPolicy.
    */
@@ -610,6 +647,12 @@ namespace Azure { namespace Storage { namespace Blobs {
      */
     Azure::Core::Nullable<Core::Http::Range> Range;
 
+    /**
+     * @brief When specified together with Range, service returns hash for the range as long as the
+     * range is less than or equal to 4 MiB in size.
+     */
+    Azure::Core::Nullable<HashAlgorithm> RangeHashAlgorithm;
+
     /**
      * @brief Optional conditions that must be met to perform this operation.
      */
@@ -647,6 +690,71 @@ namespace Azure { namespace Storage { namespace Blobs {
      * @brief The maximum number of threads that may be used in a parallel transfer.
      */
     int Concurrency = 5;
+
+    /**
+     * @brief Tune the chunk size and the number of chunks in flight while the transfer runs,
+     * from the measured throughput of the chunks downloaded so far.
+     *
+     * @remark The chunk size grows while chunks complete quickly, and the number of chunks in
+     * flight grows by one while throughput improves and is halved when it drops, for example
+     * when the service starts throttling. ChunkSize and Concurrency are used as upper bounds.
+     */
+    bool AutoTune = false;
+
+    /**
+     * @brief Verify the CRC64 of each chunk against the one sent by the service, and return the
+     * CRC64 of the whole range in DownloadBlobToResult::TransactionalContentHash.
+     *
+     * @remark The service only sends the hash of ranges up to 4MiB, so chunks are no larger than
+     * that when set.
+     */
+    bool ValidateCrc64 = false;
+
+    /**
+     * @brief When downloading to a file, allocate its disk space upfront once the size of the
+     * download is known, so the chunks written in parallel don't leave it fragmented.
+     *
+     * @remark On Linux the file has its final size from the start, including when the download
+     * fails part way.
+     */
+    bool PreallocateFile = false;
+
+    /**
+     * @brief When downloading to a file, write it bypassing the page cache, so downloading large
+     * blobs doesn't evict the rest of the cache. Uses O_DIRECT on Linux and FILE_FLAG_NO_BUFFERING
+     * on Windows, and is ignored where direct I/O isn't supported.
+     *
+     * @remark Only chunks starting at a multiple of 4KiB of the file bypass the cache. The
+     * default chunk sizes are multiples of it.
+     */
+    bool UseDirectIo = false;
+  };
+
+  /**
+   * @brief Optional parameters for BlobClient::OpenRead.
+   */
+  struct OpenReadBlobOptions
+  {
+    /**
+     * @brief Context for cancelling long running operations.
+     */
+    Azure::Core::Context Context;
+
+    /**
+     * @brief Reads only the bytes of the blob in the specified range.
+     */
+    Azure::Core::Nullable<Core::Http::Range> Range;
+
+    /**
+     * @brief The number of bytes in a single request, and in each of the buffers the blob is
+     * downloaded into ahead of the reads.
+     */
+    Azure::Core::Nullable<int64_t> ChunkSize;
+
+    /**
+     * @brief The maximum number of chunks downloaded ahead of the reads at the same time.
+     */
+    int Concurrency = 5;
   };
 
   /**
@@ -900,6 +1008,78 @@ namespace Azure { namespace Storage { namespace Blobs {
      * @brief The maximum number of threads that may be used in a parallel transfer.
      */
     int Concurrency = 5;
+
+    /**
+     * @brief Tune the chunk size and the number of chunks in flight while the transfer runs,
+     * from the measured throughput of the chunks uploaded so far.
+     *
+     * @remark The chunk size grows while chunks complete quickly, and the number of chunks in
+     * flight grows by one while throughput improves and is halved when it drops, for example
+     * when the service starts throttling. ChunkSize and Concurrency are used as upper bounds.
+     */
+    bool AutoTune = false;
+
+    /**
+     * @brief Send the CRC64 of each block for the service to verify, and return the CRC64 of
+     * the whole blob in UploadBlockBlobFromResult::TransactionalContentHash.
+     */
+    bool ValidateCrc64 = false;
+
+    /**
+     * @brief Send the MD5 of each block for the service to verify. Ignored when ValidateCrc64 is
+     * set.
+     *
+     * @remark When uploading from a buffer with a fixed chunk size, blocks are hashed eight at a
+     * time with #Azure::Storage::Details::Md5HashBatch.
+     */
+    bool ValidateMd5 = false;
+
+    /**
+     * @brief Map the file into memory when uploading from a file, and read the blocks from the
+     * mapping rather than with a read call each. Falls back to reading the file when it can't be
+     * mapped.
+     *
+     * @remark On POSIX, the process gets SIGBUS if the file is truncated during the upload.
+     */
+    bool MemoryMapFile = false;
+  };
+
+  /**
+   * @brief Optional parameters for BlockBlobClient::OpenWrite.
+   */
+  struct OpenWriteBlockBlobOptions
+  {
+    /**
+     * @brief Context for cancelling long running operations.
+     */
+    Azure::Core::Context Context;
+
+    /**
+     * @brief The standard HTTP header system properties to set.
+     */
+    Models::BlobHttpHeaders HttpHeaders;
+
+    /**
+     * @brief Name-value pairs associated with the blob as metadata.
+     */
+    Storage::Metadata Metadata;
+
+    /**
+     * @brief Indicates the tier to be set on blob.
+     */
+    Azure::Core::Nullable<Models::AccessTier> Tier;
+
+    /**
+     * @brief The size of the blocks written data is staged in, and of the buffers it is
+     * accumulated into.
+     */
+    Azure::Core::Nullable<int64_t> ChunkSize;
+
+    /**
+     * @brief The maximum number of blocks being staged at the same time. Writes wait when this many
+     * blocks are being staged and the current buffer is full.
+     */
+    int Concurrency = 5;
   };
 
   /**
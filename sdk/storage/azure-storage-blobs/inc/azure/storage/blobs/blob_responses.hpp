@@ -29,6 +29,7 @@ namespace Azure { namespace Storage { namespace Blobs {
       Models::BlobType BlobType;
       bool IsServerEncrypted = false;
       Azure::Core::Nullable<std::vector<uint8_t>> EncryptionKeySha256;
+      Azure::Core::Nullable<ContentHash> TransactionalContentHash;
     };
 
     using UploadBlockBlobFromResult = UploadBlockBlobResult;
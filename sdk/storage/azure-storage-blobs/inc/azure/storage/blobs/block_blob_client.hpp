@@ -3,18 +3,28 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "azure/storage/blobs/blob_client.hpp"
 
+namespace Azure { namespace Storage { namespace Details {
+  class ConcurrentTaskQueue;
+}}} // namespace Azure::Storage::Details
+
 namespace Azure { namespace Storage { namespace Files { namespace DataLake {
   class FileClient;
 }}}} // namespace Azure::Storage::Files::DataLake
 
 namespace Azure { namespace Storage { namespace Blobs {
 
+  class BlockBlobWriter;
+
   /**
    * @brief The BlockBlobClient allows you to manipulate Azure Storage block blobs.
    *
@@ -151,6 +161,19 @@ namespace Azure { namespace Storage { namespace Blobs {
         const std::string& fileName,
         const UploadBlockBlobFromOptions& options = UploadBlockBlobFromOptions()) const;
 
+    /**
+     * @brief Opens a writer creating a new block blob, or replacing the content of an existing
+     * block blob, from data written to it a piece at a time.
+     *
+     * @remark Nothing is sent until the first block is full. The blob is only updated once the
+     * writer is closed.
+     *
+     * @param options Optional parameters to execute this function.
+     * @return A BlockBlobWriter to write the content of the blob to.
+     */
+    std::unique_ptr<BlockBlobWriter> OpenWrite(
+        const OpenWriteBlockBlobOptions& options = OpenWriteBlockBlobOptions()) const;
+
     /**
      * @brief Creates a new block as part of a block blob's staging area to be eventually
      * committed via the CommitBlockList operation.
@@ -220,4 +243,72 @@ namespace Azure { namespace Storage { namespace Blobs {
     friend class Files::DataLake::DataLakeFileClient;
   };
 
+  /**
+   * @brief Writes the content of a block blob a piece at a time, staging blocks in parallel.
+   *
+   * @remark Written data is accumulated into buffers of ChunkSize bytes. Each full buffer is
+   * staged as a block in the background, on the threads shared by all the concurrent transfers,
+   * and re-used for later writes once staged. When Concurrency blocks are being staged, Write
+   * waits for one of them, so memory use is bounded whatever the size of the blob.
+   *
+   * @remark The first exception thrown while staging a block is rethrown by every later call to
+   * Write or Close. The blob is not updated after that.
+   */
+  class BlockBlobWriter {
+  public:
+    /**
+     * @brief Waits for the blocks being staged. The blob is not updated if the writer wasn't
+     * closed.
+     */
+    ~BlockBlobWriter();
+
+    BlockBlobWriter(const BlockBlobWriter&) = delete;
+    BlockBlobWriter& operator=(const BlockBlobWriter&) = delete;
+
+    /**
+     * @brief Appends data to the content of the blob.
+     *
+     * @param buffer A memory buffer containing the data to write.
+     * @param bufferSize Size of the memory buffer.
+     */
+    void Write(const uint8_t* buffer, std::size_t bufferSize);
+
+    /**
+     * @brief Stages the data left, waits for all the blocks to be staged and commits them.
+     *
+     * @remark A blob which fits in a single block is uploaded with a single request instead.
+     *
+     * @return A UploadBlockBlobFromResult describing the state of the updated block blob.
+     */
+    Azure::Core::Response<Models::UploadBlockBlobFromResult> Close();
+
+  private:
+    BlockBlobWriter(BlockBlobClient blockBlobClient, const OpenWriteBlockBlobOptions& options);
+
+    void StageBuffer();
+    // Waits until no more than maxStagingBlocks blocks are staging, or a block failed. Called
+    // with m_mutex held by lock.
+    void WaitForStagingBlocks(std::unique_lock<std::mutex>& lock, std::size_t maxStagingBlocks);
+    // Runs on the transfer threads. Moves the buffer back to the free buffers once staged.
+    void StageBlock(const std::string& blockId, std::vector<uint8_t> buffer);
+    // Rethrows the first exception thrown while staging a block.
+    void ThrowIfFailed();
+
+    BlockBlobClient m_blockBlobClient;
+    OpenWriteBlockBlobOptions m_options;
+    std::size_t m_blockSize;
+    std::vector<uint8_t> m_buffer;
+    std::vector<std::string> m_blockIds;
+    bool m_closed = false;
+
+    std::mutex m_mutex;
+    std::condition_variable m_blockStaged;
+    std::vector<std::vector<uint8_t>> m_freeBuffers;
+    std::size_t m_stagingBlocks = 0;
+    std::exception_ptr m_error;
+    std::unique_ptr<Storage::Details::ConcurrentTaskQueue> m_stagingQueue;
+
+    friend class BlockBlobClient;
+  };
+
 }}} // namespace Azure::Storage::Blobs
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <cstring>
+#include <functional>
 #include <limits>
 #include <map>
 #include <set>
@@ -3361,10 +3362,14 @@ namespace Azure { namespace Storage { namespace Blobs {
             const Azure::Core::Context& context,
             Azure::Core::Http::HttpPipeline& pipeline,
             const Azure::Core::Http::Url& url,
-            const ListBlobsSinglePageOptions& options)
+            const ListBlobsSinglePageOptions& options,
+            const std::function<void(BlobItem)>& onBlobItem = nullptr)
         {
           unused(options);
-          auto request = Azure::Core::Http::Request(Azure::Core::Http::HttpMethod::Get, url);
+          // With a callback, items are parsed while the body is received instead of after it's
+          // buffered, and handed over instead of kept in the result.
+          auto request = Azure::Core::Http::Request(
+              Azure::Core::Http::HttpMethod::Get, url, static_cast<bool>(onBlobItem));
           request.AddHeader("x-ms-version", "2020-02-10");
           if (options.Timeout.HasValue())
           {
@@ -3405,6 +3410,13 @@ namespace Azure { namespace Storage { namespace Blobs {
           {
             throw StorageException::CreateFromResponse(std::move(pHttpResponse));
           }
+          if (onBlobItem)
+          {
+            auto bodyStream = httpResponse.GetBodyStream();
+            Storage::Details::XmlReader reader(*bodyStream, context);
+            response = ListBlobsSinglePageResultFromXml(reader, onBlobItem);
+          }
+          else
           {
             const auto& httpResponseBody = httpResponse.GetBody();
             Storage::Details::XmlReader reader(
@@ -4117,7 +4129,8 @@ namespace Azure { namespace Storage { namespace Blobs {
         }
 
         static ListBlobsSinglePageResult ListBlobsSinglePageResultFromXml(
-            Storage::Details::XmlReader& reader)
+            Storage::Details::XmlReader& reader,
+            const std::function<void(BlobItem)>& onBlobItem = nullptr)
         {
           ListBlobsSinglePageResult ret;
           enum class XmlTagName
@@ -4177,7 +4190,14 @@ namespace Azure { namespace Storage { namespace Blobs {
               if (path.size() == 3 && path[0] == XmlTagName::k_EnumerationResults
                   && path[1] == XmlTagName::k_Blobs && path[2] == XmlTagName::k_Blob)
               {
-                ret.Items.emplace_back(BlobItemFromXml(reader));
+                if (onBlobItem)
+                {
+                  onBlobItem(BlobItemFromXml(reader));
+                }
+                else
+                {
+                  ret.Items.emplace_back(BlobItemFromXml(reader));
+                }
                 path.pop_back();
               }
             }
@@ -4853,6 +4873,7 @@ namespace Azure { namespace Storage { namespace Blobs {
         {
           Azure::Core::Nullable<int32_t> Timeout;
           Azure::Core::Nullable<Azure::Core::Http::Range> Range;
+          Azure::Core::Nullable<HashAlgorithm> RangeHashAlgorithm;
           Azure::Core::Nullable<std::string> EncryptionKey;
           Azure::Core::Nullable<std::vector<uint8_t>> EncryptionKeySha256;
           Azure::Core::Nullable<EncryptionAlgorithmType> EncryptionAlgorithm;
@@ -4889,6 +4910,17 @@ namespace Azure { namespace Storage { namespace Blobs {
             }
             request.AddHeader("x-ms-range", std::move(headerValue));
           }
+          if (options.RangeHashAlgorithm.HasValue())
+          {
+            if (options.RangeHashAlgorithm.GetValue() == HashAlgorithm::Md5)
+            {
+              request.AddHeader("x-ms-range-get-content-md5", "true");
+            }
+            else if (options.RangeHashAlgorithm.GetValue() == HashAlgorithm::Crc64)
+            {
+              request.AddHeader("x-ms-range-get-content-crc64", "true");
+            }
+          }
           if (options.EncryptionKey.HasValue())
           {
             request.AddHeader("x-ms-encryption-key", options.EncryptionKey.GetValue());
@@ -3,10 +3,13 @@
 
 #include "azure/storage/blobs/blob_client.hpp"
 
+#include <azure/core/buffer_pool.hpp>
 #include <azure/core/http/policy.hpp>
 #include <azure/storage/common/concurrent_transfer.hpp>
 #include <azure/storage/common/constants.hpp>
+#include <azure/storage/common/crypt.hpp>
 #include <azure/storage/common/file_io.hpp>
+#include <azure/storage/common/read_ahead_body_stream.hpp>
 #include <azure/storage/common/reliable_stream.hpp>
 #include <azure/storage/common/shared_key_policy.hpp>
 #include <azure/storage/common/storage_common.hpp>
@@ -19,6 +22,35 @@
 
 namespace Azure { namespace Storage { namespace Blobs {
 
+  namespace {
+    // The service only sends the hash of ranges up to this size.
+    constexpr int64_t MaxRangeHashLength = 4 * 1024 * 1024;
+
+    // Downloads the first chunk of a blob with a range request. An empty blob has no range to
+    // satisfy, it is downloaded without a range when the caller didn't ask for one.
+    Azure::Core::Response<Models::DownloadBlobResult> DownloadFirstChunk(
+        const BlobClient& blobClient,
+        DownloadBlobOptions firstChunkOptions,
+        bool rangeRequested)
+    {
+      try
+      {
+        return blobClient.Download(firstChunkOptions);
+      }
+      catch (StorageException& e)
+      {
+        if (rangeRequested
+            || e.StatusCode != Azure::Core::Http::HttpStatusCode::RangeNotSatisfiable)
+        {
+          throw;
+        }
+      }
+      firstChunkOptions.Range.Reset();
+      firstChunkOptions.RangeHashAlgorithm.Reset();
+      return blobClient.Download(firstChunkOptions);
+    }
+  } // namespace
+
   BlobClient BlobClient::CreateFromConnectionString(
       const std::string& connectionString,
       const std::string& blobContainerName,
@@ -161,6 +193,7 @@ namespace Azure { namespace Storage { namespace Blobs {
   {
     Details::BlobRestClient::Blob::DownloadBlobOptions protocolLayerOptions;
     protocolLayerOptions.Range = options.Range;
+    protocolLayerOptions.RangeHashAlgorithm = options.RangeHashAlgorithm;
     protocolLayerOptions.LeaseId = options.AccessConditions.LeaseId;
     protocolLayerOptions.IfModifiedSince = options.AccessConditions.IfModifiedSince;
     protocolLayerOptions.IfUnmodifiedSince = options.AccessConditions.IfUnmodifiedSince;
@@ -188,6 +221,8 @@ namespace Azure { namespace Storage { namespace Blobs {
         unused(context);
 
         DownloadBlobOptions newOptions = options;
+        // The hash of the range left wouldn't be checked.
+        newOptions.RangeHashAlgorithm.Reset();
         newOptions.Range = Core::Http::Range();
         newOptions.Range.GetValue().Offset
             = (options.Range.HasValue() ? options.Range.GetValue().Offset : 0) + retryInfo.Offset;
@@ -232,15 +267,30 @@ namespace Azure { namespace Storage { namespace Blobs {
       firstChunkLength = std::min(firstChunkLength, options.Range.GetValue().Length.GetValue());
     }
 
+    if (options.ValidateCrc64)
+    {
+      firstChunkLength = std::min(firstChunkLength, MaxRangeHashLength);
+    }
+
     DownloadBlobOptions firstChunkOptions;
     firstChunkOptions.Context = options.Context;
     firstChunkOptions.Range = options.Range;
+    if (options.ValidateCrc64 && !firstChunkOptions.Range.HasValue())
+    {
+      // A range request, so the service sends the CRC64 of the first chunk.
+      firstChunkOptions.Range = Core::Http::Range();
+      firstChunkOptions.Range.GetValue().Offset = 0;
+    }
     if (firstChunkOptions.Range.HasValue())
     {
       firstChunkOptions.Range.GetValue().Length = firstChunkLength;
     }
+    if (options.ValidateCrc64)
+    {
+      firstChunkOptions.RangeHashAlgorithm = HashAlgorithm::Crc64;
+    }
 
-    auto firstChunk = Download(firstChunkOptions);
+    auto firstChunk = DownloadFirstChunk(*this, firstChunkOptions, options.Range.HasValue());
 
     int64_t blobSize;
     int64_t blobRangeSize;
@@ -274,6 +324,19 @@ namespace Azure { namespace Storage { namespace Blobs {
     }
     firstChunk->BodyStream.reset();
 
+    Storage::Details::TransferCrc64 transferCrc64;
+    if (options.ValidateCrc64)
+    {
+      Crc64 chunkCrc64;
+      chunkCrc64.Update(buffer, static_cast<std::size_t>(firstChunkLength));
+      // An empty blob is downloaded without a range, the service sends no CRC64 for it.
+      if (firstChunkLength > 0)
+      {
+        Storage::Details::VerifyCrc64(chunkCrc64, firstChunk->TransactionalContentHash);
+      }
+      transferCrc64.AddChunk(-1, chunkCrc64);
+    }
+
     auto returnTypeConverter = [](Azure::Core::Response<Models::DownloadBlobResult>& response) {
       Models::DownloadBlobToResult ret;
       ret.ETag = response->ETag;
@@ -296,6 +359,10 @@ namespace Azure { namespace Storage { namespace Blobs {
             chunkOptions.Range = Core::Http::Range();
             chunkOptions.Range.GetValue().Offset = offset;
             chunkOptions.Range.GetValue().Length = length;
+            if (options.ValidateCrc64)
+            {
+              chunkOptions.RangeHashAlgorithm = HashAlgorithm::Crc64;
+            }
             if (!chunkOptions.AccessConditions.IfMatch.HasValue())
             {
               chunkOptions.AccessConditions.IfMatch = firstChunk->ETag;
@@ -310,6 +377,14 @@ namespace Azure { namespace Storage { namespace Blobs {
             {
               throw Azure::Core::RequestFailedException("error when reading body stream");
             }
+            if (options.ValidateCrc64)
+            {
+              Crc64 chunkCrc64;
+              chunkCrc64.Update(
+                  buffer + (offset - firstChunkOffset), static_cast<std::size_t>(length));
+              Storage::Details::VerifyCrc64(chunkCrc64, chunk->TransactionalContentHash);
+              transferCrc64.AddChunk(chunkId, chunkCrc64);
+            }
 
             if (chunkId == numChunks - 1)
             {
@@ -332,9 +407,30 @@ namespace Azure { namespace Storage { namespace Blobs {
       chunkSize = std::min(chunkSize, DefaultChunkSize);
     }
 
+    int64_t maxChunkSize = options.ChunkSize.ValueOr(Storage::Details::DefaultAutoTuneMaxChunkSize);
+    if (options.ValidateCrc64)
+    {
+      chunkSize = std::min(chunkSize, MaxRangeHashLength);
+      maxChunkSize = std::min(maxChunkSize, MaxRangeHashLength);
+    }
+
     Storage::Details::ConcurrentTransfer(
-        remainingOffset, remainingSize, chunkSize, options.Concurrency, downloadChunkFunc);
+        remainingOffset,
+        remainingSize,
+        chunkSize,
+        options.Concurrency,
+        options.AutoTune,
+        0,
+        maxChunkSize,
+        downloadChunkFunc);
     ret->ContentLength = blobRangeSize;
+    if (options.ValidateCrc64)
+    {
+      ContentHash contentHash;
+      contentHash.Algorithm = HashAlgorithm::Crc64;
+      contentHash.Value = transferCrc64.Combine().Digest();
+      ret->TransactionalContentHash = std::move(contentHash);
+    }
     return ret;
   }
 
@@ -358,17 +454,32 @@ namespace Azure { namespace Storage { namespace Blobs {
       firstChunkLength = std::min(firstChunkLength, options.Range.GetValue().Length.GetValue());
     }
 
+    if (options.ValidateCrc64)
+    {
+      firstChunkLength = std::min(firstChunkLength, MaxRangeHashLength);
+    }
+
     DownloadBlobOptions firstChunkOptions;
     firstChunkOptions.Context = options.Context;
     firstChunkOptions.Range = options.Range;
+    if (options.ValidateCrc64 && !firstChunkOptions.Range.HasValue())
+    {
+      // A range request, so the service sends the CRC64 of the first chunk.
+      firstChunkOptions.Range = Core::Http::Range();
+      firstChunkOptions.Range.GetValue().Offset = 0;
+    }
     if (firstChunkOptions.Range.HasValue())
     {
       firstChunkOptions.Range.GetValue().Length = firstChunkLength;
     }
+    if (options.ValidateCrc64)
+    {
+      firstChunkOptions.RangeHashAlgorithm = HashAlgorithm::Crc64;
+    }
 
-    Storage::Details::FileWriter fileWriter(fileName);
+    Storage::Details::FileWriter fileWriter(fileName, options.UseDirectIo);
 
-    auto firstChunk = Download(firstChunkOptions);
+    auto firstChunk = DownloadFirstChunk(*this, firstChunkOptions, options.Range.HasValue());
 
     int64_t blobSize;
     int64_t blobRangeSize;
@@ -387,31 +498,63 @@ namespace Azure { namespace Storage { namespace Blobs {
       blobRangeSize = blobSize;
     }
     firstChunkLength = std::min(firstChunkLength, blobRangeSize);
+    if (options.PreallocateFile)
+    {
+      fileWriter.Preallocate(blobRangeSize);
+    }
 
     auto bodyStreamToFile = [](Azure::Core::Http::BodyStream& stream,
                                Storage::Details::FileWriter& fileWriter,
                                int64_t offset,
                                int64_t length,
-                               Azure::Core::Context& context) {
-      constexpr std::size_t bufferSize = 4 * 1024 * 1024;
-      std::vector<uint8_t> buffer(bufferSize);
+                               Azure::Core::Context& context,
+                               Crc64* crc64) {
+      // Aligned, so writes can bypass the page cache with direct I/O.
+      constexpr std::size_t bufferSize = Storage::Details::FileWriterBufferSize;
+      auto bufferPool = Azure::Core::BufferPool::GetDefault();
+      auto pooledBuffer = bufferPool->Acquire(bufferSize, Storage::Details::DirectIoAlignment);
+      uint8_t* buffer = Azure::Core::BufferPool::GetAlignedData(
+          pooledBuffer, Storage::Details::DirectIoAlignment);
       while (length > 0)
       {
         int64_t readSize = std::min(static_cast<int64_t>(bufferSize), length);
         int64_t bytesRead
-            = Azure::Core::Http::BodyStream::ReadToCount(context, stream, buffer.data(), readSize);
+            = Azure::Core::Http::BodyStream::ReadToCount(context, stream, buffer, readSize);
         if (bytesRead != readSize)
         {
           throw Azure::Core::RequestFailedException("error when reading body stream");
         }
-        fileWriter.Write(buffer.data(), bytesRead, offset);
+        if (crc64 != nullptr)
+        {
+          crc64->Update(buffer, static_cast<std::size_t>(bytesRead));
+        }
+        fileWriter.Write(buffer, bytesRead, offset);
         length -= bytesRead;
         offset += bytesRead;
       }
+      bufferPool->Release(std::move(pooledBuffer));
     };
 
-    bodyStreamToFile(
-        *(firstChunk->BodyStream), fileWriter, 0, firstChunkLength, firstChunkOptions.Context);
+    Storage::Details::TransferCrc64 transferCrc64;
+    {
+      Crc64 chunkCrc64;
+      bodyStreamToFile(
+          *(firstChunk->BodyStream),
+          fileWriter,
+          0,
+          firstChunkLength,
+          firstChunkOptions.Context,
+          options.ValidateCrc64 ? &chunkCrc64 : nullptr);
+      if (options.ValidateCrc64)
+      {
+        // An empty blob is downloaded without a range, the service sends no CRC64 for it.
+        if (firstChunkLength > 0)
+        {
+          Storage::Details::VerifyCrc64(chunkCrc64, firstChunk->TransactionalContentHash);
+        }
+        transferCrc64.AddChunk(-1, chunkCrc64);
+      }
+    }
     firstChunk->BodyStream.reset();
 
     auto returnTypeConverter = [](Azure::Core::Response<Models::DownloadBlobResult>& response) {
@@ -436,17 +579,28 @@ namespace Azure { namespace Storage { namespace Blobs {
             chunkOptions.Range = Core::Http::Range();
             chunkOptions.Range.GetValue().Offset = offset;
             chunkOptions.Range.GetValue().Length = length;
+            if (options.ValidateCrc64)
+            {
+              chunkOptions.RangeHashAlgorithm = HashAlgorithm::Crc64;
+            }
             if (!chunkOptions.AccessConditions.IfMatch.HasValue())
             {
               chunkOptions.AccessConditions.IfMatch = firstChunk->ETag;
             }
             auto chunk = Download(chunkOptions);
+            Crc64 chunkCrc64;
             bodyStreamToFile(
                 *(chunk->BodyStream),
                 fileWriter,
                 offset - firstChunkOffset,
                 chunkOptions.Range.GetValue().Length.GetValue(),
-                chunkOptions.Context);
+                chunkOptions.Context,
+                options.ValidateCrc64 ? &chunkCrc64 : nullptr);
+            if (options.ValidateCrc64)
+            {
+              Storage::Details::VerifyCrc64(chunkCrc64, chunk->TransactionalContentHash);
+              transferCrc64.AddChunk(chunkId, chunkCrc64);
+            }
 
             if (chunkId == numChunks - 1)
             {
@@ -469,12 +623,108 @@ namespace Azure { namespace Storage { namespace Blobs {
       chunkSize = std::min(chunkSize, DefaultChunkSize);
     }
 
+    int64_t maxChunkSize = options.ChunkSize.ValueOr(Storage::Details::DefaultAutoTuneMaxChunkSize);
+    if (options.ValidateCrc64)
+    {
+      chunkSize = std::min(chunkSize, MaxRangeHashLength);
+      maxChunkSize = std::min(maxChunkSize, MaxRangeHashLength);
+    }
+
     Storage::Details::ConcurrentTransfer(
-        remainingOffset, remainingSize, chunkSize, options.Concurrency, downloadChunkFunc);
+        remainingOffset,
+        remainingSize,
+        chunkSize,
+        options.Concurrency,
+        options.AutoTune,
+        0,
+        maxChunkSize,
+        downloadChunkFunc);
     ret->ContentLength = blobRangeSize;
+    if (options.ValidateCrc64)
+    {
+      ContentHash contentHash;
+      contentHash.Algorithm = HashAlgorithm::Crc64;
+      contentHash.Value = transferCrc64.Combine().Digest();
+      ret->TransactionalContentHash = std::move(contentHash);
+    }
     return ret;
   }
 
+  std::unique_ptr<Azure::Core::Http::BodyStream> BlobClient::OpenRead(
+      const OpenReadBlobOptions& options) const
+  {
+    constexpr int64_t DefaultChunkSize = 4 * 1024 * 1024;
+
+    int64_t chunkSize = DefaultChunkSize;
+    if (options.ChunkSize.HasValue())
+    {
+      chunkSize = options.ChunkSize.GetValue();
+    }
+
+    // The first chunk tells the size of the blob and the ETag the other chunks are pinned to.
+    int64_t firstChunkOffset = options.Range.HasValue() ? options.Range.GetValue().Offset : 0;
+    int64_t firstChunkLength = chunkSize;
+    if (options.Range.HasValue() && options.Range.GetValue().Length.HasValue())
+    {
+      firstChunkLength = std::min(firstChunkLength, options.Range.GetValue().Length.GetValue());
+    }
+
+    DownloadBlobOptions firstChunkOptions;
+    firstChunkOptions.Context = options.Context;
+    firstChunkOptions.Range = Core::Http::Range();
+    firstChunkOptions.Range.GetValue().Offset = firstChunkOffset;
+    firstChunkOptions.Range.GetValue().Length = firstChunkLength;
+
+    auto firstChunk = DownloadFirstChunk(*this, firstChunkOptions, options.Range.HasValue());
+
+    int64_t blobRangeSize = firstChunk->BlobSize - firstChunkOffset;
+    if (options.Range.HasValue() && options.Range.GetValue().Length.HasValue())
+    {
+      blobRangeSize = std::min(blobRangeSize, options.Range.GetValue().Length.GetValue());
+    }
+    firstChunkLength = std::min(firstChunkLength, blobRangeSize);
+
+    auto firstChunkContent = Azure::Core::BufferPool::GetDefault()->Acquire(
+        static_cast<std::size_t>(firstChunkLength));
+    int64_t bytesRead = Azure::Core::Http::BodyStream::ReadToCount(
+        options.Context, *(firstChunk->BodyStream), firstChunkContent.data(), firstChunkLength);
+    if (bytesRead != firstChunkLength)
+    {
+      throw Azure::Core::RequestFailedException("error when reading body stream");
+    }
+    firstChunk->BodyStream.reset();
+
+    // The stream may outlive this client.
+    auto readChunk = [blobClient = *this, eTag = firstChunk->ETag](
+                         int64_t offset,
+                         int64_t length,
+                         uint8_t* buffer,
+                         const Azure::Core::Context& context) {
+      DownloadBlobOptions chunkOptions;
+      chunkOptions.Context = context;
+      chunkOptions.Range = Core::Http::Range();
+      chunkOptions.Range.GetValue().Offset = offset;
+      chunkOptions.Range.GetValue().Length = length;
+      chunkOptions.AccessConditions.IfMatch = eTag;
+      auto chunk = blobClient.Download(chunkOptions);
+      int64_t bytesRead = Azure::Core::Http::BodyStream::ReadToCount(
+          context, *(chunk->BodyStream), buffer, length);
+      if (bytesRead != length)
+      {
+        throw Azure::Core::RequestFailedException("error when reading body stream");
+      }
+    };
+
+    return std::make_unique<Storage::Details::ReadAheadBodyStream>(
+        options.Context,
+        std::move(firstChunkContent),
+        firstChunkOffset,
+        blobRangeSize,
+        chunkSize,
+        options.Concurrency,
+        std::move(readChunk));
+  }
+
   Azure::Core::Response<Models::GetBlobPropertiesResult> BlobClient::GetProperties(
       const GetBlobPropertiesOptions& options) const
   {
@@ -3,7 +3,10 @@
 
 #include "azure/storage/blobs/blob_container_client.hpp"
 
+#include <mutex>
+
 #include <azure/core/http/policy.hpp>
+#include <azure/storage/common/concurrent_transfer.hpp>
 #include <azure/storage/common/constants.hpp>
 #include <azure/storage/common/shared_key_policy.hpp>
 #include <azure/storage/common/storage_common.hpp>
@@ -247,6 +250,29 @@ namespace Azure { namespace Storage { namespace Blobs {
     return response;
   }
 
+  Azure::Core::Response<Models::ListBlobsSinglePageResult> BlobContainerClient::ListBlobsSinglePage(
+      const std::function<void(Models::BlobItem)>& onBlobItem,
+      const ListBlobsSinglePageOptions& options) const
+  {
+    Details::BlobRestClient::BlobContainer::ListBlobsSinglePageOptions protocolLayerOptions;
+    protocolLayerOptions.Prefix = options.Prefix;
+    protocolLayerOptions.ContinuationToken = options.ContinuationToken;
+    protocolLayerOptions.MaxResults = options.PageSizeHint;
+    protocolLayerOptions.Include = options.Include;
+    return Details::BlobRestClient::BlobContainer::ListBlobsSinglePage(
+        options.Context,
+        *m_pipeline,
+        m_blobContainerUrl,
+        protocolLayerOptions,
+        [&onBlobItem](Models::BlobItem item) {
+          if (item.VersionId.HasValue() && !item.IsCurrentVersion.HasValue())
+          {
+            item.IsCurrentVersion = false;
+          }
+          onBlobItem(std::move(item));
+        });
+  }
+
   Azure::Core::Response<Models::ListBlobsByHierarchySinglePageResult>
   BlobContainerClient::ListBlobsByHierarchySinglePage(
       const std::string& delimiter,
@@ -271,6 +297,56 @@ namespace Azure { namespace Storage { namespace Blobs {
     return response;
   }
 
+  void BlobContainerClient::ListBlobsParallel(
+      const std::function<void(Models::BlobItem)>& onBlobItem,
+      const ListBlobsParallelOptions& options) const
+  {
+    Storage::Details::ConcurrentTaskQueue queue(options.Concurrency);
+    std::mutex onBlobItemMutex;
+
+    // Lists the blobs right under a prefix, and queues the prefixes under it as soon as they're
+    // found. Stops once listing another prefix failed, the error is rethrown by the queue.
+    std::function<void(std::string)> listPrefix = [&](std::string prefix) {
+      ListBlobsSinglePageOptions pageOptions;
+      pageOptions.Context = options.Context;
+      if (!prefix.empty())
+      {
+        pageOptions.Prefix = std::move(prefix);
+      }
+      pageOptions.PageSizeHint = options.PageSizeHint;
+      pageOptions.Include = options.Include;
+      do
+      {
+        if (queue.IsFailed())
+        {
+          return;
+        }
+        auto page = ListBlobsByHierarchySinglePage(options.Delimiter, pageOptions);
+        for (auto& blobPrefix : page->BlobPrefixes)
+        {
+          queue.Push([&listPrefix, name = std::move(blobPrefix.Name)]() { listPrefix(name); });
+        }
+        {
+          std::lock_guard<std::mutex> guard(onBlobItemMutex);
+          for (auto& item : page->Items)
+          {
+            if (queue.IsFailed())
+            {
+              return;
+            }
+            onBlobItem(std::move(item));
+          }
+        }
+        pageOptions.ContinuationToken = page->ContinuationToken;
+      } while (pageOptions.ContinuationToken.HasValue());
+    };
+
+    queue.Push([&listPrefix, &options]() {
+      listPrefix(options.Prefix.HasValue() ? options.Prefix.GetValue() : std::string());
+    });
+    queue.Run();
+  }
+
   Azure::Core::Response<Models::GetBlobContainerAccessPolicyResult>
   BlobContainerClient::GetAccessPolicy(const GetBlobContainerAccessPolicyOptions& options) const
   {
@@ -3,6 +3,11 @@
 
 #include "azure/storage/blobs/block_blob_client.hpp"
 
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+#include <azure/core/buffer_pool.hpp>
 #include <azure/storage/common/concurrent_transfer.hpp>
 #include <azure/storage/common/constants.hpp>
 #include <azure/storage/common/crypt.hpp>
@@ -11,6 +16,48 @@
 
 namespace Azure { namespace Storage { namespace Blobs {
 
+  namespace {
+    constexpr int64_t DefaultBlockSize = 8 * 1024 * 1024;
+
+    // Block IDs of blocks staged by the client, from the index of the block in the blob.
+    std::string GetBlockId(int64_t id)
+    {
+      constexpr std::size_t BlockIdLength = 64;
+      std::string blockId = std::to_string(id);
+      blockId = std::string(BlockIdLength - blockId.length(), '0') + blockId;
+      return Azure::Core::Base64Encode(std::vector<uint8_t>(blockId.begin(), blockId.end()));
+    }
+
+    ContentHash GetCrc64Hash(const Crc64& crc64)
+    {
+      ContentHash contentHash;
+      contentHash.Algorithm = HashAlgorithm::Crc64;
+      contentHash.Value = crc64.Digest();
+      return contentHash;
+    }
+
+    ContentHash GetMd5Hash(std::vector<uint8_t> md5)
+    {
+      ContentHash contentHash;
+      contentHash.Algorithm = HashAlgorithm::Md5;
+      contentHash.Value = std::move(md5);
+      return contentHash;
+    }
+
+    // Reads a chunk of a file into a buffer from the default pool, to be given back once staged.
+    std::vector<uint8_t> ReadChunk(
+        const Azure::Core::Context& context,
+        Azure::Core::Http::FileBodyStream& contentStream)
+    {
+      auto buffer = Azure::Core::BufferPool::GetDefault()->Acquire(
+          static_cast<std::size_t>(contentStream.Length()));
+      buffer.resize(static_cast<std::size_t>(Azure::Core::Http::BodyStream::ReadToCount(
+          context, contentStream, buffer.data(), static_cast<int64_t>(buffer.size()))));
+      return buffer;
+    }
+
+  } // namespace
+
   BlockBlobClient BlockBlobClient::CreateFromConnectionString(
       const std::string& connectionString,
       const std::string& blobContainerName,
@@ -107,7 +154,6 @@ namespace Azure { namespace Storage { namespace Blobs {
       std::size_t bufferSize,
       const UploadBlockBlobFromOptions& options) const
   {
-    constexpr int64_t DefaultBlockSize = 8 * 1024 * 1024;
     constexpr int64_t MaximumNumberBlocks = 50000;
     constexpr int64_t GrainSize = 4 * 1024;
 
@@ -131,34 +177,104 @@ namespace Azure { namespace Storage { namespace Blobs {
       uploadBlockBlobOptions.HttpHeaders = options.HttpHeaders;
       uploadBlockBlobOptions.Metadata = options.Metadata;
       uploadBlockBlobOptions.Tier = options.Tier;
-      return Upload(&contentStream, uploadBlockBlobOptions);
+      if (options.ValidateCrc64)
+      {
+        Crc64 crc64;
+        crc64.Update(buffer, bufferSize);
+        uploadBlockBlobOptions.TransactionalContentHash = GetCrc64Hash(crc64);
+      }
+      else if (options.ValidateMd5)
+      {
+        uploadBlockBlobOptions.TransactionalContentHash
+            = GetMd5Hash(Md5::Hash(buffer, bufferSize));
+      }
+      auto response = Upload(&contentStream, uploadBlockBlobOptions);
+      if (options.ValidateCrc64)
+      {
+        response->TransactionalContentHash = uploadBlockBlobOptions.TransactionalContentHash;
+      }
+      return response;
     }
 
-    std::vector<std::string> blockIds;
-    auto getBlockId = [](int64_t id) {
-      constexpr std::size_t BlockIdLength = 64;
-      std::string blockId = std::to_string(id);
-      blockId = std::string(BlockIdLength - blockId.length(), '0') + blockId;
-      return Azure::Core::Base64Encode(std::vector<uint8_t>(blockId.begin(), blockId.end()));
+    Storage::Details::TransferCrc64 transferCrc64;
+    // With a fixed chunk size, the MD5 of the blocks are computed a group at a time by the first
+    // thread staging a block of the group.
+    constexpr int64_t Md5GroupSize = 8;
+    const bool batchMd5 = options.ValidateMd5 && !options.ValidateCrc64 && !options.AutoTune;
+    const int64_t numBlocks
+        = batchMd5 ? (static_cast<int64_t>(bufferSize) + chunkSize - 1) / chunkSize : 0;
+    std::vector<std::vector<uint8_t>> blockMd5s(static_cast<std::size_t>(numBlocks));
+    std::vector<std::once_flag> md5GroupsHashed(
+        static_cast<std::size_t>((numBlocks + Md5GroupSize - 1) / Md5GroupSize));
+    auto getBlockMd5 = [&](int64_t offset, int64_t length, int64_t chunkId) {
+      if (!batchMd5)
+      {
+        return Md5::Hash(buffer + offset, static_cast<std::size_t>(length));
+      }
+      const int64_t group = chunkId / Md5GroupSize;
+      std::call_once(md5GroupsHashed[static_cast<std::size_t>(group)], [&]() {
+        std::vector<std::pair<const uint8_t*, std::size_t>> blocks;
+        const int64_t groupEnd = std::min((group + 1) * Md5GroupSize, numBlocks);
+        for (int64_t id = group * Md5GroupSize; id < groupEnd; ++id)
+        {
+          const int64_t blockOffset = id * chunkSize;
+          blocks.emplace_back(
+              buffer + blockOffset,
+              static_cast<std::size_t>(
+                  std::min(chunkSize, static_cast<int64_t>(bufferSize) - blockOffset)));
+        }
+        auto md5s = Storage::Details::Md5HashBatch(blocks);
+        for (std::size_t i = 0; i < md5s.size(); ++i)
+        {
+          blockMd5s[static_cast<std::size_t>(group * Md5GroupSize) + i] = std::move(md5s[i]);
+        }
+      });
+      return blockMd5s[static_cast<std::size_t>(chunkId)];
     };
 
+    std::vector<std::string> blockIds;
     auto uploadBlockFunc = [&](int64_t offset, int64_t length, int64_t chunkId, int64_t numChunks) {
       Azure::Core::Http::MemoryBodyStream contentStream(buffer + offset, length);
       StageBlockOptions chunkOptions;
       chunkOptions.Context = options.Context;
-      auto blockInfo = StageBlock(getBlockId(chunkId), &contentStream, chunkOptions);
+      Crc64 chunkCrc64;
+      if (options.ValidateCrc64)
+      {
+        chunkCrc64.Update(buffer + offset, static_cast<std::size_t>(length));
+        chunkOptions.TransactionalContentHash = GetCrc64Hash(chunkCrc64);
+      }
+      else if (options.ValidateMd5)
+      {
+        chunkOptions.TransactionalContentHash = GetMd5Hash(getBlockMd5(offset, length, chunkId));
+      }
+      auto blockInfo = StageBlock(GetBlockId(chunkId), &contentStream, chunkOptions);
+      if (options.ValidateCrc64)
+      {
+        Storage::Details::VerifyCrc64(chunkCrc64, blockInfo->TransactionalContentHash);
+        transferCrc64.AddChunk(chunkId, chunkCrc64);
+      }
       if (chunkId == numChunks - 1)
       {
         blockIds.resize(static_cast<std::size_t>(numChunks));
       }
     };
 
+    // Auto-tuned blocks must be large enough for the blob to fit in the maximum number of blocks.
+    int64_t minBlockSize
+        = (static_cast<int64_t>(bufferSize) + MaximumNumberBlocks - 1) / MaximumNumberBlocks;
     Storage::Details::ConcurrentTransfer(
-        0, bufferSize, chunkSize, options.Concurrency, uploadBlockFunc);
+        0,
+        bufferSize,
+        chunkSize,
+        options.Concurrency,
+        options.AutoTune,
+        (minBlockSize + GrainSize - 1) / GrainSize * GrainSize,
+        options.ChunkSize.ValueOr(Storage::Details::DefaultAutoTuneMaxChunkSize),
+        uploadBlockFunc);
 
     for (std::size_t i = 0; i < blockIds.size(); ++i)
     {
-      blockIds[i] = getBlockId(static_cast<int64_t>(i));
+      blockIds[i] = GetBlockId(static_cast<int64_t>(i));
     }
     CommitBlockListOptions commitBlockListOptions;
     commitBlockListOptions.Context = options.Context;
@@ -174,6 +290,10 @@ namespace Azure { namespace Storage { namespace Blobs {
     ret.IsServerEncrypted = commitBlockListResponse->IsServerEncrypted;
     ret.EncryptionKeySha256 = std::move(commitBlockListResponse->EncryptionKeySha256);
     ret.EncryptionScope = std::move(commitBlockListResponse->EncryptionScope);
+    if (options.ValidateCrc64)
+    {
+      ret.TransactionalContentHash = GetCrc64Hash(transferCrc64.Combine());
+    }
     return Azure::Core::Response<Models::UploadBlockBlobFromResult>(
         std::move(ret), commitBlockListResponse.ExtractRawResponse());
   }
@@ -182,11 +302,18 @@ namespace Azure { namespace Storage { namespace Blobs {
       const std::string& fileName,
       const UploadBlockBlobFromOptions& options) const
   {
-    constexpr int64_t DefaultBlockSize = 8 * 1024 * 1024;
     constexpr int64_t MaximumNumberBlocks = 50000;
     constexpr int64_t GrainSize = 4 * 1024;
 
-    Storage::Details::FileReader fileReader(fileName);
+    Storage::Details::FileReader fileReader(fileName, options.MemoryMapFile);
+    if (fileReader.GetMappedData())
+    {
+      // Blocks are read and hashed straight from the mapping, like from a buffer.
+      return UploadFrom(
+          fileReader.GetMappedData(),
+          static_cast<std::size_t>(fileReader.GetFileSize()),
+          options);
+    }
 
     int64_t chunkSize = DefaultBlockSize;
     if (options.ChunkSize.HasValue())
@@ -210,34 +337,87 @@ namespace Azure { namespace Storage { namespace Blobs {
       uploadBlockBlobOptions.HttpHeaders = options.HttpHeaders;
       uploadBlockBlobOptions.Metadata = options.Metadata;
       uploadBlockBlobOptions.Tier = options.Tier;
-      return Upload(&contentStream, uploadBlockBlobOptions);
+      if (!options.ValidateCrc64 && !options.ValidateMd5)
+      {
+        return Upload(&contentStream, uploadBlockBlobOptions);
+      }
+      // The file is read once, the hash has to be known before the upload starts.
+      auto content = ReadChunk(options.Context, contentStream);
+      Azure::Core::Http::MemoryBodyStream memoryStream(content.data(), content.size());
+      if (options.ValidateCrc64)
+      {
+        Crc64 crc64;
+        crc64.Update(content.data(), content.size());
+        uploadBlockBlobOptions.TransactionalContentHash = GetCrc64Hash(crc64);
+      }
+      else
+      {
+        uploadBlockBlobOptions.TransactionalContentHash
+            = GetMd5Hash(Md5::Hash(content.data(), content.size()));
+      }
+      auto response = Upload(&memoryStream, uploadBlockBlobOptions);
+      Azure::Core::BufferPool::GetDefault()->Release(std::move(content));
+      if (options.ValidateCrc64)
+      {
+        response->TransactionalContentHash = uploadBlockBlobOptions.TransactionalContentHash;
+      }
+      return response;
     }
 
+    Storage::Details::TransferCrc64 transferCrc64;
     std::vector<std::string> blockIds;
-    auto getBlockId = [](int64_t id) {
-      constexpr std::size_t BlockIdLength = 64;
-      std::string blockId = std::to_string(id);
-      blockId = std::string(BlockIdLength - blockId.length(), '0') + blockId;
-      return Azure::Core::Base64Encode(std::vector<uint8_t>(blockId.begin(), blockId.end()));
-    };
-
     auto uploadBlockFunc = [&](int64_t offset, int64_t length, int64_t chunkId, int64_t numChunks) {
       Azure::Core::Http::FileBodyStream contentStream(fileReader.GetHandle(), offset, length);
       StageBlockOptions chunkOptions;
       chunkOptions.Context = options.Context;
-      auto blockInfo = StageBlock(getBlockId(chunkId), &contentStream, chunkOptions);
+      if (!options.ValidateCrc64 && !options.ValidateMd5)
+      {
+        StageBlock(GetBlockId(chunkId), &contentStream, chunkOptions);
+      }
+      else if (!options.ValidateCrc64)
+      {
+        // Blocks of a file are read by the thread staging them, one at a time.
+        auto content = ReadChunk(options.Context, contentStream);
+        Azure::Core::Http::MemoryBodyStream memoryStream(content.data(), content.size());
+        chunkOptions.TransactionalContentHash
+            = GetMd5Hash(Md5::Hash(content.data(), content.size()));
+        StageBlock(GetBlockId(chunkId), &memoryStream, chunkOptions);
+        Azure::Core::BufferPool::GetDefault()->Release(std::move(content));
+      }
+      else
+      {
+        auto content = ReadChunk(options.Context, contentStream);
+        Azure::Core::Http::MemoryBodyStream memoryStream(content.data(), content.size());
+        Crc64 chunkCrc64;
+        chunkCrc64.Update(content.data(), content.size());
+        chunkOptions.TransactionalContentHash = GetCrc64Hash(chunkCrc64);
+        auto blockInfo = StageBlock(GetBlockId(chunkId), &memoryStream, chunkOptions);
+        Azure::Core::BufferPool::GetDefault()->Release(std::move(content));
+        Storage::Details::VerifyCrc64(chunkCrc64, blockInfo->TransactionalContentHash);
+        transferCrc64.AddChunk(chunkId, chunkCrc64);
+      }
       if (chunkId == numChunks - 1)
       {
         blockIds.resize(static_cast<std::size_t>(numChunks));
       }
     };
 
+    // Auto-tuned blocks must be large enough for the file to fit in the maximum number of blocks.
+    int64_t minBlockSize
+        = (fileReader.GetFileSize() + MaximumNumberBlocks - 1) / MaximumNumberBlocks;
     Storage::Details::ConcurrentTransfer(
-        0, fileReader.GetFileSize(), chunkSize, options.Concurrency, uploadBlockFunc);
+        0,
+        fileReader.GetFileSize(),
+        chunkSize,
+        options.Concurrency,
+        options.AutoTune,
+        (minBlockSize + GrainSize - 1) / GrainSize * GrainSize,
+        options.ChunkSize.ValueOr(Storage::Details::DefaultAutoTuneMaxChunkSize),
+        uploadBlockFunc);
 
     for (std::size_t i = 0; i < blockIds.size(); ++i)
     {
-      blockIds[i] = getBlockId(static_cast<int64_t>(i));
+      blockIds[i] = GetBlockId(static_cast<int64_t>(i));
     }
     CommitBlockListOptions commitBlockListOptions;
     commitBlockListOptions.Context = options.Context;
@@ -253,10 +433,20 @@ namespace Azure { namespace Storage { namespace Blobs {
     result.IsServerEncrypted = commitBlockListResponse->IsServerEncrypted;
     result.EncryptionKeySha256 = commitBlockListResponse->EncryptionKeySha256;
     result.EncryptionScope = commitBlockListResponse->EncryptionScope;
+    if (options.ValidateCrc64)
+    {
+      result.TransactionalContentHash = GetCrc64Hash(transferCrc64.Combine());
+    }
     return Azure::Core::Response<Models::UploadBlockBlobFromResult>(
         std::move(result), commitBlockListResponse.ExtractRawResponse());
   }
 
+  std::unique_ptr<BlockBlobWriter> BlockBlobClient::OpenWrite(
+      const OpenWriteBlockBlobOptions& options) const
+  {
+    return std::unique_ptr<BlockBlobWriter>(new BlockBlobWriter(*this, options));
+  }
+
   Azure::Core::Response<Models::StageBlockResult> BlockBlobClient::StageBlock(
       const std::string& blockId,
       Azure::Core::Http::BodyStream* content,
@@ -344,4 +534,189 @@ namespace Azure { namespace Storage { namespace Blobs {
         options.Context, *m_pipeline, m_blobUrl, protocolLayerOptions);
   }
 
+  BlockBlobWriter::BlockBlobWriter(
+      BlockBlobClient blockBlobClient,
+      const OpenWriteBlockBlobOptions& options)
+      : m_blockBlobClient(std::move(blockBlobClient)), m_options(options),
+        m_blockSize(static_cast<std::size_t>(
+            options.ChunkSize.HasValue() ? options.ChunkSize.GetValue() : DefaultBlockSize)),
+        m_stagingQueue(std::make_unique<Storage::Details::ConcurrentTaskQueue>(
+            std::max(options.Concurrency, 1)))
+  {
+    m_stagingQueue->Start();
+  }
+
+  BlockBlobWriter::~BlockBlobWriter()
+  {
+    // The blocks staged so far are left uncommitted.
+    m_stagingQueue->Stop();
+    auto bufferPool = Azure::Core::BufferPool::GetDefault();
+    for (auto& buffer : m_freeBuffers)
+    {
+      bufferPool->Release(std::move(buffer));
+    }
+    bufferPool->Release(std::move(m_buffer));
+  }
+
+  void BlockBlobWriter::ThrowIfFailed()
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (m_error)
+    {
+      std::rethrow_exception(m_error);
+    }
+  }
+
+  void BlockBlobWriter::Write(const uint8_t* buffer, std::size_t bufferSize)
+  {
+    ThrowIfFailed();
+    if (m_closed)
+    {
+      throw std::runtime_error("the block blob writer is closed");
+    }
+    while (bufferSize > 0)
+    {
+      if (m_buffer.capacity() < m_blockSize)
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_freeBuffers.empty())
+        {
+          lock.unlock();
+          m_buffer = Azure::Core::BufferPool::GetDefault()->Acquire(m_blockSize);
+          m_buffer.clear();
+        }
+        else
+        {
+          m_buffer = std::move(m_freeBuffers.back());
+          m_freeBuffers.pop_back();
+        }
+      }
+      std::size_t bytesCopied = std::min(bufferSize, m_blockSize - m_buffer.size());
+      m_buffer.insert(m_buffer.end(), buffer, buffer + bytesCopied);
+      buffer += bytesCopied;
+      bufferSize -= bytesCopied;
+      if (m_buffer.size() == m_blockSize)
+      {
+        StageBuffer();
+      }
+    }
+  }
+
+  void BlockBlobWriter::StageBuffer()
+  {
+    {
+      // Back-pressure: wait for a block to be staged before staging one more.
+      std::unique_lock<std::mutex> lock(m_mutex);
+      WaitForStagingBlocks(
+          lock, static_cast<std::size_t>(std::max(m_options.Concurrency, 1)) - 1);
+      if (m_error)
+      {
+        std::rethrow_exception(m_error);
+      }
+      ++m_stagingBlocks;
+    }
+
+    std::string blockId = GetBlockId(static_cast<int64_t>(m_blockIds.size()));
+    m_blockIds.push_back(blockId);
+    m_stagingQueue->Push([this, blockId, buffer = std::move(m_buffer)]() mutable {
+      StageBlock(blockId, std::move(buffer));
+    });
+    m_buffer = std::vector<uint8_t>();
+  }
+
+  void BlockBlobWriter::WaitForStagingBlocks(
+      std::unique_lock<std::mutex>& lock,
+      std::size_t maxStagingBlocks)
+  {
+    while (!m_error && m_stagingBlocks > maxStagingBlocks)
+    {
+      // When all the pool threads are busy, blocks may not be started yet. Stage a queued block
+      // here instead of waiting for a thread.
+      lock.unlock();
+      auto const staged = m_stagingQueue->TryRunTask();
+      lock.lock();
+      // Blocks still staging are all run by pool threads, which notify once they are done.
+      if (!staged && !m_error && m_stagingBlocks > maxStagingBlocks)
+      {
+        m_blockStaged.wait(lock);
+      }
+    }
+  }
+
+  void BlockBlobWriter::StageBlock(const std::string& blockId, std::vector<uint8_t> buffer)
+  {
+    std::exception_ptr error;
+    try
+    {
+      Azure::Core::Http::MemoryBodyStream contentStream(buffer.data(), buffer.size());
+      StageBlockOptions stageBlockOptions;
+      stageBlockOptions.Context = m_options.Context;
+      m_blockBlobClient.StageBlock(blockId, &contentStream, stageBlockOptions);
+    }
+    catch (...)
+    {
+      error = std::current_exception();
+    }
+    buffer.clear();
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      if (error && !m_error)
+      {
+        m_error = error;
+      }
+      m_freeBuffers.push_back(std::move(buffer));
+      --m_stagingBlocks;
+    }
+    m_blockStaged.notify_all();
+  }
+
+  Azure::Core::Response<Models::UploadBlockBlobFromResult> BlockBlobWriter::Close()
+  {
+    ThrowIfFailed();
+    if (m_closed)
+    {
+      throw std::runtime_error("the block blob writer is closed");
+    }
+    m_closed = true;
+
+    if (m_blockIds.empty())
+    {
+      Azure::Core::Http::MemoryBodyStream contentStream(m_buffer.data(), m_buffer.size());
+      UploadBlockBlobOptions uploadBlockBlobOptions;
+      uploadBlockBlobOptions.Context = m_options.Context;
+      uploadBlockBlobOptions.HttpHeaders = m_options.HttpHeaders;
+      uploadBlockBlobOptions.Metadata = m_options.Metadata;
+      uploadBlockBlobOptions.Tier = m_options.Tier;
+      return m_blockBlobClient.Upload(&contentStream, uploadBlockBlobOptions);
+    }
+
+    if (!m_buffer.empty())
+    {
+      StageBuffer();
+    }
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      WaitForStagingBlocks(lock, 0);
+    }
+    ThrowIfFailed();
+
+    CommitBlockListOptions commitBlockListOptions;
+    commitBlockListOptions.Context = m_options.Context;
+    commitBlockListOptions.HttpHeaders = m_options.HttpHeaders;
+    commitBlockListOptions.Metadata = m_options.Metadata;
+    commitBlockListOptions.Tier = m_options.Tier;
+    auto commitBlockListResponse
+        = m_blockBlobClient.CommitBlockList(m_blockIds, commitBlockListOptions);
+
+    Models::UploadBlockBlobFromResult ret;
+    ret.ETag = std::move(commitBlockListResponse->ETag);
+    ret.LastModified = std::move(commitBlockListResponse->LastModified);
+    ret.VersionId = std::move(commitBlockListResponse->VersionId);
+    ret.IsServerEncrypted = commitBlockListResponse->IsServerEncrypted;
+    ret.EncryptionKeySha256 = std::move(commitBlockListResponse->EncryptionKeySha256);
+    ret.EncryptionScope = std::move(commitBlockListResponse->EncryptionScope);
+    return Azure::Core::Response<Models::UploadBlockBlobFromResult>(
+        std::move(ret), commitBlockListResponse.ExtractRawResponse());
+  }
+
 }}} // namespace Azure::Storage::Blobs
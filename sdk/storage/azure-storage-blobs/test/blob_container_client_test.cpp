@@ -3,7 +3,11 @@
 
 #include "blob_container_client_test.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <iterator>
+#include <set>
 #include <thread>
 
 #include <azure/storage/blobs/blob_lease_client.hpp>
@@ -234,6 +238,23 @@ namespace Azure { namespace Storage { namespace Test {
       }
     } while (options.ContinuationToken.HasValue());
     EXPECT_TRUE(std::includes(listBlobs.begin(), listBlobs.end(), p1Blobs.begin(), p1Blobs.end()));
+
+    options.Prefix = prefix2;
+    listBlobs.clear();
+    do
+    {
+      auto res = m_blobContainerClient->ListBlobsSinglePage(
+          [&listBlobs](Blobs::Models::BlobItem blob) {
+            EXPECT_FALSE(blob.ETag.empty());
+            listBlobs.insert(blob.Name);
+          },
+          options);
+      EXPECT_FALSE(res->RequestId.empty());
+      EXPECT_EQ(res->BlobContainerName, m_containerName);
+      EXPECT_TRUE(res->Items.empty());
+      options.ContinuationToken = res->ContinuationToken;
+    } while (options.ContinuationToken.HasValue());
+    EXPECT_EQ(listBlobs, p2Blobs);
   }
 
   TEST_F(BlobContainerClientTest, ListBlobsHierarchy)
@@ -1120,4 +1141,241 @@ namespace Azure { namespace Storage { namespace Test {
     EXPECT_THROW(blobClient.GetProperties(), StorageException);
   }
 
+  namespace {
+    std::string PercentDecode(const std::string& value)
+    {
+      std::string decoded;
+      for (std::size_t i = 0; i < value.size(); ++i)
+      {
+        if (value[i] == '%' && i + 2 < value.size())
+        {
+          decoded += static_cast<char>(std::stoi(value.substr(i + 1, 2), nullptr, 16));
+          i += 2;
+        }
+        else
+        {
+          decoded += value[i];
+        }
+      }
+      return decoded;
+    }
+
+    // Serves List Blobs requests from a set of blob names, taking a few milliseconds for each page
+    // so that pages overlap and complete in varying order.
+    class MockListBlobsPolicy : public Core::Http::HttpPolicy {
+    public:
+      struct State
+      {
+        std::set<std::string> BlobNames;
+        // Prefixes answered with 403 Forbidden.
+        std::set<std::string> FailingPrefixes;
+        std::atomic<int> Requests{0};
+        std::atomic<int> Running{0};
+        std::atomic<int> MaxRunning{0};
+      };
+
+      explicit MockListBlobsPolicy(std::shared_ptr<State> state) : m_state(std::move(state)) {}
+
+      std::unique_ptr<HttpPolicy> Clone() const override
+      {
+        return std::make_unique<MockListBlobsPolicy>(*this);
+      }
+
+      std::unique_ptr<Core::Http::RawResponse> Send(
+          Core::Context const& context,
+          Core::Http::Request& request,
+          Core::Http::NextHttpPolicy nextHttpPolicy) const override
+      {
+        unused(context, nextHttpPolicy);
+
+        auto query = request.GetUrl().GetQueryParameters();
+        const std::string prefix = PercentDecode(query["prefix"]);
+        const std::string delimiter = PercentDecode(query["delimiter"]);
+        const std::string marker = PercentDecode(query["marker"]);
+        const std::size_t maxResults
+            = query["maxresults"].empty() ? 5000 : std::stoul(query["maxresults"]);
+
+        const int requestNumber = ++m_state->Requests;
+        auto running = ++m_state->Running;
+        for (auto max = m_state->MaxRunning.load(); max < running;)
+        {
+          m_state->MaxRunning.compare_exchange_weak(max, running);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(requestNumber * 7 % 5 + 1));
+        --m_state->Running;
+
+        auto response = std::make_unique<Core::Http::RawResponse>(
+            1, 1, Core::Http::HttpStatusCode::Ok, "OK");
+        response->AddHeader("x-ms-request-id", Core::Uuid::CreateUuid().GetUuidString());
+        response->AddHeader("x-ms-version", Blobs::Details::ApiVersion);
+        if (m_state->FailingPrefixes.count(prefix) != 0)
+        {
+          response = std::make_unique<Core::Http::RawResponse>(
+              1, 1, Core::Http::HttpStatusCode::Forbidden, "Forbidden");
+          response->AddHeader("x-ms-request-id", Core::Uuid::CreateUuid().GetUuidString());
+          return response;
+        }
+
+        // Blobs right under the prefix, and the prefixes under it, in lexicographical order.
+        std::set<std::pair<std::string, bool>> entries;
+        for (auto i = m_state->BlobNames.lower_bound(prefix);
+             i != m_state->BlobNames.end() && i->compare(0, prefix.size(), prefix) == 0;
+             ++i)
+        {
+          auto delimiterPos = delimiter.empty() ? std::string::npos
+                                                : i->find(delimiter, prefix.size());
+          if (delimiterPos == std::string::npos)
+          {
+            entries.emplace(*i, false);
+          }
+          else
+          {
+            entries.emplace(i->substr(0, delimiterPos + delimiter.size()), true);
+          }
+        }
+
+        std::string body = "<?xml version=\"1.0\" encoding=\"utf-8\"?><EnumerationResults "
+                           "ServiceEndpoint=\"https://account.blob.core.windows.net/\" "
+                           "ContainerName=\"container\"><Prefix>"
+            + prefix + "</Prefix><Delimiter>" + delimiter + "</Delimiter><Blobs>";
+        std::size_t count = 0;
+        std::string nextMarker;
+        for (const auto& entry : entries)
+        {
+          if (entry.first <= marker)
+          {
+            continue;
+          }
+          if (count++ == maxResults)
+          {
+            break;
+          }
+          nextMarker = entry.first;
+          if (entry.second)
+          {
+            body += "<BlobPrefix><Name>" + entry.first + "</Name></BlobPrefix>";
+          }
+          else
+          {
+            body += "<Blob><Name>" + entry.first
+                + "</Name><Properties><Creation-Time>Thu, 22 Aug 2002 07:00:00 GMT</Creation-Time>"
+                  "<Last-Modified>Thu, 22 Aug 2002 07:00:00 GMT</Last-Modified><Etag>0x1</Etag>"
+                  "<Content-Length>0</Content-Length><BlobType>BlockBlob</BlobType></Properties>"
+                  "</Blob>";
+          }
+        }
+        body += "</Blobs><NextMarker>" + (count > maxResults ? nextMarker : std::string())
+            + "</NextMarker></EnumerationResults>";
+        response->SetBody(std::vector<uint8_t>(body.begin(), body.end()));
+        response->AddHeader("content-length", std::to_string(body.size()));
+        return response;
+      }
+
+    private:
+      std::shared_ptr<State> m_state;
+    };
+  } // namespace
+
+  TEST(ListBlobsParallelTest, ListsEachBlobOnce)
+  {
+    auto state = std::make_shared<MockListBlobsPolicy::State>();
+    for (int i = 0; i < 4; ++i)
+    {
+      state->BlobNames.insert("top" + std::to_string(i));
+      for (int j = 0; j < 5; ++j)
+      {
+        state->BlobNames.insert("dir" + std::to_string(i) + "/file" + std::to_string(j));
+        for (int k = 0; k < 3; ++k)
+        {
+          state->BlobNames.insert(
+              "dir" + std::to_string(i) + "/sub" + std::to_string(j) + "/file"
+              + std::to_string(k));
+        }
+      }
+    }
+    for (int i = 0; i < 30; ++i)
+    {
+      state->BlobNames.insert("flat/file" + std::to_string(i));
+    }
+
+    Blobs::BlobClientOptions clientOptions;
+    clientOptions.PerRetryPolicies.emplace_back(std::make_unique<MockListBlobsPolicy>(state));
+    Blobs::BlobContainerClient containerClient(
+        "https://account.blob.core.windows.net/container", clientOptions);
+
+    Blobs::ListBlobsParallelOptions options;
+    options.PageSizeHint = 4;
+    options.Concurrency = 4;
+    std::vector<std::string> listedBlobs;
+    containerClient.ListBlobsParallel(
+        [&listedBlobs](Blobs::Models::BlobItem blob) { listedBlobs.push_back(blob.Name); },
+        options);
+    // Pages complete in any order, only the set of blobs listed is checked.
+    std::sort(listedBlobs.begin(), listedBlobs.end());
+    EXPECT_EQ(
+        listedBlobs, std::vector<std::string>(state->BlobNames.begin(), state->BlobNames.end()));
+    EXPECT_LE(state->MaxRunning.load(), options.Concurrency);
+    EXPECT_GT(state->MaxRunning.load(), 1);
+
+    options.Prefix = "dir2/";
+    listedBlobs.clear();
+    containerClient.ListBlobsParallel(
+        [&listedBlobs](Blobs::Models::BlobItem blob) { listedBlobs.push_back(blob.Name); },
+        options);
+    std::sort(listedBlobs.begin(), listedBlobs.end());
+    std::vector<std::string> expectedBlobs;
+    std::copy_if(
+        state->BlobNames.begin(),
+        state->BlobNames.end(),
+        std::back_inserter(expectedBlobs),
+        [](const std::string& name) { return name.compare(0, 5, "dir2/") == 0; });
+    EXPECT_EQ(listedBlobs, expectedBlobs);
+  }
+
+  TEST(ListBlobsParallelTest, FirstErrorRethrown)
+  {
+    auto state = std::make_shared<MockListBlobsPolicy::State>();
+    for (int i = 0; i < 10; ++i)
+    {
+      state->BlobNames.insert("dir" + std::to_string(i) + "/file");
+    }
+    state->FailingPrefixes.insert("dir5/");
+
+    Blobs::BlobClientOptions clientOptions;
+    clientOptions.PerRetryPolicies.emplace_back(std::make_unique<MockListBlobsPolicy>(state));
+    Blobs::BlobContainerClient containerClient(
+        "https://account.blob.core.windows.net/container", clientOptions);
+
+    EXPECT_THROW(
+        containerClient.ListBlobsParallel([](Blobs::Models::BlobItem) {}), StorageException);
+  }
+
+  TEST(ListBlobsParallelTest, RunningListingsStopAfterError)
+  {
+    auto state = std::make_shared<MockListBlobsPolicy::State>();
+    state->BlobNames.insert("failing/file");
+    state->FailingPrefixes.insert("failing/");
+    for (int i = 0; i < 100; ++i)
+    {
+      state->BlobNames.insert("large/file" + std::to_string(i));
+    }
+
+    Blobs::BlobClientOptions clientOptions;
+    clientOptions.PerRetryPolicies.emplace_back(std::make_unique<MockListBlobsPolicy>(state));
+    Blobs::BlobContainerClient containerClient(
+        "https://account.blob.core.windows.net/container", clientOptions);
+
+    // One page per blob, the listing of large/ runs when the listing of failing/ fails.
+    Blobs::ListBlobsParallelOptions options;
+    options.PageSizeHint = 1;
+    options.Concurrency = 2;
+    std::atomic<int> listedBlobs{0};
+    EXPECT_THROW(
+        containerClient.ListBlobsParallel(
+            [&listedBlobs](Blobs::Models::BlobItem) { ++listedBlobs; }, options),
+        StorageException);
+    EXPECT_LT(state->Requests.load(), 50);
+    EXPECT_LT(listedBlobs.load(), 50);
+  }
+
 }}} // namespace Azure::Storage::Test
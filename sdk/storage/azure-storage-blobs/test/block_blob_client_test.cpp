@@ -3,7 +3,9 @@
 
 #include "block_blob_client_test.hpp"
 
+#include <atomic>
 #include <future>
+#include <memory>
 #include <random>
 #include <vector>
 
@@ -761,6 +763,294 @@ namespace Azure { namespace Storage { namespace Test {
     }
   }
 
+  TEST_F(BlockBlobClientTest, AutoTunedTransfer)
+  {
+    std::vector<uint8_t> blobContent = RandomBuffer(static_cast<std::size_t>(8_MB + 123));
+    auto blockBlobClient = m_blobContainerClient->GetBlockBlobClient(RandomString());
+
+    Azure::Storage::Blobs::UploadBlockBlobFromOptions uploadOptions;
+    uploadOptions.ChunkSize = 2_MB;
+    uploadOptions.Concurrency = 4;
+    uploadOptions.AutoTune = true;
+    blockBlobClient.UploadFrom(blobContent.data(), blobContent.size(), uploadOptions);
+    auto blockList = blockBlobClient.GetBlockList();
+    for (auto const& block : blockList->CommittedBlocks)
+    {
+      EXPECT_LE(block.Size, static_cast<int64_t>(2_MB));
+    }
+
+    Azure::Storage::Blobs::DownloadBlobToOptions downloadOptions;
+    downloadOptions.InitialChunkSize = 1_MB;
+    downloadOptions.ChunkSize = 2_MB;
+    downloadOptions.Concurrency = 4;
+    downloadOptions.AutoTune = true;
+    std::vector<uint8_t> downloadContent(blobContent.size(), '\x00');
+    auto res = blockBlobClient.DownloadTo(
+        downloadContent.data(), downloadContent.size(), downloadOptions);
+    EXPECT_EQ(res->ContentLength, static_cast<int64_t>(blobContent.size()));
+    EXPECT_EQ(downloadContent, blobContent);
+  }
+
+  TEST_F(BlockBlobClientTest, TransferWithCrc64Validation)
+  {
+    std::vector<uint8_t> blobContent = RandomBuffer(static_cast<std::size_t>(10_MB + 123));
+    auto blobContentCrc64 = Crc64::Hash(blobContent.data(), blobContent.size());
+    auto blockBlobClient = m_blobContainerClient->GetBlockBlobClient(RandomString());
+
+    Azure::Storage::Blobs::UploadBlockBlobFromOptions uploadOptions;
+    uploadOptions.ChunkSize = 1_MB;
+    uploadOptions.ValidateCrc64 = true;
+    auto uploadRes
+        = blockBlobClient.UploadFrom(blobContent.data(), blobContent.size(), uploadOptions);
+    EXPECT_EQ(uploadRes->TransactionalContentHash.GetValue().Algorithm, HashAlgorithm::Crc64);
+    EXPECT_EQ(uploadRes->TransactionalContentHash.GetValue().Value, blobContentCrc64);
+
+    // Chunks are capped to the largest range the service sends the hash of.
+    Azure::Storage::Blobs::DownloadBlobToOptions downloadOptions;
+    downloadOptions.InitialChunkSize = 8_MB;
+    downloadOptions.ChunkSize = 8_MB;
+    downloadOptions.ValidateCrc64 = true;
+    std::vector<uint8_t> downloadContent(blobContent.size(), '\x00');
+    auto downloadRes = blockBlobClient.DownloadTo(
+        downloadContent.data(), downloadContent.size(), downloadOptions);
+    EXPECT_EQ(downloadContent, blobContent);
+    EXPECT_EQ(downloadRes->TransactionalContentHash.GetValue().Algorithm, HashAlgorithm::Crc64);
+    EXPECT_EQ(downloadRes->TransactionalContentHash.GetValue().Value, blobContentCrc64);
+
+    std::string tempFilename = RandomString();
+    downloadRes = blockBlobClient.DownloadTo(tempFilename, downloadOptions);
+    EXPECT_EQ(downloadRes->TransactionalContentHash.GetValue().Value, blobContentCrc64);
+    uploadRes = blockBlobClient.UploadFrom(tempFilename, uploadOptions);
+    EXPECT_EQ(uploadRes->TransactionalContentHash.GetValue().Value, blobContentCrc64);
+    DeleteFile(tempFilename);
+  }
+
+  TEST_F(BlockBlobClientTest, UploadWithMd5Validation)
+  {
+    std::vector<uint8_t> blobContent = RandomBuffer(static_cast<std::size_t>(10_MB + 123));
+    auto blockBlobClient = m_blobContainerClient->GetBlockBlobClient(RandomString());
+
+    // Eleven blocks, a full group of eight hashed at once and a partial one.
+    Azure::Storage::Blobs::UploadBlockBlobFromOptions uploadOptions;
+    uploadOptions.ChunkSize = 1_MB;
+    uploadOptions.Concurrency = 4;
+    uploadOptions.ValidateMd5 = true;
+    blockBlobClient.UploadFrom(blobContent.data(), blobContent.size(), uploadOptions);
+    EXPECT_EQ(ReadBodyStream(blockBlobClient.Download()->BodyStream), blobContent);
+
+    std::string tempFilename = RandomString();
+    blockBlobClient.DownloadTo(tempFilename);
+    blockBlobClient.UploadFrom(tempFilename, uploadOptions);
+    EXPECT_EQ(ReadBodyStream(blockBlobClient.Download()->BodyStream), blobContent);
+    uploadOptions.MemoryMapFile = true;
+    blockBlobClient.UploadFrom(tempFilename, uploadOptions);
+    EXPECT_EQ(ReadBodyStream(blockBlobClient.Download()->BodyStream), blobContent);
+    DeleteFile(tempFilename);
+  }
+
+  TEST_F(BlockBlobClientTest, DownloadToFileWithDirectIo)
+  {
+    std::vector<uint8_t> blobContent = RandomBuffer(static_cast<std::size_t>(5_MB + 123));
+    auto blockBlobClient = m_blobContainerClient->GetBlockBlobClient(RandomString());
+    blockBlobClient.UploadFrom(blobContent.data(), blobContent.size());
+
+    Azure::Storage::Blobs::DownloadBlobToOptions options;
+    options.InitialChunkSize = 1_MB;
+    options.ChunkSize = 1_MB;
+    options.PreallocateFile = true;
+    options.UseDirectIo = true;
+    std::string tempFilename = RandomString();
+    blockBlobClient.DownloadTo(tempFilename, options);
+    EXPECT_EQ(ReadFile(tempFilename), blobContent);
+    DeleteFile(tempFilename);
+  }
+
+  TEST_F(BlockBlobClientTest, OpenRead)
+  {
+    std::vector<uint8_t> blobContent = RandomBuffer(static_cast<std::size_t>(3_MB + 123));
+    auto blockBlobClient = m_blobContainerClient->GetBlockBlobClient(RandomString());
+    blockBlobClient.UploadFrom(blobContent.data(), blobContent.size());
+
+    auto readAll = [](Azure::Core::Http::BodyStream& stream) {
+      return Azure::Core::Http::BodyStream::ReadToEnd(Azure::Core::Context(), stream);
+    };
+
+    Azure::Storage::Blobs::OpenReadBlobOptions options;
+    options.ChunkSize = 512_KB;
+    options.Concurrency = 3;
+    auto stream = blockBlobClient.OpenRead(options);
+    EXPECT_EQ(stream->Length(), static_cast<int64_t>(blobContent.size()));
+    EXPECT_EQ(readAll(*stream), blobContent);
+
+    options.Range = Azure::Core::Http::Range();
+    options.Range.GetValue().Offset = 1_MB + 1;
+    options.Range.GetValue().Length = 1_MB + 2;
+    stream = blockBlobClient.OpenRead(options);
+    EXPECT_EQ(
+        readAll(*stream),
+        std::vector<uint8_t>(
+            blobContent.begin() + static_cast<std::ptrdiff_t>(1_MB + 1),
+            blobContent.begin() + static_cast<std::ptrdiff_t>(2_MB + 3)));
+
+    auto emptyBlobClient = m_blobContainerClient->GetBlockBlobClient(RandomString());
+    emptyBlobClient.UploadFrom(blobContent.data(), 0);
+    EXPECT_TRUE(readAll(*emptyBlobClient.OpenRead()).empty());
+  }
+
+  TEST_F(BlockBlobClientTest, OpenWrite)
+  {
+    std::vector<uint8_t> blobContent = RandomBuffer(static_cast<std::size_t>(3_MB + 123));
+
+    auto testOpenWrite = [&](std::size_t blobSize, std::size_t writeSize) {
+      auto blockBlobClient = m_blobContainerClient->GetBlockBlobClient(RandomString());
+      Azure::Storage::Blobs::OpenWriteBlockBlobOptions options;
+      options.ChunkSize = 1_MB;
+      options.Concurrency = 2;
+      options.Metadata = m_blobUploadOptions.Metadata;
+      auto writer = blockBlobClient.OpenWrite(options);
+      for (std::size_t offset = 0; offset < blobSize; offset += writeSize)
+      {
+        writer->Write(blobContent.data() + offset, std::min(writeSize, blobSize - offset));
+      }
+      auto res = writer->Close();
+      EXPECT_FALSE(res->ETag.empty());
+      EXPECT_THROW(writer->Write(blobContent.data(), 1), std::runtime_error);
+
+      auto properties = *blockBlobClient.GetProperties();
+      EXPECT_EQ(properties.ContentLength, static_cast<int64_t>(blobSize));
+      EXPECT_EQ(properties.Metadata, options.Metadata);
+      EXPECT_EQ(properties.ETag, res->ETag);
+      std::vector<uint8_t> downloadContent(blobSize, '\x00');
+      blockBlobClient.DownloadTo(downloadContent.data(), blobSize);
+      EXPECT_EQ(
+          downloadContent,
+          std::vector<uint8_t>(
+              blobContent.begin(), blobContent.begin() + static_cast<std::ptrdiff_t>(blobSize)));
+    };
+
+    testOpenWrite(0, 1);
+    testOpenWrite(static_cast<std::size_t>(1_MB), static_cast<std::size_t>(4_KB));
+    testOpenWrite(blobContent.size(), static_cast<std::size_t>(333_KB));
+    testOpenWrite(blobContent.size(), blobContent.size());
+
+    // The blob isn't updated by a writer destroyed before it is closed.
+    auto blockBlobClient = m_blobContainerClient->GetBlockBlobClient(RandomString());
+    {
+      Azure::Storage::Blobs::OpenWriteBlockBlobOptions options;
+      options.ChunkSize = 1_MB;
+      auto writer = blockBlobClient.OpenWrite(options);
+      writer->Write(blobContent.data(), blobContent.size());
+    }
+    EXPECT_THROW(blockBlobClient.GetProperties(), StorageException);
+  }
+
+  // Answers Stage Block requests, failing one of them with 403 Forbidden, and Commit Block List
+  // requests, counting both.
+  class MockStageBlockPolicy : public Core::Http::HttpPolicy {
+  public:
+    struct State
+    {
+      int FailingStageBlockRequest = 0;
+      std::atomic<int> StageBlockRequests{0};
+      std::atomic<int> CommitBlockListRequests{0};
+    };
+
+    explicit MockStageBlockPolicy(std::shared_ptr<State> state) : m_state(std::move(state)) {}
+
+    std::unique_ptr<HttpPolicy> Clone() const override
+    {
+      return std::make_unique<MockStageBlockPolicy>(*this);
+    }
+
+    std::unique_ptr<Core::Http::RawResponse> Send(
+        Core::Context const& context,
+        Core::Http::Request& request,
+        Core::Http::NextHttpPolicy nextHttpPolicy) const override
+    {
+      unused(context, nextHttpPolicy);
+      auto response = std::make_unique<Core::Http::RawResponse>(
+          1, 1, Core::Http::HttpStatusCode::Created, "Created");
+      if (request.GetUrl().GetQueryParameters()["comp"] == "blocklist")
+      {
+        ++m_state->CommitBlockListRequests;
+        response->AddHeader("etag", DummyETag);
+        response->AddHeader("last-modified", "Thu, 01 Oct 2020 00:00:00 GMT");
+      }
+      else if (++m_state->StageBlockRequests == m_state->FailingStageBlockRequest)
+      {
+        response = std::make_unique<Core::Http::RawResponse>(
+            1, 1, Core::Http::HttpStatusCode::Forbidden, "Forbidden");
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      response->AddHeader("x-ms-request-id", Core::Uuid::CreateUuid().GetUuidString());
+      response->AddHeader("x-ms-request-server-encrypted", "true");
+      return response;
+    }
+
+  private:
+    std::shared_ptr<State> m_state;
+  };
+
+  TEST(BlockBlobWriterTest, FirstStagingErrorRethrown)
+  {
+    auto state = std::make_shared<MockStageBlockPolicy::State>();
+    state->FailingStageBlockRequest = 3;
+    Blobs::BlobClientOptions clientOptions;
+    clientOptions.PerRetryPolicies.emplace_back(std::make_unique<MockStageBlockPolicy>(state));
+    Blobs::BlockBlobClient blockBlobClient(
+        "https://account.blob.core.windows.net/container/blob", clientOptions);
+
+    Blobs::OpenWriteBlockBlobOptions options;
+    options.ChunkSize = 1024;
+    options.Concurrency = 2;
+    auto writer = blockBlobClient.OpenWrite(options);
+    std::vector<uint8_t> block(1024);
+    int blocksWritten = 0;
+    EXPECT_THROW(
+        {
+          for (; blocksWritten < 1000; ++blocksWritten)
+          {
+            writer->Write(block.data(), block.size());
+          }
+        },
+        StorageException);
+    // Staging stops soon after the failed block.
+    EXPECT_LT(blocksWritten, 10);
+    EXPECT_LE(state->StageBlockRequests.load(), blocksWritten);
+
+    // The writer keeps throwing the same error, and doesn't commit the blob.
+    EXPECT_THROW(writer->Write(block.data(), block.size()), StorageException);
+    EXPECT_THROW(writer->Close(), StorageException);
+    EXPECT_THROW(writer->Close(), StorageException);
+    writer.reset();
+    EXPECT_EQ(state->CommitBlockListRequests.load(), 0);
+  }
+
+  TEST(BlockBlobWriterTest, WriteWithoutFreePoolThreads)
+  {
+    // No pool thread can stage the blocks, the writer stages them while it waits.
+    TransferPoolThreadsBlocker blocker;
+    auto state = std::make_shared<MockStageBlockPolicy::State>();
+    Blobs::BlobClientOptions clientOptions;
+    clientOptions.PerRetryPolicies.emplace_back(std::make_unique<MockStageBlockPolicy>(state));
+    Blobs::BlockBlobClient blockBlobClient(
+        "https://account.blob.core.windows.net/container/blob", clientOptions);
+
+    Blobs::OpenWriteBlockBlobOptions options;
+    options.ChunkSize = 1024;
+    options.Concurrency = 2;
+    auto writer = blockBlobClient.OpenWrite(options);
+    std::vector<uint8_t> block(1024);
+    for (int i = 0; i < 8; ++i)
+    {
+      writer->Write(block.data(), block.size());
+    }
+    writer->Write(block.data(), 100);
+    writer->Close();
+    EXPECT_EQ(state->StageBlockRequests.load(), 9);
+    EXPECT_EQ(state->CommitBlockListRequests.load(), 1);
+  }
+
   TEST_F(BlockBlobClientTest, DownloadError)
   {
     auto blockBlobClient = Azure::Storage::Blobs::BlockBlobClient::CreateFromConnectionString(
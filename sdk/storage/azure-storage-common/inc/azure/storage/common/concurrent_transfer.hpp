@@ -5,69 +5,295 @@
 
 #include <algorithm>
 #include <atomic>
-#include <cstdlib>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <functional>
-#include <future>
-#include <stdexcept>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 namespace Azure { namespace Storage { namespace Details {
 
-  inline void ConcurrentTransfer(
+  constexpr static size_t DefaultMaxTransferThreads = 64;
+  // Bounds and starting point of the chunk size of auto-tuned transfers.
+  constexpr static int64_t DefaultAutoTuneMinChunkSize = 1 * 1024 * 1024;
+  constexpr static int64_t DefaultAutoTuneInitialChunkSize = 4 * 1024 * 1024;
+  constexpr static int64_t DefaultAutoTuneMaxChunkSize = 64 * 1024 * 1024;
+  // Auto-tuned chunks are grown when they take less than half this time and shrunk when they take
+  // more than twice this time.
+  constexpr static int64_t AutoTuneTargetChunkMilliseconds = 2000;
+
+  /**
+   * @brief Work the #TransferScheduler runs on the calling thread and hands to pool threads one
+   * piece at a time, like the chunks of a transfer or the tasks of a queue.
+   */
+  class ScheduledJob : public std::enable_shared_from_this<ScheduledJob> {
+  public:
+    virtual ~ScheduledJob() = default;
+
+    /**
+     * @brief Whether a piece of work threw. Pieces not started yet are skipped after it.
+     */
+    bool IsFailed() const { return m_failed; }
+
+  protected:
+    ScheduledJob() = default;
+
+    // Records the first error, rethrown once the job is done.
+    void Fail(std::exception_ptr error)
+    {
+      if (!m_failed.exchange(true))
+      {
+        m_error = std::move(error);
+      }
+    }
+
+  private:
+    friend class TransferScheduler;
+
+    // Whether a pool thread joining the job would find a piece of work to run.
+    virtual bool HasWorkLeft() const = 0;
+    // Max number of pool threads working on the job at the same time.
+    virtual size_t GetMaxPoolThreads() const = 0;
+    // Runs one piece of work on a pool thread.
+    virtual void RunOnPoolThread() = 0;
+    // Runs pieces of work on the thread calling TransferScheduler::Run, until all are done.
+    virtual void RunOnCallingThread() = 0;
+
+    std::atomic<bool> m_failed{false};
+    std::exception_ptr m_error;
+
+    // Guarded by the scheduler mutex.
+    size_t m_poolThreads = 0;
+    bool m_queued = false;
+    bool m_finished = false;
+    std::condition_variable m_poolThreadsDone;
+  };
+
+  /**
+   * @brief Process-wide pool of threads running the chunks of all concurrent transfers.
+   *
+   * @remark A transfer with a concurrency of N runs its chunks on the calling thread and on up
+   * to N - 1 pool threads. Pool threads take turns between the transfers one chunk at a time, so
+   * a large transfer doesn't hold back the ones started after it. Threads are started when they
+   * are needed, up to a limit for the whole process, and are kept until the application ends.
+   *
+   * @remark The scheduler is leaked together with its threads, which are never joined, so
+   * nothing waits for them while static objects are destroyed or a DLL is unloaded.
+   */
+  class TransferScheduler {
+  public:
+    static TransferScheduler& GetInstance();
+
+    /**
+     * @brief Set the max number of threads in the pool. Threads already started are kept.
+     *
+     * @remark With `0`, jobs only run on the threads waiting for them.
+     */
+    void SetMaxThreads(size_t maxThreads);
+
+    size_t GetThreadCount();
+
+    /**
+     * @brief Run \p job on the calling thread and on pool threads, and return once all its
+     * work is done.
+     *
+     * @remark Rethrows the first exception thrown by the job. Work not started yet is skipped
+     * after a failure.
+     */
+    void Run(std::shared_ptr<ScheduledJob> job);
+
+    /**
+     * @brief Let one more pool thread join \p job, if it has work left and room for one, after
+     * work was added to it or its max number of pool threads grew.
+     */
+    void Reschedule(std::shared_ptr<ScheduledJob> job);
+
+    /**
+     * @brief Stop pool threads from joining \p job, and wait for the ones working on it.
+     */
+    void Finish(std::shared_ptr<ScheduledJob> const& job);
+
+  private:
+    TransferScheduler() = default;
+
+    // Called with m_mutex held. Queues the job if it can take one more pool thread.
+    void Schedule(std::shared_ptr<ScheduledJob> job, bool wakeUpThread);
+    void WorkerThread();
+
+    std::mutex m_mutex;
+    std::condition_variable m_jobsChanged;
+    // Jobs which can take one more pool thread, in the order they get one.
+    std::deque<std::shared_ptr<ScheduledJob>> m_jobs;
+    std::vector<std::thread> m_threads;
+    size_t m_idleThreads = 0;
+    size_t m_maxThreads = DefaultMaxTransferThreads;
+  };
+
+  /**
+   * @brief Picks the chunk size and the number of chunks in flight of an auto-tuned transfer from
+   * the throughput of the chunks done so far.
+   *
+   * @remark The chunk size is doubled while chunks take much less than
+   * #AutoTuneTargetChunkMilliseconds, so per-request overhead doesn't dominate, and halved when
+   * they take much longer, so a retried chunk doesn't cost much.
+   *
+   * @remark The number of chunks in flight follows additive increase, multiplicative decrease.
+   * After every round of chunks, one chunk per slot, it is increased by one if the throughput of
+   * the round improved over the previous one, and halved if it dropped by a quarter or more. A
+   * chunk four times slower per byte than the fastest one so far, typically because it was retried
+   * after the service throttled it, halves it right away.
+   */
+  class TransferTuner {
+  public:
+    TransferTuner(
+        int64_t minChunkSize,
+        int64_t initialChunkSize,
+        int64_t maxChunkSize,
+        int maxConcurrency);
+
+    int64_t GetChunkSize() const { return m_chunkSize; }
+    int GetConcurrency() const { return m_concurrency; }
+
+    /**
+     * @brief Record a chunk of \p chunkLength bytes which ran from \p start to \p end.
+     */
+    void OnChunkDone(
+        int64_t chunkLength,
+        std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end);
+
+  private:
+    int64_t const m_minChunkSize;
+    int64_t const m_maxChunkSize;
+    int const m_maxConcurrency;
+    std::atomic<int64_t> m_chunkSize;
+    std::atomic<int> m_concurrency;
+
+    std::mutex m_mutex;
+    // Chunks done in the current round.
+    int m_roundChunks = 0;
+    int64_t m_roundBytes = 0;
+    std::chrono::steady_clock::time_point m_roundStart;
+    std::chrono::steady_clock::time_point m_roundEnd;
+    // Bytes per second of the previous round, and of the fastest chunk.
+    double m_lastRoundThroughput = 0;
+    double m_bestChunkThroughput = 0;
+  };
+
+  class TaskQueueJob;
+
+  /**
+   * @brief Queue of tasks run by the #TransferScheduler on the thread calling #Run and on up to
+   * a number of pool threads, for work which isn't known upfront, like walking a hierarchy.
+   *
+   * @remark Tasks may push more tasks while they run. #Run returns once the queue is empty and no
+   * task is running anymore, and rethrows the first exception thrown by a task. Tasks not started
+   * yet are skipped after a failure, and tasks still running can stop early by checking
+   * #IsFailed.
+   *
+   * @remark The queue can also be started with #Start instead, for work done in the background
+   * while the calling thread goes on. Its tasks then run on pool threads, and the queue is
+   * stopped by #Stop or when it is destroyed. A thread waiting for the tasks calls #TryRunTask, so
+   * they complete even when all the pool threads are busy or the pool has no thread.
+   */
+  class ConcurrentTaskQueue {
+  public:
+    /**
+     * @param concurrency Max number of tasks running at the same time.
+     */
+    explicit ConcurrentTaskQueue(int concurrency);
+
+    ~ConcurrentTaskQueue();
+
+    ConcurrentTaskQueue(ConcurrentTaskQueue const&) = delete;
+    ConcurrentTaskQueue& operator=(ConcurrentTaskQueue const&) = delete;
+
+    /**
+     * @brief Add a task. Can be called from any thread, including from tasks.
+     */
+    void Push(std::function<void()> task);
+
+    void Run();
+
+    /**
+     * @brief Run the tasks on pool threads only, and return right away.
+     */
+    void Start();
+
+    /**
+     * @brief Run the oldest task not started yet on the calling thread, if there is one.
+     *
+     * @remark Errors thrown by the task are handled the same way as on pool threads.
+     *
+     * @return `true` if a task was run.
+     */
+    bool TryRunTask();
+
+    /**
+     * @brief Skip the tasks not started yet, and wait for the ones running. Errors thrown by tasks
+     * are not rethrown.
+     */
+    void Stop();
+
+    /**
+     * @brief Whether a task threw. Can be called from any thread, including from tasks.
+     */
+    bool IsFailed() const;
+
+  private:
+    std::shared_ptr<TaskQueueJob> m_job;
+    int const m_concurrency;
+    // Pool threads only join once the queue runs, tasks pushed before wait for it.
+    std::atomic<bool> m_running{false};
+    bool m_started = false;
+  };
+
+  void ConcurrentTransfer(
       int64_t offset,
       int64_t length,
       int64_t chunkSize,
       int concurrency,
       // offset, length, chunk id, number of chunks
-      std::function<void(int64_t, int64_t, int64_t, int64_t)> transferFunc)
-  {
-    std::atomic<int> numWorkingThreads{concurrency};
-    std::atomic<int> nextChunkId{0};
-    std::atomic<bool> failed{false};
+      std::function<void(int64_t, int64_t, int64_t, int64_t)> transferFunc);
 
-    const auto numChunks = (length + chunkSize - 1) / chunkSize;
-
-    auto threadFunc = [&]() {
-      while (true)
-      {
-        int chunkId = nextChunkId.fetch_add(1);
-        if (chunkId >= numChunks || failed)
-        {
-          break;
-        }
-        int64_t chunkOffset = offset + chunkSize * chunkId;
-        int64_t chunkLength = std::min(length - chunkSize * chunkId, chunkSize);
-        try
-        {
-          transferFunc(chunkOffset, chunkLength, chunkId, numChunks);
-        }
-        catch (std::exception&)
-        {
-          if (failed.exchange(true) == false)
-          {
-            numWorkingThreads.fetch_sub(1);
-            throw;
-          }
-        }
-      }
-      numWorkingThreads.fetch_sub(1);
-    };
-
-    std::vector<std::future<void>> threadHandles;
-    for (int i = 0; i < concurrency - 1; ++i)
-    {
-      threadHandles.emplace_back(std::async(std::launch::async, threadFunc));
-    }
-    threadFunc();
-    for (auto& handle : threadHandles)
-    {
-      handle.get();
-    }
+  /**
+   * @brief Same as #ConcurrentTransfer, with the chunk size and the number of chunks in flight
+   * picked by a #TransferTuner while the transfer runs.
+   *
+   * @remark Chunks are still handed out in order of offset, with consecutive ids. The number of
+   * chunks is only known once the last chunk is started, \p transferFunc gets `-1` as the number of
+   * chunks for the other ones.
+   */
+  void AutoTunedConcurrentTransfer(
+      int64_t offset,
+      int64_t length,
+      int64_t minChunkSize,
+      int64_t maxChunkSize,
+      int maxConcurrency,
+      // offset, length, chunk id, number of chunks or -1
+      std::function<void(int64_t, int64_t, int64_t, int64_t)> transferFunc);
 
-    if (numWorkingThreads != 0)
-    {
-      std::abort();
-    }
-  }
+  /**
+   * @brief Runs a transfer with #ConcurrentTransfer in chunks of \p chunkSize or, when
+   * \p autoTune is `true`, with #AutoTunedConcurrentTransfer.
+   *
+   * @remark Auto-tuned chunks are no larger than \p maxChunkSize, and no smaller than the larger
+   * of \p minChunkSize and #DefaultAutoTuneMinChunkSize, capped by \p maxChunkSize.
+   */
+  void ConcurrentTransfer(
+      int64_t offset,
+      int64_t length,
+      int64_t chunkSize,
+      int concurrency,
+      bool autoTune,
+      int64_t minChunkSize,
+      int64_t maxChunkSize,
+      // offset, length, chunk id, number of chunks or -1 when auto-tuned
+      std::function<void(int64_t, int64_t, int64_t, int64_t)> transferFunc);
 
 }}} // namespace Azure::Storage::Details
@@ -4,10 +4,16 @@
 #pragma once
 
 #include <cstdint>
+#include <map>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <azure/core/base64.hpp>
+#include <azure/core/nullable.hpp>
+
+#include "azure/storage/common/storage_common.hpp"
 
 namespace Azure { namespace Storage {
 
@@ -65,7 +71,115 @@ namespace Azure { namespace Storage {
     std::vector<uint8_t> HmacSha256(
         const std::vector<uint8_t>& data,
         const std::vector<uint8_t>& key);
+
+    /**
+     * @brief Computes HMAC-SHA256 with the same key over and over.
+     *
+     * @remark The hash state after the inner and outer padded keys is computed once, when
+     * constructed, so signing only hashes the data. Sign can be called from many threads at the
+     * same time.
+     */
+    class HmacSha256Signer {
+    public:
+      explicit HmacSha256Signer(const std::vector<uint8_t>& key);
+      ~HmacSha256Signer();
+
+      HmacSha256Signer(const HmacSha256Signer&) = delete;
+      HmacSha256Signer& operator=(const HmacSha256Signer&) = delete;
+
+      std::vector<uint8_t> Sign(const uint8_t* data, std::size_t length) const;
+
+      std::vector<uint8_t> Sign(const std::string& data) const
+      {
+        return Sign(reinterpret_cast<const uint8_t*>(data.data()), data.length());
+      }
+
+    private:
+      void* m_context;
+    };
+
     std::string UrlEncodeQueryParameter(const std::string& value);
     std::string UrlEncodePath(const std::string& value);
+
+    /**
+     * @brief Computes the MD5 of several buffers, typically the blocks of a transfer.
+     *
+     * @remark On CPUs with AVX2, eight buffers are hashed at once, one per 32-bit lane. It takes
+     * about as long as hashing the longest of them alone. Otherwise the buffers are hashed one
+     * after the other with #Md5.
+     *
+     * @param buffers Pointer and length of each buffer.
+     * @return The MD5 of each buffer, in the same order.
+     */
+    std::vector<std::vector<uint8_t>> Md5HashBatch(
+        const std::vector<std::pair<const uint8_t*, std::size_t>>& buffers);
+
+    /**
+     * @brief Implementations of the CRC64 computation.
+     */
+    enum class Crc64Kernel
+    {
+      /**
+       * @brief Slicing tables, on any CPU.
+       */
+      Table,
+
+      /**
+       * @brief Carry-less multiplication of 128-bit registers, with PCLMULQDQ.
+       */
+      Clmul,
+
+      /**
+       * @brief Carry-less multiplication of 512-bit registers, with AVX-512 and VPCLMULQDQ.
+       */
+      Vpclmul,
+    };
+
+    /**
+     * @brief The fastest CRC64 implementation the CPU supports, used by Crc64::Update. The
+     * implementations before it in #Crc64Kernel are supported as well.
+     */
+    Crc64Kernel GetCrc64Kernel();
+
+    /**
+     * @brief Update \p crc64, the CRC64 of the content so far, with \p data, using \p kernel.
+     *
+     * @return The CRC64 of the content followed by \p data.
+     */
+    uint64_t Crc64Update(
+        Crc64Kernel kernel,
+        uint64_t crc64,
+        const uint8_t* data,
+        std::size_t length);
+
+    /**
+     * @brief Combines the CRC64 of the chunks of a parallel transfer, computed in any order, into
+     * the CRC64 of the whole content, without going over the content again.
+     */
+    class TransferCrc64 {
+    public:
+      /**
+       * @brief Record the CRC64 of a chunk. Can be called from many threads at the same time.
+       */
+      void AddChunk(int64_t chunkId, const Crc64& chunkCrc64);
+
+      /**
+       * @brief The CRC64 of the chunks added, concatenated in order of chunk id.
+       */
+      Crc64 Combine();
+
+    private:
+      std::mutex m_mutex;
+      std::map<int64_t, Crc64> m_chunks;
+    };
+
+    /**
+     * @brief Check \p crc64, computed over the content of a request or a response, against the
+     * transactional hash the service sent for it.
+     *
+     * @throw Azure::Core::RequestFailedException if \p serviceHash doesn't match, or isn't a
+     * CRC64.
+     */
+    void VerifyCrc64(const Crc64& crc64, const Azure::Core::Nullable<ContentHash>& serviceHash);
   } // namespace Details
 }} // namespace Azure::Storage
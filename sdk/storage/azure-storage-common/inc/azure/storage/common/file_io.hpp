@@ -15,6 +15,7 @@
 #include <windows.h>
 #endif
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 
@@ -26,33 +27,98 @@ namespace Azure { namespace Storage { namespace Details {
   using FileHandle = int;
 #endif
 
+  // Alignment of the address, offset and length of writes bypassing the page cache. A multiple of
+  // the logical block size of common devices, 512 or 4096 bytes.
+  constexpr static std::size_t DirectIoAlignment = 4096;
+  // Aligned bytes of the buffers downloads are written to files from. With the bytes before the
+  // aligned ones, a buffer fits in the 4MiB size class of the buffer pool.
+  constexpr static std::size_t FileWriterBufferSize = 4 * 1024 * 1024 - DirectIoAlignment;
+
   class FileReader {
   public:
-    FileReader(const std::string& filename);
+    /**
+     * @brief Open a file for reading.
+     *
+     * @param filename Path of the file.
+     * @param memoryMapped Also map the whole file into memory, see #GetMappedData.
+     */
+    explicit FileReader(const std::string& filename, bool memoryMapped = false);
 
     ~FileReader();
 
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+
     FileHandle GetHandle() const { return m_handle; }
 
     int64_t GetFileSize() const { return m_fileSize; }
 
+    /**
+     * @brief Content of the file mapped read-only into memory, or nullptr if the reader wasn't
+     * asked to map it or the file couldn't be mapped, for example because it's empty.
+     *
+     * @remark On POSIX the mapping is advised for sequential access, so pages are read ahead
+     * aggressively and dropped soon after being read, and for transparent huge pages where the
+     * kernel supports them for files.
+     *
+     * @remark Reading the mapping after the file was truncated by another process raises SIGBUS
+     * on POSIX, where reading through the handle would fail.
+     */
+    const uint8_t* GetMappedData() const { return m_mappedData; }
+
   private:
+    void MapFile();
+
     FileHandle m_handle;
     int64_t m_fileSize;
+    const uint8_t* m_mappedData = nullptr;
+#if defined(AZ_PLATFORM_WINDOWS)
+    HANDLE m_mappingHandle = NULL;
+#endif
   };
 
   class FileWriter {
   public:
-    FileWriter(const std::string& filename);
+    /**
+     * @brief Create or truncate a file for writing.
+     *
+     * @param filename Path of the file.
+     * @param directIo Write aligned data bypassing the page cache, with O_DIRECT on Linux and
+     * FILE_FLAG_NO_BUFFERING on Windows, so large files don't evict everything else from it.
+     * Ignored where the platform or the file system doesn't support it.
+     */
+    explicit FileWriter(const std::string& filename, bool directIo = false);
 
     ~FileWriter();
 
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
     FileHandle GetHandle() const { return m_handle; }
 
+    /**
+     * @brief Write \p length bytes at \p offset. Safe to call from several threads at once.
+     *
+     * @remark With direct I/O, the part of the write starting at an address and offset aligned
+     * to #DirectIoAlignment, and spanning whole multiples of it, bypasses the page cache. The
+     * rest goes through it.
+     */
     void Write(const uint8_t* buffer, int64_t length, int64_t offset);
 
+    /**
+     * @brief Allocate the disk space of a file of \p size bytes upfront, so the writes of a
+     * parallel transfer don't leave it fragmented. Sets the size of the file on Linux.
+     *
+     * @remark Best effort, does nothing where the platform or the file system doesn't support
+     * it.
+     */
+    void Preallocate(int64_t size);
+
   private:
     FileHandle m_handle;
+    // Second handle on the file, bypassing the page cache, if m_directIo.
+    FileHandle m_directHandle;
+    bool m_directIo = false;
   };
 
 }}} // namespace Azure::Storage::Details
@@ -0,0 +1,100 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <azure/core/context.hpp>
+#include <azure/core/http/body_stream.hpp>
+
+#include "azure/storage/common/concurrent_transfer.hpp"
+
+namespace Azure { namespace Storage { namespace Details {
+
+  // Max time a read waiting for a chunk goes without checking cancellation.
+  constexpr static int ReadAheadWaitIntervalMilliseconds = 1000;
+
+  // Reads the whole range at offset, length into buffer, or throws.
+  typedef std::function<void(int64_t, int64_t, uint8_t*, Azure::Core::Context const&)>
+      RangeReader;
+
+  /**
+   * @brief Body stream reading a range of a resource in chunks, in order, while the chunks after
+   * the one being read are downloaded in parallel.
+   *
+   * @remark Chunks are downloaded by a #ConcurrentTaskQueue running in the background into a ring
+   * of `concurrency + 1` buffers, which are re-used once read. The download of a chunk is only
+   * queued once its buffer was read, so memory use is bounded whatever the size of the range, and
+   * pool threads never wait for the reader.
+   *
+   * @remark Destroying the stream cancels the chunks being downloaded.
+   */
+  class ReadAheadBodyStream : public Azure::Core::Http::BodyStream {
+  public:
+    /**
+     * @brief Start downloading the range ahead of the reads.
+     *
+     * @param context #Azure::Core::Context used to download the chunks.
+     * @param firstChunk Bytes at the start of the range which were already downloaded.
+     * @param offset Offset of the range, including \p firstChunk.
+     * @param length Length of the range, including \p firstChunk.
+     * @param chunkSize Size of the chunks after \p firstChunk.
+     * @param concurrency Max number of chunks downloaded at the same time.
+     * @param rangeReader Called to download each chunk.
+     */
+    ReadAheadBodyStream(
+        Azure::Core::Context const& context,
+        std::vector<uint8_t> firstChunk,
+        int64_t offset,
+        int64_t length,
+        int64_t chunkSize,
+        int concurrency,
+        RangeReader rangeReader);
+
+    ~ReadAheadBodyStream() override;
+
+    ReadAheadBodyStream(ReadAheadBodyStream const&) = delete;
+    ReadAheadBodyStream& operator=(ReadAheadBodyStream const&) = delete;
+
+    int64_t Length() const override { return m_length; }
+
+  private:
+    struct ChunkBuffer
+    {
+      std::vector<uint8_t> Data;
+      // The chunk this buffer holds, or is waiting for.
+      int64_t ChunkId;
+      bool Ready = false;
+    };
+
+    int64_t OnRead(Azure::Core::Context const& context, uint8_t* buffer, int64_t count) override;
+
+    // Runs on the pool threads.
+    void DownloadChunk(int64_t chunkId);
+
+    Azure::Core::Context m_context;
+    std::vector<uint8_t> m_firstChunk;
+    int64_t const m_offset;
+    int64_t const m_length;
+    int64_t const m_chunkSize;
+    int64_t m_numChunks = 0;
+    RangeReader m_rangeReader;
+    // Bytes of the range read so far.
+    int64_t m_position = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_chunksChanged;
+    std::vector<ChunkBuffer> m_buffers;
+    std::exception_ptr m_error;
+    bool m_cancelled = false;
+    std::unique_ptr<ConcurrentTaskQueue> m_downloads;
+  };
+
+}}} // namespace Azure::Storage::Details
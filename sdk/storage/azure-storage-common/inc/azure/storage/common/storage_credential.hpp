@@ -20,7 +20,8 @@ namespace Azure { namespace Storage {
 
   namespace Details {
     class SharedKeyPolicy;
-  }
+    class HmacSha256Signer;
+  } // namespace Details
 
   /**
    * @brief A StorageSharedKeyCredential is a credential backed by a storage account's name and
@@ -50,6 +51,7 @@ namespace Azure { namespace Storage {
     {
       std::lock_guard<std::mutex> guard(m_mutex);
       m_accountKey = std::move(accountKey);
+      m_signer.reset();
     }
 
     /**
@@ -69,8 +71,12 @@ namespace Azure { namespace Storage {
       return m_accountKey;
     }
 
+    // Signer keyed with the account key, created on first use and kept until the key changes.
+    std::shared_ptr<Details::HmacSha256Signer> GetSigner() const;
+
     mutable std::mutex m_mutex;
     std::string m_accountKey;
+    mutable std::shared_ptr<Details::HmacSha256Signer> m_signer;
   };
 
   namespace Details {
@@ -4,8 +4,12 @@
 #pragma once
 
 #include <cstdint>
+#include <exception>
 #include <string>
 
+#include <azure/core/context.hpp>
+#include <azure/core/http/body_stream.hpp>
+
 namespace Azure { namespace Storage { namespace Details {
 
   enum class XmlNodeType
@@ -32,13 +36,31 @@ namespace Azure { namespace Storage { namespace Details {
   class XmlReader {
   public:
     explicit XmlReader(const char* data, std::size_t length);
+
+    /**
+     * @brief Parse a document while it is read from \p stream, a chunk at a time, instead of from
+     * a buffer holding all of it.
+     *
+     * @remark The stream and the context must outlive the reader. An exception thrown by the
+     * stream is thrown again by #Read.
+     */
+    explicit XmlReader(Azure::Core::Http::BodyStream& stream, const Azure::Core::Context& context);
+
     ~XmlReader();
 
+    /**
+     * @brief Read the next node. Its name and value are valid until the next call.
+     */
     XmlNode Read();
 
   private:
+    static int ReadStream(void* reader, char* buffer, int length);
+
     void* m_reader = nullptr;
     bool m_readingAttributes = false;
+    Azure::Core::Http::BodyStream* m_stream = nullptr;
+    const Azure::Core::Context* m_context = nullptr;
+    std::exception_ptr m_streamException;
   };
 
   class XmlWriter {
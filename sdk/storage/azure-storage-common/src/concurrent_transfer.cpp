@@ -0,0 +1,525 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// SPDX-License-Identifier: MIT
+
+#include "azure/storage/common/concurrent_transfer.hpp"
+
+#include <atomic>
+#include <exception>
+#include <system_error>
+
+namespace Azure { namespace Storage { namespace Details {
+
+  // Chunks of a range, of a fixed size or picked by a tuner as the transfer goes.
+  class TransferJob final : public ScheduledJob {
+  public:
+    int64_t Offset;
+    int64_t Length;
+    int64_t ChunkSize;
+    int64_t NumChunks;
+    // offset, length, chunk id, number of chunks
+    std::function<void(int64_t, int64_t, int64_t, int64_t)> TransferFunc;
+    size_t MaxPoolThreads;
+    // Set for auto-tuned transfers, which pick the size of each chunk and the number of pool
+    // threads as they go, instead of ChunkSize, NumChunks and MaxPoolThreads.
+    std::unique_ptr<TransferTuner> Tuner;
+
+    std::atomic<int64_t> NextChunkId{0};
+    // Auto-tuned transfers only. Updated with TunedChunkMutex held.
+    std::atomic<int64_t> NextOffset{0};
+
+  private:
+    std::mutex TunedChunkMutex;
+
+    bool HasWorkLeft() const override
+    {
+      if (IsFailed())
+      {
+        return false;
+      }
+      return Tuner ? NextOffset < Offset + Length : NextChunkId < NumChunks;
+    }
+
+    size_t GetMaxPoolThreads() const override
+    {
+      return Tuner ? static_cast<size_t>(Tuner->GetConcurrency() - 1) : MaxPoolThreads;
+    }
+
+    void RunOnPoolThread() override { RunChunk(); }
+
+    void RunOnCallingThread() override
+    {
+      while (RunChunk())
+      {
+        if (Tuner)
+        {
+          // The tuner may have made room for one more pool thread.
+          TransferScheduler::GetInstance().Reschedule(shared_from_this());
+        }
+      }
+    }
+
+    bool NextChunk(int64_t& chunkOffset, int64_t& chunkLength, int64_t& chunkId, int64_t& numChunks)
+    {
+      if (!Tuner)
+      {
+        chunkId = NextChunkId.fetch_add(1);
+        if (chunkId >= NumChunks)
+        {
+          return false;
+        }
+        chunkOffset = Offset + ChunkSize * chunkId;
+        chunkLength = std::min(Length - ChunkSize * chunkId, ChunkSize);
+        numChunks = NumChunks;
+        return true;
+      }
+
+      std::lock_guard<std::mutex> guard(TunedChunkMutex);
+      chunkOffset = NextOffset;
+      if (chunkOffset >= Offset + Length)
+      {
+        return false;
+      }
+      chunkLength = std::min(Offset + Length - chunkOffset, Tuner->GetChunkSize());
+      chunkId = NextChunkId++;
+      numChunks = chunkOffset + chunkLength == Offset + Length ? chunkId + 1 : -1;
+      NextOffset = chunkOffset + chunkLength;
+      return true;
+    }
+
+    // Returns false once there is no chunk left to run.
+    bool RunChunk()
+    {
+      if (IsFailed())
+      {
+        return false;
+      }
+      int64_t chunkOffset;
+      int64_t chunkLength;
+      int64_t chunkId;
+      int64_t numChunks;
+      if (!NextChunk(chunkOffset, chunkLength, chunkId, numChunks))
+      {
+        return false;
+      }
+      try
+      {
+        auto const start = std::chrono::steady_clock::now();
+        TransferFunc(chunkOffset, chunkLength, chunkId, numChunks);
+        if (Tuner)
+        {
+          Tuner->OnChunkDone(chunkLength, start, std::chrono::steady_clock::now());
+        }
+      }
+      catch (...)
+      {
+        Fail(std::current_exception());
+        return false;
+      }
+      return true;
+    }
+  };
+
+  // Tasks pushed while the queue runs.
+  class TaskQueueJob final : public ScheduledJob {
+  public:
+    explicit TaskQueueJob(size_t maxPoolThreads) : m_maxPoolThreads(maxPoolThreads) {}
+
+    void Push(std::function<void()> task)
+    {
+      {
+        std::lock_guard<std::mutex> guard(m_tasksMutex);
+        m_tasks.push_back(std::move(task));
+        ++m_queuedTasks;
+      }
+      m_tasksChanged.notify_all();
+    }
+
+    // Drops the tasks not started yet.
+    void Clear()
+    {
+      std::lock_guard<std::mutex> guard(m_tasksMutex);
+      m_tasks.clear();
+      m_queuedTasks = 0;
+    }
+
+    bool HasMaxPoolThreads() const { return m_maxPoolThreads > 0; }
+
+    void SetMaxPoolThreads(size_t maxPoolThreads) { m_maxPoolThreads = maxPoolThreads; }
+
+    // Runs the oldest task queued. Returns false if there was none.
+    bool TryRunTask()
+    {
+      std::function<void()> task;
+      {
+        std::lock_guard<std::mutex> guard(m_tasksMutex);
+        if (IsFailed() || m_tasks.empty())
+        {
+          return false;
+        }
+        task = std::move(m_tasks.front());
+        m_tasks.pop_front();
+        --m_queuedTasks;
+        ++m_runningTasks;
+      }
+      try
+      {
+        task();
+      }
+      catch (...)
+      {
+        Fail(std::current_exception());
+      }
+      {
+        std::lock_guard<std::mutex> guard(m_tasksMutex);
+        --m_runningTasks;
+      }
+      m_tasksChanged.notify_all();
+      return true;
+    }
+
+  private:
+    std::atomic<size_t> m_maxPoolThreads;
+    std::deque<std::function<void()>> m_tasks;
+    std::atomic<size_t> m_queuedTasks{0};
+    size_t m_runningTasks = 0;
+    std::mutex m_tasksMutex;
+    // Signaled when a task is pushed or done.
+    std::condition_variable m_tasksChanged;
+
+    bool HasWorkLeft() const override { return !IsFailed() && m_queuedTasks > 0; }
+
+    size_t GetMaxPoolThreads() const override { return m_maxPoolThreads; }
+
+    void RunOnCallingThread() override
+    {
+      while (RunTask())
+      {
+      }
+      // Tasks still running may push more tasks.
+      std::unique_lock<std::mutex> lock(m_tasksMutex);
+      while (!IsFailed() && (!m_tasks.empty() || m_runningTasks > 0))
+      {
+        if (m_tasks.empty())
+        {
+          m_tasksChanged.wait(lock);
+          continue;
+        }
+        lock.unlock();
+        RunTask();
+        lock.lock();
+      }
+    }
+
+    // Returns false once there is no task queued.
+    bool RunTask() { return TryRunTask() && !IsFailed(); }
+
+    void RunOnPoolThread() override { RunTask(); }
+  };
+
+  TransferTuner::TransferTuner(
+      int64_t minChunkSize,
+      int64_t initialChunkSize,
+      int64_t maxChunkSize,
+      int maxConcurrency)
+      : m_minChunkSize(minChunkSize), m_maxChunkSize(std::max(maxChunkSize, minChunkSize)),
+        m_maxConcurrency(std::max(maxConcurrency, 1)),
+        m_chunkSize(std::min(std::max(initialChunkSize, minChunkSize), m_maxChunkSize)),
+        m_concurrency(std::min(2, m_maxConcurrency))
+  {
+  }
+
+  void TransferTuner::OnChunkDone(
+      int64_t chunkLength,
+      std::chrono::steady_clock::time_point start,
+      std::chrono::steady_clock::time_point end)
+  {
+    constexpr std::chrono::milliseconds TargetChunkDuration(AutoTuneTargetChunkMilliseconds);
+    // Rounds shorter than this are not timed precisely enough to compare them.
+    constexpr std::chrono::milliseconds MinRoundDuration(1);
+
+    auto const chunkDuration = std::max<std::chrono::steady_clock::duration>(
+        end - start, std::chrono::microseconds(1));
+    double const chunkThroughput = static_cast<double>(chunkLength)
+        / std::chrono::duration<double>(chunkDuration).count();
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    // Only full size chunks tell whether the chunk size is right, the last one may be smaller.
+    if (chunkLength >= m_chunkSize)
+    {
+      if (chunkDuration < TargetChunkDuration / 2)
+      {
+        m_chunkSize = std::min(m_chunkSize * 2, m_maxChunkSize);
+      }
+      else if (chunkDuration > TargetChunkDuration * 2)
+      {
+        m_chunkSize = std::max(m_chunkSize / 2, m_minChunkSize);
+      }
+    }
+
+    // Small chunks are dominated by per-request overhead, their throughput says little.
+    if (chunkLength >= m_minChunkSize)
+    {
+      if (m_bestChunkThroughput > 0 && chunkThroughput * 4 < m_bestChunkThroughput)
+      {
+        m_concurrency = std::max(m_concurrency / 2, 1);
+        m_roundChunks = 0;
+        m_lastRoundThroughput = 0;
+        return;
+      }
+      m_bestChunkThroughput = std::max(m_bestChunkThroughput, chunkThroughput);
+    }
+
+    if (m_roundChunks == 0)
+    {
+      m_roundStart = start;
+      m_roundEnd = end;
+      m_roundBytes = 0;
+    }
+    m_roundStart = std::min(m_roundStart, start);
+    m_roundEnd = std::max(m_roundEnd, end);
+    m_roundBytes += chunkLength;
+    if (++m_roundChunks < m_concurrency)
+    {
+      return;
+    }
+
+    auto const roundDuration = std::max<std::chrono::steady_clock::duration>(
+        m_roundEnd - m_roundStart, MinRoundDuration);
+    double const roundThroughput
+        = static_cast<double>(m_roundBytes) / std::chrono::duration<double>(roundDuration).count();
+    if (roundThroughput > m_lastRoundThroughput * 1.05)
+    {
+      m_concurrency = std::min(m_concurrency + 1, m_maxConcurrency);
+    }
+    else if (roundThroughput < m_lastRoundThroughput * 0.75)
+    {
+      m_concurrency = std::max(m_concurrency / 2, 1);
+    }
+    m_lastRoundThroughput = roundThroughput;
+    m_roundChunks = 0;
+  }
+
+  TransferScheduler& TransferScheduler::GetInstance()
+  {
+    static TransferScheduler* instance = new TransferScheduler();
+    return *instance;
+  }
+
+  void TransferScheduler::SetMaxThreads(size_t maxThreads)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxThreads = maxThreads;
+  }
+
+  size_t TransferScheduler::GetThreadCount()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_threads.size();
+  }
+
+  void TransferScheduler::Schedule(std::shared_ptr<ScheduledJob> job, bool wakeUpThread)
+  {
+    if (job->m_queued || job->m_finished || job->m_poolThreads >= job->GetMaxPoolThreads()
+        || !job->HasWorkLeft())
+    {
+      return;
+    }
+    job->m_queued = true;
+    m_jobs.push_back(std::move(job));
+    if (!wakeUpThread)
+    {
+      return;
+    }
+
+    if (m_idleThreads > 0)
+    {
+      m_jobsChanged.notify_one();
+    }
+    else if (m_threads.size() < m_maxThreads)
+    {
+      try
+      {
+        m_threads.emplace_back([this]() { WorkerThread(); });
+      }
+      catch (std::system_error const&)
+      {
+        // Keep going with the threads already started. The caller of Run(), or the thread
+        // waiting for the tasks of a started queue, works on the job in any case.
+      }
+    }
+  }
+
+  void TransferScheduler::WorkerThread()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+      if (m_jobs.empty())
+      {
+        ++m_idleThreads;
+        m_jobsChanged.wait(lock);
+        --m_idleThreads;
+        continue;
+      }
+
+      auto job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+      job->m_queued = false;
+      ++job->m_poolThreads;
+      // Let another pool thread join the job while this one runs a piece of it.
+      Schedule(job, true);
+
+      lock.unlock();
+      job->RunOnPoolThread();
+      lock.lock();
+
+      --job->m_poolThreads;
+      if (job->m_poolThreads == 0)
+      {
+        job->m_poolThreadsDone.notify_all();
+      }
+      // Back at the end of the line, after the jobs waiting for a thread. This thread picks the
+      // next one.
+      Schedule(std::move(job), false);
+    }
+  }
+
+  void TransferScheduler::Run(std::shared_ptr<ScheduledJob> job)
+  {
+    Reschedule(job);
+
+    // The calling thread works on the job too, so it completes even when all the pool threads are
+    // busy, including with the job that started this one.
+    job->RunOnCallingThread();
+    Finish(job);
+
+    if (job->m_error)
+    {
+      std::rethrow_exception(job->m_error);
+    }
+  }
+
+  void TransferScheduler::Reschedule(std::shared_ptr<ScheduledJob> job)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Schedule(std::move(job), true);
+  }
+
+  void TransferScheduler::Finish(std::shared_ptr<ScheduledJob> const& job)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    job->m_finished = true;
+    if (job->m_queued)
+    {
+      m_jobs.erase(std::find(m_jobs.begin(), m_jobs.end(), job));
+      job->m_queued = false;
+    }
+    job->m_poolThreadsDone.wait(lock, [&job]() { return job->m_poolThreads == 0; });
+  }
+
+  ConcurrentTaskQueue::ConcurrentTaskQueue(int concurrency)
+      : m_job(std::make_shared<TaskQueueJob>(
+          concurrency > 1 ? static_cast<size_t>(concurrency - 1) : 0)),
+        m_concurrency(std::max(concurrency, 1))
+  {
+  }
+
+  ConcurrentTaskQueue::~ConcurrentTaskQueue()
+  {
+    if (m_started)
+    {
+      Stop();
+    }
+  }
+
+  void ConcurrentTaskQueue::Push(std::function<void()> task)
+  {
+    m_job->Push(std::move(task));
+    if (m_running && m_job->HasMaxPoolThreads())
+    {
+      TransferScheduler::GetInstance().Reschedule(m_job);
+    }
+  }
+
+  void ConcurrentTaskQueue::Run()
+  {
+    m_running = true;
+    TransferScheduler::GetInstance().Run(m_job);
+  }
+
+  void ConcurrentTaskQueue::Start()
+  {
+    // No calling thread works on the queue, pool threads run all the tasks.
+    m_job->SetMaxPoolThreads(static_cast<size_t>(m_concurrency));
+    m_started = true;
+    m_running = true;
+    TransferScheduler::GetInstance().Reschedule(m_job);
+  }
+
+  bool ConcurrentTaskQueue::TryRunTask() { return m_job->TryRunTask(); }
+
+  void ConcurrentTaskQueue::Stop()
+  {
+    m_job->Clear();
+    TransferScheduler::GetInstance().Finish(m_job);
+  }
+
+  bool ConcurrentTaskQueue::IsFailed() const { return m_job->IsFailed(); }
+
+  void ConcurrentTransfer(
+      int64_t offset,
+      int64_t length,
+      int64_t chunkSize,
+      int concurrency,
+      std::function<void(int64_t, int64_t, int64_t, int64_t)> transferFunc)
+  {
+    auto job = std::make_shared<TransferJob>();
+    job->Offset = offset;
+    job->Length = length;
+    job->ChunkSize = chunkSize;
+    job->NumChunks = (length + chunkSize - 1) / chunkSize;
+    job->TransferFunc = std::move(transferFunc);
+    job->MaxPoolThreads = concurrency > 1 ? static_cast<size_t>(concurrency - 1) : 0;
+    TransferScheduler::GetInstance().Run(std::move(job));
+  }
+
+  void AutoTunedConcurrentTransfer(
+      int64_t offset,
+      int64_t length,
+      int64_t minChunkSize,
+      int64_t maxChunkSize,
+      int maxConcurrency,
+      std::function<void(int64_t, int64_t, int64_t, int64_t)> transferFunc)
+  {
+    auto job = std::make_shared<TransferJob>();
+    job->Offset = offset;
+    job->Length = length;
+    job->NextOffset = offset;
+    job->TransferFunc = std::move(transferFunc);
+    job->Tuner = std::make_unique<TransferTuner>(
+        minChunkSize, DefaultAutoTuneInitialChunkSize, maxChunkSize, maxConcurrency);
+    TransferScheduler::GetInstance().Run(std::move(job));
+  }
+
+  void ConcurrentTransfer(
+      int64_t offset,
+      int64_t length,
+      int64_t chunkSize,
+      int concurrency,
+      bool autoTune,
+      int64_t minChunkSize,
+      int64_t maxChunkSize,
+      std::function<void(int64_t, int64_t, int64_t, int64_t)> transferFunc)
+  {
+    if (!autoTune)
+    {
+      ConcurrentTransfer(offset, length, chunkSize, concurrency, std::move(transferFunc));
+      return;
+    }
+    minChunkSize = std::max(std::min(DefaultAutoTuneMinChunkSize, maxChunkSize), minChunkSize);
+    AutoTunedConcurrentTransfer(
+        offset, length, minChunkSize, maxChunkSize, concurrency, std::move(transferFunc));
+  }
+
+}}} // namespace Azure::Storage::Details
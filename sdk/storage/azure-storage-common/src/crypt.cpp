@@ -16,16 +16,44 @@
 #elif defined(AZ_PLATFORM_POSIX)
 #include <openssl/bio.h>
 #include <openssl/buffer.h>
+#include <openssl/crypto.h>
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
 #include <openssl/md5.h>
 #include <openssl/sha.h>
 #endif
 
+// SIMD kernels of Crc64 and of the MD5 of several buffers, picked at runtime from what the CPU
+// supports.
+#if defined(__x86_64__) || defined(_M_X64)
+#define AZ_STORAGE_CRC64_CLMUL
+#define AZ_STORAGE_MD5_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AZ_STORAGE_TARGET_CLMUL
+#define AZ_STORAGE_TARGET_VPCLMUL
+#define AZ_STORAGE_TARGET_AVX2
+#if _MSC_VER >= 1920
+#define AZ_STORAGE_CRC64_VPCLMUL
+#endif
+#else
+#include <cpuid.h>
+#define AZ_STORAGE_TARGET_CLMUL __attribute__((target("pclmul")))
+#define AZ_STORAGE_TARGET_VPCLMUL __attribute__((target("pclmul,avx512f,vpclmulqdq")))
+#define AZ_STORAGE_TARGET_AVX2 __attribute__((target("avx2")))
+#if (defined(__clang__) && __clang_major__ >= 6) || (!defined(__clang__) && __GNUC__ >= 8)
+#define AZ_STORAGE_CRC64_VPCLMUL
+#endif
+#endif
+#endif
+
 #include <algorithm>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 
+#include <azure/core/exception.hpp>
 #include <azure/core/http/http.hpp>
 
 #include "azure/storage/common/storage_common.hpp"
@@ -247,6 +275,86 @@ namespace Azure { namespace Storage {
 
       return hash;
     }
+
+    struct HmacSha256SignerContext
+    {
+      std::string Buffer;
+      BCRYPT_HASH_HANDLE HashHandle = nullptr;
+      std::size_t ContextSize = 0;
+      std::size_t HashLength = 0;
+    };
+
+    HmacSha256Signer::HmacSha256Signer(const std::vector<uint8_t>& key)
+    {
+      static AlgorithmProviderInstance AlgorithmProvider(AlgorithmType::HmacSha256);
+
+      auto context = std::make_unique<HmacSha256SignerContext>();
+      context->ContextSize = AlgorithmProvider.ContextSize;
+      context->HashLength = AlgorithmProvider.HashLength;
+      context->Buffer.resize(context->ContextSize);
+      NTSTATUS status = BCryptCreateHash(
+          AlgorithmProvider.Handle,
+          &context->HashHandle,
+          reinterpret_cast<PUCHAR>(&context->Buffer[0]),
+          static_cast<ULONG>(context->Buffer.size()),
+          reinterpret_cast<PUCHAR>(const_cast<uint8_t*>(key.data())),
+          static_cast<ULONG>(key.size()),
+          0);
+      if (!BCRYPT_SUCCESS(status))
+      {
+        throw std::runtime_error("BCryptCreateHash failed");
+      }
+      m_context = context.release();
+    }
+
+    HmacSha256Signer::~HmacSha256Signer()
+    {
+      HmacSha256SignerContext* context = static_cast<HmacSha256SignerContext*>(m_context);
+      BCryptDestroyHash(context->HashHandle);
+      delete context;
+    }
+
+    std::vector<uint8_t> HmacSha256Signer::Sign(const uint8_t* data, std::size_t length) const
+    {
+      HmacSha256SignerContext* context = static_cast<HmacSha256SignerContext*>(m_context);
+
+      // The keyed hash is never finished, each signature starts from a copy of it.
+      std::string buffer;
+      buffer.resize(context->ContextSize);
+      BCRYPT_HASH_HANDLE hashHandle;
+      NTSTATUS status = BCryptDuplicateHash(
+          context->HashHandle,
+          &hashHandle,
+          reinterpret_cast<PUCHAR>(&buffer[0]),
+          static_cast<ULONG>(buffer.size()),
+          0);
+      if (!BCRYPT_SUCCESS(status))
+      {
+        throw std::runtime_error("BCryptDuplicateHash failed");
+      }
+
+      status = BCryptHashData(
+          hashHandle,
+          reinterpret_cast<PBYTE>(const_cast<uint8_t*>(data)),
+          static_cast<ULONG>(length),
+          0);
+      if (!BCRYPT_SUCCESS(status))
+      {
+        BCryptDestroyHash(hashHandle);
+        throw std::runtime_error("BCryptHashData failed");
+      }
+
+      std::vector<uint8_t> hash;
+      hash.resize(context->HashLength);
+      status = BCryptFinishHash(
+          hashHandle, reinterpret_cast<PUCHAR>(&hash[0]), static_cast<ULONG>(hash.size()), 0);
+      BCryptDestroyHash(hashHandle);
+      if (!BCRYPT_SUCCESS(status))
+      {
+        throw std::runtime_error("BCryptFinishHash failed");
+      }
+      return hash;
+    }
   } // namespace Details
 
   struct Md5HashContext
@@ -350,6 +458,100 @@ namespace Azure { namespace Storage {
       return std::vector<uint8_t>(std::begin(hash), std::begin(hash) + hashLength);
     }
 
+    struct HmacSha256SignerContext
+    {
+      // Digests of the inner and the outer padded key, copied for each signature.
+      EVP_MD_CTX* Inner = nullptr;
+      EVP_MD_CTX* Outer = nullptr;
+
+      ~HmacSha256SignerContext()
+      {
+        EVP_MD_CTX_free(Inner);
+        EVP_MD_CTX_free(Outer);
+      }
+    };
+
+    namespace {
+      struct EvpMdCtxDeleter
+      {
+        void operator()(EVP_MD_CTX* context) const { EVP_MD_CTX_free(context); }
+      };
+
+      EVP_MD_CTX* NewPaddedKeyDigest(const uint8_t* keyBlock, uint8_t padByte)
+      {
+        uint8_t pad[SHA256_CBLOCK];
+        for (std::size_t i = 0; i < sizeof(pad); ++i)
+        {
+          pad[i] = keyBlock[i] ^ padByte;
+        }
+        std::unique_ptr<EVP_MD_CTX, EvpMdCtxDeleter> context(EVP_MD_CTX_new());
+        const bool succeeded = context
+            && EVP_DigestInit_ex(context.get(), EVP_sha256(), nullptr) == 1
+            && EVP_DigestUpdate(context.get(), pad, sizeof(pad)) == 1;
+        OPENSSL_cleanse(pad, sizeof(pad));
+        if (!succeeded)
+        {
+          throw std::runtime_error("failed to initialize the HMAC-SHA256 key");
+        }
+        return context.release();
+      }
+    } // namespace
+
+    HmacSha256Signer::HmacSha256Signer(const std::vector<uint8_t>& key)
+    {
+      // Keys longer than a block are hashed first, as per RFC 2104.
+      uint8_t keyBlock[SHA256_CBLOCK] = {};
+      if (key.size() > sizeof(keyBlock))
+      {
+        if (EVP_Digest(key.data(), key.size(), keyBlock, nullptr, EVP_sha256(), nullptr) != 1)
+        {
+          throw std::runtime_error("failed to hash the HMAC-SHA256 key");
+        }
+      }
+      else
+      {
+        std::copy(key.begin(), key.end(), keyBlock);
+      }
+
+      std::unique_ptr<HmacSha256SignerContext> context(new HmacSha256SignerContext);
+      try
+      {
+        context->Inner = NewPaddedKeyDigest(keyBlock, 0x36);
+        context->Outer = NewPaddedKeyDigest(keyBlock, 0x5c);
+      }
+      catch (...)
+      {
+        OPENSSL_cleanse(keyBlock, sizeof(keyBlock));
+        throw;
+      }
+      OPENSSL_cleanse(keyBlock, sizeof(keyBlock));
+      m_context = context.release();
+    }
+
+    HmacSha256Signer::~HmacSha256Signer()
+    {
+      delete static_cast<HmacSha256SignerContext*>(m_context);
+    }
+
+    std::vector<uint8_t> HmacSha256Signer::Sign(const uint8_t* data, std::size_t length) const
+    {
+      const HmacSha256SignerContext* context
+          = static_cast<const HmacSha256SignerContext*>(m_context);
+
+      unsigned char hash[SHA256_DIGEST_LENGTH];
+      std::unique_ptr<EVP_MD_CTX, EvpMdCtxDeleter> sha256Context(EVP_MD_CTX_new());
+      if (!sha256Context || EVP_MD_CTX_copy_ex(sha256Context.get(), context->Inner) != 1
+          || EVP_DigestUpdate(sha256Context.get(), data, length) != 1
+          || EVP_DigestFinal_ex(sha256Context.get(), hash, nullptr) != 1
+          || EVP_MD_CTX_copy_ex(sha256Context.get(), context->Outer) != 1
+          || EVP_DigestUpdate(sha256Context.get(), hash, sizeof(hash)) != 1
+          || EVP_DigestFinal_ex(sha256Context.get(), hash, nullptr) != 1)
+      {
+        throw std::runtime_error("failed to compute the HMAC-SHA256");
+      }
+      return std::vector<uint8_t>(std::begin(hash), std::end(hash));
+    }
+
   } // namespace Details
 
   Md5::Md5()
@@ -1012,11 +1214,9 @@ namespace Azure { namespace Storage {
     return vr[0] ^ vr[1];
   }
 
-  void Crc64::Update(const uint8_t* data, std::size_t length)
+  static uint64_t Crc64UpdateTable(uint64_t crc64, const uint8_t* data, std::size_t length)
   {
-    m_length += length;
-
-    uint64_t uCrc = m_context ^ ~0ULL;
+    uint64_t uCrc = crc64 ^ ~0ULL;
 
     uint64_t pData = 0;
 
@@ -1157,7 +1357,276 @@ namespace Azure { namespace Storage {
     {
       uCrc = (uCrc >> 8) ^ Crc64MU1[(uCrc ^ data[pData]) & 0xff];
     }
-    m_context = uCrc ^ ~0ULL;
+    return uCrc ^ ~0ULL;
+  }
+
+#if defined(AZ_STORAGE_CRC64_CLMUL)
+  /*
+   * Carry-less multiplication kernels, folding the data 128 bits at a time as described in
+   * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" by Intel.
+   *
+   * In this bit-reflected CRC, bit i of a 128-bit block of data holds the coefficient of x^(127-i).
+   * The low half L and the high half H of a block stand for L * x^64 + H. Moving the block n bits
+   * forward, modulo P, is clmul(L, x^(n+63) mod P) ^ clmul(H, x^(n-1) mod P), as clmul of
+   * reflected values multiplies by an extra x. Once the data is folded into a single block B, the
+   * CRC is the one of the 16 bytes of B, which is left to the tables with the bytes after B.
+   */
+
+  // x^n mod P, bit-reflected.
+  static constexpr uint64_t Crc64XPowModP(int n)
+  {
+    uint64_t r = 1ULL << 63;
+    for (int i = 0; i < n; ++i)
+    {
+      r = (r >> 1) ^ ((r & 1) != 0 ? Crc64Poly : 0);
+    }
+    return r;
+  }
+
+  // Multipliers moving a block of data 128, 512, 1024 and 2048 bits forward. The first one is
+  // applied to the low half of the block, the second one to the high half.
+  static constexpr uint64_t Crc64Fold128[] = {Crc64XPowModP(128 + 63), Crc64XPowModP(128 - 1)};
+  static constexpr uint64_t Crc64Fold512[] = {Crc64XPowModP(512 + 63), Crc64XPowModP(512 - 1)};
+  static constexpr uint64_t Crc64Fold1024[]
+      = {Crc64XPowModP(1024 + 63), Crc64XPowModP(1024 - 1)};
+  static constexpr uint64_t Crc64Fold2048[]
+      = {Crc64XPowModP(2048 + 63), Crc64XPowModP(2048 - 1)};
+
+  AZ_STORAGE_TARGET_CLMUL static inline __m128i Crc64Fold(__m128i block, __m128i k, __m128i data)
+  {
+    return _mm_xor_si128(
+        _mm_xor_si128(_mm_clmulepi64_si128(block, k, 0x00), _mm_clmulepi64_si128(block, k, 0x11)),
+        data);
+  }
+
+  // Folds the whole 16-byte blocks of data into block, then computes the CRC with the tables.
+  AZ_STORAGE_TARGET_CLMUL static uint64_t
+  Crc64FinishClmul(__m128i block, const uint8_t* data, std::size_t length)
+  {
+    const __m128i k128 = _mm_set_epi64x(
+        static_cast<int64_t>(Crc64Fold128[1]), static_cast<int64_t>(Crc64Fold128[0]));
+    for (; length >= 16; data += 16, length -= 16)
+    {
+      block = Crc64Fold(block, k128, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+    }
+    uint8_t blockBytes[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(blockBytes), block);
+    // ~0ULL is the CRC of nothing, the state of the tables is 0.
+    return Crc64UpdateTable(Crc64UpdateTable(~0ULL, blockBytes, 16), data, length);
+  }
+
+  // Eight blocks in flight hide the latency of the multiplications.
+  AZ_STORAGE_TARGET_CLMUL static uint64_t
+  Crc64UpdateClmul(uint64_t crc64, const uint8_t* data, std::size_t length)
+  {
+    constexpr std::size_t Lanes = 8;
+    constexpr std::size_t Stride = Lanes * 16;
+    if (length < 2 * Stride)
+    {
+      return Crc64UpdateTable(crc64, data, length);
+    }
+
+    __m128i lanes[Lanes];
+    for (std::size_t i = 0; i < Lanes; ++i)
+    {
+      lanes[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 16));
+    }
+    // The CRC so far applies to the first 64 bits of data.
+    lanes[0] = _mm_xor_si128(lanes[0], _mm_cvtsi64_si128(static_cast<int64_t>(crc64 ^ ~0ULL)));
+    data += Stride;
+    length -= Stride;
+
+    const __m128i k1024 = _mm_set_epi64x(
+        static_cast<int64_t>(Crc64Fold1024[1]), static_cast<int64_t>(Crc64Fold1024[0]));
+    for (; length >= Stride; data += Stride, length -= Stride)
+    {
+      for (std::size_t i = 0; i < Lanes; ++i)
+      {
+        lanes[i] = Crc64Fold(
+            lanes[i], k1024, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 16)));
+      }
+    }
+
+    const __m128i k128 = _mm_set_epi64x(
+        static_cast<int64_t>(Crc64Fold128[1]), static_cast<int64_t>(Crc64Fold128[0]));
+    __m128i block = lanes[0];
+    for (std::size_t i = 1; i < Lanes; ++i)
+    {
+      block = Crc64Fold(block, k128, lanes[i]);
+    }
+    return Crc64FinishClmul(block, data, length);
+  }
+
+#if defined(AZ_STORAGE_CRC64_VPCLMUL)
+  AZ_STORAGE_TARGET_VPCLMUL static inline __m512i
+  Crc64Fold(__m512i block, __m512i k, __m512i data)
+  {
+    return _mm512_ternarylogic_epi64(
+        _mm512_clmulepi64_epi128(block, k, 0x00),
+        _mm512_clmulepi64_epi128(block, k, 0x11),
+        data,
+        0x96);
+  }
+
+  AZ_STORAGE_TARGET_VPCLMUL static inline __m512i
+  Crc64FoldMultipliers512(const uint64_t (&multipliers)[2])
+  {
+    const auto low = static_cast<int64_t>(multipliers[0]);
+    const auto high = static_cast<int64_t>(multipliers[1]);
+    return _mm512_set_epi64(high, low, high, low, high, low, high, low);
+  }
+
+  // Four 512-bit registers, each folding four blocks at a time.
+  AZ_STORAGE_TARGET_VPCLMUL static uint64_t
+  Crc64UpdateVpclmul(uint64_t crc64, const uint8_t* data, std::size_t length)
+  {
+    constexpr std::size_t Lanes = 4;
+    constexpr std::size_t Stride = Lanes * 64;
+    if (length < 4 * Stride)
+    {
+      return Crc64UpdateClmul(crc64, data, length);
+    }
+
+    __m512i lanes[Lanes];
+    for (std::size_t i = 0; i < Lanes; ++i)
+    {
+      lanes[i] = _mm512_loadu_si512(data + i * 64);
+    }
+    lanes[0] = _mm512_xor_si512(
+        lanes[0], _mm512_set_epi64(0, 0, 0, 0, 0, 0, 0, static_cast<int64_t>(crc64 ^ ~0ULL)));
+    data += Stride;
+    length -= Stride;
+
+    const __m512i k2048 = Crc64FoldMultipliers512(Crc64Fold2048);
+    for (; length >= Stride; data += Stride, length -= Stride)
+    {
+      for (std::size_t i = 0; i < Lanes; ++i)
+      {
+        lanes[i] = Crc64Fold(lanes[i], k2048, _mm512_loadu_si512(data + i * 64));
+      }
+    }
+
+    const __m512i k512 = Crc64FoldMultipliers512(Crc64Fold512);
+    __m512i blocks = lanes[0];
+    for (std::size_t i = 1; i < Lanes; ++i)
+    {
+      blocks = Crc64Fold(blocks, k512, lanes[i]);
+    }
+
+    const __m128i k128 = _mm_set_epi64x(
+        static_cast<int64_t>(Crc64Fold128[1]), static_cast<int64_t>(Crc64Fold128[0]));
+    // Unpacked through memory, GCC 12 warns about _mm512_extracti32x4_epi32 with -Wall.
+    uint8_t blockBytes[64];
+    _mm512_storeu_si512(blockBytes, blocks);
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blockBytes));
+    for (std::size_t i = 1; i < 4; ++i)
+    {
+      block = Crc64Fold(
+          block, k128, _mm_loadu_si128(reinterpret_cast<const __m128i*>(blockBytes + i * 16)));
+    }
+    return Crc64FinishClmul(block, data, length);
+  }
+#endif
+
+  static void GetCpuId(int leaf, uint32_t info[4])
+  {
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuidex(regs, leaf, 0);
+    for (int i = 0; i < 4; ++i)
+    {
+      info[i] = static_cast<uint32_t>(regs[i]);
+    }
+#else
+    info[0] = info[1] = info[2] = info[3] = 0;
+    if (static_cast<unsigned int>(leaf) <= __get_cpuid_max(0, nullptr))
+    {
+      __cpuid_count(leaf, 0, info[0], info[1], info[2], info[3]);
+    }
+#endif
+  }
+
+  // Registers the OS saves on context switches.
+  static uint64_t GetEnabledXsaveFeatures()
+  {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax = 0;
+    uint32_t edx = 0;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+  }
+
+  static Details::Crc64Kernel DetectCrc64Kernel()
+  {
+    uint32_t leaf1[4];
+    GetCpuId(1, leaf1);
+    const bool pclmulqdq = (leaf1[2] & (1U << 1)) != 0;
+    const bool osxsave = (leaf1[2] & (1U << 27)) != 0;
+    if (!pclmulqdq)
+    {
+      return Details::Crc64Kernel::Table;
+    }
+#if defined(AZ_STORAGE_CRC64_VPCLMUL)
+    uint32_t leaf7[4];
+    GetCpuId(7, leaf7);
+    const bool avx512f = (leaf7[1] & (1U << 16)) != 0;
+    const bool vpclmulqdq = (leaf7[2] & (1U << 10)) != 0;
+    // XMM, YMM, opmask and the upper ZMM registers.
+    constexpr uint64_t Avx512State = 0xE6;
+    if (avx512f && vpclmulqdq && osxsave
+        && (GetEnabledXsaveFeatures() & Avx512State) == Avx512State)
+    {
+      return Details::Crc64Kernel::Vpclmul;
+    }
+#else
+    (void)osxsave;
+#endif
+    return Details::Crc64Kernel::Clmul;
+  }
+#endif
+
+  namespace Details {
+
+    Crc64Kernel GetCrc64Kernel()
+    {
+#if defined(AZ_STORAGE_CRC64_CLMUL)
+      static const Crc64Kernel kernel = DetectCrc64Kernel();
+      return kernel;
+#else
+      return Crc64Kernel::Table;
+#endif
+    }
+
+    uint64_t Crc64Update(
+        Crc64Kernel kernel,
+        uint64_t crc64,
+        const uint8_t* data,
+        std::size_t length)
+    {
+      switch (kernel)
+      {
+#if defined(AZ_STORAGE_CRC64_CLMUL)
+        case Crc64Kernel::Vpclmul:
+#if defined(AZ_STORAGE_CRC64_VPCLMUL)
+          return Crc64UpdateVpclmul(crc64, data, length);
+#endif
+        case Crc64Kernel::Clmul:
+          return Crc64UpdateClmul(crc64, data, length);
+#endif
+        default:
+          return Crc64UpdateTable(crc64, data, length);
+      }
+    }
+
+  } // namespace Details
+
+  void Crc64::Update(const uint8_t* data, std::size_t length)
+  {
+    m_length += length;
+    m_context = Details::Crc64Update(Details::GetCrc64Kernel(), m_context, data, length);
   }
 
   void Crc64::Concatenate(const Crc64& other)
@@ -1200,4 +1669,285 @@ namespace Azure { namespace Storage {
     return binary;
   }
 
+  namespace Details {
+
+    void TransferCrc64::AddChunk(int64_t chunkId, const Crc64& chunkCrc64)
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_chunks[chunkId] = chunkCrc64;
+    }
+
+    Crc64 TransferCrc64::Combine()
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      Crc64 crc64;
+      for (const auto& chunk : m_chunks)
+      {
+        crc64.Concatenate(chunk.second);
+      }
+      return crc64;
+    }
+
+    void VerifyCrc64(const Crc64& crc64, const Azure::Core::Nullable<ContentHash>& serviceHash)
+    {
+      if (!serviceHash.HasValue() || serviceHash.GetValue().Algorithm != HashAlgorithm::Crc64)
+      {
+        throw Azure::Core::RequestFailedException("the service didn't send a CRC64 to check");
+      }
+      if (serviceHash.GetValue().Value != crc64.Digest())
+      {
+        throw Azure::Core::RequestFailedException(
+            "CRC64 mismatch, expected " + Azure::Core::Base64Encode(serviceHash.GetValue().Value)
+            + ", computed " + Azure::Core::Base64Encode(crc64.Digest()));
+      }
+    }
+
+  } // namespace Details
+
+#if defined(AZ_STORAGE_MD5_AVX2)
+  /*
+   * MD5 of eight buffers at once, one per 32-bit lane of AVX2 registers. MD5 can't be
+   * parallelized within a buffer, but the same step for eight buffers is one instruction.
+   */
+
+  static constexpr uint32_t Md5K[] = {
+      0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613,
+      0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193,
+      0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d,
+      0x02441453, 0xd8a1e681, 0xe7d3fbc8, 0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+      0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122,
+      0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+      0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665, 0xf4292244,
+      0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+      0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb,
+      0xeb86d391,
+  };
+  static constexpr std::size_t Md5Lanes = 8;
+  static constexpr std::size_t Md5BlockSize = 64;
+
+  // a = b + ((a + f(b, c, d) + k[i] + w[g]) <<< s)
+  template <int S>
+  AZ_STORAGE_TARGET_AVX2 static inline __m256i
+  Md5Step(__m256i a, __m256i b, __m256i f, int i, __m256i w)
+  {
+    a = _mm256_add_epi32(
+        _mm256_add_epi32(a, f),
+        _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(Md5K[i])), w));
+    return _mm256_add_epi32(
+        b, _mm256_or_si256(_mm256_slli_epi32(a, S), _mm256_srli_epi32(a, 32 - S)));
+  }
+
+  // d ^ (b & (c ^ d))
+  AZ_STORAGE_TARGET_AVX2 static inline __m256i Md5F(__m256i b, __m256i c, __m256i d)
+  {
+    return _mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d)));
+  }
+
+  // c ^ (d & (b ^ c))
+  AZ_STORAGE_TARGET_AVX2 static inline __m256i Md5G(__m256i b, __m256i c, __m256i d)
+  {
+    return _mm256_xor_si256(c, _mm256_and_si256(d, _mm256_xor_si256(b, c)));
+  }
+
+  AZ_STORAGE_TARGET_AVX2 static inline __m256i Md5H(__m256i b, __m256i c, __m256i d)
+  {
+    return _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+  }
+
+  // c ^ (b | ~d)
+  AZ_STORAGE_TARGET_AVX2 static inline __m256i Md5I(__m256i b, __m256i c, __m256i d)
+  {
+    return _mm256_xor_si256(c, _mm256_or_si256(b, _mm256_xor_si256(d, _mm256_set1_epi32(-1))));
+  }
+
+  // Loads word i of the block of each lane in lane i of words[i], eight words at a time.
+  AZ_STORAGE_TARGET_AVX2 static inline void
+  Md5LoadTransposed(const uint8_t* const blocks[Md5Lanes], std::size_t offset, __m256i words[8])
+  {
+    __m256i r[8];
+    for (std::size_t i = 0; i < Md5Lanes; ++i)
+    {
+      r[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks[i] + offset));
+    }
+    __m256i t[8];
+    for (std::size_t i = 0; i < 8; i += 2)
+    {
+      t[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+      t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+    }
+    __m256i u[8];
+    for (std::size_t i = 0; i < 8; i += 4)
+    {
+      u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+      u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+      u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+      u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+      words[i] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+      words[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+    }
+  }
+
+  AZ_STORAGE_TARGET_AVX2 static void Md5HashAvx2(
+      const uint8_t* const* data,
+      const std::size_t* length,
+      std::size_t count,
+      std::vector<uint8_t>* hashes)
+  {
+    // Padding of each buffer: the bytes after its last whole block, 0x80, zeros and the length
+    // in bits, in one or two blocks.
+    uint8_t padding[Md5Lanes][2 * Md5BlockSize] = {};
+    static const uint8_t ZeroBlock[Md5BlockSize] = {};
+    int32_t dataBlocks[Md5Lanes] = {};
+    int32_t totalBlocks[Md5Lanes] = {};
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      const std::size_t tail = length[i] % Md5BlockSize;
+      dataBlocks[i] = static_cast<int32_t>(length[i] / Md5BlockSize);
+      std::copy(data[i] + length[i] - tail, data[i] + length[i], padding[i]);
+      padding[i][tail] = 0x80;
+      const std::size_t paddingBlocks = tail < Md5BlockSize - 8 ? 1 : 2;
+      uint64_t bitLength = static_cast<uint64_t>(length[i]) * 8;
+      for (std::size_t j = 0; j < 8; ++j)
+      {
+        padding[i][paddingBlocks * Md5BlockSize - 8 + j]
+            = static_cast<uint8_t>(bitLength >> (8 * j));
+      }
+      totalBlocks[i] = dataBlocks[i] + static_cast<int32_t>(paddingBlocks);
+    }
+
+    __m256i a = _mm256_set1_epi32(0x67452301);
+    __m256i b = _mm256_set1_epi32(static_cast<int>(0xefcdab89));
+    __m256i c = _mm256_set1_epi32(static_cast<int>(0x98badcfe));
+    __m256i d = _mm256_set1_epi32(0x10325476);
+    const __m256i laneBlocks = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(totalBlocks));
+    const int32_t maxBlocks = *std::max_element(totalBlocks, totalBlocks + Md5Lanes);
+
+    for (int32_t block = 0; block < maxBlocks; ++block)
+    {
+      // Lanes done, or not used, hash a block of zeros which is thrown away.
+      const uint8_t* blocks[Md5Lanes];
+      for (std::size_t i = 0; i < Md5Lanes; ++i)
+      {
+        if (block < dataBlocks[i])
+        {
+          blocks[i] = data[i] + static_cast<std::size_t>(block) * Md5BlockSize;
+        }
+        else if (block < totalBlocks[i])
+        {
+          blocks[i] = padding[i] + static_cast<std::size_t>(block - dataBlocks[i]) * Md5BlockSize;
+        }
+        else
+        {
+          blocks[i] = ZeroBlock;
+        }
+      }
+      __m256i w[16];
+      Md5LoadTransposed(blocks, 0, w);
+      Md5LoadTransposed(blocks, 32, w + 8);
+
+      __m256i aa = a;
+      __m256i bb = b;
+      __m256i cc = c;
+      __m256i dd = d;
+      for (int i = 0; i < 16; i += 4)
+      {
+        aa = Md5Step<7>(aa, bb, Md5F(bb, cc, dd), i, w[i]);
+        dd = Md5Step<12>(dd, aa, Md5F(aa, bb, cc), i + 1, w[i + 1]);
+        cc = Md5Step<17>(cc, dd, Md5F(dd, aa, bb), i + 2, w[i + 2]);
+        bb = Md5Step<22>(bb, cc, Md5F(cc, dd, aa), i + 3, w[i + 3]);
+      }
+      for (int i = 16; i < 32; i += 4)
+      {
+        aa = Md5Step<5>(aa, bb, Md5G(bb, cc, dd), i, w[(5 * i + 1) % 16]);
+        dd = Md5Step<9>(dd, aa, Md5G(aa, bb, cc), i + 1, w[(5 * i + 6) % 16]);
+        cc = Md5Step<14>(cc, dd, Md5G(dd, aa, bb), i + 2, w[(5 * i + 11) % 16]);
+        bb = Md5Step<20>(bb, cc, Md5G(cc, dd, aa), i + 3, w[(5 * i + 16) % 16]);
+      }
+      for (int i = 32; i < 48; i += 4)
+      {
+        aa = Md5Step<4>(aa, bb, Md5H(bb, cc, dd), i, w[(3 * i + 5) % 16]);
+        dd = Md5Step<11>(dd, aa, Md5H(aa, bb, cc), i + 1, w[(3 * i + 8) % 16]);
+        cc = Md5Step<16>(cc, dd, Md5H(dd, aa, bb), i + 2, w[(3 * i + 11) % 16]);
+        bb = Md5Step<23>(bb, cc, Md5H(cc, dd, aa), i + 3, w[(3 * i + 14) % 16]);
+      }
+      for (int i = 48; i < 64; i += 4)
+      {
+        aa = Md5Step<6>(aa, bb, Md5I(bb, cc, dd), i, w[(7 * i) % 16]);
+        dd = Md5Step<10>(dd, aa, Md5I(aa, bb, cc), i + 1, w[(7 * i + 7) % 16]);
+        cc = Md5Step<15>(cc, dd, Md5I(dd, aa, bb), i + 2, w[(7 * i + 14) % 16]);
+        bb = Md5Step<21>(bb, cc, Md5I(cc, dd, aa), i + 3, w[(7 * i + 21) % 16]);
+      }
+
+      const __m256i active = _mm256_cmpgt_epi32(laneBlocks, _mm256_set1_epi32(block));
+      a = _mm256_blendv_epi8(a, _mm256_add_epi32(a, aa), active);
+      b = _mm256_blendv_epi8(b, _mm256_add_epi32(b, bb), active);
+      c = _mm256_blendv_epi8(c, _mm256_add_epi32(c, cc), active);
+      d = _mm256_blendv_epi8(d, _mm256_add_epi32(d, dd), active);
+    }
+
+    uint32_t state[4][Md5Lanes];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(state[0]), a);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(state[1]), b);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(state[2]), c);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(state[3]), d);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      hashes[i].resize(16);
+      for (std::size_t j = 0; j < 16; ++j)
+      {
+        hashes[i][j] = static_cast<uint8_t>(state[j / 4][i] >> (8 * (j % 4)));
+      }
+    }
+  }
+
+  static bool CpuSupportsAvx2()
+  {
+    uint32_t leaf1[4];
+    GetCpuId(1, leaf1);
+    const bool osxsave = (leaf1[2] & (1U << 27)) != 0;
+    uint32_t leaf7[4];
+    GetCpuId(7, leaf7);
+    const bool avx2 = (leaf7[1] & (1U << 5)) != 0;
+    // XMM and YMM registers.
+    constexpr uint64_t AvxState = 0x6;
+    return avx2 && osxsave && (GetEnabledXsaveFeatures() & AvxState) == AvxState;
+  }
+#endif
+
+  namespace Details {
+
+    std::vector<std::vector<uint8_t>> Md5HashBatch(
+        const std::vector<std::pair<const uint8_t*, std::size_t>>& buffers)
+    {
+      std::vector<std::vector<uint8_t>> hashes(buffers.size());
+      std::size_t i = 0;
+#if defined(AZ_STORAGE_MD5_AVX2)
+      static const bool avx2 = CpuSupportsAvx2();
+      // A single buffer is faster with the scalar implementation.
+      while (avx2 && buffers.size() - i >= 2)
+      {
+        const uint8_t* data[Md5Lanes] = {};
+        std::size_t length[Md5Lanes] = {};
+        const std::size_t count = std::min(Md5Lanes, buffers.size() - i);
+        for (std::size_t j = 0; j < count; ++j)
+        {
+          data[j] = buffers[i + j].first;
+          length[j] = buffers[i + j].second;
+        }
+        Md5HashAvx2(data, length, count, &hashes[i]);
+        i += count;
+      }
+#endif
+      for (; i < buffers.size(); ++i)
+      {
+        hashes[i] = Md5::Hash(buffers[i].first, buffers[i].second);
+      }
+      return hashes;
+    }
+
+  } // namespace Details
+
 }} // namespace Azure::Storage
@@ -7,6 +7,7 @@
 
 #if defined(AZ_PLATFORM_POSIX)
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -20,7 +21,7 @@
 namespace Azure { namespace Storage { namespace Details {
 
 #if defined(AZ_PLATFORM_WINDOWS)
-  FileReader::FileReader(const std::string& filename)
+  FileReader::FileReader(const std::string& filename, bool memoryMapped)
   {
 #if !defined(WINAPI_PARTITION_DESKTOP) \
     || WINAPI_PARTITION_DESKTOP // See azure/core/platform.hpp for explanation.
@@ -53,11 +54,46 @@ namespace Azure { namespace Storage { namespace Details {
       throw std::runtime_error("failed to get size of file");
     }
     m_fileSize = fileSize.QuadPart;
+
+    if (memoryMapped)
+    {
+      MapFile();
+    }
+  }
+
+  FileReader::~FileReader()
+  {
+    if (m_mappedData)
+    {
+      UnmapViewOfFile(m_mappedData);
+    }
+    if (m_mappingHandle)
+    {
+      CloseHandle(m_mappingHandle);
+    }
+    CloseHandle(m_handle);
   }
 
-  FileReader::~FileReader() { CloseHandle(m_handle); }
+  void FileReader::MapFile()
+  {
+    if (m_fileSize == 0
+        || static_cast<uint64_t>(m_fileSize) > std::numeric_limits<SIZE_T>::max())
+    {
+      return;
+    }
+#if !defined(WINAPI_PARTITION_DESKTOP) \
+    || WINAPI_PARTITION_DESKTOP // See azure/core/platform.hpp for explanation.
+    m_mappingHandle = CreateFileMapping(m_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mappingHandle)
+    {
+      return;
+    }
+    m_mappedData
+        = static_cast<const uint8_t*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#endif
+  }
 
-  FileWriter::FileWriter(const std::string& filename)
+  FileWriter::FileWriter(const std::string& filename, bool directIo)
   {
 #if !defined(WINAPI_PARTITION_DESKTOP) \
     || WINAPI_PARTITION_DESKTOP // See azure/core/platform.hpp for explanation.
@@ -81,11 +117,44 @@ namespace Azure { namespace Storage { namespace Details {
     {
       throw std::runtime_error("failed to open file");
     }
+
+#if !defined(WINAPI_PARTITION_DESKTOP) \
+    || WINAPI_PARTITION_DESKTOP // See azure/core/platform.hpp for explanation.
+    if (directIo)
+    {
+      m_directHandle = CreateFile(
+          filename.data(),
+          GENERIC_WRITE,
+          FILE_SHARE_READ | FILE_SHARE_WRITE,
+          nullptr,
+          OPEN_EXISTING,
+          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING,
+          NULL);
+      m_directIo = m_directHandle != INVALID_HANDLE_VALUE;
+    }
+#else
+    (void)directIo;
+#endif
+  }
+
+  FileWriter::~FileWriter()
+  {
+    if (m_directIo)
+    {
+      CloseHandle(m_directHandle);
+    }
+    CloseHandle(m_handle);
   }
 
-  FileWriter::~FileWriter() { CloseHandle(m_handle); }
+  void FileWriter::Preallocate(int64_t size)
+  {
+    FILE_ALLOCATION_INFO allocationInfo;
+    allocationInfo.AllocationSize.QuadPart = size;
+    SetFileInformationByHandle(
+        m_handle, FileAllocationInfo, &allocationInfo, sizeof(allocationInfo));
+  }
 
-  void FileWriter::Write(const uint8_t* buffer, int64_t length, int64_t offset)
+  static void WriteAt(HANDLE handle, const uint8_t* buffer, int64_t length, int64_t offset)
   {
     if (length > std::numeric_limits<DWORD>::max())
     {
@@ -98,14 +167,14 @@ namespace Azure { namespace Storage { namespace Details {
     overlapped.OffsetHigh = static_cast<DWORD>(static_cast<uint64_t>(offset) >> 32);
 
     DWORD bytesWritten;
-    BOOL ret = WriteFile(m_handle, buffer, static_cast<DWORD>(length), &bytesWritten, &overlapped);
+    BOOL ret = WriteFile(handle, buffer, static_cast<DWORD>(length), &bytesWritten, &overlapped);
     if (!ret)
     {
       throw std::runtime_error("failed to write file");
     }
   }
 #elif defined(AZ_PLATFORM_POSIX)
-  FileReader::FileReader(const std::string& filename)
+  FileReader::FileReader(const std::string& filename, bool memoryMapped)
   {
     m_handle = open(filename.data(), O_RDONLY);
     if (m_handle == -1)
@@ -118,11 +187,44 @@ namespace Azure { namespace Storage { namespace Details {
       close(m_handle);
       throw std::runtime_error("failed to get size of file");
     }
+
+    if (memoryMapped)
+    {
+      MapFile();
+    }
   }
 
-  FileReader::~FileReader() { close(m_handle); }
+  FileReader::~FileReader()
+  {
+    if (m_mappedData)
+    {
+      munmap(const_cast<uint8_t*>(m_mappedData), static_cast<size_t>(m_fileSize));
+    }
+    close(m_handle);
+  }
 
-  FileWriter::FileWriter(const std::string& filename)
+  void FileReader::MapFile()
+  {
+    if (m_fileSize == 0
+        || static_cast<uint64_t>(m_fileSize) > std::numeric_limits<size_t>::max())
+    {
+      return;
+    }
+    void* mappedData
+        = mmap(nullptr, static_cast<size_t>(m_fileSize), PROT_READ, MAP_SHARED, m_handle, 0);
+    if (mappedData == MAP_FAILED)
+    {
+      return;
+    }
+    // Both are hints, failing to apply them doesn't matter.
+    madvise(mappedData, static_cast<size_t>(m_fileSize), MADV_SEQUENTIAL);
+#if defined(MADV_HUGEPAGE)
+    madvise(mappedData, static_cast<size_t>(m_fileSize), MADV_HUGEPAGE);
+#endif
+    m_mappedData = static_cast<const uint8_t*>(mappedData);
+  }
+
+  FileWriter::FileWriter(const std::string& filename, bool directIo)
   {
     m_handle = open(
         filename.data(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
@@ -130,11 +232,43 @@ namespace Azure { namespace Storage { namespace Details {
     {
       throw std::runtime_error("failed to open file");
     }
+
+#if defined(O_DIRECT)
+    if (directIo)
+    {
+      // Fails on file systems without direct I/O, like tmpfs.
+      m_directHandle = open(filename.data(), O_WRONLY | O_DIRECT);
+      m_directIo = m_directHandle != -1;
+    }
+#else
+    (void)directIo;
+#endif
   }
 
-  FileWriter::~FileWriter() { close(m_handle); }
+  FileWriter::~FileWriter()
+  {
+    if (m_directIo)
+    {
+      close(m_directHandle);
+    }
+    close(m_handle);
+  }
 
-  void FileWriter::Write(const uint8_t* buffer, int64_t length, int64_t offset)
+  void FileWriter::Preallocate(int64_t size)
+  {
+#if defined(__linux__)
+    // Unlike posix_fallocate, fails rather than writing zeros where the file system can't
+    // allocate space.
+    if (size > 0 && size <= static_cast<int64_t>(std::numeric_limits<off_t>::max()))
+    {
+      fallocate(m_handle, 0, 0, static_cast<off_t>(size));
+    }
+#else
+    (void)size;
+#endif
+  }
+
+  static void WriteAt(int handle, const uint8_t* buffer, int64_t length, int64_t offset)
   {
     if (static_cast<uint64_t>(length) > std::numeric_limits<size_t>::max()
         || offset > static_cast<int64_t>(std::numeric_limits<off_t>::max()))
@@ -142,7 +276,7 @@ namespace Azure { namespace Storage { namespace Details {
       throw std::runtime_error("failed to write file");
     }
     ssize_t bytesWritten
-        = pwrite(m_handle, buffer, static_cast<size_t>(length), static_cast<off_t>(offset));
+        = pwrite(handle, buffer, static_cast<size_t>(length), static_cast<off_t>(offset));
     if (bytesWritten != length)
     {
       throw std::runtime_error("failed to write file");
@@ -150,4 +284,22 @@ namespace Azure { namespace Storage { namespace Details {
   }
 #endif
 
+  void FileWriter::Write(const uint8_t* buffer, int64_t length, int64_t offset)
+  {
+    constexpr auto alignment = static_cast<int64_t>(DirectIoAlignment);
+    if (m_directIo && reinterpret_cast<std::uintptr_t>(buffer) % DirectIoAlignment == 0
+        && offset % alignment == 0 && length >= alignment)
+    {
+      const int64_t alignedLength = length / alignment * alignment;
+      WriteAt(m_directHandle, buffer, alignedLength, offset);
+      buffer += alignedLength;
+      offset += alignedLength;
+      length -= alignedLength;
+    }
+    if (length > 0)
+    {
+      WriteAt(m_handle, buffer, length, offset);
+    }
+  }
+
 }}} // namespace Azure::Storage::Details
@@ -0,0 +1,180 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// SPDX-License-Identifier: MIT
+
+#include "azure/storage/common/read_ahead_body_stream.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <azure/core/buffer_pool.hpp>
+
+namespace Azure { namespace Storage { namespace Details {
+
+  ReadAheadBodyStream::ReadAheadBodyStream(
+      Azure::Core::Context const& context,
+      std::vector<uint8_t> firstChunk,
+      int64_t offset,
+      int64_t length,
+      int64_t chunkSize,
+      int concurrency,
+      RangeReader rangeReader)
+      : m_context(context.WithDeadline(Azure::Core::Context::time_point::max())),
+        m_firstChunk(std::move(firstChunk)), m_offset(offset), m_length(length),
+        m_chunkSize(chunkSize), m_rangeReader(std::move(rangeReader))
+  {
+    concurrency = std::max(concurrency, 1);
+    m_buffers.resize(static_cast<size_t>(concurrency) + 1);
+    for (size_t i = 0; i < m_buffers.size(); ++i)
+    {
+      m_buffers[i].ChunkId = static_cast<int64_t>(i);
+    }
+
+    auto const firstChunkLength = static_cast<int64_t>(m_firstChunk.size());
+    if (m_length <= firstChunkLength)
+    {
+      return;
+    }
+    m_numChunks = (m_length - firstChunkLength + m_chunkSize - 1) / m_chunkSize;
+    m_downloads = std::make_unique<ConcurrentTaskQueue>(concurrency);
+    for (int64_t chunkId = 0;
+         chunkId < std::min(m_numChunks, static_cast<int64_t>(m_buffers.size()));
+         ++chunkId)
+    {
+      m_downloads->Push([this, chunkId]() { DownloadChunk(chunkId); });
+    }
+    m_downloads->Start();
+  }
+
+  ReadAheadBodyStream::~ReadAheadBodyStream()
+  {
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_cancelled = true;
+    }
+    m_context.Cancel();
+    if (m_downloads)
+    {
+      m_downloads->Stop();
+    }
+    auto bufferPool = Azure::Core::BufferPool::GetDefault();
+    bufferPool->Release(std::move(m_firstChunk));
+    for (auto& chunkBuffer : m_buffers)
+    {
+      bufferPool->Release(std::move(chunkBuffer.Data));
+    }
+  }
+
+  void ReadAheadBodyStream::DownloadChunk(int64_t chunkId)
+  {
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      if (m_cancelled || m_error)
+      {
+        return;
+      }
+    }
+
+    // The download is queued once the buffer was read, it belongs to this chunk until it is
+    // marked ready.
+    auto& chunkBuffer = m_buffers[static_cast<size_t>(chunkId) % m_buffers.size()];
+    auto const offset
+        = m_offset + static_cast<int64_t>(m_firstChunk.size()) + chunkId * m_chunkSize;
+    auto const length = std::min(m_chunkSize, m_offset + m_length - offset);
+    if (chunkBuffer.Data.capacity() == 0)
+    {
+      chunkBuffer.Data
+          = Azure::Core::BufferPool::GetDefault()->Acquire(static_cast<size_t>(length));
+    }
+    chunkBuffer.Data.resize(static_cast<size_t>(length));
+    try
+    {
+      m_rangeReader(offset, length, chunkBuffer.Data.data(), m_context);
+    }
+    catch (...)
+    {
+      {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (!m_error)
+        {
+          m_error = std::current_exception();
+        }
+      }
+      m_chunksChanged.notify_all();
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      chunkBuffer.Ready = true;
+    }
+    m_chunksChanged.notify_all();
+  }
+
+  int64_t ReadAheadBodyStream::OnRead(
+      Azure::Core::Context const& context,
+      uint8_t* buffer,
+      int64_t count)
+  {
+    if (count <= 0 || m_position >= m_length)
+    {
+      return 0;
+    }
+
+    auto const firstChunkLength = static_cast<int64_t>(m_firstChunk.size());
+    if (m_position < firstChunkLength)
+    {
+      auto const bytesRead = std::min(count, firstChunkLength - m_position);
+      std::memcpy(buffer, m_firstChunk.data() + m_position, static_cast<size_t>(bytesRead));
+      m_position += bytesRead;
+      return bytesRead;
+    }
+
+    auto const chunkId = (m_position - firstChunkLength) / m_chunkSize;
+    auto const chunkOffset = (m_position - firstChunkLength) % m_chunkSize;
+    auto& chunkBuffer = m_buffers[static_cast<size_t>(chunkId) % m_buffers.size()];
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      while (!(chunkBuffer.ChunkId == chunkId && chunkBuffer.Ready))
+      {
+        if (m_error)
+        {
+          std::rethrow_exception(m_error);
+        }
+        context.ThrowIfCancelled();
+        // When all the pool threads are busy, the chunk may not be started yet. Download a queued
+        // chunk here instead of waiting for a thread.
+        lock.unlock();
+        auto const downloaded = m_downloads->TryRunTask();
+        lock.lock();
+        if (!downloaded)
+        {
+          m_chunksChanged.wait_for(
+              lock, std::chrono::milliseconds(ReadAheadWaitIntervalMilliseconds));
+        }
+      }
+    }
+
+    // Once ready, the buffer belongs to the reader until it is handed to the next chunk.
+    auto const chunkLength = static_cast<int64_t>(chunkBuffer.Data.size());
+    auto const bytesRead = std::min(count, chunkLength - chunkOffset);
+    std::memcpy(buffer, chunkBuffer.Data.data() + chunkOffset, static_cast<size_t>(bytesRead));
+    m_position += bytesRead;
+
+    if (chunkOffset + bytesRead == chunkLength)
+    {
+      auto const nextChunkId = chunkId + static_cast<int64_t>(m_buffers.size());
+      {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        chunkBuffer.Ready = false;
+        chunkBuffer.ChunkId = nextChunkId;
+      }
+      if (nextChunkId < m_numChunks)
+      {
+        m_downloads->Push([this, nextChunkId]() { DownloadChunk(nextChunkId); });
+      }
+    }
+    return bytesRead;
+  }
+
+}}} // namespace Azure::Storage::Details
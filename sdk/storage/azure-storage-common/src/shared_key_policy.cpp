@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstring>
 
 #include <azure/core/http/http.hpp>
 #include <azure/core/internal/strings.hpp>
@@ -15,58 +16,79 @@ namespace Azure { namespace Storage { namespace Details {
 
   std::string SharedKeyPolicy::GetSignature(const Core::Http::Request& request) const
   {
-    std::string string_to_sign;
-    string_to_sign += Azure::Core::Http::HttpMethodToString(request.GetMethod()) + "\n";
+    // Lower case, as stored in the request headers.
+    static constexpr const char* StandardHeaders[] = {
+        "content-encoding",
+        "content-language",
+        "content-length",
+        "content-md5",
+        "content-type",
+        "date",
+        "if-modified-since",
+        "if-match",
+        "if-none-match",
+        "if-unmodified-since",
+        "range",
+    };
+    const std::string prefix = "x-ms-";
 
     const auto& headers = request.GetHeaders();
-    for (std::string headerName :
-         {"Content-Encoding",
-          "Content-Language",
-          "Content-Length",
-          "Content-MD5",
-          "Content-Type",
-          "Date",
-          "If-Modified-Since",
-          "If-Match",
-          "If-None-Match",
-          "If-Unmodified-Since",
-          "Range"})
+    const auto& path = request.GetUrl().GetPath();
+    const auto queryParameters = request.GetUrl().GetQueryParameters();
+
+    // The string to sign is written in one buffer, allocated once.
+    std::size_t stringToSignLength = 64 + m_credential->AccountName.length() + path.length();
+    for (const auto& header : headers)
+    {
+      stringToSignLength += header.first.length() + header.second.length() + 2;
+    }
+    for (const auto& query : queryParameters)
+    {
+      stringToSignLength += query.first.length() + query.second.length() + 2;
+    }
+    std::string stringToSign;
+    stringToSign.reserve(stringToSignLength);
+
+    stringToSign += Azure::Core::Http::HttpMethodToString(request.GetMethod());
+    stringToSign += '\n';
+
+    for (const char* headerName : StandardHeaders)
     {
-      auto ite = headers.find(Azure::Core::Internal::Strings::ToLower(headerName));
+      auto ite = headers.find(headerName);
       if (ite != headers.end())
       {
-        if (headerName == "Content-Length" && ite->second == "0")
+        if (std::strcmp(headerName, "content-length") == 0 && ite->second == "0")
         {
           // do nothing
         }
         else
         {
-          string_to_sign += ite->second;
+          stringToSign += ite->second;
         }
       }
-      string_to_sign += "\n";
+      stringToSign += '\n';
     }
 
-    // canonicalized headers
-    const std::string prefix = "x-ms-";
-    std::vector<std::pair<std::string, std::string>> ordered_kv;
+    // canonicalized headers, already in lower case and in order
     for (auto ite = headers.lower_bound(prefix);
-         ite != headers.end() && ite->first.substr(0, prefix.length()) == prefix;
+         ite != headers.end() && ite->first.compare(0, prefix.length(), prefix) == 0;
          ++ite)
     {
-      std::string key = Azure::Core::Internal::Strings::ToLower(ite->first);
-      ordered_kv.emplace_back(std::make_pair(std::move(key), ite->second));
+      stringToSign += ite->first;
+      stringToSign += ':';
+      stringToSign += ite->second;
+      stringToSign += '\n';
     }
-    std::sort(ordered_kv.begin(), ordered_kv.end());
-    for (const auto& p : ordered_kv)
-    {
-      string_to_sign += p.first + ":" + p.second + "\n";
-    }
-    ordered_kv.clear();
 
     // canonicalized resource
-    string_to_sign += "/" + m_credential->AccountName + "/" + request.GetUrl().GetPath() + "\n";
-    for (const auto& query : request.GetUrl().GetQueryParameters())
+    stringToSign += '/';
+    stringToSign += m_credential->AccountName;
+    stringToSign += '/';
+    stringToSign += path;
+    stringToSign += '\n';
+    std::vector<std::pair<std::string, std::string>> ordered_kv;
+    ordered_kv.reserve(queryParameters.size());
+    for (const auto& query : queryParameters)
     {
       std::string key = Azure::Core::Internal::Strings::ToLower(query.first);
       ordered_kv.emplace_back(std::make_pair(
@@ -75,14 +97,15 @@ namespace Azure { namespace Storage { namespace Details {
     std::sort(ordered_kv.begin(), ordered_kv.end());
     for (const auto& p : ordered_kv)
     {
-      string_to_sign += p.first + ":" + p.second + "\n";
+      stringToSign += p.first;
+      stringToSign += ':';
+      stringToSign += p.second;
+      stringToSign += '\n';
     }
 
     // remove last linebreak
-    string_to_sign.pop_back();
+    stringToSign.pop_back();
 
-    return Azure::Core::Base64Encode(Details::HmacSha256(
-        std::vector<uint8_t>(string_to_sign.begin(), string_to_sign.end()),
-        Azure::Core::Base64Decode(m_credential->GetAccountKey())));
+    return Azure::Core::Base64Encode(m_credential->GetSigner()->Sign(stringToSign));
   }
 }}} // namespace Azure::Storage::Details
@@ -5,6 +5,23 @@
 
 #include <algorithm>
 
+#include "azure/storage/common/crypt.hpp"
+
+namespace Azure { namespace Storage {
+
+  std::shared_ptr<Details::HmacSha256Signer> StorageSharedKeyCredential::GetSigner() const
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (!m_signer)
+    {
+      m_signer = std::make_shared<Details::HmacSha256Signer>(
+          Azure::Core::Base64Decode(m_accountKey));
+    }
+    return m_signer;
+  }
+
+}} // namespace Azure::Storage
+
 namespace Azure { namespace Storage { namespace Details {
 
   ConnectionStringParts ParseConnectionString(const std::string& connectionString)
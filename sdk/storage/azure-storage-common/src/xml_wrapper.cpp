@@ -3,8 +3,12 @@
 
 #include "azure/storage/common/xml_wrapper.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include <libxml/xmlreader.h>
 #include <libxml/xmlwriter.h>
@@ -19,6 +23,7 @@ namespace Azure { namespace Storage { namespace Details {
 
   static void XmlGlobalInitialize() { static XmlGlobalInitializer globalInitializer; }
 
+#if defined(BUILD_STORAGE_LIBXML2_XML_READER)
   XmlReader::XmlReader(const char* data, std::size_t length)
   {
     XmlGlobalInitialize();
@@ -35,6 +40,38 @@ namespace Azure { namespace Storage { namespace Details {
     }
   }
 
+  XmlReader::XmlReader(
+      Azure::Core::Http::BodyStream& stream,
+      const Azure::Core::Context& context)
+      : m_stream(&stream), m_context(&context)
+  {
+    XmlGlobalInitialize();
+
+    m_reader = xmlReaderForIO(&XmlReader::ReadStream, nullptr, this, nullptr, nullptr, 0);
+    if (!m_reader)
+    {
+      throw std::runtime_error("failed to parse xml");
+    }
+  }
+
+  int XmlReader::ReadStream(void* reader, char* buffer, int length)
+  {
+    XmlReader* xmlReader = static_cast<XmlReader*>(reader);
+    // Exceptions can't go through libxml2, they are kept and thrown again once it returns.
+    try
+    {
+      return static_cast<int>(xmlReader->m_stream->Read(
+          *xmlReader->m_context,
+          reinterpret_cast<uint8_t*>(buffer),
+          static_cast<int64_t>(length)));
+    }
+    catch (...)
+    {
+      xmlReader->m_streamException = std::current_exception();
+      return -1;
+    }
+  }
+
   XmlReader::~XmlReader() { xmlFreeTextReader(static_cast<xmlTextReaderPtr>(m_reader)); }
 
   XmlNode XmlReader::Read()
@@ -45,8 +82,8 @@ namespace Azure { namespace Storage { namespace Details {
       int ret = xmlTextReaderMoveToNextAttribute(reader);
       if (ret == 1)
       {
-        const char* name = reinterpret_cast<const char*>(xmlTextReaderName(reader));
-        const char* value = reinterpret_cast<const char*>(xmlTextReaderValue(reader));
+        const char* name = reinterpret_cast<const char*>(xmlTextReaderConstName(reader));
+        const char* value = reinterpret_cast<const char*>(xmlTextReaderConstValue(reader));
         return XmlNode{XmlNodeType::Attribute, name, value};
       }
       else if (ret == 0)
@@ -60,6 +97,10 @@ namespace Azure { namespace Storage { namespace Details {
     }
 
     int ret = xmlTextReaderRead(reader);
+    if (m_streamException)
+    {
+      std::rethrow_exception(m_streamException);
+    }
     if (ret == 0)
     {
       return XmlNode{XmlNodeType::End};
@@ -74,10 +115,12 @@ namespace Azure { namespace Storage { namespace Details {
     bool has_value = xmlTextReaderHasValue(reader) == 1;
     bool has_attributes = xmlTextReaderHasAttributes(reader) == 1;
 
-    const char* name = reinterpret_cast<const char*>(xmlTextReaderName(reader));
-    const char* value = reinterpret_cast<const char*>(xmlTextReaderValue(reader));
+    const char* name = reinterpret_cast<const char*>(xmlTextReaderConstName(reader));
+    const char* value = reinterpret_cast<const char*>(xmlTextReaderConstValue(reader));
 
-    if (has_attributes)
+    // libxml2 also reports the attributes of an element on its end tag, they are only read after
+    // the start tag.
+    if (has_attributes && type == XML_READER_TYPE_ELEMENT)
     {
       m_readingAttributes = true;
     }
@@ -113,6 +156,565 @@ namespace Azure { namespace Storage { namespace Details {
     return Read();
   }
 
+#else
+
+  namespace {
+    constexpr std::size_t XmlStreamChunkSize = 16 * 1024;
+
+    [[noreturn]] void ThrowParseError() { throw std::runtime_error("failed to parse xml"); }
+
+    bool IsXmlWhitespace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+    // Writes the UTF-8 encoding of a character reference to output, returns its length.
+    std::size_t EncodeUtf8(unsigned long codePoint, char* output)
+    {
+      if (codePoint == 0 || codePoint > 0x10ffff || (codePoint >= 0xd800 && codePoint <= 0xdfff))
+      {
+        ThrowParseError();
+      }
+      if (codePoint < 0x80)
+      {
+        output[0] = static_cast<char>(codePoint);
+        return 1;
+      }
+      if (codePoint < 0x800)
+      {
+        output[0] = static_cast<char>(0xc0 | (codePoint >> 6));
+        output[1] = static_cast<char>(0x80 | (codePoint & 0x3f));
+        return 2;
+      }
+      if (codePoint < 0x10000)
+      {
+        output[0] = static_cast<char>(0xe0 | (codePoint >> 12));
+        output[1] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+        output[2] = static_cast<char>(0x80 | (codePoint & 0x3f));
+        return 3;
+      }
+      output[0] = static_cast<char>(0xf0 | (codePoint >> 18));
+      output[1] = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+      output[2] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+      output[3] = static_cast<char>(0x80 | (codePoint & 0x3f));
+      return 4;
+    }
+
+    /*
+     * Pull parser for the XML the storage services send: elements, attributes, text with the
+     * predefined and character entities, CDATA sections, comments and processing instructions.
+     * DTDs aren't supported.
+     *
+     * Names and values aren't copied, they point into the buffer of the document and are
+     * terminated in place by overwriting the delimiter following them. Entities are decoded in
+     * place too, since no entity is shorter than the characters it stands for.
+     */
+    class XmlTokenizer {
+    public:
+      explicit XmlTokenizer(const char* data, std::size_t length)
+          : m_buffer(data, data + length), m_size(length), m_endOfStream(true)
+      {
+      }
+
+      explicit XmlTokenizer(
+          Azure::Core::Http::BodyStream& stream,
+          const Azure::Core::Context& context)
+          : m_stream(&stream), m_context(&context)
+      {
+      }
+
+      XmlNode Read()
+      {
+        if (m_nextAttribute < m_attributes.size())
+        {
+          const auto& attribute = m_attributes[m_nextAttribute++];
+          return XmlNode{XmlNodeType::Attribute, At(attribute.first), At(attribute.second)};
+        }
+        m_attributes.clear();
+        m_nextAttribute = 0;
+        Compact();
+
+        if (!m_started)
+        {
+          m_started = true;
+          if (Ensure(3) && std::memcmp(At(0), "\xef\xbb\xbf", 3) == 0)
+          {
+            m_position = 3;
+          }
+        }
+
+        while (true)
+        {
+          if (m_lessThanConsumed)
+          {
+            m_lessThanConsumed = false;
+          }
+          else
+          {
+            const std::size_t textEnd = Find('<', m_position);
+            if (textEnd == std::string::npos)
+            {
+              if (!IsWhitespace(m_position, m_size) || !m_rootClosed)
+              {
+                ThrowParseError();
+              }
+              m_position = m_size;
+              return XmlNode{XmlNodeType::End};
+            }
+            const std::size_t textBegin = m_position;
+            m_position = textEnd;
+            if (!IsWhitespace(textBegin, textEnd))
+            {
+              if (m_depth == 0)
+              {
+                ThrowParseError();
+              }
+              // The '<' is overwritten by the terminator, the next read knows it's there.
+              m_lessThanConsumed = true;
+              Decode(textBegin, textEnd, false);
+              return XmlNode{XmlNodeType::Text, nullptr, At(textBegin)};
+            }
+          }
+          ++m_position;
+
+          if (!Ensure(m_position + 1))
+          {
+            ThrowParseError();
+          }
+          const char c = *At(m_position);
+          if (c == '/')
+          {
+            return ReadEndTag();
+          }
+          else if (c == '?')
+          {
+            m_position = Skip("?>", m_position + 1);
+          }
+          else if (c == '!')
+          {
+            if (StartsWith("!--", m_position))
+            {
+              m_position = Skip("-->", m_position + 3);
+            }
+            else if (StartsWith("![CDATA[", m_position))
+            {
+              const std::size_t valueBegin = m_position + 8;
+              const std::size_t valueEnd = Find("]]>", valueBegin);
+              if (valueEnd == std::string::npos || m_depth == 0)
+              {
+                ThrowParseError();
+              }
+              *At(valueEnd) = '\0';
+              m_position = valueEnd + 3;
+              if (valueEnd != valueBegin)
+              {
+                return XmlNode{XmlNodeType::Text, nullptr, At(valueBegin)};
+              }
+            }
+            else
+            {
+              m_position = Skip(">", m_position + 1);
+            }
+          }
+          else
+          {
+            return ReadStartTag();
+          }
+        }
+      }
+
+    private:
+      char* At(std::size_t offset) { return m_buffer.data() + offset; }
+
+      // Reads more of the stream after the data in the buffer, returns false at the end of it.
+      bool Fill()
+      {
+        if (m_endOfStream)
+        {
+          return false;
+        }
+        if (m_buffer.size() < m_size + XmlStreamChunkSize)
+        {
+          m_buffer.resize(m_size + XmlStreamChunkSize);
+        }
+        const int64_t bytesRead = m_stream->Read(
+            *m_context,
+            reinterpret_cast<uint8_t*>(At(m_size)),
+            static_cast<int64_t>(XmlStreamChunkSize));
+        if (bytesRead == 0)
+        {
+          m_endOfStream = true;
+          return false;
+        }
+        m_size += static_cast<std::size_t>(bytesRead);
+        return true;
+      }
+
+      // Moves what's left to parse to the start of the buffer, once the previous node's name and
+      // value aren't used anymore.
+      void Compact()
+      {
+        if (m_stream == nullptr || m_position < XmlStreamChunkSize)
+        {
+          return;
+        }
+        std::memmove(At(0), At(m_position), m_size - m_position);
+        m_size -= m_position;
+        m_position = 0;
+      }
+
+      bool Ensure(std::size_t size)
+      {
+        while (m_size < size)
+        {
+          if (!Fill())
+          {
+            return false;
+          }
+        }
+        return true;
+      }
+
+      std::size_t Find(char c, std::size_t offset)
+      {
+        while (true)
+        {
+          if (offset < m_size)
+          {
+            const void* found = std::memchr(At(offset), c, m_size - offset);
+            if (found != nullptr)
+            {
+              return static_cast<std::size_t>(static_cast<const char*>(found) - At(0));
+            }
+            offset = m_size;
+          }
+          if (!Fill())
+          {
+            return std::string::npos;
+          }
+        }
+      }
+
+      std::size_t Find(const char* s, std::size_t offset)
+      {
+        const std::size_t length = std::strlen(s);
+        while (true)
+        {
+          if (offset + length <= m_size)
+          {
+            const char* found = std::search(At(offset), At(m_size), s, s + length);
+            if (found != At(m_size))
+            {
+              return static_cast<std::size_t>(found - At(0));
+            }
+            offset = m_size - length + 1;
+          }
+          if (!Fill())
+          {
+            return std::string::npos;
+          }
+        }
+      }
+
+      // Returns the offset following the next s.
+      std::size_t Skip(const char* s, std::size_t offset)
+      {
+        const std::size_t found = Find(s, offset);
+        if (found == std::string::npos)
+        {
+          ThrowParseError();
+        }
+        return found + std::strlen(s);
+      }
+
+      bool StartsWith(const char* s, std::size_t offset)
+      {
+        const std::size_t length = std::strlen(s);
+        return Ensure(offset + length) && std::memcmp(At(offset), s, length) == 0;
+      }
+
+      bool IsWhitespace(std::size_t begin, std::size_t end)
+      {
+        return std::all_of(At(begin), At(end), IsXmlWhitespace);
+      }
+
+      // Decodes entities and normalizes line breaks of the value in [begin, end), and terminates
+      // it.
+      void Decode(std::size_t begin, std::size_t end, bool attribute)
+      {
+        char* data = At(0);
+        std::size_t input = begin;
+        while (input < end && data[input] != '&' && data[input] != '\r'
+               && !(attribute && (data[input] == '\n' || data[input] == '\t')))
+        {
+          ++input;
+        }
+        std::size_t output = input;
+        while (input < end)
+        {
+          const char c = data[input];
+          if (c == '&')
+          {
+            const std::size_t entityEnd = static_cast<std::size_t>(
+                std::find(data + input + 1, data + end, ';') - data);
+            if (entityEnd == end)
+            {
+              ThrowParseError();
+            }
+            const char* entity = data + input + 1;
+            const std::size_t entityLength = entityEnd - input - 1;
+            if (entityLength == 2 && std::memcmp(entity, "lt", 2) == 0)
+            {
+              data[output++] = '<';
+            }
+            else if (entityLength == 2 && std::memcmp(entity, "gt", 2) == 0)
+            {
+              data[output++] = '>';
+            }
+            else if (entityLength == 3 && std::memcmp(entity, "amp", 3) == 0)
+            {
+              data[output++] = '&';
+            }
+            else if (entityLength == 4 && std::memcmp(entity, "quot", 4) == 0)
+            {
+              data[output++] = '"';
+            }
+            else if (entityLength == 4 && std::memcmp(entity, "apos", 4) == 0)
+            {
+              data[output++] = '\'';
+            }
+            else if (entityLength >= 2 && entity[0] == '#')
+            {
+              const bool hex = entity[1] == 'x';
+              const char* digits = entity + (hex ? 2 : 1);
+              if (digits == data + entityEnd || data + entityEnd - digits > 8)
+              {
+                ThrowParseError();
+              }
+              unsigned long codePoint = 0;
+              for (const char* digit = digits; digit != data + entityEnd; ++digit)
+              {
+                if (*digit >= '0' && *digit <= '9')
+                {
+                  codePoint
+                      = codePoint * (hex ? 16 : 10) + static_cast<unsigned long>(*digit - '0');
+                }
+                else if (hex && *digit >= 'a' && *digit <= 'f')
+                {
+                  codePoint = codePoint * 16 + static_cast<unsigned long>(*digit - 'a' + 10);
+                }
+                else if (hex && *digit >= 'A' && *digit <= 'F')
+                {
+                  codePoint = codePoint * 16 + static_cast<unsigned long>(*digit - 'A' + 10);
+                }
+                else
+                {
+                  ThrowParseError();
+                }
+              }
+              output += EncodeUtf8(codePoint, data + output);
+            }
+            else
+            {
+              ThrowParseError();
+            }
+            input = entityEnd + 1;
+          }
+          else if (c == '\r')
+          {
+            data[output++] = attribute ? ' ' : '\n';
+            ++input;
+            if (input < end && data[input] == '\n')
+            {
+              ++input;
+            }
+          }
+          else if (attribute && (c == '\n' || c == '\t'))
+          {
+            data[output++] = ' ';
+            ++input;
+          }
+          else
+          {
+            data[output++] = data[input++];
+          }
+        }
+        data[output] = '\0';
+      }
+
+      XmlNode ReadStartTag()
+      {
+        // Finds the closing '>', which may also appear in attribute values.
+        const std::size_t nameBegin = m_position;
+        std::size_t tagEnd = nameBegin;
+        char quote = '\0';
+        while (true)
+        {
+          const std::size_t scanBegin = tagEnd;
+          tagEnd = Find('>', scanBegin);
+          if (tagEnd == std::string::npos)
+          {
+            ThrowParseError();
+          }
+          for (const char* c = At(scanBegin); c != At(tagEnd); ++c)
+          {
+            if (quote == '\0' && (*c == '"' || *c == '\''))
+            {
+              quote = *c;
+            }
+            else if (*c == quote)
+            {
+              quote = '\0';
+            }
+          }
+          if (quote == '\0')
+          {
+            break;
+          }
+          ++tagEnd;
+        }
+
+        char* data = At(0);
+        const bool selfClosing = data[tagEnd - 1] == '/';
+        const std::size_t end = selfClosing ? tagEnd - 1 : tagEnd;
+        std::size_t nameEnd = nameBegin;
+        while (nameEnd < end && !IsXmlWhitespace(data[nameEnd]))
+        {
+          ++nameEnd;
+        }
+        if (nameEnd == nameBegin || (m_depth == 0 && m_rootClosed))
+        {
+          ThrowParseError();
+        }
+
+        std::size_t offset = nameEnd;
+        while (true)
+        {
+          while (offset < end && IsXmlWhitespace(data[offset]))
+          {
+            ++offset;
+          }
+          if (offset == end)
+          {
+            break;
+          }
+          const std::size_t attributeNameBegin = offset;
+          while (offset < end && data[offset] != '=' && !IsXmlWhitespace(data[offset]))
+          {
+            ++offset;
+          }
+          const std::size_t attributeNameEnd = offset;
+          while (offset < end && IsXmlWhitespace(data[offset]))
+          {
+            ++offset;
+          }
+          if (attributeNameEnd == attributeNameBegin || offset == end || data[offset] != '=')
+          {
+            ThrowParseError();
+          }
+          ++offset;
+          while (offset < end && IsXmlWhitespace(data[offset]))
+          {
+            ++offset;
+          }
+          if (offset == end || (data[offset] != '"' && data[offset] != '\''))
+          {
+            ThrowParseError();
+          }
+          const std::size_t valueBegin = offset + 1;
+          const std::size_t valueEnd = static_cast<std::size_t>(
+              std::find(data + valueBegin, data + end, data[offset]) - data);
+          if (valueEnd == end)
+          {
+            ThrowParseError();
+          }
+          data[attributeNameEnd] = '\0';
+          Decode(valueBegin, valueEnd, true);
+          m_attributes.emplace_back(attributeNameBegin, valueBegin);
+          offset = valueEnd + 1;
+        }
+
+        if (selfClosing)
+        {
+          m_rootClosed = m_rootClosed || m_depth == 0;
+        }
+        else
+        {
+          if (m_elements.size() == m_depth)
+          {
+            m_elements.emplace_back();
+          }
+          m_elements[m_depth++].assign(data + nameBegin, nameEnd - nameBegin);
+        }
+        data[nameEnd] = '\0';
+        m_position = tagEnd + 1;
+        return XmlNode{
+            selfClosing ? XmlNodeType::SelfClosingTag : XmlNodeType::StartTag, At(nameBegin)};
+      }
+
+      XmlNode ReadEndTag()
+      {
+        const std::size_t nameBegin = m_position + 1;
+        const std::size_t tagEnd = Find('>', nameBegin);
+        if (tagEnd == std::string::npos)
+        {
+          ThrowParseError();
+        }
+        char* data = At(0);
+        std::size_t nameEnd = nameBegin;
+        while (nameEnd < tagEnd && !IsXmlWhitespace(data[nameEnd]))
+        {
+          ++nameEnd;
+        }
+        if (m_depth == 0 || !IsWhitespace(nameEnd, tagEnd)
+            || m_elements[m_depth - 1].compare(
+                   0, std::string::npos, data + nameBegin, nameEnd - nameBegin)
+                != 0)
+        {
+          ThrowParseError();
+        }
+        m_rootClosed = --m_depth == 0;
+        data[nameEnd] = '\0';
+        m_position = tagEnd + 1;
+        return XmlNode{XmlNodeType::EndTag, At(nameBegin)};
+      }
+
+      std::vector<char> m_buffer;
+      // Bytes of the buffer holding the document, the rest is room to read the stream into.
+      std::size_t m_size = 0;
+      std::size_t m_position = 0;
+      bool m_endOfStream = false;
+      Azure::Core::Http::BodyStream* m_stream = nullptr;
+      const Azure::Core::Context* m_context = nullptr;
+
+      bool m_started = false;
+      bool m_lessThanConsumed = false;
+      bool m_rootClosed = false;
+      // Names of the open elements, the strings are re-used from one element to the next.
+      std::vector<std::string> m_elements;
+      std::size_t m_depth = 0;
+      // Offsets of the names and values of the attributes of the last start tag.
+      std::vector<std::pair<std::size_t, std::size_t>> m_attributes;
+      std::size_t m_nextAttribute = 0;
+    };
+  } // namespace
+
+  XmlReader::XmlReader(const char* data, std::size_t length)
+  {
+    m_reader = new XmlTokenizer(data, length);
+  }
+
+  XmlReader::XmlReader(
+      Azure::Core::Http::BodyStream& stream,
+      const Azure::Core::Context& context)
+      : m_stream(&stream), m_context(&context)
+  {
+    m_reader = new XmlTokenizer(stream, context);
+  }
+
+  XmlReader::~XmlReader() { delete static_cast<XmlTokenizer*>(m_reader); }
+
+  XmlNode XmlReader::Read() { return static_cast<XmlTokenizer*>(m_reader)->Read(); }
+
+#endif
+
   XmlWriter::XmlWriter()
   {
     XmlGlobalInitialize();
@@ -0,0 +1,305 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <azure/storage/common/concurrent_transfer.hpp>
+
+#include "test_base.hpp"
+
+namespace Azure { namespace Storage { namespace Test {
+
+  TEST(ConcurrentTransferTest, AllChunksTransferredOnce)
+  {
+    const int64_t offset = 100;
+    const int64_t length = 1000;
+    const int64_t chunkSize = 64;
+    const int concurrency = 4;
+
+    std::mutex mutex;
+    std::vector<int> transferred(16, 0);
+    std::atomic<int> running{0};
+    std::atomic<int> maxRunning{0};
+    Details::ConcurrentTransfer(
+        offset,
+        length,
+        chunkSize,
+        concurrency,
+        [&](int64_t chunkOffset, int64_t chunkLength, int64_t chunkId, int64_t numChunks) {
+          auto nowRunning = ++running;
+          for (auto max = maxRunning.load(); max < nowRunning;)
+          {
+            maxRunning.compare_exchange_weak(max, nowRunning);
+          }
+          EXPECT_EQ(numChunks, 16);
+          EXPECT_EQ(chunkOffset, offset + chunkId * chunkSize);
+          EXPECT_EQ(chunkLength, chunkId == 15 ? length - 15 * chunkSize : chunkSize);
+          std::this_thread::sleep_for(std::chrono::milliseconds(5));
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            transferred[static_cast<size_t>(chunkId)]++;
+          }
+          --running;
+        });
+
+    EXPECT_EQ(transferred, std::vector<int>(16, 1));
+    EXPECT_LE(maxRunning.load(), concurrency);
+  }
+
+  TEST(ConcurrentTransferTest, FirstErrorRethrown)
+  {
+    std::atomic<int> transferred{0};
+    EXPECT_THROW(
+        Details::ConcurrentTransfer(
+            0,
+            1024,
+            1,
+            4,
+            [&](int64_t, int64_t, int64_t chunkId, int64_t) {
+              if (chunkId == 10)
+              {
+                throw std::runtime_error("chunk failed");
+              }
+              // Slow enough that the chunks after the failed one can't all be done before it,
+              // even when the thread running it is preempted for a while.
+              std::this_thread::sleep_for(std::chrono::microseconds(200));
+              ++transferred;
+            }),
+        std::runtime_error);
+    // Chunks not started when the error happened are skipped
+    EXPECT_LT(transferred.load(), 1023);
+  }
+
+  TEST(ConcurrentTransferTest, ThreadsSharedBetweenTransfers)
+  {
+    auto& scheduler = Details::TransferScheduler::GetInstance();
+    const size_t maxThreads = 8;
+    scheduler.SetMaxThreads(maxThreads);
+    auto const threadCount = scheduler.GetThreadCount();
+
+    // Many transfers at once, each starting nested transfers, don't start a thread per chunk nor
+    // wait on each other forever.
+    std::vector<std::future<void>> transfers;
+    std::atomic<int> transferred{0};
+    for (int i = 0; i < 8; ++i)
+    {
+      transfers.emplace_back(std::async(std::launch::async, [&]() {
+        Details::ConcurrentTransfer(0, 16, 1, 8, [&](int64_t, int64_t, int64_t, int64_t) {
+          Details::ConcurrentTransfer(0, 4, 1, 4, [&](int64_t, int64_t, int64_t, int64_t) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            ++transferred;
+          });
+        });
+      }));
+    }
+    for (auto& transfer : transfers)
+    {
+      transfer.get();
+    }
+
+    EXPECT_EQ(transferred.load(), 8 * 16 * 4);
+    EXPECT_LE(scheduler.GetThreadCount(), std::max(threadCount, maxThreads));
+    scheduler.SetMaxThreads(Details::DefaultMaxTransferThreads);
+  }
+
+  TEST(ConcurrentTransferTest, TaskQueueRunsPushedTasks)
+  {
+    const int concurrency = 4;
+    Details::ConcurrentTaskQueue queue(concurrency);
+    std::atomic<int> running{0};
+    std::atomic<int> maxRunning{0};
+    std::mutex mutex;
+    std::vector<int> visited;
+
+    // Walks a tree of depth 3 with 4 children per node, each node pushing its children.
+    std::function<void(int, int)> visit = [&](int node, int depth) {
+      auto nowRunning = ++running;
+      for (auto max = maxRunning.load(); max < nowRunning;)
+      {
+        maxRunning.compare_exchange_weak(max, nowRunning);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        visited.push_back(node);
+      }
+      if (depth < 3)
+      {
+        for (int i = 1; i <= 4; ++i)
+        {
+          queue.Push([&visit, node, depth, i]() { visit(node * 4 + i, depth + 1); });
+        }
+      }
+      --running;
+    };
+    queue.Push([&visit]() { visit(0, 0); });
+    queue.Run();
+
+    std::sort(visited.begin(), visited.end());
+    std::vector<int> expected(1 + 4 + 16 + 64);
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+      expected[i] = static_cast<int>(i);
+    }
+    EXPECT_EQ(visited, expected);
+    EXPECT_LE(maxRunning.load(), concurrency);
+
+    Details::ConcurrentTaskQueue failingQueue(concurrency);
+    for (int i = 0; i < 100; ++i)
+    {
+      failingQueue.Push([i]() {
+        if (i == 10)
+        {
+          throw std::runtime_error("task failed");
+        }
+      });
+    }
+    EXPECT_THROW(failingQueue.Run(), std::runtime_error);
+  }
+
+  TEST(ConcurrentTransferTest, TaskQueueFailureSeenByRunningTasks)
+  {
+    Details::ConcurrentTaskQueue queue(2);
+    std::atomic<bool> failureSeen{false};
+    queue.Push([&]() {
+      auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+      while (!queue.IsFailed() && std::chrono::steady_clock::now() < deadline)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      failureSeen = queue.IsFailed();
+    });
+    queue.Push([]() { throw std::runtime_error("task failed"); });
+    EXPECT_FALSE(queue.IsFailed());
+    EXPECT_THROW(queue.Run(), std::runtime_error);
+    EXPECT_TRUE(queue.IsFailed());
+    EXPECT_TRUE(failureSeen);
+  }
+
+  TEST(ConcurrentTransferTest, AutoTunedChunksCoverRangeInOrder)
+  {
+    const int64_t offset = 100;
+    const int64_t length = 3 * Details::DefaultAutoTuneMaxChunkSize + 1000;
+
+    std::mutex mutex;
+    std::vector<std::pair<int64_t, int64_t>> chunks;
+    int64_t lastChunkNumChunks = 0;
+    Details::AutoTunedConcurrentTransfer(
+        offset,
+        length,
+        Details::DefaultAutoTuneMinChunkSize,
+        Details::DefaultAutoTuneMaxChunkSize,
+        4,
+        [&](int64_t chunkOffset, int64_t chunkLength, int64_t chunkId, int64_t numChunks) {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (chunks.size() <= static_cast<size_t>(chunkId))
+          {
+            chunks.resize(static_cast<size_t>(chunkId) + 1);
+          }
+          chunks[static_cast<size_t>(chunkId)] = std::make_pair(chunkOffset, chunkLength);
+          if (numChunks != -1)
+          {
+            EXPECT_EQ(numChunks, chunkId + 1);
+            lastChunkNumChunks = numChunks;
+          }
+        });
+
+    ASSERT_EQ(static_cast<size_t>(lastChunkNumChunks), chunks.size());
+    int64_t nextOffset = offset;
+    for (auto const& chunk : chunks)
+    {
+      EXPECT_EQ(chunk.first, nextOffset);
+      EXPECT_LE(chunk.second, Details::DefaultAutoTuneMaxChunkSize);
+      nextOffset += chunk.second;
+    }
+    EXPECT_EQ(nextOffset, offset + length);
+    // Chunks done this fast grow to the max size.
+    EXPECT_EQ(chunks[chunks.size() - 2].second, Details::DefaultAutoTuneMaxChunkSize);
+  }
+
+  TEST(ConcurrentTransferTest, ChunkSizeBounds)
+  {
+    const int64_t length = 4 * 1024 * 1024 + 1000;
+    auto largestChunk = [&](int64_t chunkSize, bool autoTune, int64_t minSize, int64_t maxSize) {
+      std::mutex mutex;
+      int64_t largest = 0;
+      int64_t transferred = 0;
+      Details::ConcurrentTransfer(
+          0,
+          length,
+          chunkSize,
+          4,
+          autoTune,
+          minSize,
+          maxSize,
+          [&](int64_t, int64_t chunkLength, int64_t, int64_t) {
+            std::lock_guard<std::mutex> lock(mutex);
+            largest = std::max(largest, chunkLength);
+            transferred += chunkLength;
+          });
+      EXPECT_EQ(transferred, length);
+      return largest;
+    };
+
+    // Without auto-tuning, the tuned chunk bounds don't matter.
+    EXPECT_EQ(largestChunk(64 * 1024, false, 0, 1024 * 1024), 64 * 1024);
+    // Tuned chunks stay under the max size, even when it is below the default min size.
+    EXPECT_EQ(largestChunk(64 * 1024, true, 0, 512 * 1024), 512 * 1024);
+    // Unless the min size is larger.
+    EXPECT_EQ(largestChunk(64 * 1024, true, 2 * 1024 * 1024, 512 * 1024), 2 * 1024 * 1024);
+  }
+
+  TEST(ConcurrentTransferTest, TunerAdditiveIncreaseMultiplicativeDecrease)
+  {
+    using std::chrono::milliseconds;
+    auto const t0 = std::chrono::steady_clock::now();
+    Details::TransferTuner tuner(1024, 4096, 16384, 8);
+    EXPECT_EQ(tuner.GetChunkSize(), 4096);
+    EXPECT_EQ(tuner.GetConcurrency(), 2);
+
+    // Fast chunks grow the chunk size, and a faster round adds one chunk in flight.
+    tuner.OnChunkDone(4096, t0, t0 + milliseconds(10));
+    EXPECT_EQ(tuner.GetChunkSize(), 8192);
+    EXPECT_EQ(tuner.GetConcurrency(), 2);
+    tuner.OnChunkDone(4096, t0, t0 + milliseconds(10));
+    EXPECT_EQ(tuner.GetConcurrency(), 3);
+    for (int i = 0; i < 3; ++i)
+    {
+      tuner.OnChunkDone(8192, t0 + milliseconds(10), t0 + milliseconds(20));
+    }
+    EXPECT_EQ(tuner.GetChunkSize(), 16384);
+    EXPECT_EQ(tuner.GetConcurrency(), 4);
+
+    // A chunk much slower than the others, like one retried after throttling, halves the chunks
+    // in flight, and a chunk slower than the target shrinks the chunk size.
+    tuner.OnChunkDone(16384, t0, t0 + std::chrono::seconds(5));
+    EXPECT_EQ(tuner.GetConcurrency(), 2);
+    EXPECT_EQ(tuner.GetChunkSize(), 8192);
+
+    // The concurrency never goes below one or above the max.
+    for (int i = 0; i < 4; ++i)
+    {
+      tuner.OnChunkDone(8192, t0, t0 + std::chrono::seconds(5));
+    }
+    EXPECT_EQ(tuner.GetConcurrency(), 1);
+    EXPECT_EQ(tuner.GetChunkSize(), 1024);
+    auto start = t0;
+    for (int i = 0; i < 100; ++i)
+    {
+      start += milliseconds(10);
+      tuner.OnChunkDone(16384, start, start + milliseconds(10 - i / 20));
+    }
+    EXPECT_LE(tuner.GetConcurrency(), 8);
+    EXPECT_GT(tuner.GetConcurrency(), 1);
+  }
+
+}}} // namespace Azure::Storage::Test
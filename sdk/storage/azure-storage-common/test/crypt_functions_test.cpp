@@ -3,6 +3,7 @@
 
 #include <cstring>
 
+#include <azure/core/exception.hpp>
 #include <azure/storage/common/crypt.hpp>
 
 #include "test_base.hpp"
@@ -37,6 +38,31 @@ namespace Azure { namespace Storage { namespace Test {
         "+SBESxQVhI53mSEdZJcCBpdBkaqwzfPaVYZMAf5LP3c=");
   }
 
+  TEST(CryptFunctionsTest, HmacSha256Signer)
+  {
+    std::string key = "8CwtGFF1mGR4bPEP9eZ0x1fxKiQ3Ca5N";
+    Details::HmacSha256Signer signer(std::vector<uint8_t>(key.begin(), key.end()));
+    EXPECT_EQ(
+        Azure::Core::Base64Encode(signer.Sign("")),
+        "fFy2T+EuCvAgouw/vB/RAJ75z7jwTj+uiURebkFKF5M=");
+    EXPECT_EQ(
+        Azure::Core::Base64Encode(signer.Sign("Hello Azure!")),
+        "+SBESxQVhI53mSEdZJcCBpdBkaqwzfPaVYZMAf5LP3c=");
+
+    // Keys shorter than, as long as and longer than a SHA-256 block.
+    for (std::size_t keyLength : {1U, 32U, 63U, 64U, 65U, 100U})
+    {
+      auto binaryKey = RandomBuffer(keyLength);
+      Details::HmacSha256Signer keySigner(binaryKey);
+      for (std::size_t dataLength : {0U, 1U, 55U, 56U, 64U, 1000U})
+      {
+        auto data = RandomBuffer(dataLength);
+        EXPECT_EQ(
+            keySigner.Sign(data.data(), data.size()), Details::HmacSha256(data, binaryKey));
+      }
+    }
+  }
+
   TEST(CryptFunctionsTest, Md5)
   {
     EXPECT_EQ(Azure::Core::Base64Encode(Md5::Hash("")), "1B2M2Y8AsgTpgAmY7PhCfg==");
@@ -57,6 +83,29 @@ namespace Azure { namespace Storage { namespace Test {
     EXPECT_EQ(md5Instance.Digest(), Md5::Hash(data.data(), data.size()));
   }
 
+  TEST(CryptFunctionsTest, Md5HashBatch)
+  {
+    EXPECT_TRUE(Details::Md5HashBatch({}).empty());
+
+    // Lengths around the padding taking one or two blocks, in batches of every size.
+    std::vector<std::size_t> lengths = {0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 1000, 100_KB};
+    auto data = RandomBuffer(static_cast<std::size_t>(100_KB) + 20);
+    for (std::size_t count = 1; count <= 20; ++count)
+    {
+      std::vector<std::pair<const uint8_t*, std::size_t>> buffers;
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        buffers.emplace_back(data.data() + i, lengths[(i * 7 + count) % lengths.size()]);
+      }
+      auto hashes = Details::Md5HashBatch(buffers);
+      ASSERT_EQ(hashes.size(), count);
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        EXPECT_EQ(hashes[i], Md5::Hash(buffers[i].first, buffers[i].second));
+      }
+    }
+  }
+
   TEST(CryptFunctionsTest, Crc64)
   {
     EXPECT_EQ(Azure::Core::Base64Encode(Crc64::Hash("")), "AAAAAAAAAAA=");
@@ -126,4 +175,67 @@ namespace Azure { namespace Storage { namespace Test {
         Crc64::Hash(reinterpret_cast<const uint8_t*>(allData.data()), allData.size()));
   }
 
+  TEST(CryptFunctionsTest, Crc64Kernels)
+  {
+    const auto fastestKernel = Details::GetCrc64Kernel();
+    auto data = RandomBuffer(static_cast<std::size_t>(64_KB));
+    const uint64_t crc64 = 0x0123456789ABCDEFULL;
+    // Every length around the sizes where the kernels hand over to one another, at every
+    // alignment.
+    for (std::size_t offset = 0; offset < 64; ++offset)
+    {
+      for (std::size_t length = 0; length < 4200; length += offset % 2 == 0 ? 1 : 7)
+      {
+        auto expected = Details::Crc64Update(
+            Details::Crc64Kernel::Table, crc64, data.data() + offset, length);
+        for (auto kernel = Details::Crc64Kernel::Clmul; kernel <= fastestKernel;
+             kernel = static_cast<Details::Crc64Kernel>(static_cast<int>(kernel) + 1))
+        {
+          ASSERT_EQ(Details::Crc64Update(kernel, crc64, data.data() + offset, length), expected);
+        }
+      }
+    }
+    for (auto kernel = Details::Crc64Kernel::Clmul; kernel <= fastestKernel;
+         kernel = static_cast<Details::Crc64Kernel>(static_cast<int>(kernel) + 1))
+    {
+      EXPECT_EQ(
+          Details::Crc64Update(kernel, 0, data.data(), data.size()),
+          Details::Crc64Update(Details::Crc64Kernel::Table, 0, data.data(), data.size()));
+    }
+  }
+
+  TEST(CryptFunctionsTest, TransferCrc64)
+  {
+    auto data = RandomBuffer(static_cast<std::size_t>(3_MB + 123));
+    const std::size_t chunkSize = static_cast<std::size_t>(256_KB);
+
+    // Chunks done in any order combine into the CRC64 of the whole content.
+    Details::TransferCrc64 transferCrc64;
+    int64_t numChunks = static_cast<int64_t>((data.size() + chunkSize - 1) / chunkSize);
+    for (int64_t chunkId = numChunks - 1; chunkId >= 0; --chunkId)
+    {
+      std::size_t offset = static_cast<std::size_t>(chunkId) * chunkSize;
+      Crc64 chunkCrc64;
+      chunkCrc64.Update(&data[offset], std::min(chunkSize, data.size() - offset));
+      transferCrc64.AddChunk(chunkId, chunkCrc64);
+    }
+    auto crc64 = transferCrc64.Combine();
+    EXPECT_EQ(crc64.Digest(), Crc64::Hash(data.data(), data.size()));
+    EXPECT_EQ(Details::TransferCrc64().Combine().Digest(), Crc64::Hash(""));
+
+    ContentHash serviceHash;
+    serviceHash.Algorithm = HashAlgorithm::Crc64;
+    serviceHash.Value = crc64.Digest();
+    EXPECT_NO_THROW(Details::VerifyCrc64(crc64, serviceHash));
+    serviceHash.Value[0] ^= 1;
+    EXPECT_THROW(Details::VerifyCrc64(crc64, serviceHash), Azure::Core::RequestFailedException);
+    // A missing hash or a hash of another kind doesn't pass for a match.
+    EXPECT_THROW(
+        Details::VerifyCrc64(crc64, Azure::Core::Nullable<ContentHash>()),
+        Azure::Core::RequestFailedException);
+    serviceHash.Algorithm = HashAlgorithm::Md5;
+    serviceHash.Value = Md5::Hash(data.data(), data.size());
+    EXPECT_THROW(Details::VerifyCrc64(crc64, serviceHash), Azure::Core::RequestFailedException);
+  }
+
 }}} // namespace Azure::Storage::Test
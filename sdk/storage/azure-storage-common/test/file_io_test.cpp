@@ -0,0 +1,76 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// SPDX-License-Identifier: MIT
+
+#include <azure/core/buffer_pool.hpp>
+#include <azure/storage/common/file_io.hpp>
+
+#include "test_base.hpp"
+
+namespace Azure { namespace Storage { namespace Test {
+
+  TEST(FileIoTest, MemoryMappedFileReader)
+  {
+    std::string filename = RandomString();
+    auto content = RandomBuffer(static_cast<std::size_t>(3_MB + 123));
+    {
+      Details::FileWriter fileWriter(filename);
+      fileWriter.Write(content.data(), static_cast<int64_t>(content.size()), 0);
+    }
+
+    {
+      Details::FileReader fileReader(filename);
+      EXPECT_EQ(fileReader.GetFileSize(), static_cast<int64_t>(content.size()));
+      EXPECT_EQ(fileReader.GetMappedData(), nullptr);
+    }
+    {
+      Details::FileReader fileReader(filename, true);
+      EXPECT_EQ(fileReader.GetFileSize(), static_cast<int64_t>(content.size()));
+      ASSERT_NE(fileReader.GetMappedData(), nullptr);
+      EXPECT_EQ(
+          std::vector<uint8_t>(
+              fileReader.GetMappedData(), fileReader.GetMappedData() + content.size()),
+          content);
+    }
+
+    // Empty files can't be mapped.
+    {
+      Details::FileWriter fileWriter(filename);
+    }
+    {
+      Details::FileReader fileReader(filename, true);
+      EXPECT_EQ(fileReader.GetFileSize(), 0);
+      EXPECT_EQ(fileReader.GetMappedData(), nullptr);
+    }
+    DeleteFile(filename);
+  }
+
+  TEST(FileIoTest, DirectIoFileWriter)
+  {
+    std::string filename = RandomString();
+    const std::size_t fileSize = static_cast<std::size_t>(9_MB + 123);
+    auto content = RandomBuffer(fileSize);
+    {
+      Details::FileWriter fileWriter(filename, true);
+      fileWriter.Preallocate(static_cast<int64_t>(fileSize));
+      auto pooledBuffer = Azure::Core::BufferPool::GetDefault()->Acquire(
+          static_cast<std::size_t>(4_MB), Details::DirectIoAlignment);
+      uint8_t* buffer
+          = Azure::Core::BufferPool::GetAlignedData(pooledBuffer, Details::DirectIoAlignment);
+      EXPECT_EQ(reinterpret_cast<std::uintptr_t>(buffer) % Details::DirectIoAlignment, 0U);
+      // Aligned writes with an unaligned tail, then unaligned ones.
+      const std::size_t chunks[][2]
+          = {{0, 4_MB}, {4_MB, 3_MB + 100}, {7_MB + 100, 2_MB}, {9_MB + 100, 23}};
+      for (const auto& chunk : chunks)
+      {
+        std::copy(
+            content.begin() + static_cast<std::ptrdiff_t>(chunk[0]),
+            content.begin() + static_cast<std::ptrdiff_t>(chunk[0] + chunk[1]),
+            buffer);
+        fileWriter.Write(buffer, static_cast<int64_t>(chunk[1]), static_cast<int64_t>(chunk[0]));
+      }
+    }
+    EXPECT_EQ(ReadFile(filename), content);
+    DeleteFile(filename);
+  }
+
+}}} // namespace Azure::Storage::Test
@@ -0,0 +1,228 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <azure/storage/common/read_ahead_body_stream.hpp>
+
+#include "test_base.hpp"
+
+namespace Azure { namespace Storage { namespace Test {
+
+  namespace {
+    uint8_t ByteAt(int64_t offset) { return static_cast<uint8_t>(offset * 7 + 3); }
+
+    std::vector<uint8_t> Bytes(int64_t offset, int64_t length)
+    {
+      std::vector<uint8_t> bytes(static_cast<size_t>(length));
+      for (int64_t i = 0; i < length; ++i)
+      {
+        bytes[static_cast<size_t>(i)] = ByteAt(offset + i);
+      }
+      return bytes;
+    }
+  } // namespace
+
+  TEST(ReadAheadBodyStreamTest, ReadsRangeInOrderWithBoundedMemory)
+  {
+    const int64_t offset = 1000;
+    const int64_t length = 10000;
+    const int64_t firstChunkLength = 300;
+    const int64_t chunkSize = 512;
+    const int concurrency = 3;
+
+    // Chunks downloaded but not read yet can't be more than the ring of buffers.
+    std::atomic<int64_t> bytesDownloaded{firstChunkLength};
+    int64_t bytesReadSoFar = 0;
+    std::atomic<int64_t> maxAhead{0};
+    Details::ReadAheadBodyStream stream(
+        Azure::Core::GetApplicationContext(),
+        Bytes(offset, firstChunkLength),
+        offset,
+        length,
+        chunkSize,
+        concurrency,
+        [&](int64_t chunkOffset,
+            int64_t chunkLength,
+            uint8_t* buffer,
+            Azure::Core::Context const&) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          auto bytes = Bytes(chunkOffset, chunkLength);
+          std::copy(bytes.begin(), bytes.end(), buffer);
+          bytesDownloaded += chunkLength;
+        });
+    EXPECT_EQ(stream.Length(), length);
+
+    std::vector<uint8_t> content;
+    std::vector<uint8_t> buffer(333);
+    while (true)
+    {
+      auto bytesRead = stream.Read(
+          Azure::Core::GetApplicationContext(), buffer.data(), static_cast<int64_t>(buffer.size()));
+      if (bytesRead == 0)
+      {
+        break;
+      }
+      content.insert(content.end(), buffer.begin(), buffer.begin() + bytesRead);
+      bytesReadSoFar += bytesRead;
+      auto ahead = bytesDownloaded - bytesReadSoFar;
+      if (ahead > maxAhead)
+      {
+        maxAhead = ahead;
+      }
+      // Give the downloads time to fill the ring.
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_EQ(content, Bytes(offset, length));
+    EXPECT_LE(maxAhead.load(), chunkSize * (concurrency + 1));
+  }
+
+  TEST(ReadAheadBodyStreamTest, ChunkErrorRethrownByRead)
+  {
+    const int64_t chunkSize = 100;
+    Details::ReadAheadBodyStream stream(
+        Azure::Core::GetApplicationContext(),
+        {},
+        0,
+        2000,
+        chunkSize,
+        4,
+        [&](int64_t chunkOffset,
+            int64_t chunkLength,
+            uint8_t* buffer,
+            Azure::Core::Context const&) {
+          if (chunkOffset == 5 * chunkSize)
+          {
+            throw std::runtime_error("chunk failed");
+          }
+          auto bytes = Bytes(chunkOffset, chunkLength);
+          std::copy(bytes.begin(), bytes.end(), buffer);
+        });
+
+    std::vector<uint8_t> buffer(static_cast<size_t>(chunkSize));
+    int64_t bytesRead = 0;
+    bool errorThrown = false;
+    try
+    {
+      while (true)
+      {
+        auto n = stream.Read(Azure::Core::GetApplicationContext(), buffer.data(), chunkSize);
+        ASSERT_EQ(n, chunkSize);
+        EXPECT_EQ(buffer, Bytes(bytesRead, chunkSize));
+        bytesRead += n;
+      }
+    }
+    catch (std::runtime_error const&)
+    {
+      errorThrown = true;
+    }
+    EXPECT_TRUE(errorThrown);
+    // The chunks before the failed one are read.
+    EXPECT_EQ(bytesRead, 5 * chunkSize);
+  }
+
+  TEST(ReadAheadBodyStreamTest, PoolThreadsNotHeldByUnreadStreams)
+  {
+    // More streams than pool threads, none of them read. Their chunks are downloaded into the
+    // ring of buffers without holding a pool thread while waiting for the reader.
+    auto& scheduler = Details::TransferScheduler::GetInstance();
+    auto const maxThreads = std::max<size_t>(scheduler.GetThreadCount(), 1);
+    scheduler.SetMaxThreads(maxThreads);
+    auto const numStreams = static_cast<int>(maxThreads) + 1;
+    std::atomic<int> chunksDownloaded{0};
+    {
+      std::vector<std::unique_ptr<Details::ReadAheadBodyStream>> streams;
+      for (int i = 0; i < numStreams; ++i)
+      {
+        streams.push_back(std::make_unique<Details::ReadAheadBodyStream>(
+            Azure::Core::GetApplicationContext(),
+            std::vector<uint8_t>(),
+            0,
+            10000,
+            100,
+            2,
+            [&](int64_t, int64_t, uint8_t*, Azure::Core::Context const&) {
+              ++chunksDownloaded;
+            }));
+      }
+      auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+      while (chunksDownloaded < numStreams * 3 && std::chrono::steady_clock::now() < deadline)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      EXPECT_EQ(chunksDownloaded.load(), numStreams * 3);
+
+      // The pool threads are free for other work.
+      std::atomic<bool> taskRan{false};
+      Details::ConcurrentTaskQueue queue(1);
+      queue.Push([&taskRan]() { taskRan = true; });
+      queue.Start();
+      while (!taskRan && std::chrono::steady_clock::now() < deadline)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      EXPECT_TRUE(taskRan);
+
+      // The streams still read to the end.
+      EXPECT_EQ(
+          Azure::Core::Http::BodyStream::ReadToEnd(
+              Azure::Core::GetApplicationContext(), *streams.back())
+              .size(),
+          10000U);
+    }
+    scheduler.SetMaxThreads(Details::DefaultMaxTransferThreads);
+  }
+
+  TEST(ReadAheadBodyStreamTest, ReadWithoutFreePoolThreads)
+  {
+    // No pool thread can download the chunks, the reader downloads them while it waits.
+    TransferPoolThreadsBlocker blocker;
+    Details::ReadAheadBodyStream stream(
+        Azure::Core::GetApplicationContext(),
+        Bytes(0, 100),
+        0,
+        10000,
+        512,
+        4,
+        [](int64_t chunkOffset,
+           int64_t chunkLength,
+           uint8_t* buffer,
+           Azure::Core::Context const&) {
+          auto bytes = Bytes(chunkOffset, chunkLength);
+          std::copy(bytes.begin(), bytes.end(), buffer);
+        });
+    EXPECT_EQ(
+        Azure::Core::Http::BodyStream::ReadToEnd(Azure::Core::GetApplicationContext(), stream),
+        Bytes(0, 10000));
+  }
+
+  TEST(ReadAheadBodyStreamTest, DestroyedBeforeReadToEnd)
+  {
+    std::atomic<int> chunksDownloaded{0};
+    {
+      Details::ReadAheadBodyStream stream(
+          Azure::Core::GetApplicationContext(),
+          {},
+          0,
+          1000000,
+          100,
+          4,
+          [&](int64_t, int64_t, uint8_t*, Azure::Core::Context const& context) {
+            context.ThrowIfCancelled();
+            ++chunksDownloaded;
+          });
+      std::vector<uint8_t> buffer(150);
+      stream.Read(Azure::Core::GetApplicationContext(), buffer.data(), 150);
+    }
+    // Only the chunks which fit in the ring of buffers were downloaded.
+    EXPECT_LE(chunksDownloaded.load(), 6);
+  }
+
+}}} // namespace Azure::Storage::Test
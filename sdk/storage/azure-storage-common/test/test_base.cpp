@@ -255,4 +255,45 @@ namespace Azure { namespace Storage { namespace Test {
     return datetime > minTime && datetime < maxTime;
   }
 
+  TransferPoolThreadsBlocker::TransferPoolThreadsBlocker()
+  {
+    auto& scheduler = Storage::Details::TransferScheduler::GetInstance();
+    scheduler.SetMaxThreads(0);
+    auto const threadCount = scheduler.GetThreadCount();
+    if (threadCount == 0)
+    {
+      return;
+    }
+    // One task for each pool thread, each one waiting until the blocker is destroyed.
+    m_queue = std::make_unique<Storage::Details::ConcurrentTaskQueue>(
+        static_cast<int>(threadCount));
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+      m_queue->Push([this]() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        ++m_blockedThreads;
+        m_changed.notify_all();
+        m_changed.wait(lock, [this]() { return m_released; });
+      });
+    }
+    m_queue->Start();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait(lock, [this, threadCount]() { return m_blockedThreads == threadCount; });
+  }
+
+  TransferPoolThreadsBlocker::~TransferPoolThreadsBlocker()
+  {
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_released = true;
+    }
+    m_changed.notify_all();
+    if (m_queue)
+    {
+      m_queue->Stop();
+    }
+    Storage::Details::TransferScheduler::GetInstance().SetMaxThreads(
+        Storage::Details::DefaultMaxTransferThreads);
+  }
+
 }}} // namespace Azure::Storage::Test
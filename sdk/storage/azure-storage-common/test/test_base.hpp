@@ -4,13 +4,17 @@
 #pragma once
 
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include <azure/core/base64.hpp>
 #include <azure/core/datetime.hpp>
 #include <azure/core/http/body_stream.hpp>
+#include <azure/storage/common/concurrent_transfer.hpp>
 #include <azure/storage/common/constants.hpp>
 #include <azure/storage/common/storage_common.hpp>
 #include <gtest/gtest.h>
@@ -89,4 +93,19 @@ namespace Azure { namespace Storage { namespace Test {
     return Azure::Core::Base64Encode(std::vector<uint8_t>(text.begin(), text.end()));
   }
 
+  // Keeps all the threads of the transfer pool busy and doesn't let it start new ones, until
+  // destroyed.
+  class TransferPoolThreadsBlocker {
+  public:
+    TransferPoolThreadsBlocker();
+    ~TransferPoolThreadsBlocker();
+
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    size_t m_blockedThreads = 0;
+    bool m_released = false;
+    std::unique_ptr<Storage::Details::ConcurrentTaskQueue> m_queue;
+  };
+
 }}} // namespace Azure::Storage::Test
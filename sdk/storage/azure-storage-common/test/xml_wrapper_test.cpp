@@ -0,0 +1,142 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <azure/storage/common/xml_wrapper.hpp>
+
+#include "test_base.hpp"
+
+namespace Azure { namespace Storage { namespace Test {
+
+  namespace {
+    // Hands out a few bytes per read, then fails if asked to.
+    class TrickleBodyStream : public Azure::Core::Http::BodyStream {
+    public:
+      TrickleBodyStream(const std::string& content, bool fail) : m_content(content), m_fail(fail)
+      {
+      }
+
+      int64_t Length() const override { return static_cast<int64_t>(m_content.size()); }
+
+      void Rewind() override { m_offset = 0; }
+
+    private:
+      int64_t OnRead(Azure::Core::Context const&, uint8_t* buffer, int64_t count) override
+      {
+        if (m_fail && m_offset >= m_content.size() / 2)
+        {
+          throw std::runtime_error("connection lost");
+        }
+        std::size_t length = std::min(
+            {static_cast<std::size_t>(count), m_content.size() - m_offset, std::size_t(7)});
+        std::copy(m_content.begin() + m_offset, m_content.begin() + m_offset + length, buffer);
+        m_offset += length;
+        return static_cast<int64_t>(length);
+      }
+
+      std::string m_content;
+      bool m_fail;
+      std::size_t m_offset = 0;
+    };
+
+    std::vector<std::string> ReadAll(Details::XmlReader& reader)
+    {
+      std::vector<std::string> nodes;
+      while (true)
+      {
+        auto node = reader.Read();
+        nodes.emplace_back(
+            std::to_string(static_cast<int>(node.Type)) + ":" + (node.Name ? node.Name : "") + ":"
+            + (node.Value ? node.Value : ""));
+        if (node.Type == Details::XmlNodeType::End)
+        {
+          return nodes;
+        }
+      }
+    }
+  } // namespace
+
+  TEST(XmlReaderTest, Nodes)
+  {
+    const std::string document
+        = "\xef\xbb\xbf<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+          "<Root>\n"
+          "  <Attributes a=\"1 &amp; 2\" b='&quot;x&gt;y&quot;'/>\n"
+          "  <Name>a &lt;&#x41;&#233;&#20320;&#128512;&gt; b</Name>\n"
+          "  <Empty />\n"
+          "  <Empty></Empty>\n"
+          "  <Self c=\"d\"/>\n"
+          "  <Nested><Inner>value</Inner></Nested>\n"
+          "  <Parent p=\"1\"><Child/></Parent>\n"
+          "</Root>\n";
+    const std::vector<std::string> expected = {
+        "0:Root:",
+        "2:Attributes:",
+        "4:a:1 & 2",
+        "4:b:\"x>y\"",
+        "0:Name:",
+        "3::a <A\xc3\xa9\xe4\xbd\xa0\xf0\x9f\x98\x80> b",
+        "1:Name:",
+        "2:Empty:",
+        "0:Empty:",
+        "1:Empty:",
+        "2:Self:",
+        "4:c:d",
+        "0:Nested:",
+        "0:Inner:",
+        "3::value",
+        "1:Inner:",
+        "1:Nested:",
+        // Attributes are only reported after the start tag.
+        "0:Parent:",
+        "4:p:1",
+        "2:Child:",
+        "1:Parent:",
+        "1:Root:",
+        "5::",
+    };
+
+    Details::XmlReader reader(document.data(), document.size());
+    EXPECT_EQ(ReadAll(reader), expected);
+  }
+
+  TEST(XmlReaderTest, Malformed)
+  {
+    for (std::string document :
+         {"", "<a>", "<a></b>", "<a><b></a></b>", "<a>&bogus;</a>", "<a b=\"c></a>", "text",
+          "<a></a><b></b>", "<a></a>text"})
+    {
+      Details::XmlReader reader(document.data(), document.size());
+      EXPECT_THROW(ReadAll(reader), std::runtime_error) << document;
+    }
+  }
+
+  TEST(XmlReaderTest, Stream)
+  {
+    std::string document
+        = "<?xml version=\"1.0\" encoding=\"utf-8\"?><EnumerationResults ContainerName=\"c\">"
+          "<Blobs>";
+    for (int i = 0; i < 100; ++i)
+    {
+      document += "<Blob><Name>blob" + std::to_string(i) + "</Name><Properties/></Blob>";
+    }
+    document += "</Blobs><NextMarker /></EnumerationResults>";
+
+    Details::XmlReader memoryReader(document.data(), document.size());
+    auto expected = ReadAll(memoryReader);
+
+    TrickleBodyStream stream(document, false);
+    Details::XmlReader streamReader(stream, Azure::Core::GetApplicationContext());
+    EXPECT_EQ(ReadAll(streamReader), expected);
+
+    TrickleBodyStream failingStream(document, true);
+    Details::XmlReader failingReader(failingStream, Azure::Core::GetApplicationContext());
+    EXPECT_THROW(ReadAll(failingReader), std::runtime_error);
+  }
+
+}}} // namespace Azure::Storage::Test
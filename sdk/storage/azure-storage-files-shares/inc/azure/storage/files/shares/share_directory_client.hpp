@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -175,6 +176,27 @@ namespace Azure { namespace Storage { namespace Files { namespace Shares {
         const ListFilesAndDirectoriesSinglePageOptions& options
         = ListFilesAndDirectoriesSinglePageOptions()) const;
 
+    /**
+     * @brief Lists the files and directories under the directory and under all of its
+     * subdirectories, listing several directories at the same time, and hands each page to a
+     * callback.
+     *
+     * @remark Each directory is listed page by page with ListFilesAndDirectoriesSinglePage. The
+     * subdirectories found in a page are queued as soon as the page is received and listed
+     * concurrently with it, in the order found, up to Concurrency pages at a time.
+     *
+     * @remark The callback is called from one thread at a time, with each page of each directory
+     * once, in no particular order. DirectoryPath in the page tells which directory it lists. The
+     * first error thrown by a page or by the callback stops the listing and is rethrown.
+     *
+     * @param onPage Called with each page.
+     * @param options Optional parameters to execute this function.
+     */
+    void ListFilesAndDirectoriesParallel(
+        const std::function<void(Models::ListFilesAndDirectoriesSinglePageResult)>& onPage,
+        const ListFilesAndDirectoriesParallelOptions& options
+        = ListFilesAndDirectoriesParallelOptions()) const;
+
     /**
      * @brief List open handles on the directory.
      * @param options Optional parameters to list this directory's open handles.
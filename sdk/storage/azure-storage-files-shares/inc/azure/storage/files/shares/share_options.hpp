@@ -360,6 +360,24 @@ namespace Azure { namespace Storage { namespace Files { namespace Shares {
     Azure::Core::Nullable<int32_t> PageSizeHint;
   };
 
+  struct ListFilesAndDirectoriesParallelOptions
+  {
+    /**
+     * @brief Context for cancelling long running operations.
+     */
+    Azure::Core::Context Context;
+
+    /**
+     * @brief Specifies the maximum number of entries to return in each page.
+     */
+    Azure::Core::Nullable<int32_t> PageSizeHint;
+
+    /**
+     * @brief The maximum number of pages listed at the same time.
+     */
+    int Concurrency = 5;
+  };
+
   struct ListShareDirectoryHandlesSinglePageOptions
   {
     /**
@@ -766,6 +784,25 @@ namespace Azure { namespace Storage { namespace Files { namespace Shares {
      * @brief The maximum number of threads that may be used in a parallel transfer.
      */
     int Concurrency = 5;
+
+    /**
+     * @brief When downloading to a file, allocate its disk space upfront once the size of the
+     * download is known, so the chunks written in parallel don't leave it fragmented.
+     *
+     * @remark On Linux the file has its final size from the start, including when the download
+     * fails part way.
+     */
+    bool PreallocateFile = false;
+
+    /**
+     * @brief When downloading to a file, write it bypassing the page cache, so downloading large
+     * files doesn't evict the rest of the cache. Uses O_DIRECT on Linux and FILE_FLAG_NO_BUFFERING
+     * on Windows, and is ignored where direct I/O isn't supported.
+     *
+     * @remark Only chunks starting at a multiple of 4KiB of the file bypass the cache. The
+     * default chunk sizes are multiples of it.
+     */
+    bool UseDirectIo = false;
   };
 
   /**
@@ -810,5 +847,14 @@ namespace Azure { namespace Storage { namespace Files { namespace Shares {
      * @brief The maximum number of threads that may be used in a parallel transfer.
      */
     int Concurrency = 5;
+
+    /**
+     * @brief Map the file into memory when uploading from a file, and read the chunks from the
+     * mapping rather than with a read call each. Falls back to reading the file when it can't be
+     * mapped.
+     *
+     * @remark On POSIX, the process gets SIGBUS if the file is truncated during the upload.
+     */
+    bool MemoryMapFile = false;
   };
 }}}} // namespace Azure::Storage::Files::Shares
@@ -3,8 +3,11 @@
 
 #include "azure/storage/files/shares/share_directory_client.hpp"
 
+#include <mutex>
+
 #include <azure/core/credentials.hpp>
 #include <azure/core/http/policy.hpp>
+#include <azure/storage/common/concurrent_transfer.hpp>
 #include <azure/storage/common/constants.hpp>
 #include <azure/storage/common/crypt.hpp>
 #include <azure/storage/common/shared_key_policy.hpp>
@@ -329,6 +332,49 @@ namespace Azure { namespace Storage { namespace Files { namespace Shares {
         std::move(ret), result.ExtractRawResponse());
   }
 
+  void ShareDirectoryClient::ListFilesAndDirectoriesParallel(
+      const std::function<void(Models::ListFilesAndDirectoriesSinglePageResult)>& onPage,
+      const ListFilesAndDirectoriesParallelOptions& options) const
+  {
+    Storage::Details::ConcurrentTaskQueue queue(options.Concurrency);
+    std::mutex onPageMutex;
+
+    // Lists a directory, and queues the subdirectories in each page as soon as it's received.
+    // Stops once listing another directory failed, the error is rethrown by the queue.
+    std::function<void(const ShareDirectoryClient&)> listDirectory
+        = [&](const ShareDirectoryClient& directoryClient) {
+            ListFilesAndDirectoriesSinglePageOptions pageOptions;
+            pageOptions.Context = options.Context;
+            pageOptions.PageSizeHint = options.PageSizeHint;
+            do
+            {
+              if (queue.IsFailed())
+              {
+                return;
+              }
+              auto page = directoryClient.ListFilesAndDirectoriesSinglePage(pageOptions);
+              for (const auto& directoryItem : page->DirectoryItems)
+              {
+                queue.Push([&listDirectory,
+                            subdirectoryClient
+                            = directoryClient.GetSubdirectoryClient(directoryItem.Name)]() {
+                  listDirectory(subdirectoryClient);
+                });
+              }
+              pageOptions.ContinuationToken = page->ContinuationToken;
+              std::lock_guard<std::mutex> guard(onPageMutex);
+              if (queue.IsFailed())
+              {
+                return;
+              }
+              onPage(page.ExtractValue());
+            } while (!pageOptions.ContinuationToken.GetValue().empty());
+          };
+
+    queue.Push([&listDirectory, this]() { listDirectory(*this); });
+    queue.Run();
+  }
+
   Azure::Core::Response<Models::ListShareDirectoryHandlesSinglePageResult>
   ShareDirectoryClient::ListHandlesSinglePage(
       const ListShareDirectoryHandlesSinglePageOptions& options) const
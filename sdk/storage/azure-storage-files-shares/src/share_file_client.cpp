@@ -3,6 +3,7 @@
 
 #include "azure/storage/files/shares/share_file_client.hpp"
 
+#include <azure/core/buffer_pool.hpp>
 #include <azure/core/credentials.hpp>
 #include <azure/core/http/policy.hpp>
 #include <azure/storage/common/concurrent_transfer.hpp>
@@ -717,7 +718,7 @@ namespace Azure { namespace Storage { namespace Files { namespace Shares {
       firstChunkOptions.Range.GetValue().Length = firstChunkLength;
     }
 
-    Storage::Details::FileWriter fileWriter(fileName);
+    Storage::Details::FileWriter fileWriter(fileName, options.UseDirectIo);
 
     auto firstChunk = Download(firstChunkOptions);
 
@@ -738,27 +739,36 @@ namespace Azure { namespace Storage { namespace Files { namespace Shares {
       fileRangeSize = fileSize;
     }
     firstChunkLength = std::min(firstChunkLength, fileRangeSize);
+    if (options.PreallocateFile)
+    {
+      fileWriter.Preallocate(fileRangeSize);
+    }
 
     auto bodyStreamToFile = [](Azure::Core::Http::BodyStream& stream,
                                Storage::Details::FileWriter& fileWriter,
                                int64_t offset,
                                int64_t length,
                                Azure::Core::Context& context) {
-      constexpr std::size_t bufferSize = 4 * 1024 * 1024;
-      std::vector<uint8_t> buffer(bufferSize);
+      // Aligned, so writes can bypass the page cache with direct I/O.
+      constexpr std::size_t bufferSize = Storage::Details::FileWriterBufferSize;
+      auto bufferPool = Azure::Core::BufferPool::GetDefault();
+      auto pooledBuffer = bufferPool->Acquire(bufferSize, Storage::Details::DirectIoAlignment);
+      uint8_t* buffer = Azure::Core::BufferPool::GetAlignedData(
+          pooledBuffer, Storage::Details::DirectIoAlignment);
       while (length > 0)
       {
         int64_t readSize = std::min(static_cast<int64_t>(bufferSize), length);
         int64_t bytesRead
-            = Azure::Core::Http::BodyStream::ReadToCount(context, stream, buffer.data(), readSize);
+            = Azure::Core::Http::BodyStream::ReadToCount(context, stream, buffer, readSize);
         if (bytesRead != readSize)
         {
           throw Azure::Core::RequestFailedException("error when reading body stream");
         }
-        fileWriter.Write(buffer.data(), bytesRead, offset);
+        fileWriter.Write(buffer, bytesRead, offset);
         length -= bytesRead;
         offset += bytesRead;
       }
+      bufferPool->Release(std::move(pooledBuffer));
     };
 
     bodyStreamToFile(
@@ -924,7 +934,15 @@ namespace Azure { namespace Storage { namespace Files { namespace Shares {
       const std::string& fileName,
       const UploadShareFileFromOptions& options) const
   {
-    Storage::Details::FileReader fileReader(fileName);
+    Storage::Details::FileReader fileReader(fileName, options.MemoryMapFile);
+    if (fileReader.GetMappedData())
+    {
+      // Ranges are read straight from the mapping, like from a buffer.
+      return UploadFrom(
+          fileReader.GetMappedData(),
+          static_cast<std::size_t>(fileReader.GetFileSize()),
+          options);
+    }
 
     Details::ShareRestClient::File::CreateOptions protocolLayerOptions;
     protocolLayerOptions.XMsContentLength = fileReader.GetFileSize();
@@ -4,7 +4,11 @@
 #include "share_directory_client_test.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <map>
+#include <set>
+#include <thread>
 
 namespace Azure { namespace Storage { namespace Test {
 
@@ -428,4 +432,223 @@ namespace Azure { namespace Storage { namespace Test {
     EXPECT_TRUE(result->ContinuationToken.empty());
     EXPECT_NO_THROW(m_fileShareDirectoryClient->ForceCloseAllHandles());
   }
+
+  namespace {
+    // Serves List Files and Directories requests from a set of file paths, taking a few
+    // milliseconds for each page so that pages overlap and complete in varying order.
+    class MockListFilesAndDirectoriesPolicy : public Core::Http::HttpPolicy {
+    public:
+      struct State
+      {
+        std::set<std::string> FilePaths;
+        // Directories answered with 403 Forbidden.
+        std::set<std::string> FailingDirectories;
+        std::atomic<int> Requests{0};
+        std::atomic<int> Running{0};
+        std::atomic<int> MaxRunning{0};
+      };
+
+      explicit MockListFilesAndDirectoriesPolicy(std::shared_ptr<State> state)
+          : m_state(std::move(state))
+      {
+      }
+
+      std::unique_ptr<HttpPolicy> Clone() const override
+      {
+        return std::make_unique<MockListFilesAndDirectoriesPolicy>(*this);
+      }
+
+      std::unique_ptr<Core::Http::RawResponse> Send(
+          Core::Context const& context,
+          Core::Http::Request& request,
+          Core::Http::NextHttpPolicy nextHttpPolicy) const override
+      {
+        unused(context, nextHttpPolicy);
+
+        // The path is the share name followed by the directory path.
+        const std::string path = request.GetUrl().GetPath();
+        const auto shareNameEnd = path.find('/');
+        const std::string directoryPath
+            = shareNameEnd == std::string::npos ? std::string() : path.substr(shareNameEnd + 1);
+        auto query = request.GetUrl().GetQueryParameters();
+        const std::string marker = query["marker"];
+        const std::size_t maxResults
+            = query["maxresults"].empty() ? 5000 : std::stoul(query["maxresults"]);
+
+        const int requestNumber = ++m_state->Requests;
+        auto running = ++m_state->Running;
+        for (auto max = m_state->MaxRunning.load(); max < running;)
+        {
+          m_state->MaxRunning.compare_exchange_weak(max, running);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(requestNumber * 7 % 5 + 1));
+        --m_state->Running;
+
+        if (m_state->FailingDirectories.count(directoryPath) != 0)
+        {
+          auto response = std::make_unique<Core::Http::RawResponse>(
+              1, 1, Core::Http::HttpStatusCode::Forbidden, "Forbidden");
+          response->AddHeader("x-ms-request-id", Core::Uuid::CreateUuid().GetUuidString());
+          return response;
+        }
+
+        // Files and directories right under the directory, by name, directories flagged true.
+        const std::string prefix = directoryPath.empty() ? std::string() : directoryPath + "/";
+        std::map<std::string, bool> entries;
+        for (auto i = m_state->FilePaths.lower_bound(prefix);
+             i != m_state->FilePaths.end() && i->compare(0, prefix.size(), prefix) == 0;
+             ++i)
+        {
+          auto separatorPos = i->find('/', prefix.size());
+          entries.emplace(
+              i->substr(prefix.size(), separatorPos - prefix.size()),
+              separatorPos != std::string::npos);
+        }
+
+        std::string body = "<?xml version=\"1.0\" encoding=\"utf-8\"?><EnumerationResults "
+                           "ServiceEndpoint=\"https://account.file.core.windows.net/\" "
+                           "ShareName=\"share\" DirectoryPath=\""
+            + directoryPath + "\"><Entries>";
+        std::size_t count = 0;
+        std::string nextMarker;
+        for (const auto& entry : entries)
+        {
+          if (entry.first <= marker)
+          {
+            continue;
+          }
+          if (count++ == maxResults)
+          {
+            break;
+          }
+          nextMarker = entry.first;
+          if (entry.second)
+          {
+            body += "<Directory><Name>" + entry.first + "</Name></Directory>";
+          }
+          else
+          {
+            body += "<File><Name>" + entry.first
+                + "</Name><Properties><Content-Length>0</Content-Length></Properties></File>";
+          }
+        }
+        body += "</Entries><NextMarker>" + (count > maxResults ? nextMarker : std::string())
+            + "</NextMarker></EnumerationResults>";
+
+        auto response = std::make_unique<Core::Http::RawResponse>(
+            1, 1, Core::Http::HttpStatusCode::Ok, "OK");
+        response->AddHeader("x-ms-request-id", Core::Uuid::CreateUuid().GetUuidString());
+        response->AddHeader("content-type", "application/xml");
+        response->SetBody(std::vector<uint8_t>(body.begin(), body.end()));
+        response->AddHeader("content-length", std::to_string(body.size()));
+        return response;
+      }
+
+    private:
+      std::shared_ptr<State> m_state;
+    };
+  } // namespace
+
+  TEST(ShareListParallelTest, ListsEachDirectoryOnce)
+  {
+    auto state = std::make_shared<MockListFilesAndDirectoriesPolicy::State>();
+    for (int i = 0; i < 4; ++i)
+    {
+      state->FilePaths.insert("top" + std::to_string(i));
+      for (int j = 0; j < 5; ++j)
+      {
+        state->FilePaths.insert("dir" + std::to_string(i) + "/file" + std::to_string(j));
+        for (int k = 0; k < 3; ++k)
+        {
+          state->FilePaths.insert(
+              "dir" + std::to_string(i) + "/sub" + std::to_string(j) + "/file"
+              + std::to_string(k));
+        }
+      }
+    }
+
+    Files::Shares::ShareClientOptions clientOptions;
+    clientOptions.PerRetryPolicies.emplace_back(
+        std::make_unique<MockListFilesAndDirectoriesPolicy>(state));
+    Files::Shares::ShareDirectoryClient rootDirectoryClient(
+        "https://account.file.core.windows.net/share", clientOptions);
+
+    // Pages only name the entries of their own directory, so the paths are rebuilt from the
+    // DirectoryPath of each page. The pages of a directory come in order, one after another.
+    Files::Shares::ListFilesAndDirectoriesParallelOptions options;
+    options.PageSizeHint = 4;
+    options.Concurrency = 4;
+    std::map<std::string, std::vector<std::string>> entriesByDirectory;
+    rootDirectoryClient.ListFilesAndDirectoriesParallel(
+        [&](Files::Shares::Models::ListFilesAndDirectoriesSinglePageResult page) {
+          EXPECT_LE(page.FileItems.size() + page.DirectoryItems.size(), 4U);
+          auto& entries = entriesByDirectory[page.DirectoryPath];
+          std::vector<std::string> pageEntries;
+          for (const auto& file : page.FileItems)
+          {
+            pageEntries.push_back(file.Name);
+          }
+          for (const auto& directory : page.DirectoryItems)
+          {
+            pageEntries.push_back(directory.Name);
+          }
+          std::sort(pageEntries.begin(), pageEntries.end());
+          EXPECT_TRUE(
+              entries.empty() || pageEntries.empty() || entries.back() < pageEntries.front());
+          entries.insert(entries.end(), pageEntries.begin(), pageEntries.end());
+        },
+        options);
+    EXPECT_EQ(entriesByDirectory.size(), 1U + 4U + 4U * 5U);
+    EXPECT_EQ(entriesByDirectory[""].size(), 4U + 4U);
+    EXPECT_EQ(entriesByDirectory["dir1"].size(), 5U + 5U);
+    EXPECT_EQ(
+        entriesByDirectory["dir3/sub4"], std::vector<std::string>({"file0", "file1", "file2"}));
+    EXPECT_LE(state->MaxRunning.load(), options.Concurrency);
+    EXPECT_GT(state->MaxRunning.load(), 1);
+
+    // Starting from a subdirectory client, only it and the directories under it are listed.
+    std::set<std::string> listedDirectories;
+    rootDirectoryClient.GetSubdirectoryClient("dir2").ListFilesAndDirectoriesParallel(
+        [&](Files::Shares::Models::ListFilesAndDirectoriesSinglePageResult page) {
+          listedDirectories.insert(page.DirectoryPath);
+        },
+        options);
+    EXPECT_EQ(
+        listedDirectories,
+        std::set<std::string>(
+            {"dir2", "dir2/sub0", "dir2/sub1", "dir2/sub2", "dir2/sub3", "dir2/sub4"}));
+  }
+
+  TEST(ShareListParallelTest, SubdirectoryErrorRethrown)
+  {
+    auto state = std::make_shared<MockListFilesAndDirectoriesPolicy::State>();
+    state->FilePaths.insert("dir/failing/file");
+    state->FailingDirectories.insert("dir/failing");
+    for (int i = 0; i < 100; ++i)
+    {
+      state->FilePaths.insert("large/file" + std::to_string(i));
+    }
+
+    Files::Shares::ShareClientOptions clientOptions;
+    clientOptions.PerRetryPolicies.emplace_back(
+        std::make_unique<MockListFilesAndDirectoriesPolicy>(state));
+    Files::Shares::ShareDirectoryClient rootDirectoryClient(
+        "https://account.file.core.windows.net/share", clientOptions);
+
+    // One page per entry. The error of a nested directory stops the listing of large, which
+    // runs alongside it.
+    Files::Shares::ListFilesAndDirectoriesParallelOptions options;
+    options.PageSizeHint = 1;
+    options.Concurrency = 2;
+    std::atomic<int> listedPages{0};
+    EXPECT_THROW(
+        rootDirectoryClient.ListFilesAndDirectoriesParallel(
+            [&listedPages](Files::Shares::Models::ListFilesAndDirectoriesSinglePageResult) {
+              ++listedPages;
+            },
+            options),
+        StorageException);
+    EXPECT_LT(state->Requests.load(), 50);
+    EXPECT_LT(listedPages.load(), 50);
+  }
 }}} // namespace Azure::Storage::Test